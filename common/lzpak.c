@@ -0,0 +1,197 @@
+/*
+ * lzpak.c -- small lz77 codec for compressed pak files
+ * Copyright (C) 2026  uHexen2 developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "q_stdinc.h"
+#include "lzpak.h"
+
+#define	LZ_HASHBITS	14
+#define	LZ_HASHSIZE	(1 << LZ_HASHBITS)
+
+static unsigned int LZ_Read32 (const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned int LZ_Hash (const unsigned char *p)
+{
+	return (LZ_Read32(p) * 2654435761U) >> (32 - LZ_HASHBITS);
+}
+
+int LZ_CompressBound (int inlen)
+{
+	return inlen + inlen / 255 + 16;
+}
+
+/* writes the remainder of a length which didn't fit in its nibble */
+static unsigned char *LZ_PutLength (unsigned char *op, int len)
+{
+	for ( ; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char) len;
+	return op;
+}
+
+static unsigned char *LZ_PutSequence (unsigned char *op, const unsigned char *lit,
+					int litlen, int offset, int matchlen)
+{
+	unsigned char	*token = op++;
+	int	ml = matchlen - LZ_MINMATCH;
+
+	*token = (unsigned char) (((litlen < 15) ? litlen : 15) << 4);
+	if (litlen >= 15)
+		op = LZ_PutLength (op, litlen - 15);
+	memcpy (op, lit, litlen);
+	op += litlen;
+
+	if (!matchlen)	/* last sequence */
+		return op;
+
+	*token |= (ml < 15) ? ml : 15;
+	*op++ = offset & 0xff;
+	*op++ = (offset >> 8) & 0xff;
+	if (ml >= 15)
+		op = LZ_PutLength (op, ml - 15);
+	return op;
+}
+
+/*
+==============
+LZ_Compress
+
+Greedy matcher on a single-entry hash of the next four bytes.
+==============
+*/
+int LZ_Compress (const unsigned char *in, int inlen, unsigned char *out, int outmax)
+{
+	static int	table[LZ_HASHSIZE];	/* not reentrant: tools only */
+	const unsigned char	*ip, *anchor, *ref, *iend, *mlimit;
+	unsigned char	*op, *buf;
+	unsigned int	h;
+	int	len, size;
+
+	buf = (unsigned char *) malloc (LZ_CompressBound(inlen));
+	if (!buf)
+		return 0;
+
+	memset (table, -1, sizeof(table));
+	ip = anchor = in;
+	iend = in + inlen;
+	mlimit = iend - LZ_MINMATCH;
+	op = buf;
+
+	while (ip < mlimit)
+	{
+		h = LZ_Hash (ip);
+		ref = (table[h] >= 0) ? in + table[h] : NULL;
+		table[h] = (int)(ip - in);
+		if (!ref || ip - ref > LZ_MAXOFFSET || LZ_Read32(ref) != LZ_Read32(ip))
+		{
+			ip++;
+			continue;
+		}
+
+		for (len = LZ_MINMATCH; ip + len < iend && ref[len] == ip[len]; len++)
+			;
+		op = LZ_PutSequence (op, anchor, (int)(ip - anchor), (int)(ip - ref), len);
+		ip += len;
+		anchor = ip;
+	}
+	op = LZ_PutSequence (op, anchor, (int)(iend - anchor), 0, 0);
+
+	size = (int)(op - buf);
+	if (size > outmax)
+		size = 0;
+	else	memcpy (out, buf, size);
+	free (buf);
+
+	return size;
+}
+
+/*
+==============
+LZ_Decompress
+==============
+*/
+int LZ_Decompress (const unsigned char *in, int inlen, unsigned char *out, int outlen)
+{
+	const unsigned char	*ip = in, *iend = in + inlen;
+	unsigned char		*op = out, *oend = out + outlen;
+	const unsigned char	*ref;
+	int	token, len, offset, c;
+
+	while (ip < iend)
+	{
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == 15)
+		{
+			do {
+				if (ip >= iend)
+					return -1;
+				c = *ip++;
+				len += c;
+			} while (c == 255);
+		}
+		if (len > iend - ip || len > oend - op)
+			return -1;
+		memcpy (op, ip, len);
+		ip += len;
+		op += len;
+
+		if (ip == iend)	/* last sequence */
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - out)
+			return -1;
+		ref = op - offset;
+
+		len = token & 15;
+		if (len == 15)
+		{
+			do {
+				if (ip >= iend)
+					return -1;
+				c = *ip++;
+				len += c;
+			} while (c == 255);
+		}
+		len += LZ_MINMATCH;
+		if (len > oend - op)
+			return -1;
+		while (len--)	/* may overlap */
+			*op++ = *ref++;
+	}
+
+	return (int)(op - out);
+}
+
+unsigned int PAKZ_HashName (const char *name)
+{
+	unsigned int	i, hash = 0;
+
+	for (i = 0; *name; i++)
+		hash += (unsigned char)(*name++) * (i + 119);
+	return hash;
+}
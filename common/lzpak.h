@@ -0,0 +1,49 @@
+/*
+ * lzpak.h -- small lz77 codec for compressed pak files
+ * Copyright (C) 2026  uHexen2 developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __LZPAK_H
+#define __LZPAK_H
+
+/* The stream is a series of sequences: a token byte holding the literal
+ * count in its high nibble and the match length minus LZ_MINMATCH in its
+ * low nibble, extra length bytes for either when the nibble is 15, the
+ * literals, then a two byte little endian match offset.  The last sequence
+ * carries only literals.  Every block is compressed on its own.  */
+
+#define	LZ_MINMATCH	4
+#define	LZ_MAXOFFSET	65535
+
+int LZ_CompressBound (int inlen);
+	/* worst case compressed size of inlen bytes. */
+
+int LZ_Compress (const unsigned char *in, int inlen, unsigned char *out, int outmax);
+	/* returns the compressed size, or 0 if it wouldn't fit in outmax bytes. */
+
+int LZ_Decompress (const unsigned char *in, int inlen, unsigned char *out, int outlen);
+	/* returns the number of bytes written, which must be outlen for a
+	 * good block, or -1 if the input is corrupt.  never reads or writes
+	 * outside of the given buffers.  */
+
+unsigned int PAKZ_HashName (const char *name);
+	/* the name hash stored in PAKZ directories: the same sum as the
+	 * engine's case sensitive Hash_GenerateKeyString, before masking. */
+
+#endif	/* __LZPAK_H */
+
@@ -40,6 +40,42 @@ typedef struct
 	int		dirlen;
 } dpackheader_t;
 
+/* compressed pak: same idea, but the directory is sorted by name with
+ * the engine's name hash precomputed, file data is aligned and may be
+ * split into independently compressed blocks so that big files can be
+ * decompressed in parallel.  */
+
+// Little-endian "PAKZ"
+#define IDPAKZHEADER		(('Z'<<24)+('K'<<16)+('A'<<8)+'P')
+#define	PAKZ_VERSION		1
+#define	PAKZ_ALIGN		16
+#define	PAKZ_BLOCKSIZE		65536
+
+#define	PAKZ_STORED		0	/* raw data at filepos */
+#define	PAKZ_LZBLOCKS		1	/* block table at filepos, see below */
+
+typedef struct
+{
+	char	name[PAK_PATH_LENGTH];	/* 7-bit ascii only */
+	unsigned int	hash;		/* PAKZ_HashName (name), see lzpak.h */
+	int		filepos;	/* PAKZ_ALIGN aligned */
+	int		filelen;	/* uncompressed size */
+	int		packlen;	/* bytes at filepos */
+	int		method;
+} dpackzfile_t;
+
+/* a PAKZ_LZBLOCKS file starts with numblocks+1 offsets relative to filepos,
+ * numblocks being filelen / PAKZ_BLOCKSIZE rounded up: block i is at
+ * [ofs[i], ofs[i+1]), and is stored raw if that is a whole block.  */
+
+typedef struct
+{
+	char	id[4];		/* "PAKZ" */
+	int		version;
+	int		dirofs;
+	int		numfiles;
+} dpackzheader_t;
+
 #define	packfile_t	dpackfile_t
 #define	packheader_t	dpackheader_t
 #define	MAX_FILES_IN_PACK	2048
@@ -39,6 +39,7 @@ void CFG_ReadCvars (const char **vars, int num_vars)
 {
 	char	buff[1024], *tmp;
 	int			i, j;
+	size_t		len;
 
 	if (!cfg_file || num_vars < 1)
 		return;
@@ -87,8 +88,8 @@ void CFG_ReadCvars (const char **vars, int num_vars)
 			for (i = 0; i < num_vars && vars[i]; i++)
 			{
 				// look for the cvar name + one space
-				tmp = strstr(buff, va("%s ",vars[i]));
-				if (tmp != buff)
+				len = strlen(vars[i]);
+				if (strncmp(buff, vars[i], len) || buff[len] != ' ')
 					continue;
 				// locate the first quotation mark
 				tmp = strchr(buff, '\"');
@@ -152,23 +153,15 @@ void CFG_CloseConfig (void)
 
 int CFG_OpenConfig (const char *cfg_name)
 {
-	FILE	*f;
-	long	length;
-	qboolean	pak;
-
 	CFG_CloseConfig ();
 
-	length = FS_OpenFile (cfg_name, &f, NULL);
-	pak = file_from_pak;
-	if (length < 0)
-		return -1;
-
 	cfg_file = (fshandle_t *) Z_Malloc(sizeof(fshandle_t), Z_MAINZONE);
-	cfg_file->file = f;
-	cfg_file->start = ftell(f);
-	cfg_file->pos = 0;
-	cfg_file->length = length;
-	cfg_file->pak = pak;
+	if (FS_OpenHandle (cfg_name, cfg_file, NULL) < 0)
+	{
+		Z_Free(cfg_file);
+		cfg_file = NULL;
+		return -1;
+	}
 
 	return 0;
 }
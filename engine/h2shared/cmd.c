@@ -19,6 +19,7 @@
  */
 
 #include "quakedef.h"
+#include "hashindex.h"
 
 #define	MAX_ALIAS_NAME	32
 #define	MAX_ARGS	80
@@ -45,6 +46,10 @@ typedef struct cmd_function_s
 static cmdalias_t	*cmd_alias = NULL;
 static cmd_function_t	*cmd_functions = NULL;
 
+/* the lists above are for listing, the lookups go through these */
+static hashnames_t	alias_names;
+static hashnames_t	cmd_names;
+
 static	int			cmd_argc;
 static	char		*cmd_argv[MAX_ARGS];
 static	char		cmd_null_string[] = "";
@@ -361,15 +366,10 @@ static void Cmd_Alias_f (void)
 
 	if (Cmd_Argc() == 2)
 	{
-		for (a = cmd_alias ; a ; a = a->next)
-		{
-			if ( !strcmp(s, a->name) )
-			{
-				Con_Printf ("%s : %s\n", s, a->value);
-				return;
-			}
-		}
-		Con_Printf ("No alias named %s\n", s);
+		a = (cmdalias_t *) HashNames_Find (&alias_names, s, true);
+		if (a)
+			Con_Printf ("%s : %s\n", s, a->value);
+		else	Con_Printf ("No alias named %s\n", s);
 		return;
 	}
 
@@ -380,22 +380,19 @@ static void Cmd_Alias_f (void)
 	}
 
 	// if the alias already exists, reuse it
-	for (a = cmd_alias ; a ; a = a->next)
+	a = (cmdalias_t *) HashNames_Find (&alias_names, s, true);
+	if (a)
 	{
-		if ( !strcmp(s, a->name) )
-		{
-			Z_Free (a->value);
-			break;
-		}
+		Z_Free (a->value);
 	}
-
-	if (!a)
+	else
 	{
 		a = (cmdalias_t *) Z_Malloc (sizeof(cmdalias_t), Z_MAINZONE);
 		a->next = cmd_alias;
 		cmd_alias = a;
+		strcpy (a->name, s);
+		HashNames_Add (&alias_names, a->name, a);
 	}
-	strcpy (a->name, s);
 
 // copy the rest of the command line
 	cmd[0] = 0;		// start out with a null string
@@ -418,39 +415,51 @@ static void Cmd_Alias_f (void)
 
 /*
 ===============
-Cmd_Unalias_f
-
-Delete an alias
+Cmd_RemoveAlias
 ===============
 */
-void Cmd_Unalias_f (void)
+static qboolean Cmd_RemoveAlias (const char *name)
 {
 	cmdalias_t	*prev = NULL, *a;
 
-	if (Cmd_Argc() != 2)
-	{
-		Con_Printf("unalias <name> : delete alias\n"
-			   "unaliasall : delete all aliases\n");
-		return;
-	}
-
 	for (a = cmd_alias ; a ; a=a->next)
 	{
-		if ( !strcmp(Cmd_Argv(1), a->name) )
+		if ( !strcmp(name, a->name) )
 		{
 			if (prev)
 				prev->next = a->next;
 			else
 				cmd_alias  = a->next;
 
+			HashNames_Remove (&alias_names, a->name, a);
 			Z_Free (a->value);
 			Z_Free (a);
-			return;
+			return true;
 		}
 		prev = a;
 	}
 
-	Con_Printf ("No alias named %s\n", Cmd_Argv(1));
+	return false;
+}
+
+/*
+===============
+Cmd_Unalias_f
+
+Delete an alias
+===============
+*/
+void Cmd_Unalias_f (void)
+{
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf("unalias <name> : delete alias\n"
+			   "unaliasall : delete all aliases\n");
+		return;
+	}
+
+	if (!Cmd_RemoveAlias (Cmd_Argv(1)))
+		Con_Printf ("No alias named %s\n", Cmd_Argv(1));
 }
 
 /*
@@ -471,6 +480,7 @@ void Cmd_Unaliasall_f (void)
 		Z_Free(cmd_alias);
 		cmd_alias = a;
 	}
+	HashNames_Clear (&alias_names);
 }
 
 /*
@@ -589,13 +599,10 @@ void Cmd_AddCommand (const char *cmd_name, xcommand_t function)
 	}
 
 // fail if the command already exists
-	for (cmd = cmd_functions ; cmd ; cmd = cmd->next)
+	if (HashNames_Find (&cmd_names, cmd_name, true))
 	{
-		if ( !strcmp(cmd_name, cmd->name) )
-		{
-			Con_Printf ("%s: %s already defined\n", __thisfunc__, cmd_name);
-			return;
-		}
+		Con_Printf ("%s: %s already defined\n", __thisfunc__, cmd_name);
+		return;
 	}
 
 	cmd = (cmd_function_t *) Hunk_AllocName (sizeof(cmd_function_t), "commands");
@@ -603,6 +610,7 @@ void Cmd_AddCommand (const char *cmd_name, xcommand_t function)
 	cmd->function = function;
 	cmd->next = cmd_functions;
 	cmd_functions = cmd;
+	HashNames_Add (&cmd_names, cmd->name, cmd);
 }
 
 /*
@@ -612,15 +620,7 @@ Cmd_Exists
 */
 qboolean Cmd_Exists (const char *cmd_name)
 {
-	cmd_function_t	*cmd;
-
-	for (cmd = cmd_functions ; cmd ; cmd = cmd->next)
-	{
-		if ( !strcmp(cmd_name, cmd->name) )
-			return true;
-	}
-
-	return false;
+	return (HashNames_Find (&cmd_names, cmd_name, true) != NULL);
 }
 
 
@@ -631,28 +631,14 @@ Cmd_CheckCommand
 */
 qboolean Cmd_CheckCommand (const char *partial)
 {
-	cmd_function_t	*cmd;
-	cmdalias_t	*a;
-	cvar_t		*var;
-
 	if (!partial || !partial[0])
 		return false;
-	for (cmd = cmd_functions ; cmd ; cmd = cmd->next)
-	{
-		if ( !strcmp(partial, cmd->name) )
-			return true;
-	}
-	var = Cvar_FindVarAfter ("", CVAR_NONE);
-	for ( ; var ; var = var->next)
-	{
-		if ( !strcmp(partial, var->name) )
-			return true;
-	}
-	for (a = cmd_alias ; a ; a = a->next)
-	{
-		if ( !strcmp(partial, a->name) )
-			return true;
-	}
+	if (HashNames_Find (&cmd_names, partial, true))
+		return true;
+	if (Cvar_FindVar (partial))
+		return true;
+	if (HashNames_Find (&alias_names, partial, true))
+		return true;
 
 	return false;
 }
@@ -660,6 +646,8 @@ qboolean Cmd_CheckCommand (const char *partial)
 /*
 ============
 Cmd_MoveToFront
+
+Only changes the order of the listings, now that the lookups are hashed.
 ============
 */
 void Cmd_MoveToFront (const char *name)
@@ -686,7 +674,6 @@ void Cmd_MoveToFront (const char *name)
 Cmd_ExecuteString
 
 A complete command line has been parsed, so try to execute it
-FIXME: lookupnoadd the token to speed search?
 ============
 */
 void Cmd_ExecuteString (const char *text, cmd_source_t src)
@@ -702,33 +689,29 @@ void Cmd_ExecuteString (const char *text, cmd_source_t src)
 		return;		// no tokens
 
 // check functions
-	for (cmd = cmd_functions ; cmd ; cmd = cmd->next)
+	cmd = (cmd_function_t *) HashNames_Find (&cmd_names, cmd_argv[0], false);
+	if (cmd)
 	{
-		if ( !q_strcasecmp(cmd_argv[0], cmd->name) )
-		{
 #if defined(H2W)
-			if (!cmd->function)
+		if (!cmd->function)
 #  ifndef SERVERONLY
-				Cmd_ForwardToServer ();
+			Cmd_ForwardToServer ();
 #  else
-				Sys_Printf ("FIXME: command %s has NULL handler function\n", cmd->name);
+			Sys_Printf ("FIXME: command %s has NULL handler function\n", cmd->name);
 #  endif
-			else
+		else
 #endif
-				cmd->function ();
+			cmd->function ();
 
-			return;
-		}
+		return;
 	}
 
 // check alias
-	for (a = cmd_alias ; a ; a = a->next)
+	a = (cmdalias_t *) HashNames_Find (&alias_names, cmd_argv[0], false);
+	if (a)
 	{
-		if ( !q_strcasecmp(cmd_argv[0], a->name) )
-		{
-			Cbuf_InsertText (a->value);
-			return;
-		}
+		Cbuf_InsertText (a->value);
+		return;
 	}
 
 // check cvars
@@ -937,6 +920,197 @@ static void Cmd_WriteCommands_f (void)
 }
 #endif
 
+/*
+============
+Cmd_Bench_f
+
+cmdbench [lines] : runs a made up config of that many lines through the
+command buffer the way exec does: cvars set to the values they already
+have, aliases defined and called.  Then times the lookups of the same
+names through the hash tables against walking the lists.
+============
+*/
+#define	BENCH_ALIASES	256
+
+static void Cmd_Bench_f (void)
+{
+	char	(*aliasnames)[MAX_ALIAS_NAME];
+	const char	**names;
+	char	*text, *p, *end, *saved;
+	cmd_function_t	*cmd;
+	cmdalias_t	*a;
+	cvar_t		*var, *firstvar;
+	size_t	len, textsize, textlen;
+	int	i, r, numlines, numaliases, numcvars, numvars, found, savedsize;
+	int	lines_cvar, lines_alias, lines_cmd;
+	double	t1, t2, t3, t4;
+
+	numlines = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : 20000;
+	if (numlines < 16 || numlines > 1000000)
+	{
+		Con_Printf ("cmdbench [lines] : lines between 16 and 1000000\n");
+		return;
+	}
+	numaliases = numlines / 4;
+	if (numaliases > BENCH_ALIASES)
+		numaliases = BENCH_ALIASES;
+
+	/* the cvars which can be set from a line to what they are */
+	firstvar = Cvar_FindVarAfter ("", CVAR_NONE);
+	numcvars = numvars = 0;
+	for (var = firstvar; var; var = var->next, numvars++)
+	{
+		if (!strchr(var->string, '\"') && !strchr(var->string, '\n') &&
+		    strlen(var->name) + strlen(var->string) < 256)
+			numcvars++;
+	}
+
+	aliasnames = (char (*)[MAX_ALIAS_NAME]) malloc (numaliases * MAX_ALIAS_NAME);
+	names = (const char **) malloc (numlines * sizeof(const char *));
+	textsize = (size_t)numlines * 64;
+	text = (char *) malloc (textsize);
+	if (!aliasnames || !names || !text)
+		Sys_Error ("%s: out of memory", __thisfunc__);
+
+	/* make up the config */
+	textlen = 0;
+	lines_cvar = lines_alias = lines_cmd = 0;
+	var = firstvar;
+	for (i = 0; i < numlines; i++)
+	{
+		if (textsize - textlen < 300)
+		{
+			textsize *= 2;
+			text = (char *) realloc (text, textsize);
+			if (!text)
+				Sys_Error ("%s: out of memory", __thisfunc__);
+		}
+		p = text + textlen;
+		if (i < numaliases)
+		{
+			q_snprintf (aliasnames[i], MAX_ALIAS_NAME, "cmdbench_%d", i);
+			len = q_snprintf (p, 300, "alias %s \"\"\n", aliasnames[i]);
+			names[i] = "alias";
+			lines_cmd++;
+		}
+		else if ((i & 3) == 1 || ((i & 1) == 0 && !numcvars))
+		{
+			len = q_snprintf (p, 300, "%s\n", aliasnames[i % numaliases]);
+			names[i] = aliasnames[i % numaliases];
+			lines_alias++;
+		}
+		else if ((i & 3) == 3)
+		{
+			len = q_snprintf (p, 300, "alias %s \"\"\n", aliasnames[i % numaliases]);
+			names[i] = "alias";
+			lines_cmd++;
+		}
+		else
+		{
+			do {
+				var = (var && var->next) ? var->next : firstvar;
+			} while (strchr(var->string, '\"') || strchr(var->string, '\n') ||
+				 strlen(var->name) + strlen(var->string) >= 256);
+			len = q_snprintf (p, 300, "%s \"%s\"\n", var->name, var->string);
+			names[i] = var->name;
+			lines_cvar++;
+		}
+		textlen += len;
+	}
+
+	/* run it through the command buffer in whole lines, keeping aside
+	 * what the buffer held */
+	savedsize = cmd_text.cursize;
+	saved = (char *) malloc (savedsize + 1);
+	if (!saved)
+		Sys_Error ("%s: out of memory", __thisfunc__);
+	memcpy (saved, cmd_text.data, savedsize);
+	SZ_Clear (&cmd_text);
+
+	t1 = Sys_DoubleTime ();
+	for (p = text; p < text + textlen; p = end)
+	{
+		end = p + cmd_text.maxsize / 2;
+		if (end >= text + textlen)
+			end = text + textlen;
+		else
+		{
+			while (end[-1] != '\n')
+				end--;
+		}
+		SZ_Write (&cmd_text, p, end - p);
+		Cbuf_Execute ();
+	}
+	t1 = Sys_DoubleTime () - t1;
+
+	SZ_Clear (&cmd_text);
+	SZ_Write (&cmd_text, saved, savedsize);
+	free (saved);
+
+	/* the same lookups Cmd_ExecuteString does, hashed and walked */
+	found = 0;
+	t2 = Sys_DoubleTime ();
+	for (r = 0; r < 10; r++)
+	{
+		for (i = 0; i < numlines; i++)
+		{
+			if (HashNames_Find(&cmd_names, names[i], false) ||
+			    HashNames_Find(&alias_names, names[i], false) ||
+			    Cvar_FindVar(names[i]))
+				found++;
+		}
+	}
+	t3 = Sys_DoubleTime ();
+	for (r = 0; r < 10; r++)
+	{
+		for (i = 0; i < numlines; i++)
+		{
+			for (cmd = cmd_functions; cmd; cmd = cmd->next)
+			{
+				if (!q_strcasecmp(names[i], cmd->name))
+					break;
+			}
+			if (cmd)
+			{
+				found++;
+				continue;
+			}
+			for (a = cmd_alias; a; a = a->next)
+			{
+				if (!q_strcasecmp(names[i], a->name))
+					break;
+			}
+			if (a)
+			{
+				found++;
+				continue;
+			}
+			for (var = firstvar; var; var = var->next)
+			{
+				if (!strcmp(names[i], var->name))
+					break;
+			}
+			if (var)
+				found++;
+		}
+	}
+	t4 = Sys_DoubleTime ();
+
+	Con_Printf ("%d lines (%d cvars, %d aliases, %d commands) executed in %.1f ms\n",
+			numlines, lines_cvar, lines_alias, lines_cmd, t1 * 1000.0);
+	Con_Printf ("%d lookups over %d commands, %d aliases, %d cvars:\n"
+			"hashed %.2f ms, list walk %.2f ms%s\n",
+			numlines * 10, cmd_names.count, alias_names.count, numvars,
+			(t3 - t2) * 1000.0, (t4 - t3) * 1000.0,
+			(found != numlines * 20) ? " (MISMATCH)" : "");
+
+	for (i = 0; i < numaliases; i++)
+		Cmd_RemoveAlias (aliasnames[i]);
+	free (text);
+	free ((void *) names);
+	free (aliasnames);
+}
+
 /*
 ============
 Cmd_Init
@@ -954,6 +1128,7 @@ void Cmd_Init (void)
 	Cmd_AddCommand ("unalias",Cmd_Unalias_f);
 	Cmd_AddCommand ("unaliasall",Cmd_Unaliasall_f);
 	Cmd_AddCommand ("wait", Cmd_Wait_f);
+	Cmd_AddCommand ("cmdbench", Cmd_Bench_f);
 #ifndef SERVERONLY
 	Cmd_AddCommand ("commands", Cmd_WriteCommands_f);
 	Cmd_AddCommand ("cmdlist", Cmd_List_f);
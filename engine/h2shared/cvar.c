@@ -21,8 +21,10 @@
  */
 
 #include "quakedef.h"
+#include "hashindex.h"
 
-static	cvar_t	*cvar_vars;
+static	cvar_t	*cvar_vars;	// for listing, the lookups go through cvar_names
+static	hashnames_t	cvar_names;
 static	char	cvar_null_string[] = "";
 
 /*
@@ -32,15 +34,7 @@ Cvar_FindVar
 */
 cvar_t *Cvar_FindVar (const char *var_name)
 {
-	cvar_t	*var;
-
-	for (var = cvar_vars ; var ; var = var->next)
-	{
-		if (!strcmp (var_name, var->name))
-			return var;
-	}
-
-	return NULL;
+	return (cvar_t *) HashNames_Find (&cvar_names, var_name, true);
 }
 
 cvar_t *Cvar_FindVarAfter (const char *prev_name, unsigned int with_flags)
@@ -297,6 +291,7 @@ void Cvar_RegisterVariable (cvar_t *variable)
 // link the variable in
 	variable->next = cvar_vars;
 	cvar_vars = variable;
+	HashNames_Add (&cvar_names, variable->name, variable);
 	variable->flags |= CVAR_REGISTERED;
 
 // copy the value off, because future sets will Z_Free it
@@ -359,6 +354,8 @@ qboolean	Cvar_Command (void)
 /*
 ============
 Cvar_MoveToFront
+
+Only changes the order of the listings, now that the lookups are hashed.
 ============
 */
 void Cvar_MoveToFront (const char *name)
@@ -37,8 +37,22 @@ static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 static void Mod_LoadAliasModelNew (qmodel_t *mod, void *buffer);
 
 static void Mod_Print (void);
+static void Mod_FlushPVSCache (void);
+static void Mod_PVSCache_f (void);
 
 static cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
+static cvar_t	gl_bspcache = {"gl_bspcache", "1", CVAR_ARCHIVE};
+
+/* the world model to write to the bsp cache */
+static struct
+{
+	qboolean	first;		/* no brush model loaded since Mod_ClearAll */
+	qmodel_t	*mod;		/* to be written after R_NewMap */
+	int		bspsize, bspcrc;
+	int		numleafs;	/* what the model doesn't keep */
+	int		vissize, lightsize, entsize;
+	int		entity_file_size;
+} bspcache = { true };
 
 static byte	mod_novis[MAX_MAP_LEAFS/8];
 
@@ -65,9 +79,12 @@ Mod_Init
 void Mod_Init (void)
 {
 	Cvar_RegisterVariable (&external_ents);
+	Cvar_RegisterVariable (&gl_bspcache);
 	Cmd_AddCommand ("mcache", Mod_Print);
 
 	memset (mod_novis, 0xff, sizeof(mod_novis));
+	Mod_FlushPVSCache ();
+	Cmd_AddCommand ("pvscache", Mod_PVSCache_f);
 
 	Hash_Allocate (&hash_mod, MAX_MOD_KNOWN);
 }
@@ -127,6 +144,98 @@ mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model)
 }
 
 
+/*
+===============================================================================
+
+PVS ROW CACHE
+
+Mod_LeafPVS keeps the last PVS_CACHE_ROWS rows it decompressed, most
+recently used first, so that the leafs asked for again and again (the
+view leaf, the leafs around each client for the fat pvs) are decoded
+once.  A returned row stays valid until PVS_CACHE_ROWS other rows have
+been decompressed after it was last asked for, or until the next map.
+
+===============================================================================
+*/
+
+#define	PVS_CACHE_ROWS	64
+#define	PVS_CACHE_HASH	128
+#define	PVS_ROWBYTES	(((MAX_MAP_LEAFS+31)>>5)<<2)	/* SV_CalcPHS copies whole words */
+
+typedef struct pvsrow_s
+{
+	const byte	*in;		/* the compressed row, NULL if unused */
+	int		rowsize;
+	struct pvsrow_s	*prev, *next;	/* in the use order */
+	struct pvsrow_s	*hashnext;
+} pvsrow_t;
+
+static pvsrow_t	pvs_rows[PVS_CACHE_ROWS];
+static pvsrow_t	*pvs_hash[PVS_CACHE_HASH];
+static pvsrow_t	*pvs_mru, *pvs_lru;
+static byte	pvs_data[PVS_CACHE_ROWS][PVS_ROWBYTES];
+static int	pvs_hits, pvs_misses;
+
+#define	PVS_HashRow(in)	((int)(((size_t)(in) ^ ((size_t)(in) >> 7)) & (PVS_CACHE_HASH-1)))
+
+static void Mod_FlushPVSCache (void)
+{
+	int		i;
+
+	memset (pvs_hash, 0, sizeof(pvs_hash));
+	for (i = 0; i < PVS_CACHE_ROWS; i++)
+	{
+		pvs_rows[i].in = NULL;
+		pvs_rows[i].hashnext = NULL;
+		pvs_rows[i].prev = (i > 0) ? &pvs_rows[i-1] : NULL;
+		pvs_rows[i].next = (i < PVS_CACHE_ROWS-1) ? &pvs_rows[i+1] : NULL;
+	}
+	pvs_mru = &pvs_rows[0];
+	pvs_lru = &pvs_rows[PVS_CACHE_ROWS-1];
+}
+
+static void Mod_TouchPVSRow (pvsrow_t *r)
+{
+	if (r == pvs_mru)
+		return;
+	r->prev->next = r->next;
+	if (r->next)
+		r->next->prev = r->prev;
+	else	pvs_lru = r->prev;
+	r->prev = NULL;
+	r->next = pvs_mru;
+	pvs_mru->prev = r;
+	pvs_mru = r;
+}
+
+static void Mod_UnhashPVSRow (pvsrow_t *r)
+{
+	pvsrow_t	**link;
+
+	for (link = &pvs_hash[PVS_HashRow(r->in)]; *link; link = &(*link)->hashnext)
+	{
+		if (*link == r)
+		{
+			*link = r->hashnext;
+			break;
+		}
+	}
+	r->hashnext = NULL;
+	r->in = NULL;
+}
+
+static void Mod_PVSCache_f (void)
+{
+	int		lookups = pvs_hits + pvs_misses;
+
+	Con_Printf ("pvs rows    %d cached, %d bytes each\n", PVS_CACHE_ROWS, PVS_ROWBYTES);
+	Con_Printf ("hits        %d\n", pvs_hits);
+	Con_Printf ("misses      %d\n", pvs_misses);
+	Con_Printf ("hit rate    %.1f%%\n", lookups ? 100.0 * pvs_hits / lookups : 0.0);
+	if (Cmd_Argc() > 1 && !q_strcasecmp(Cmd_Argv(1), "reset"))
+		pvs_hits = pvs_misses = 0;
+}
+
 /*
 ===================
 Mod_DecompressVis
@@ -134,25 +243,35 @@ Mod_DecompressVis
 */
 static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 {
-	static byte	decompressed[MAX_MAP_LEAFS/8];
-	int		c;
-	byte	*out;
-	int		row;
+	const byte	*key = in;
+	pvsrow_t	*r;
+	byte	*out, *end;
+	int		c, row, h;
 
-	row = (model->numleafs+7)>>3;
-	out = decompressed;
+	if (!in)	// no vis info, so make all visible
+		return mod_novis;
 
-	if (!in)
-	{	// no vis info, so make all visible
-		while (row)
+	row = (model->numleafs+7)>>3;
+	h = PVS_HashRow(in);
+	for (r = pvs_hash[h]; r; r = r->hashnext)
+	{
+		if (r->in == key && r->rowsize == row)
 		{
-			*out++ = 0xff;
-			row--;
+			pvs_hits++;
+			Mod_TouchPVSRow (r);
+			return pvs_data[r - pvs_rows];
 		}
-		return decompressed;
 	}
+	pvs_misses++;
+
+// take the least recently used row
+	r = pvs_lru;
+	if (r->in)
+		Mod_UnhashPVSRow (r);
+	out = pvs_data[r - pvs_rows];
+	end = out + row;
 
-	do
+	while (out < end)
 	{
 		if (*in)
 		{
@@ -162,14 +281,19 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 
 		c = in[1];
 		in += 2;
-		while (c)
-		{
-			*out++ = 0;
-			c--;
-		}
-	} while (out - decompressed < row);
-
-	return decompressed;
+		if (c > end - out)	// don't run past the row
+			c = end - out;
+		memset (out, 0, c);
+		out += c;
+	}
+	memset (end, 0, ((row + 3) & ~3) - row);
+
+	r->in = key;
+	r->rowsize = row;
+	r->hashnext = pvs_hash[h];
+	pvs_hash[h] = r;
+	Mod_TouchPVSRow (r);
+	return pvs_data[r - pvs_rows];
 }
 
 byte *Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model)
@@ -211,6 +335,12 @@ void Mod_ClearAll (void)
 			mod->needload = NL_UNREFERENCED;
 		}
 	}
+
+	Mod_FlushPVSCache ();
+
+	// the next brush model is the world of a new map
+	bspcache.first = true;
+	bspcache.mod = NULL;
 }
 
 /*
@@ -288,6 +418,34 @@ void Mod_TouchModel (const char *name)
 	}
 }
 
+/*
+==================
+Mod_Prefetch
+
+Queues the file of a model which Mod_ForName is going to load for
+FS_Prefetch.
+==================
+*/
+void Mod_Prefetch (const char *name)
+{
+	qmodel_t	*mod;
+
+	if (name[0] == '*')	/* a submodel of the world */
+		return;
+
+	mod = Mod_FindName (name);
+	if (mod->type == mod_alias)
+	{
+		if (Cache_Check(&mod->cache))
+			return;
+	}
+	else if (mod->needload == NL_PRESENT)
+	{
+		return;
+	}
+	FS_Prefetch (mod->name, NULL);
+}
+
 /*
 ==================
 Mod_LoadModel
@@ -386,8 +544,44 @@ qmodel_t *Mod_ForName (const char *name, qboolean crash)
 */
 
 static byte	*mod_base;
+static int	mod_lightsize, mod_entsize;	/* -1 if from an external file */
 
 
+/*
+=================
+Mod_UploadTexture
+=================
+*/
+static void Mod_UploadTexture (texture_t *tx, const char *name)
+{
+	if (!strncmp(name,"sky",3))
+		R_InitSky (tx);
+	else
+	{
+		// Try external texture file (PNG, TGA, PCX) first
+		byte	*external_data;
+		int		ext_width, ext_height;
+		qboolean	has_alpha;
+		int		tex_flags;
+
+		external_data = IMG_LoadExternalTexture(name, &ext_width, &ext_height, &has_alpha);
+		if (external_data)
+		{
+			// External texture loaded successfully
+			tex_flags = TEX_MIPMAP | TEX_RGBA;
+			if (has_alpha)
+				tex_flags |= TEX_ALPHA;
+			tx->gl_texturenum = GL_LoadTexture(name, external_data, ext_width, ext_height, tex_flags);
+			free(external_data);
+		}
+		else
+		{
+			// Fall back to internal BSP texture
+			tx->gl_texturenum = GL_LoadTexture(name, (byte *)(tx+1), tx->width, tx->height, TEX_MIPMAP);
+		}
+	}
+}
+
 /*
 =================
 Mod_LoadTextures
@@ -506,32 +700,7 @@ bsp_tex_internal:
 			continue;
 #endif
 
-		if (!strncmp(mt->name,"sky",3))
-			R_InitSky (tx);
-		else
-		{
-			// Try external texture file (PNG, TGA, PCX) first
-			byte	*external_data;
-			int		ext_width, ext_height;
-			qboolean	has_alpha;
-			int		tex_flags;
-
-			external_data = IMG_LoadExternalTexture(mt->name, &ext_width, &ext_height, &has_alpha);
-			if (external_data)
-			{
-				// External texture loaded successfully
-				tex_flags = TEX_MIPMAP | TEX_RGBA;
-				if (has_alpha)
-					tex_flags |= TEX_ALPHA;
-				tx->gl_texturenum = GL_LoadTexture(mt->name, external_data, ext_width, ext_height, tex_flags);
-				free(external_data);
-			}
-			else
-			{
-				// Fall back to internal BSP texture
-				tx->gl_texturenum = GL_LoadTexture(mt->name, (byte *)(tx+1), tx->width, tx->height, TEX_MIPMAP);
-			}
-		}
+		Mod_UploadTexture (tx, mt->name);
 	}
 
 //
@@ -704,10 +873,10 @@ void Mod_ReloadTextures (void)
 
 /*
 =================
-Mod_LoadLighting
+Mod_SetupLighting
 =================
 */
-static void Mod_LoadLighting (lump_t *l)
+static void Mod_SetupLighting (void)
 {
 	GL_SetupLightmapFmt();	// setup the lightmap format to reflect any
 				// changes via the cvar gl_lightmapfmt
@@ -716,6 +885,16 @@ static void Mod_LoadLighting (lump_t *l)
 	if (gl_coloredlight.integer < 0)
 		Cvar_Set ("gl_coloredlight", "0");
 	gl_coloredstatic = gl_coloredlight.integer;
+}
+
+/*
+=================
+Mod_LoadLighting
+=================
+*/
+static void Mod_LoadLighting (lump_t *l)
+{
+	mod_lightsize = -1;	/* from a .lit file unless set below */
 
 	if (gl_lightmap_format == GL_RGBA)
 	{
@@ -822,6 +1001,7 @@ static void Mod_LoadLighting (lump_t *l)
 		}
   _load_internal:
 		// no .lit found, expand the white lighting data to color
+		mod_lightsize = l->filelen*3;
 		if (!l->filelen)
 			return;
 		loadmodel->lightdata = (byte *) Hunk_AllocName (l->filelen*3, "light");
@@ -839,6 +1019,7 @@ static void Mod_LoadLighting (lump_t *l)
 	}
 	else
 	{
+		mod_lightsize = l->filelen;
 		if (!l->filelen)
 		{
 			loadmodel->lightdata = NULL;
@@ -880,6 +1061,7 @@ static void Mod_LoadEntities (lump_t *l)
 	int		mark;
 	unsigned int	path_id;
 
+	mod_entsize = -1;	/* from an .ent file unless set below */
 	if (! external_ents.integer)
 		goto _load_embedded;
 
@@ -910,6 +1092,7 @@ static void Mod_LoadEntities (lump_t *l)
 	}
 
 _load_embedded:
+	mod_entsize = l->filelen;
 	if (!l->filelen)
 	{
 		loadmodel->entities = NULL;
@@ -1916,6 +2099,579 @@ static float RadiusFromBounds (const vec3_t mins, const vec3_t maxs)
 	return VectorLength (corner);
 }
 
+/*
+=================
+Mod_SetupSubmodels
+
+Sets up the submodels (FIXME: this is confusing)
+=================
+*/
+static void Mod_SetupSubmodels (qmodel_t *mod)
+{
+	int			i, j;
+	dmodel_t	*bm;
+
+	for (i = 0; i < mod->numsubmodels; i++)
+	{
+		bm = &mod->submodels[i];
+
+		mod->hulls[0].firstclipnode = bm->headnode[0];
+		for (j = 1; j < MAX_MAP_HULLS; j++)
+		{
+			mod->hulls[j].firstclipnode = bm->headnode[j];
+			mod->hulls[j].lastclipnode = mod->numclipnodes-1;
+		}
+
+		mod->firstmodelsurface = bm->firstface;
+		mod->nummodelsurfaces = bm->numfaces;
+
+		VectorCopy (bm->maxs, mod->maxs);
+		VectorCopy (bm->mins, mod->mins);
+
+		mod->radius = RadiusFromBounds (mod->mins, mod->maxs);
+
+		mod->numleafs = bm->visleafs;
+
+		if (i < mod->numsubmodels-1)
+		{	// duplicate the basic information
+			char	name[10];
+
+			q_snprintf (name, sizeof(name), "*%i", i+1);
+			loadmodel = Mod_FindName (name);
+			*loadmodel = *mod;
+			strcpy (loadmodel->name, name);
+			mod = loadmodel;
+		}
+	}
+}
+
+/*
+==============================================================================
+
+BSP CACHE
+
+Once R_NewMap has built the display lists of a world model, the model is
+written to maps/<name>.bspc in the user directory as it is in memory: all
+of it in one block, its pointers turned into offsets into the block, and
+a list of where those pointers are.  Loading the same bsp again reads the
+block into the hunk at once and adds its address to the pointers instead
+of parsing the lumps, subdividing the warps and building the polygons.
+The file is only good for the bsp it was made from and for the build that
+wrote it, whose structure layout it has.
+
+==============================================================================
+*/
+
+#define	BSPCACHE_VERSION	1
+#define	BSPCACHE_ALIGN		16
+
+typedef struct
+{
+	char		id[4];		/* "BSPC" */
+	int		version;
+	char		build[64];	/* the engine and its structure sizes */
+	int		bspsize;	/* the bsp it was made from */
+	int		bspcrc;
+	int		lightmapfmt;	/* the settings it was made with */
+	int		keeptjunctions;
+	int		entity_file_size;
+	int		datasize;	/* the model data, starting with its qmodel_t */
+	int		numrelocs;	/* offsets of the pointers in the data */
+	int		numnotexture;	/* offsets of the pointers to r_notexture_mip */
+} bspcacheheader_t;
+
+typedef struct
+{
+	const byte	*base;		/* a piece of the model in memory */
+	int		size;
+	int		ofs;		/* and where it goes in the data */
+} bspcacherange_t;
+
+typedef struct
+{
+	byte		*data;
+	int		datasize;
+	bspcacherange_t	*ranges;	/* sorted by base once all are added */
+	int		numranges, maxranges;
+	int		*relocs;
+	int		numrelocs, maxrelocs;
+	int		*notexture;
+	int		numnotexture, maxnotexture;
+	qboolean	bad;
+} bspcachewriter_t;
+
+static void Mod_BrushCacheName (qmodel_t *mod, char *name, size_t size)
+{
+	q_strlcpy (name, mod->name, size);
+	COM_StripExtension (name, name, size);
+	q_strlcat (name, ".bspc", size);
+}
+
+static void Mod_BrushCacheBuild (char *build, size_t size)
+{
+	q_snprintf (build, size, "%s %s %d/%d/%d/%d/%d/%d/%d", ENGINE_NAME, HOT_VERSION_STR,
+			(int)sizeof(void *), (int)sizeof(qmodel_t), (int)sizeof(msurface_t),
+			(int)sizeof(mnode_t), (int)sizeof(mleaf_t), (int)sizeof(texture_t),
+			(int)sizeof(glpoly_t));
+}
+
+static qboolean Mod_HasExternalLump (qmodel_t *mod, const char *ext)
+{
+	char		name[MAX_QPATH];
+	unsigned int	path_id;
+
+	q_strlcpy (name, mod->name, sizeof(name));
+	COM_StripExtension (name, name, sizeof(name));
+	q_strlcat (name, ext, sizeof(name));
+	return FS_FileExists (name, &path_id) && path_id >= mod->path_id;
+}
+
+/*
+=================
+Mod_BrushCacheable
+
+Only the world model is cached, which is the first brush model loaded for
+a map.  Maps with a .lit or an .ent file aren't, those may change.
+=================
+*/
+static qboolean Mod_BrushCacheable (qmodel_t *mod)
+{
+	qboolean	first = bspcache.first;
+
+	bspcache.first = false;
+	if (!first || !gl_bspcache.integer)
+		return false;
+#ifdef H2W
+	if (Mod_isnotmap())
+		return false;
+#endif
+#ifdef WAL_TEXTURES
+	if (r_texture_external.integer)
+		return false;
+#endif
+	if (gl_lightmap_format == GL_RGBA && gl_coloredlight.integer && Mod_HasExternalLump(mod, ".lit"))
+		return false;
+	if (external_ents.integer && Mod_HasExternalLump(mod, ".ent"))
+		return false;
+	return true;
+}
+
+/*
+=================
+Mod_ReadBrushCache
+=================
+*/
+static qboolean Mod_ReadBrushCache (qmodel_t *mod, int bspsize, int bspcrc)
+{
+	bspcacheheader_t	header;
+	qmodel_t	*cached;
+	char	name[MAX_QPATH], path[MAX_OSPATH], build[64];
+	FILE	*f;
+	byte	*data;
+	int	*relocs;
+	int	i, count, ofs, mark, err;
+	intptr_t	v;
+	long	len;
+
+	Mod_BrushCacheName (mod, name, sizeof(name));
+	FS_MakePath_BUF (FS_USERDIR, &err, path, sizeof(path), name);
+	if (err)
+		return false;
+	f = fopen (path, "rb");
+	if (!f)
+		return false;
+
+	Mod_BrushCacheBuild (build, sizeof(build));
+	if (fread(&header, 1, sizeof(header), f) != sizeof(header) ||
+		memcmp(header.id, "BSPC", 4) || header.version != BSPCACHE_VERSION ||
+		strncmp(header.build, build, sizeof(header.build)) ||
+		header.bspsize != bspsize || header.bspcrc != bspcrc ||
+		header.lightmapfmt != gl_lightmap_format ||
+		header.keeptjunctions != gl_keeptjunctions.integer)
+	{	// made from something else, it will be replaced
+		fclose (f);
+		return false;
+	}
+
+	count = header.numrelocs + header.numnotexture;
+	fseek (f, 0, SEEK_END);
+	len = ftell (f);
+	fseek (f, sizeof(header), SEEK_SET);
+	if (header.datasize < (int)sizeof(qmodel_t) || header.numrelocs < 0 || header.numnotexture < 0 ||
+		len != (long)(sizeof(header) + header.datasize + count * sizeof(int)))
+	{
+		fclose (f);
+		Con_Printf ("%s is corrupt\n", name);
+		return false;
+	}
+
+	// not Hunk_TempAlloc for the relocations: the bsp may be there
+	mark = Hunk_LowMark ();
+	data = (byte *) Hunk_AllocName (header.datasize, "bspcache");
+	relocs = (int *) malloc ((count + 1) * sizeof(int));
+	if (!relocs || fread(data, 1, header.datasize, f) != (size_t)header.datasize ||
+		fread(relocs, sizeof(int), count, f) != (size_t)count)
+		goto corrupt;
+	fclose (f);
+	f = NULL;
+
+	for (i = 0; i < count; i++)
+	{
+		ofs = relocs[i];
+		if (ofs < 0 || ofs > header.datasize - (int)sizeof(void *) || (ofs % sizeof(void *)))
+			goto corrupt;
+		if (i >= header.numrelocs)
+		{
+			*(texture_t **)(data + ofs) = r_notexture_mip;
+			continue;
+		}
+		v = *(intptr_t *)(data + ofs);
+		if (v < 0 || v > header.datasize)
+			goto corrupt;
+		*(byte **)(data + ofs) = data + v;
+	}
+	free (relocs);
+	relocs = NULL;
+
+	cached = (qmodel_t *) data;
+	if (cached->type != mod_brush || cached->numsubmodels < 1)
+		goto corrupt;
+	memcpy (cached->name, mod->name, sizeof(cached->name));
+	cached->path_id = mod->path_id;
+	cached->needload = mod->needload;
+	*mod = *cached;
+
+	for (i = 0; i < mod->numtextures; i++)
+	{
+		if (!mod->textures[i])
+			continue;
+#if !defined (H2W)
+		if (cls.state == ca_dedicated)
+			break;
+#endif
+		Mod_UploadTexture (mod->textures[i], mod->textures[i]->name);
+	}
+#ifndef H2W
+	entity_file_size = header.entity_file_size;
+#endif
+
+	Con_DPrintf ("Loaded %s from %s\n", mod->name, name);
+	return true;
+
+corrupt:
+	if (f)
+		fclose (f);
+	free (relocs);
+	Hunk_FreeToLowMark (mark);
+	Con_Printf ("%s is corrupt\n", name);
+	return false;
+}
+
+static qboolean BspCache_Grow (void **list, int num, int *max, size_t size)
+{
+	void	*p;
+
+	if (num < *max)
+		return true;
+	p = realloc (*list, (*max ? *max * 2 : 1024) * size);
+	if (!p)
+		return false;
+	*list = p;
+	*max = *max ? *max * 2 : 1024;
+	return true;
+}
+
+static void BspCache_AddRange (bspcachewriter_t *w, const void *base, int size)
+{
+	bspcacherange_t	*r;
+
+	if (!base)
+		return;
+	if (!BspCache_Grow ((void **)&w->ranges, w->numranges, &w->maxranges, sizeof(bspcacherange_t)))
+	{
+		w->bad = true;
+		return;
+	}
+	r = &w->ranges[w->numranges++];
+	r->base = (const byte *) base;
+	r->size = size;
+	r->ofs = w->datasize;
+	w->datasize += (size + BSPCACHE_ALIGN - 1) & ~(BSPCACHE_ALIGN - 1);
+}
+
+static int BspCache_CompareRanges (const void *a, const void *b)
+{
+	const byte	*pa = ((const bspcacherange_t *)a)->base;
+	const byte	*pb = ((const bspcacherange_t *)b)->base;
+
+	return (pa < pb) ? -1 : (pa > pb);
+}
+
+/* where p goes in the data, -1 if it isn't a part of the model */
+static int BspCache_Offset (bspcachewriter_t *w, const void *p)
+{
+	int	lo, hi, mid;
+
+	lo = 0;
+	hi = w->numranges - 1;
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		if (w->ranges[mid].base <= (const byte *)p)
+			lo = mid + 1;
+		else	hi = mid - 1;
+	}
+	if (hi < 0 || (const byte *)p > w->ranges[hi].base + w->ranges[hi].size)
+		return -1;
+	return w->ranges[hi].ofs + (int)((const byte *)p - w->ranges[hi].base);
+}
+
+/* the copy of a piece of the model in the data */
+static void *BspCache_Copy (bspcachewriter_t *w, const void *p)
+{
+	int	ofs = BspCache_Offset (w, p);
+
+	if (ofs < 0)
+	{
+		w->bad = true;
+		return NULL;
+	}
+	return w->data + ofs;
+}
+
+/* turns a pointer in the data into an offset and notes where it is */
+static void BspCache_Pointer (bspcachewriter_t *w, void *field)
+{
+	void	*p = *(void **)field;
+	int	ofs, where;
+
+	if (!p)
+		return;
+	where = (int)((byte *)field - w->data);
+	*(void **)field = NULL;
+	if (p == (void *) r_notexture_mip)
+	{
+		if (!BspCache_Grow ((void **)&w->notexture, w->numnotexture, &w->maxnotexture, sizeof(int)))
+			w->bad = true;
+		else	w->notexture[w->numnotexture++] = where;
+		return;
+	}
+	ofs = BspCache_Offset (w, p);
+	if (ofs < 0 || !BspCache_Grow ((void **)&w->relocs, w->numrelocs, &w->maxrelocs, sizeof(int)))
+	{
+		w->bad = true;
+		return;
+	}
+	*(intptr_t *)field = ofs;
+	w->relocs[w->numrelocs++] = where;
+}
+
+/*
+=================
+Mod_WriteBrushCache
+
+Called by R_NewMap once the display lists are built.  Writes the cache
+of the world model if it was just loaded from its bsp.
+=================
+*/
+void Mod_WriteBrushCache (qmodel_t *mod)
+{
+	bspcachewriter_t	w;
+	bspcacheheader_t	header;
+	qmodel_t	*out;
+	texture_t	*tx, **txs;
+	mtexinfo_t	*ti;
+	msurface_t	*surf, **mark;
+	mnode_t		*node;
+	mleaf_t		*leaf;
+	glpoly_t	*p, *poly;
+	char	name[MAX_QPATH], path[MAX_OSPATH];
+	FILE	*f;
+	int	i, j, err;
+	double	t;
+
+	if (!mod || mod != bspcache.mod)
+		return;
+	bspcache.mod = NULL;
+	t = Sys_DoubleTime ();
+
+	memset (&w, 0, sizeof(w));
+	BspCache_AddRange (&w, mod, sizeof(qmodel_t));	/* at offset 0 */
+	BspCache_AddRange (&w, mod->submodels, mod->numsubmodels * sizeof(dmodel_t));
+	BspCache_AddRange (&w, mod->planes, mod->numplanes * sizeof(mplane_t));
+	BspCache_AddRange (&w, mod->leafs, bspcache.numleafs * sizeof(mleaf_t));
+	BspCache_AddRange (&w, mod->vertexes, mod->numvertexes * sizeof(mvertex_t));
+	BspCache_AddRange (&w, mod->edges, (mod->numedges + 1) * sizeof(medge_t));
+	BspCache_AddRange (&w, mod->nodes, mod->numnodes * sizeof(mnode_t));
+	BspCache_AddRange (&w, mod->texinfo, mod->numtexinfo * sizeof(mtexinfo_t));
+	BspCache_AddRange (&w, mod->surfaces, mod->numsurfaces * sizeof(msurface_t));
+	BspCache_AddRange (&w, mod->surfedges, mod->numsurfedges * sizeof(int));
+	BspCache_AddRange (&w, mod->clipnodes, mod->numclipnodes * sizeof(mclipnode_t));
+	BspCache_AddRange (&w, mod->hulls[0].clipnodes, mod->numnodes * sizeof(mclipnode_t));
+	BspCache_AddRange (&w, mod->marksurfaces, mod->nummarksurfaces * sizeof(msurface_t *));
+	BspCache_AddRange (&w, mod->textures, mod->numtextures * sizeof(texture_t *));
+	for (i = 0; i < mod->numtextures; i++)
+	{
+		tx = mod->textures[i];
+		if (tx)
+			BspCache_AddRange (&w, tx, sizeof(texture_t) + tx->width*tx->height/64*85);
+	}
+	BspCache_AddRange (&w, mod->visdata, bspcache.vissize);
+	BspCache_AddRange (&w, mod->lightdata, bspcache.lightsize);
+	BspCache_AddRange (&w, mod->entities, bspcache.entsize);
+	for (i = 0; i < mod->numsurfaces; i++)
+	{
+		for (p = mod->surfaces[i].polys; p; p = p->next)
+			BspCache_AddRange (&w, p, sizeof(glpoly_t) + (p->numverts-4) * VERTEXSIZE*sizeof(float));
+	}
+	if (w.bad || !(w.data = (byte *) calloc (1, w.datasize)))
+		goto done;
+	for (i = 0; i < w.numranges; i++)
+		memcpy (w.data + w.ranges[i].ofs, w.ranges[i].base, w.ranges[i].size);
+	qsort (w.ranges, w.numranges, sizeof(bspcacherange_t), BspCache_CompareRanges);
+
+// turn the pointers into offsets, clearing what is only good for a frame
+	out = (qmodel_t *) w.data;
+	memset (&out->cache, 0, sizeof(out->cache));
+	out->ex_flags = 0;
+	memset (out->glow_settings, 0, sizeof(out->glow_settings));
+	memset (out->glow_color, 0, sizeof(out->glow_color));
+	BspCache_Pointer (&w, &out->submodels);
+	BspCache_Pointer (&w, &out->planes);
+	BspCache_Pointer (&w, &out->leafs);
+	BspCache_Pointer (&w, &out->vertexes);
+	BspCache_Pointer (&w, &out->edges);
+	BspCache_Pointer (&w, &out->nodes);
+	BspCache_Pointer (&w, &out->texinfo);
+	BspCache_Pointer (&w, &out->surfaces);
+	BspCache_Pointer (&w, &out->surfedges);
+	BspCache_Pointer (&w, &out->clipnodes);
+	BspCache_Pointer (&w, &out->marksurfaces);
+	for (i = 0; i < MAX_MAP_HULLS; i++)
+	{
+		BspCache_Pointer (&w, &out->hulls[i].clipnodes);
+		BspCache_Pointer (&w, &out->hulls[i].planes);
+	}
+	BspCache_Pointer (&w, &out->textures);
+	BspCache_Pointer (&w, &out->visdata);
+	BspCache_Pointer (&w, &out->lightdata);
+	BspCache_Pointer (&w, &out->entities);
+
+	if (mod->numtextures)
+	{
+		txs = (texture_t **) BspCache_Copy (&w, mod->textures);
+		for (i = 0; txs && i < mod->numtextures; i++)
+		{
+			if (!mod->textures[i])
+				continue;
+			tx = (texture_t *) BspCache_Copy (&w, mod->textures[i]);
+			if (!tx)
+				break;
+			tx->gl_texturenum = 0;
+			tx->texturechain = NULL;
+			BspCache_Pointer (&w, &tx->anim_next);
+			BspCache_Pointer (&w, &tx->alternate_anims);
+			BspCache_Pointer (&w, &txs[i]);
+		}
+	}
+	ti = (mtexinfo_t *) BspCache_Copy (&w, mod->texinfo);
+	for (i = 0; ti && i < mod->numtexinfo; i++, ti++)
+		BspCache_Pointer (&w, &ti->texture);
+	surf = (msurface_t *) BspCache_Copy (&w, mod->surfaces);
+	for (i = 0; surf && i < mod->numsurfaces; i++, surf++)
+	{
+		surf->visframe = 0;
+		surf->texturechain = NULL;
+		surf->dlightframe = 0;
+		surf->dlightbits = 0;
+		memset (surf->cached_light, 0, sizeof(surf->cached_light));
+		surf->cached_dlight = false;
+		for (p = mod->surfaces[i].polys; p; p = p->next)
+		{
+			poly = (glpoly_t *) BspCache_Copy (&w, p);
+			if (!poly)
+				break;
+			poly->chain = NULL;
+			BspCache_Pointer (&w, &poly->next);
+		}
+		BspCache_Pointer (&w, &surf->plane);
+		BspCache_Pointer (&w, &surf->polys);
+		BspCache_Pointer (&w, &surf->texinfo);
+		BspCache_Pointer (&w, &surf->samples);
+	}
+	mark = (msurface_t **) BspCache_Copy (&w, mod->marksurfaces);
+	for (i = 0; mark && i < mod->nummarksurfaces; i++)
+		BspCache_Pointer (&w, &mark[i]);
+	node = (mnode_t *) BspCache_Copy (&w, mod->nodes);
+	for (i = 0; node && i < mod->numnodes; i++, node++)
+	{
+		node->visframe = 0;
+		BspCache_Pointer (&w, &node->parent);
+		BspCache_Pointer (&w, &node->plane);
+		for (j = 0; j < 2; j++)
+			BspCache_Pointer (&w, &node->children[j]);
+	}
+	leaf = (mleaf_t *) BspCache_Copy (&w, mod->leafs);
+	for (i = 0; leaf && i < bspcache.numleafs; i++, leaf++)
+	{
+		leaf->visframe = 0;
+		leaf->efrags = NULL;
+		BspCache_Pointer (&w, &leaf->parent);
+		BspCache_Pointer (&w, &leaf->compressed_vis);
+		BspCache_Pointer (&w, &leaf->firstmarksurface);
+	}
+	if (w.bad)
+		goto done;
+
+	memset (&header, 0, sizeof(header));
+	memcpy (header.id, "BSPC", 4);
+	header.version = BSPCACHE_VERSION;
+	Mod_BrushCacheBuild (header.build, sizeof(header.build));
+	header.bspsize = bspcache.bspsize;
+	header.bspcrc = bspcache.bspcrc;
+	header.lightmapfmt = gl_lightmap_format;
+	header.keeptjunctions = gl_keeptjunctions.integer;
+	header.entity_file_size = bspcache.entity_file_size;
+	header.datasize = w.datasize;
+	header.numrelocs = w.numrelocs;
+	header.numnotexture = w.numnotexture;
+
+	Mod_BrushCacheName (mod, name, sizeof(name));
+	FS_MakePath_BUF (FS_USERDIR, &err, path, sizeof(path), name);
+	if (err || FS_CreatePath(path))
+	{
+		Con_Printf ("Couldn't create the path for %s\n", name);
+		goto done;
+	}
+	f = fopen (path, "wb");
+	if (!f)
+	{
+		Con_Printf ("Couldn't write %s\n", name);
+		goto done;
+	}
+	err  = (fwrite(&header, 1, sizeof(header), f) != sizeof(header));
+	err |= (fwrite(w.data, 1, w.datasize, f) != (size_t)w.datasize);
+	err |= (fwrite(w.relocs, sizeof(int), w.numrelocs, f) != (size_t)w.numrelocs);
+	err |= (fwrite(w.notexture, sizeof(int), w.numnotexture, f) != (size_t)w.numnotexture);
+	err |= fclose (f);
+	if (err)
+	{	// don't leave a runt behind
+		Con_Printf ("Couldn't write %s\n", name);
+		remove (path);
+		goto done;
+	}
+	Con_DPrintf ("Wrote %s: %d KB, %d pointers, in %.1f ms\n", name, w.datasize >> 10,
+			w.numrelocs + w.numnotexture, (Sys_DoubleTime () - t) * 1000.0);
+
+done:
+	if (w.bad)
+		Con_DPrintf ("%s: couldn't cache %s\n", __thisfunc__, mod->name);
+	free (w.data);
+	free (w.ranges);
+	free (w.relocs);
+	free (w.notexture);
+}
+
 /*
 =================
 Mod_LoadBrushModel
@@ -1923,12 +2679,15 @@ Mod_LoadBrushModel
 */
 static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 {
-	int			i, j;
+	int			i;
 	dheader_t	*header;
-	dmodel_t	*bm;
 	qboolean	bsp2 = false;
+	qboolean	cacheable;
+	int			bspsize, bspcrc;
+	double		t;
 
 	loadmodel->type = mod_brush;
+	Mod_FlushPVSCache ();	// the rows may be at the same addresses
 
 	header = (dheader_t *)buffer;
 
@@ -1943,6 +2702,25 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 	if (i != BSPVERSION)
 		Sys_Error ("%s: %s has unsupported version %i", __thisfunc__, mod->name, i);
 
+	Mod_SetupLighting ();
+
+// see if it was cached, the bsp was just loaded so fs_filesize is its size
+	t = Sys_DoubleTime ();
+	bspsize = (int) fs_filesize;
+	bspcrc = 0;
+	cacheable = Mod_BrushCacheable (mod);
+	if (cacheable)
+	{
+		bspcrc = CRC_Block ((byte *)buffer, bspsize);
+		if (Mod_ReadBrushCache (mod, bspsize, bspcrc))
+		{
+			Mod_SetupSubmodels (mod);
+			Con_DPrintf ("%s: cached model loaded in %.1f ms\n", mod->name,
+					(Sys_DoubleTime () - t) * 1000.0);
+			return;
+		}
+	}
+
 // swap all the lumps
 	mod_base = (byte *)header;
 
@@ -1970,41 +2748,23 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 
 	mod->numframes = 2;		// regular and alternate animation
 
-//
-// set up the submodels (FIXME: this is confusing)
-//
-	for (i = 0; i < mod->numsubmodels; i++)
-	{
-		bm = &mod->submodels[i];
-
-		mod->hulls[0].firstclipnode = bm->headnode[0];
-		for (j = 1; j < MAX_MAP_HULLS; j++)
-		{
-			mod->hulls[j].firstclipnode = bm->headnode[j];
-			mod->hulls[j].lastclipnode = mod->numclipnodes-1;
-		}
-
-		mod->firstmodelsurface = bm->firstface;
-		mod->nummodelsurfaces = bm->numfaces;
-
-		VectorCopy (bm->maxs, mod->maxs);
-		VectorCopy (bm->mins, mod->mins);
-
-		mod->radius = RadiusFromBounds (mod->mins, mod->maxs);
-
-		mod->numleafs = bm->visleafs;
-
-		if (i < mod->numsubmodels-1)
-		{	// duplicate the basic information
-			char	name[10];
-
-			q_snprintf (name, sizeof(name), "*%i", i+1);
-			loadmodel = Mod_FindName (name);
-			*loadmodel = *mod;
-			strcpy (loadmodel->name, name);
-			mod = loadmodel;
-		}
+	if (cacheable && mod_lightsize >= 0 && mod_entsize >= 0)
+	{	// written by R_NewMap once the polygons are built
+		bspcache.mod = mod;
+		bspcache.bspsize = bspsize;
+		bspcache.bspcrc = bspcrc;
+		bspcache.numleafs = mod->numleafs;
+		bspcache.vissize = header->lumps[LUMP_VISIBILITY].filelen;
+		bspcache.lightsize = mod_lightsize;
+		bspcache.entsize = mod_entsize;
+#ifndef H2W
+		bspcache.entity_file_size = entity_file_size;
+#endif
 	}
+
+	Mod_SetupSubmodels (mod);
+	if (cacheable)
+		Con_DPrintf ("%s: model loaded in %.1f ms\n", mod->name, (Sys_DoubleTime () - t) * 1000.0);
 }
 
 /*
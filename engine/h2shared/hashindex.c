@@ -49,6 +49,71 @@ void Hash_Allocate(hashindex_t *hi, int hashSize)
 	hi->hashMask = hashSize - 1;
 }
 
+/*
+================
+Hash_AllocateHunk
+
+same as Hash_Allocate, but the tables live on the hunk and go away
+with it: meant for indexes over other hunk data, e.g. the progs. the
+caller must zero the hashindex_t before reusing it, never Hash_Free.
+================
+*/
+void Hash_AllocateHunk(hashindex_t *hi, int hashSize, const char *name)
+{
+	if (!Hash_IsPowerOfTwo(hashSize))
+		Sys_Error("%s: has size %d is not power of two", __thisfunc__, hashSize);
+
+	if (hi->hash != NULL)
+		Sys_Error("%s: hash is already initialized", __thisfunc__);
+
+	hi->hashSize = hashSize;
+	hi->hash = (int *) Hunk_AllocName(sizeof(int) * hi->hashSize, name);
+	memset(hi->hash, NULL_INDEX, hi->hashSize * sizeof(hi->hash[0]));
+	hi->indexChain = (int *) Hunk_AllocName(sizeof(int) * hi->hashSize, name);
+	memset(hi->indexChain, NULL_INDEX, hi->hashSize * sizeof(hi->indexChain[0]));
+	hi->hashMask = hashSize - 1;
+}
+
+/*
+================
+Hash_AllocateMalloc
+
+same as Hash_Allocate, but the tables are malloc'ed: meant for indexes
+too big for the zone which must outlive the hunk, e.g. the file index.
+free them with Hash_FreeMalloc.
+================
+*/
+void Hash_AllocateMalloc(hashindex_t *hi, int hashSize)
+{
+	if (!Hash_IsPowerOfTwo(hashSize))
+		Sys_Error("%s: has size %d is not power of two", __thisfunc__, hashSize);
+
+	if (hi->hash != NULL)
+		Sys_Error("%s: hash is already initialized", __thisfunc__);
+
+	hi->hashSize = hashSize;
+	hi->hash = (int *) malloc(sizeof(int) * hi->hashSize);
+	hi->indexChain = (int *) malloc(sizeof(int) * hi->hashSize);
+	if (!hi->hash || !hi->indexChain)
+		Sys_Error("%s: failed on allocation of %d entries", __thisfunc__, hashSize);
+	memset(hi->hash, NULL_INDEX, hi->hashSize * sizeof(hi->hash[0]));
+	memset(hi->indexChain, NULL_INDEX, hi->hashSize * sizeof(hi->indexChain[0]));
+	hi->hashMask = hashSize - 1;
+}
+
+/*
+================
+Hash_FreeMalloc
+================
+*/
+void Hash_FreeMalloc(hashindex_t *hi)
+{
+	free(hi->hash);
+	free(hi->indexChain);
+	hi->hash = NULL;
+	hi->indexChain = NULL;
+}
+
 /*
 ================
 Hash_Free
@@ -133,3 +198,112 @@ void Hash_Clear(hashindex_t *hi)
 	// only clear the hash table because clearing the indexChain is not really needed
 	memset(hi->hash, NULL_INDEX, hi->hashSize * sizeof(hi->hash[0]));
 }
+
+
+/*
+================
+HashNames_Rehash
+
+add all the names to the hash again, oldest first, so that the
+newest of the names which only differ in case is found first
+================
+*/
+static void HashNames_Rehash(hashnames_t *hn)
+{
+	int i;
+
+	Hash_Clear(&hn->hash);
+	for (i = 0; i < hn->count; i++)
+		Hash_Add(&hn->hash, Hash_GenerateKeyString(&hn->hash, hn->names[i], false), i);
+}
+
+/*
+================
+HashNames_Add
+================
+*/
+void HashNames_Add(hashnames_t *hn, const char *name, void *item)
+{
+	int size;
+
+	if (hn->count == hn->hash.hashSize)
+	{
+		size = (hn->hash.hashSize) ? hn->hash.hashSize * 2 : 256;
+		hn->names = (const char **) realloc(hn->names, size * sizeof(hn->names[0]));
+		hn->items = (void **) realloc(hn->items, size * sizeof(hn->items[0]));
+		if (!hn->names || !hn->items)
+			Sys_Error("%s: failed on allocation of %d entries", __thisfunc__, size);
+		Hash_FreeMalloc(&hn->hash);
+		Hash_AllocateMalloc(&hn->hash, size);
+		HashNames_Rehash(hn);
+	}
+
+	hn->names[hn->count] = name;
+	hn->items[hn->count] = item;
+	Hash_Add(&hn->hash, Hash_GenerateKeyString(&hn->hash, name, false), hn->count);
+	hn->count++;
+}
+
+/*
+================
+HashNames_Remove
+================
+*/
+void HashNames_Remove(hashnames_t *hn, const char *name, void *item)
+{
+	int i;
+
+	if (!hn->count)
+		return;
+	i = Hash_First(&hn->hash, Hash_GenerateKeyString(&hn->hash, name, false));
+	for ( ; i != NULL_INDEX; i = Hash_Next(&hn->hash, i))
+	{
+		if (hn->items[i] == item)
+			break;
+	}
+	if (i == NULL_INDEX)
+		return;
+
+	hn->count--;
+	memmove(&hn->names[i], &hn->names[i + 1], (hn->count - i) * sizeof(hn->names[0]));
+	memmove(&hn->items[i], &hn->items[i + 1], (hn->count - i) * sizeof(hn->items[0]));
+	HashNames_Rehash(hn);
+}
+
+/*
+================
+HashNames_Clear
+================
+*/
+void HashNames_Clear(hashnames_t *hn)
+{
+	hn->count = 0;
+	Hash_Clear(&hn->hash);
+}
+
+/*
+================
+HashNames_Find
+
+returns the item of that name, or NULL
+================
+*/
+void *HashNames_Find(hashnames_t *hn, const char *name, qboolean caseSensitive)
+{
+	int i;
+
+	if (!hn->count)
+		return NULL;
+	i = Hash_First(&hn->hash, Hash_GenerateKeyString(&hn->hash, name, false));
+	for ( ; i != NULL_INDEX; i = Hash_Next(&hn->hash, i))
+	{
+		if (caseSensitive) {
+			if (!strcmp(hn->names[i], name))
+				return hn->items[i];
+		} else {
+			if (!q_strcasecmp(hn->names[i], name))
+				return hn->items[i];
+		}
+	}
+	return NULL;
+}
@@ -32,7 +32,10 @@ typedef struct hashindex_s
 } hashindex_t;
 
 void Hash_Allocate(hashindex_t *hi, int hashSize);
+void Hash_AllocateHunk(hashindex_t *hi, int hashSize, const char *name);
+void Hash_AllocateMalloc(hashindex_t *hi, int hashSize);
 void Hash_Free(hashindex_t *hi);
+void Hash_FreeMalloc(hashindex_t *hi);
 void Hash_Add(hashindex_t *hi, int key, int index);
 void Hash_Remove(hashindex_t *hi, int key, int index);
 void Hash_Clear(hashindex_t *hi);
@@ -92,4 +95,24 @@ static inline int Hash_GenerateKeyInt(hashindex_t *hi, int n)
 	return n & hi->hashMask;
 }
 
+/*
+ * a table of names over a hashindex_t, for things which live elsewhere and
+ * are looked up by name, such as the cvars, commands and aliases.  names
+ * are hashed without regard to case so that both kinds of lookup can use
+ * the same table.  the tables are malloc'ed and grow as needed, the names
+ * must stay valid while they are in the table.
+ */
+typedef struct hashnames_s
+{
+	hashindex_t hash;
+	const char **names;
+	void **items;
+	int count;
+} hashnames_t;
+
+void HashNames_Add(hashnames_t *hn, const char *name, void *item);
+void HashNames_Remove(hashnames_t *hn, const char *name, void *item);
+void HashNames_Clear(hashnames_t *hn);
+void *HashNames_Find(hashnames_t *hn, const char *name, qboolean caseSensitive);
+
 #endif /* !HASHINDEX_H_ */
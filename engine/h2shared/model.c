@@ -37,6 +37,8 @@ static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
 static void Mod_LoadAliasModelNew (qmodel_t *mod, void *buffer);
 
 static void Mod_Print (void);
+static void Mod_FlushPVSCache (void);
+static void Mod_PVSCache_f (void);
 
 static cvar_t	external_ents = {"external_ents", "1", CVAR_ARCHIVE};
 
@@ -65,6 +67,8 @@ void Mod_Init (void)
 	Cmd_AddCommand ("mcache", Mod_Print);
 
 	memset (mod_novis, 0xff, sizeof(mod_novis));
+	Mod_FlushPVSCache ();
+	Cmd_AddCommand ("pvscache", Mod_PVSCache_f);
 
 	Hash_Allocate (&hash_mod, MAX_MOD_KNOWN);
 }
@@ -124,6 +128,98 @@ mleaf_t *Mod_PointInLeaf (vec3_t p, qmodel_t *model)
 }
 
 
+/*
+===============================================================================
+
+PVS ROW CACHE
+
+Mod_LeafPVS keeps the last PVS_CACHE_ROWS rows it decompressed, most
+recently used first, so that the leafs asked for again and again (the
+view leaf, the leafs around each client for the fat pvs) are decoded
+once.  A returned row stays valid until PVS_CACHE_ROWS other rows have
+been decompressed after it was last asked for, or until the next map.
+
+===============================================================================
+*/
+
+#define	PVS_CACHE_ROWS	64
+#define	PVS_CACHE_HASH	128
+#define	PVS_ROWBYTES	(((MAX_MAP_LEAFS+31)>>5)<<2)	/* SV_CalcPHS copies whole words */
+
+typedef struct pvsrow_s
+{
+	const byte	*in;		/* the compressed row, NULL if unused */
+	int		rowsize;
+	struct pvsrow_s	*prev, *next;	/* in the use order */
+	struct pvsrow_s	*hashnext;
+} pvsrow_t;
+
+static pvsrow_t	pvs_rows[PVS_CACHE_ROWS];
+static pvsrow_t	*pvs_hash[PVS_CACHE_HASH];
+static pvsrow_t	*pvs_mru, *pvs_lru;
+static byte	pvs_data[PVS_CACHE_ROWS][PVS_ROWBYTES];
+static int	pvs_hits, pvs_misses;
+
+#define	PVS_HashRow(in)	((int)(((size_t)(in) ^ ((size_t)(in) >> 7)) & (PVS_CACHE_HASH-1)))
+
+static void Mod_FlushPVSCache (void)
+{
+	int		i;
+
+	memset (pvs_hash, 0, sizeof(pvs_hash));
+	for (i = 0; i < PVS_CACHE_ROWS; i++)
+	{
+		pvs_rows[i].in = NULL;
+		pvs_rows[i].hashnext = NULL;
+		pvs_rows[i].prev = (i > 0) ? &pvs_rows[i-1] : NULL;
+		pvs_rows[i].next = (i < PVS_CACHE_ROWS-1) ? &pvs_rows[i+1] : NULL;
+	}
+	pvs_mru = &pvs_rows[0];
+	pvs_lru = &pvs_rows[PVS_CACHE_ROWS-1];
+}
+
+static void Mod_TouchPVSRow (pvsrow_t *r)
+{
+	if (r == pvs_mru)
+		return;
+	r->prev->next = r->next;
+	if (r->next)
+		r->next->prev = r->prev;
+	else	pvs_lru = r->prev;
+	r->prev = NULL;
+	r->next = pvs_mru;
+	pvs_mru->prev = r;
+	pvs_mru = r;
+}
+
+static void Mod_UnhashPVSRow (pvsrow_t *r)
+{
+	pvsrow_t	**link;
+
+	for (link = &pvs_hash[PVS_HashRow(r->in)]; *link; link = &(*link)->hashnext)
+	{
+		if (*link == r)
+		{
+			*link = r->hashnext;
+			break;
+		}
+	}
+	r->hashnext = NULL;
+	r->in = NULL;
+}
+
+static void Mod_PVSCache_f (void)
+{
+	int		lookups = pvs_hits + pvs_misses;
+
+	Con_Printf ("pvs rows    %d cached, %d bytes each\n", PVS_CACHE_ROWS, PVS_ROWBYTES);
+	Con_Printf ("hits        %d\n", pvs_hits);
+	Con_Printf ("misses      %d\n", pvs_misses);
+	Con_Printf ("hit rate    %.1f%%\n", lookups ? 100.0 * pvs_hits / lookups : 0.0);
+	if (Cmd_Argc() > 1 && !q_strcasecmp(Cmd_Argv(1), "reset"))
+		pvs_hits = pvs_misses = 0;
+}
+
 /*
 ===================
 Mod_DecompressVis
@@ -131,25 +227,35 @@ Mod_DecompressVis
 */
 static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 {
-	static byte	decompressed[MAX_MAP_LEAFS/8];
-	int		c;
-	byte	*out;
-	int		row;
+	const byte	*key = in;
+	pvsrow_t	*r;
+	byte	*out, *end;
+	int		c, row, h;
 
-	row = (model->numleafs+7)>>3;
-	out = decompressed;
+	if (!in)	// no vis info, so make all visible
+		return mod_novis;
 
-	if (!in)
-	{	// no vis info, so make all visible
-		while (row)
+	row = (model->numleafs+7)>>3;
+	h = PVS_HashRow(in);
+	for (r = pvs_hash[h]; r; r = r->hashnext)
+	{
+		if (r->in == key && r->rowsize == row)
 		{
-			*out++ = 0xff;
-			row--;
+			pvs_hits++;
+			Mod_TouchPVSRow (r);
+			return pvs_data[r - pvs_rows];
 		}
-		return decompressed;
 	}
+	pvs_misses++;
+
+// take the least recently used row
+	r = pvs_lru;
+	if (r->in)
+		Mod_UnhashPVSRow (r);
+	out = pvs_data[r - pvs_rows];
+	end = out + row;
 
-	do
+	while (out < end)
 	{
 		if (*in)
 		{
@@ -159,14 +265,19 @@ static byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 
 		c = in[1];
 		in += 2;
-		while (c)
-		{
-			*out++ = 0;
-			c--;
-		}
-	} while (out - decompressed < row);
-
-	return decompressed;
+		if (c > end - out)	// don't run past the row
+			c = end - out;
+		memset (out, 0, c);
+		out += c;
+	}
+	memset (end, 0, ((row + 3) & ~3) - row);
+
+	r->in = key;
+	r->rowsize = row;
+	r->hashnext = pvs_hash[h];
+	pvs_hash[h] = r;
+	Mod_TouchPVSRow (r);
+	return pvs_data[r - pvs_rows];
 }
 
 byte *Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model)
@@ -190,6 +301,8 @@ void Mod_ClearAll (void)
 	{
 		mod->needload = NL_UNREFERENCED;
 	}
+
+	Mod_FlushPVSCache ();
 }
 
 /*
@@ -274,6 +387,34 @@ void Mod_TouchModel (const char *name)
 	}
 }
 
+/*
+==================
+Mod_Prefetch
+
+Queues the file of a model which Mod_ForName is going to load for
+FS_Prefetch.
+==================
+*/
+void Mod_Prefetch (const char *name)
+{
+	qmodel_t	*mod;
+
+	if (name[0] == '*')	/* a submodel of the world */
+		return;
+
+	mod = Mod_FindName (name);
+	if (mod->type == mod_alias)
+	{
+		if (Cache_Check(&mod->cache))
+			return;
+	}
+	else if (mod->needload == NL_PRESENT)
+	{
+		return;
+	}
+	FS_Prefetch (mod->name, NULL);
+}
+
 /*
 ==================
 Mod_LoadModel
@@ -1665,6 +1806,7 @@ static void Mod_LoadBrushModel (qmodel_t *mod, void *buffer)
 	qboolean	bsp2 = false;
 
 	loadmodel->type = mod_brush;
+	Mod_FlushPVSCache ();	// the rows may be at the same addresses
 
 	header = (dheader_t *)buffer;
 
@@ -321,6 +321,7 @@ static void PF_setmodel (void)
 	{
 		e->v.model = PR_SetEngineString(*check);
 		e->v.modelindex = i; //SV_ModelIndex (m);
+		ED_SetAdd (ed_modelset, NUM_FOR_EDICT(e));
 
 		mod = sv.models[ (int)e->v.modelindex];	// Mod_ForName (m, true);
 
@@ -372,6 +373,7 @@ static void PF_setpuzzlemodel (void)
 		}
 
 		e->v.modelindex = i;	//SV_ModelIndex (m);
+		ED_SetAdd (ed_modelset, NUM_FOR_EDICT(e));
 
 		mod = sv.models[ (int)e->v.modelindex];	// Mod_ForName (m, true);
 
@@ -1255,6 +1257,112 @@ static void PF_tracearea (void)
 	PR_SetTrace (&trace);
 }
 
+/*
+=================
+PF_tracebatch
+
+Traces lines from start to each of the first count points of the progs
+array tracebatch_end[], with the results of as many traceline() calls
+but a single search for the edicts in the way.  The fractions go to
+tracebatch_fraction[] and, if the progs define them, the entities hit
+and end positions to tracebatch_ent[] and tracebatch_endpos[].
+Returns how many of the lines were not blocked.
+
+float tracebatch (vector start, float count, float nomonsters, entity ignore)
+=================
+*/
+#define	MAX_TRACEBATCH	64
+
+static void PF_tracebatch (void)
+{
+	float	*start;
+	vec3_t	ends[MAX_TRACEBATCH];
+	trace_t	traces[MAX_TRACEBATCH];
+	int	count, n, i, clear;
+	int	endofs, fracofs, entofs, posofs;
+	int	nomonsters;
+	edict_t	*ent;
+	float	save_hull;
+
+	start = G_VECTOR(OFS_PARM0);
+	count = G_FLOAT(OFS_PARM1);
+	nomonsters = G_FLOAT(OFS_PARM2);
+	ent = G_EDICT(OFS_PARM3);
+
+	endofs = ED_GlobalArray ("tracebatch_end", ev_vector, &n);
+	if (endofs < 0)
+		PR_RunError ("%s: progs have no vector tracebatch_end[]", __thisfunc__);
+	if (count > n)
+		count = n;
+	fracofs = ED_GlobalArray ("tracebatch_fraction", ev_float, &n);
+	if (fracofs < 0)
+		PR_RunError ("%s: progs have no float tracebatch_fraction[]", __thisfunc__);
+	if (count > n)
+		count = n;
+	entofs = ED_GlobalArray ("tracebatch_ent", ev_entity, &n);
+	if (entofs >= 0 && count > n)
+		count = n;
+	posofs = ED_GlobalArray ("tracebatch_endpos", ev_vector, &n);
+	if (posofs >= 0 && count > n)
+		count = n;
+	if (count > MAX_TRACEBATCH)
+		count = MAX_TRACEBATCH;
+
+	for (i = 0; i < count; i++)
+		VectorCopy (G_VECTOR(endofs + i*3), ends[i]);
+
+	save_hull = ent->v.hull;
+	ent->v.hull = 0;
+	SV_MoveBatch (start, vec3_origin, vec3_origin, ends, count, nomonsters, ent, traces);
+	ent->v.hull = save_hull;
+
+	clear = 0;
+	for (i = 0; i < count; i++)
+	{
+		G_FLOAT(fracofs + i) = traces[i].fraction;
+		if (traces[i].fraction == 1)
+			clear++;
+		if (entofs >= 0)
+		{
+			ent = traces[i].ent ? traces[i].ent : sv.edicts;
+			G_INT(entofs + i) = EDICT_TO_PROG(ent);
+		}
+		if (posofs >= 0)
+			VectorCopy (traces[i].endpos, G_VECTOR(posofs + i*3));
+	}
+
+	G_FLOAT(OFS_RETURN) = clear;
+}
+
+/*
+=================
+PF_navpath
+
+Finds a way to walk from start to end through the navigation graph of the
+map, and stores the points to pass in the progs array navpath_point[].
+Returns how many were stored, 0 if there is no known way.
+
+float navpath (vector start, vector end)
+=================
+*/
+static void PF_navpath (void)
+{
+	vec3_t	points[MAX_TRACEBATCH];
+	int	ofs, count, i;
+
+	ofs = ED_GlobalArray ("navpath_point", ev_vector, &count);
+	if (ofs < 0)
+		PR_RunError ("%s: progs have no vector navpath_point[]", __thisfunc__);
+	if (count > MAX_TRACEBATCH)
+		count = MAX_TRACEBATCH;
+
+	count = SV_NavPath (G_VECTOR(OFS_PARM0), G_VECTOR(OFS_PARM1), points, count);
+	for (i = 0; i < count; i++)
+		VectorCopy (points[i], G_VECTOR(ofs + i*3));
+
+	G_FLOAT(OFS_RETURN) = count;
+}
+
 #if 0	/* not used */
 
 struct PointInfo_t
@@ -1766,6 +1874,9 @@ static void PF_cvar_set (void)
 	Cvar_Set (var, val);
 }
 
+/* 0: linear scan, 1: area tree query, 2: both, reporting mismatches */
+cvar_t	sv_findradius = {"sv_findradius", "1", CVAR_NONE};
+
 /*
 =================
 PF_findradius
@@ -1775,44 +1886,90 @@ Returns a chain of entities that have origins within a spherical area
 findradius (origin, radius)
 =================
 */
+
+static qboolean PF_InRadius (edict_t *ent, float *org, float rad)
+{
+	float d, lensq;
+
+	if (ent->free)
+		return false;
+	if (ent->v.solid == SOLID_NOT)
+		return false;
+
+	d = org[0] - (ent->v.origin[0] + (ent->v.mins[0] + ent->v.maxs[0]) * 0.5);
+	lensq = d * d;
+	if (lensq > rad)
+		return false;
+	d = org[1] - (ent->v.origin[1] + (ent->v.mins[1] + ent->v.maxs[1]) * 0.5);
+	lensq += d * d;
+	if (lensq > rad)
+		return false;
+	d = org[2] - (ent->v.origin[2] + (ent->v.mins[2] + ent->v.maxs[2]) * 0.5);
+	lensq += d * d;
+	if (lensq > rad)
+		return false;
+
+	return true;
+}
+
 static void PF_findradius (void)
 {
 	edict_t	*ent, *chain;
 	float	rad;
 	float	*org;
-	int		i;
+	int		i, count, found;
+	static int	list[MAX_EDICTS];
 
 	chain = (edict_t *)sv.edicts;
 
 	org = G_VECTOR(OFS_PARM0);
 	rad = G_FLOAT(OFS_PARM1);
-	rad *= rad;
 
+	count = -1;
+	if (sv_findradius.integer && !IS_NAN(rad))
+	{
+		// the candidates are sorted, so the chain comes out in the same
+		// (descending) order as the linear scan below would produce it.
+		count = SV_FindInRadius (org, rad, list);
+		rad *= rad;
+		for (i = found = 0; i < count; i++)
+		{
+			ent = EDICT_NUM(list[i]);
+			if (!PF_InRadius(ent, org, rad))
+				continue;
+			ent->v.chain = EDICT_TO_PROG(chain);
+			chain = ent;
+			list[found++] = list[i];
+		}
+		if (sv_findradius.integer != 2)
+		{
+			RETURN_EDICT(chain);
+			return;
+		}
+		count = found;
+		chain = (edict_t *)sv.edicts;
+	}
+	else
+	{
+		rad *= rad;
+	}
+
+	found = 0;
 	ent = NEXT_EDICT(sv.edicts);
 	for (i = 1; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent))
 	{
-		float d, lensq;
-		if (ent->free)
-			continue;
-		if (ent->v.solid == SOLID_NOT)
+		if (!PF_InRadius(ent, org, rad))
 			continue;
 
-		d = org[0] - (ent->v.origin[0] + (ent->v.mins[0] + ent->v.maxs[0]) * 0.5);
-		lensq = d * d;
-		if (lensq > rad)
-			continue;
-		d = org[1] - (ent->v.origin[1] + (ent->v.mins[1] + ent->v.maxs[1]) * 0.5);
-		lensq += d * d;
-		if (lensq > rad)
-			continue;
-		d = org[2] - (ent->v.origin[2] + (ent->v.mins[2] + ent->v.maxs[2]) * 0.5);
-		lensq += d * d;
-		if (lensq > rad)
-			continue;
+		if (count >= 0 && (found >= count || list[found] != i))
+			Con_Printf ("findradius: index missed edict %d\n", i);
+		found++;
 
 		ent->v.chain = EDICT_TO_PROG(chain);
 		chain = ent;
 	}
+	if (count >= 0 && found != count)
+		Con_Printf ("findradius: index returned %d edicts, scan %d\n", count, found);
 
 	RETURN_EDICT(chain);
 }
@@ -1935,6 +2092,9 @@ static void PF_Remove (void)
 }
 
 
+/* find() on classname, targetname, target and netname uses ED_FindString */
+cvar_t	sv_findindex = {"sv_findindex", "1", CVAR_NONE};
+
 // entity (entity start, .string field, string match) find = #5;
 static void PF_Find (void)
 #ifdef QUAKE2
@@ -1998,6 +2158,17 @@ static void PF_Find (void)
 	if (!s)
 		PR_RunError ("%s: bad search string", __thisfunc__);
 
+	if (sv_findindex.integer)
+	{
+		e = ED_FindString (e, f, s);
+		if (e >= 0)
+		{
+			RETURN_EDICT(EDICT_NUM(e));
+			return;
+		}
+		e = G_EDICTNUM(OFS_PARM0);
+	}
+
 	for (e++ ; e < sv.num_edicts ; e++)
 	{
 		ed = EDICT_NUM(e);
@@ -4258,6 +4429,8 @@ static builtin_t pr_builtin[] =
 	PF_Fixme,
 #endif
 	PF_Fixme,
+	PF_tracebatch,		// float(vector start, float count, float nomonsters, entity ignore) tracebatch = #119
+	PF_navpath,		// float(vector start, vector end) navpath = #120
 #endif
 
 #else  /* H2W: */
@@ -4285,6 +4458,8 @@ static builtin_t pr_builtin[] =
 	PF_precache_file,	// 118
 	PF_setsiegeteam,	// 119
 	PF_updateSiegeInfo,	// 120
+	PF_tracebatch,		// 121
+	PF_navpath,		// 122
 #endif /* H2W */
 };
 
@@ -20,6 +20,7 @@
  */
 
 #include "quakedef.h"
+#include "hashindex.h"
 
 #if defined(H2W) && !defined(SERVERONLY)
 #error SERVERONLY not defined for HW server
@@ -42,11 +43,22 @@ static	char		pr_null_string[] = "";
 static	char		*pr_strings;
 static	int		pr_stringssize;
 static	const char	**pr_knownstrings;
+static	int		*pr_knownstringnext;	/* slot kind, or next free slot */
 static	int		pr_maxknownstrings;
 static	int		pr_numknownstrings;
+static	int		pr_freeknownstring = -1;	/* head of the free slot list */
+static	int		pr_numdynstrings;	/* live PR_AllocString() strings */
+static	int		pr_dynstringsallocd;	/* allocated since last collection */
+static	hashindex_t	pr_knownstringhash;	/* string pointer -> slot */
 static	ddef_t		*pr_fielddefs;
 static	ddef_t		*pr_globaldefs;
 
+/* lookup indexes over the defs and functions, built by PR_LoadProgs()
+ * on the hunk next to the progs themselves. */
+static	hashindex_t	pr_fieldhash, pr_fieldofshash;
+static	hashindex_t	pr_globalhash, pr_globalofshash;
+static	hashindex_t	pr_functionhash, pr_functionhash_ci;
+
 dstatement_t	*pr_statements;
 float		*pr_globals;
 sv_globals_t	sv_globals;
@@ -55,6 +67,7 @@ int		pr_edict_size;		/* in bytes */
 qboolean	is_progs_v6;
 
 qboolean	ignore_precache = false;
+qboolean	pr_holdstrings = false;	/* no string collection while set */
 
 unsigned short	pr_crc;
 
@@ -566,6 +579,9 @@ static sv_def_t globals_v015[] = {
 
 static ddef_t	*ED_FieldAtOfs (int ofs);
 static qboolean	ED_ParseEpair (void *base, ddef_t *key, const char *s);
+static void	PR_FreeKnownStrings (void);
+static qboolean	PR_IsStableString (int num);
+static qboolean	PR_DefFits (ddef_t *def, int count);
 
 static char field_name[256], class_name[256];
 static qboolean RemoveBadReferences;
@@ -622,6 +638,10 @@ void ED_ClearEdict (edict_t *e)
 	memset (&e->baseline, 0, sizeof(e->baseline));
 	#endif
 	e->free = false;
+	e->linkvalid = false;
+	ED_StringFieldsChanged (e);
+	ED_SetAdd (ed_physset, NUM_FOR_EDICT(e));
+	ED_SetAdd (ed_modelset, NUM_FOR_EDICT(e));
 }
 
 /*
@@ -736,6 +756,263 @@ void ED_Free (edict_t *ed)
 
 //===========================================================================
 
+unsigned int	ed_physset[ED_SETWORDS];
+unsigned int	ed_modelset[ED_SETWORDS];
+
+/*
+============
+ED_SetNext
+
+Returns the first member of set in [n, end), or end if there is none.
+============
+*/
+int ED_SetNext (const unsigned int *set, int n, int end)
+{
+	unsigned int	bits;
+
+	if (n >= end)
+		return end;
+	bits = set[n >> 5] >> (n & 31);
+	while (!bits)
+	{
+		n = (n | 31) + 1;
+		if (n >= end)
+			return end;
+		bits = set[n >> 5];
+	}
+	while (!(bits & 1))
+	{
+		bits >>= 1;
+		n++;
+	}
+	return (n < end) ? n : end;
+}
+
+//===========================================================================
+
+/*
+============
+ED_FindString
+
+Index of the string fields gamecode searches with find(), maintained
+lazily: writes only queue the edict, and the queue is folded into the
+hashes by the next lookup, when the new values are in place.  Engine
+strings can change under the same string_t (ftos() results, client
+names), so edicts holding one sit on a separate list that every lookup
+scans in full.
+============
+*/
+#define	ED_NUMSTRFIELDS		4
+#define	ED_STRKEY_NONE		-1
+#define	ED_STRKEY_VOLATILE	-2
+
+static const int	ed_strfields[ED_NUMSTRFIELDS] =
+{
+	(int)offsetof(entvars_t,classname)/4,
+	(int)offsetof(entvars_t,targetname)/4,
+	(int)offsetof(entvars_t,target)/4,
+	(int)offsetof(entvars_t,netname)/4
+};
+
+static	hashindex_t	ed_strhash[ED_NUMSTRFIELDS];
+static	hashindex_t	ed_strvolatile[ED_NUMSTRFIELDS];
+static	int		ed_strkeys[ED_NUMSTRFIELDS][MAX_EDICTS];
+static	int		ed_strdirty[MAX_EDICTS];	/* queued edict numbers */
+static	byte		ed_strqueued[MAX_EDICTS];
+static	int		ed_numstrdirty;
+
+static void ED_ResetStringIndex (void)
+{
+	int		i;
+
+	for (i = 0; i < ED_NUMSTRFIELDS; i++)
+	{
+		memset (&ed_strhash[i], 0, sizeof(hashindex_t));
+		memset (&ed_strvolatile[i], 0, sizeof(hashindex_t));
+		Hash_AllocateHunk (&ed_strhash[i], MAX_EDICTS, "edstrhash");
+		Hash_AllocateHunk (&ed_strvolatile[i], MAX_EDICTS, "edstrhash");
+	}
+	// fresh edicts are zeroed, so all the fields are "": ED_FindString
+	// leaves searches for "" to the caller's linear scan.
+	memset (ed_strkeys, 0xff, sizeof(ed_strkeys));	/* ED_STRKEY_NONE */
+	memset (ed_strqueued, 0, sizeof(ed_strqueued));
+	ed_numstrdirty = 0;
+}
+
+/*
+============
+ED_StringFieldsChanged
+
+Called when any of the indexed fields of ed may have been written.
+============
+*/
+void ED_StringFieldsChanged (edict_t *ed)
+{
+	int		num = NUM_FOR_EDICT(ed);
+
+	if (ed_strqueued[num])
+		return;
+	ed_strqueued[num] = 1;
+	ed_strdirty[ed_numstrdirty++] = num;
+}
+
+static void ED_UpdateStringIndex (void)
+{
+	int		i, j, num, key;
+	string_t	s;
+	edict_t		*ed;
+
+	for (i = 0; i < ed_numstrdirty; i++)
+	{
+		num = ed_strdirty[i];
+		ed_strqueued[num] = 0;
+		ed = EDICT_NUM(num);
+		for (j = 0; j < ED_NUMSTRFIELDS; j++)
+		{
+			key = ed_strkeys[j][num];
+			if (key == ED_STRKEY_VOLATILE)
+				Hash_Remove (&ed_strvolatile[j], 0, num);
+			else if (key != ED_STRKEY_NONE)
+				Hash_Remove (&ed_strhash[j], key, num);
+
+			s = ((string_t *)&ed->v)[ed_strfields[j]];
+			if (ed->free)
+				key = ED_STRKEY_NONE;
+			else if (!PR_IsStableString(s))
+			{
+				key = ED_STRKEY_VOLATILE;
+				Hash_Add (&ed_strvolatile[j], 0, num);
+			}
+			else
+			{
+				key = Hash_GenerateKeyString(&ed_strhash[j], PR_GetString(s), true);
+				Hash_Add (&ed_strhash[j], key, num);
+			}
+			ed_strkeys[j][num] = key;
+		}
+	}
+	ed_numstrdirty = 0;
+}
+
+/*
+============
+ED_FindString
+
+Returns the number of the first edict after start whose field matches s
+exactly like the linear scan in PF_Find would, or -1 when the field isn't
+indexed and the caller has to scan.
+============
+*/
+int ED_FindString (int start, int field, const char *s)
+{
+	int		i, j, best;
+	const char	*t;
+	edict_t		*ed;
+	hashindex_t	*hi;
+
+	if (!*s)
+		return -1;
+	for (j = 0; j < ED_NUMSTRFIELDS; j++)
+	{
+		if (ed_strfields[j] == field)
+			break;
+	}
+	if (j == ED_NUMSTRFIELDS)
+		return -1;
+
+	if (ed_numstrdirty)
+		ED_UpdateStringIndex ();
+
+	best = sv.num_edicts;
+	hi = &ed_strhash[j];
+	i = Hash_First (hi, Hash_GenerateKeyString(hi, s, true));
+	for ( ; i != -1; i = Hash_Next(hi, i))
+	{
+		if (i <= start || i >= best)
+			continue;
+		ed = EDICT_NUM(i);
+		if (ed->free)
+			continue;
+		t = E_STRING(ed,field);
+		if (t && !strcmp(t,s))
+			best = i;
+	}
+	hi = &ed_strvolatile[j];
+	for (i = Hash_First(hi, 0); i != -1; i = Hash_Next(hi, i))
+	{
+		if (i <= start || i >= best)
+			continue;
+		ed = EDICT_NUM(i);
+		if (ed->free)
+			continue;
+		t = E_STRING(ed,field);
+		if (t && !strcmp(t,s))
+			best = i;
+	}
+
+	return (best == sv.num_edicts) ? 0 : best;
+}
+
+//===========================================================================
+
+/*
+============
+PR_BuildHashes
+
+The linear scans these replace returned the first match in the table,
+and Hash_Add() prepends to the chains: adding the entries backwards
+leaves the lowest index first in every chain, so the results are the
+same.
+============
+*/
+static int PR_HashSize (int count)
+{
+	int		size;
+
+	for (size = 64; size < count; size <<= 1)
+		;
+	return size;
+}
+
+static void PR_HashDefs (hashindex_t *names, hashindex_t *ofs, ddef_t *defs, int numdefs, const char *name)
+{
+	int		i, size;
+
+	size = PR_HashSize (numdefs);
+	memset (names, 0, sizeof(hashindex_t));
+	memset (ofs, 0, sizeof(hashindex_t));
+	Hash_AllocateHunk (names, size, name);
+	Hash_AllocateHunk (ofs, size, name);
+
+	for (i = numdefs - 1; i >= 0; i--)
+	{
+		Hash_Add (names, Hash_GenerateKeyString(names, PR_GetString(defs[i].s_name), true), i);
+		Hash_Add (ofs, Hash_GenerateKeyInt(ofs, defs[i].ofs), i);
+	}
+}
+
+static void PR_BuildHashes (void)
+{
+	int		i, size;
+	const char	*name;
+
+	PR_HashDefs (&pr_fieldhash, &pr_fieldofshash, pr_fielddefs, progs->numfielddefs, "progfldhash");
+	PR_HashDefs (&pr_globalhash, &pr_globalofshash, pr_globaldefs, progs->numglobaldefs, "progglbhash");
+
+	size = PR_HashSize (progs->numfunctions);
+	memset (&pr_functionhash, 0, sizeof(hashindex_t));
+	memset (&pr_functionhash_ci, 0, sizeof(hashindex_t));
+	Hash_AllocateHunk (&pr_functionhash, size, "progfnchash");
+	Hash_AllocateHunk (&pr_functionhash_ci, size, "progfnchash");
+
+	for (i = progs->numfunctions - 1; i >= 0; i--)
+	{
+		name = PR_GetString(pr_functions[i].s_name);
+		Hash_Add (&pr_functionhash, Hash_GenerateKeyString(&pr_functionhash, name, true), i);
+		Hash_Add (&pr_functionhash_ci, Hash_GenerateKeyString(&pr_functionhash_ci, name, false), i);
+	}
+}
+
 /*
 ============
 ED_GlobalAtOfs
@@ -743,14 +1020,13 @@ ED_GlobalAtOfs
 */
 static ddef_t *ED_GlobalAtOfs (int ofs)
 {
-	ddef_t		*def;
 	int			i;
 
-	for (i = 0; i < progs->numglobaldefs; i++)
+	i = Hash_First (&pr_globalofshash, Hash_GenerateKeyInt(&pr_globalofshash, ofs));
+	for ( ; i != -1; i = Hash_Next(&pr_globalofshash, i))
 	{
-		def = &pr_globaldefs[i];
-		if (def->ofs == ofs)
-			return def;
+		if (pr_globaldefs[i].ofs == ofs)
+			return &pr_globaldefs[i];
 	}
 	return NULL;
 }
@@ -762,14 +1038,13 @@ ED_FieldAtOfs
 */
 static ddef_t *ED_FieldAtOfs (int ofs)
 {
-	ddef_t		*def;
 	int			i;
 
-	for (i = 0; i < progs->numfielddefs; i++)
+	i = Hash_First (&pr_fieldofshash, Hash_GenerateKeyInt(&pr_fieldofshash, ofs));
+	for ( ; i != -1; i = Hash_Next(&pr_fieldofshash, i))
 	{
-		def = &pr_fielddefs[i];
-		if (def->ofs == ofs)
-			return def;
+		if (pr_fielddefs[i].ofs == ofs)
+			return &pr_fielddefs[i];
 	}
 	return NULL;
 }
@@ -781,14 +1056,13 @@ ED_FindField
 */
 static ddef_t *ED_FindField (const char *name)
 {
-	ddef_t		*def;
 	int			i;
 
-	for (i = 0; i < progs->numfielddefs; i++)
+	i = Hash_First (&pr_fieldhash, Hash_GenerateKeyString(&pr_fieldhash, name, true));
+	for ( ; i != -1; i = Hash_Next(&pr_fieldhash, i))
 	{
-		def = &pr_fielddefs[i];
-		if ( !strcmp(PR_GetString(def->s_name), name) )
-			return def;
+		if ( !strcmp(PR_GetString(pr_fielddefs[i].s_name), name) )
+			return &pr_fielddefs[i];
 	}
 	return NULL;
 }
@@ -801,18 +1075,44 @@ ED_FindGlobal
 */
 static ddef_t *ED_FindGlobal (const char *name)
 {
-	ddef_t		*def;
 	int			i;
 
-	for (i = 0; i < progs->numglobaldefs; i++)
+	i = Hash_First (&pr_globalhash, Hash_GenerateKeyString(&pr_globalhash, name, true));
+	for ( ; i != -1; i = Hash_Next(&pr_globalhash, i))
 	{
-		def = &pr_globaldefs[i];
-		if ( !strcmp(PR_GetString(def->s_name), name) )
-			return def;
+		if ( !strcmp(PR_GetString(pr_globaldefs[i].s_name), name) )
+			return &pr_globaldefs[i];
 	}
 	return NULL;
 }
 
+/*
+============
+ED_GlobalArray
+
+Finds a global array of the given type the progs define under name.
+Returns its first global and sets count to its number of elements, or
+returns -1.
+============
+*/
+int ED_GlobalArray (const char *name, int type, int *count)
+{
+	ddef_t	*def;
+	int	n;
+
+	def = ED_FindGlobal (name);
+	if (!def || (def->type & ~DEF_SAVEGLOBAL) != type || def->ofs < 1)
+		return -1;
+
+	// hcc stores the last index just before the array
+	n = ((int *)pr_globals)[def->ofs - 1] + 1;
+	if (n < 1 || n > progs->numglobals || def->ofs + n * type_size[type] > progs->numglobals)
+		return -1;
+
+	*count = n;
+	return def->ofs;
+}
+
 
 /*
 ============
@@ -821,28 +1121,26 @@ ED_FindFunction
 */
 static dfunction_t *ED_FindFunction (const char *fn_name)
 {
-	dfunction_t		*func;
 	int				i;
 
-	for (i = 0; i < progs->numfunctions; i++)
+	i = Hash_First (&pr_functionhash, Hash_GenerateKeyString(&pr_functionhash, fn_name, true));
+	for ( ; i != -1; i = Hash_Next(&pr_functionhash, i))
 	{
-		func = &pr_functions[i];
-		if ( !strcmp(PR_GetString(func->s_name), fn_name) )
-			return func;
+		if ( !strcmp(PR_GetString(pr_functions[i].s_name), fn_name) )
+			return &pr_functions[i];
 	}
 	return NULL;
 }
 
 dfunction_t *ED_FindFunctioni (const char *fn_name)
 {
-	dfunction_t		*func;
 	int				i;
-	
-	for (i = 0; i < progs->numfunctions; i++)
+
+	i = Hash_First (&pr_functionhash_ci, Hash_GenerateKeyString(&pr_functionhash_ci, fn_name, false));
+	for ( ; i != -1; i = Hash_Next(&pr_functionhash_ci, i))
 	{
-		func = &pr_functions[i];
-		if ( !q_strcasecmp(PR_GetString(func->s_name), fn_name) )
-			return func;
+		if ( !q_strcasecmp(PR_GetString(pr_functions[i].s_name), fn_name) )
+			return &pr_functions[i];
 	}
 	return NULL;
 }
@@ -1580,6 +1878,13 @@ const char *ED_ParseEdict (const char *data, edict_t *ent)
 
 	if (!init)
 		ent->free = true;
+	else
+	{
+		SV_EdictMoved (ent);	// not linked yet: visible to findradius
+		ED_StringFieldsChanged (ent);
+		ED_SetAdd (ed_physset, NUM_FOR_EDICT(ent));
+		ED_SetAdd (ed_modelset, NUM_FOR_EDICT(ent));
+	}
 
 	return data;
 }
@@ -1607,12 +1912,14 @@ void ED_LoadFromFile (const char *data)
 	dfunction_t	*func;
 	edict_t		*ent = NULL;
 	int		inhibit = 0;
+	double		spawntime;
 	#ifndef SERVERONLY
 	int		start_amount = current_loading_size;
 	const char	*orig = data;
 	#endif
 
 	*sv_globals.time = sv.time;
+	spawntime = Sys_DoubleTime ();
 
 	// parse ents
 	while (1)
@@ -1756,6 +2063,7 @@ void ED_LoadFromFile (const char *data)
 	}
 
 	Con_DPrintf ("%i entities inhibited\n", inhibit);
+	Con_DPrintf ("entities spawned in %.1f ms\n", (Sys_DoubleTime() - spawntime) * 1000.0);
 }
 
 
@@ -1786,9 +2094,7 @@ static const char maplist_name[] = "maplist.txt";
 	unsigned int	id0, id1;
 	fshandle_t	FH;
 
-	FH.length = FS_OpenFile (maplist_name, & FH.file, &id1);
-	FH.pak = file_from_pak;
-	if (FH.file == NULL)
+	if (FS_OpenHandle (maplist_name, &FH, &id1) < 0)
 		return def_progname;
 	else if (FS_FileExists(def_progname, &id0) && id1 < id0)
 	{
@@ -1800,9 +2106,6 @@ static const char maplist_name[] = "maplist.txt";
 		char	build[256], *test;
 		int	entries;
 
-		FH.pos = 0;
-		FH.start = ftell(FH.file);
-
 		if (!FS_fgets(build, sizeof(build), &FH))
 			goto _fail;
 		entries = atoi(build);
@@ -1913,6 +2216,24 @@ static dstatement_v7_t *PR_ConvertV6Stmts (dstatement_v6_t *v6stmts, int numstmt
 	return v7stmts;
 }
 
+/*
+===============
+PR_DefFits
+
+Whether the def lies inside the first count globals or entity fields.
+===============
+*/
+static qboolean PR_DefFits (ddef_t *def, int count)
+{
+	int	type = def->type & ~DEF_SAVEGLOBAL;
+
+	if (type >= (int)(sizeof(type_size) / sizeof(type_size[0])))
+		return false;
+	if (type == ev_void)	/* markers like end_sys_fields take no space */
+		return def->ofs >= 0 && def->ofs <= count;
+	return def->ofs >= 0 && def->ofs + type_size[type] <= count;
+}
+
 /*
 ===============
 PR_LoadProgs
@@ -1940,6 +2261,7 @@ void PR_LoadProgs (void)
 	Con_DPrintf ("Programs occupy %ldK.\n", fs_filesize / 1024);
 
 	pr_crc = CRC_Block ((byte *)progs, fs_filesize);
+	PR_ProfileCheckProgs ();
 	#if defined(H2W) /* add prog crc to the serverinfo */
 	sprintf (num, "%u", pr_crc);
 	Info_SetValueForStarKey (svs.info, "*progs", num, MAX_SERVERINFO_STRING);
@@ -2007,12 +2329,8 @@ void PR_LoadProgs (void)
 		Host_Error ("%s: strings go past end of file\n", progname);
 
 	// initialize the strings
-	pr_numknownstrings = 0;
-	pr_maxknownstrings = 0;
+	PR_FreeKnownStrings ();
 	pr_stringssize = progs->numstrings;
-	if (pr_knownstrings)
-		Z_Free ((void *)pr_knownstrings);
-	pr_knownstrings = NULL;
 	PR_SetEngineString(pr_null_string);
 
 	if (progs->version == PROG_VERSION_V6)
@@ -2076,11 +2394,26 @@ void PR_LoadProgs (void)
 	{
 		if (pr_fielddefs[i].type & DEF_SAVEGLOBAL)
 			Host_Error ("%s: pr_fielddefs[i].type & DEF_SAVEGLOBAL", __thisfunc__);
+		if (!PR_DefFits(&pr_fielddefs[i], progs->entityfields))
+			Host_Error ("%s: field %d out of the entity fields", __thisfunc__, i);
 	}
 
+	for (i = 0; i < progs->numglobaldefs; i++)
+	{
+		if (!PR_DefFits(&pr_globaldefs[i], progs->numglobals))
+			Host_Error ("%s: global %d out of the globals", __thisfunc__, i);
+	}
+
+	PR_BuildHashes ();
+	ED_ResetStringIndex ();
+	memset (ed_physset, 0, sizeof(ed_physset));
+	memset (ed_modelset, 0, sizeof(ed_modelset));
+
 	for (i = 0; i < progs->numglobals; i++)
 		((int *)pr_globals)[i] = LittleLong (((int *)pr_globals)[i]);
 
+	PR_VerifyProgs ();
+
 	pr_edict_size = progs->entityfields * 4 + sizeof(edict_t) - sizeof(entvars_t);
 	// round off to next highest whole word address (esp for Alpha)
 	// this ensures that pointers in the engine data area are always
@@ -2114,10 +2447,16 @@ PR_Init
 */
 void PR_Init (void)
 {
+	PR_InitFieldWatch ();
+
 	Cmd_AddCommand ("edict", ED_PrintEdict_f);
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	Cmd_AddCommand ("profile_start", PR_ProfileStart_f);
+	Cmd_AddCommand ("profile_stop", PR_ProfileStop_f);
+	Cmd_AddCommand ("profile_report", PR_ProfileReport_f);
+	Cmd_AddCommand ("profile_folded", PR_ProfileFolded_f);
 
 	Cvar_RegisterVariable (&max_temp_edicts);
 
@@ -2174,13 +2513,165 @@ int NUM_FOR_EDICT(edict_t *e)
 //===========================================================================
 
 
+/* known strings are engine strings registered by PR_SetEngineString()
+ * and dynamic strings from PR_AllocString().  for a used slot, the
+ * pr_knownstringnext entry tells which kind it is; for a free slot it
+ * links to the next free one.  all used slots are in a pointer hash so
+ * that registering an engine string doesn't have to scan the table.  */
 #define	PR_STRING_ALLOCSLOTS	256
+#define	PR_STRING_ENGINE	-2
+#define	PR_STRING_DYNAMIC	-3
+
+static int PR_KnownStringKey (const char *s)
+{
+	uintptr_t	p = (uintptr_t)s;
+	return (int)(p ^ (p >> 4) ^ (p >> 12));
+}
 
 static void PR_AllocStringSlots (void)
 {
-	pr_maxknownstrings += PR_STRING_ALLOCSLOTS;
+	int		i;
+
+	pr_maxknownstrings = (pr_maxknownstrings) ? pr_maxknownstrings * 2 : PR_STRING_ALLOCSLOTS;
 	Sys_DPrintf("%s: realloc'ing for %d slots\n", __thisfunc__, pr_maxknownstrings);
 	pr_knownstrings = (const char **) Z_Realloc ((void *)pr_knownstrings, pr_maxknownstrings * sizeof(char *), Z_MAINZONE);
+	pr_knownstringnext = (int *) Z_Realloc (pr_knownstringnext, pr_maxknownstrings * sizeof(int), Z_MAINZONE);
+
+	/* the hash covers the slot range, so it is rebuilt with it. */
+	Hash_FreeMalloc (&pr_knownstringhash);
+	Hash_AllocateMalloc (&pr_knownstringhash, pr_maxknownstrings);
+	for (i = pr_numknownstrings - 1; i >= 0; i--)
+	{
+		if (pr_knownstrings[i])
+			Hash_Add (&pr_knownstringhash, Hash_GenerateKeyInt(&pr_knownstringhash, PR_KnownStringKey(pr_knownstrings[i])), i);
+	}
+}
+
+static int PR_NewStringSlot (void)
+{
+	int		i;
+
+	if (pr_freeknownstring != -1)
+	{
+		i = pr_freeknownstring;
+		pr_freeknownstring = pr_knownstringnext[i];
+		return i;
+	}
+	if (pr_numknownstrings >= pr_maxknownstrings)
+		PR_AllocStringSlots();
+	return pr_numknownstrings++;
+}
+
+/*
+===============
+PR_FreeKnownStrings
+
+releases the dynamic strings and empties the table for a new progs.
+===============
+*/
+static void PR_FreeKnownStrings (void)
+{
+	int		i;
+
+	for (i = 0; i < pr_numknownstrings; i++)
+	{
+		if (pr_knownstrings[i] && pr_knownstringnext[i] == PR_STRING_DYNAMIC)
+			free ((void *)pr_knownstrings[i]);
+	}
+	if (pr_knownstrings)
+		Z_Free ((void *)pr_knownstrings);
+	if (pr_knownstringnext)
+		Z_Free (pr_knownstringnext);
+	pr_knownstrings = NULL;
+	pr_knownstringnext = NULL;
+	pr_numknownstrings = 0;
+	pr_maxknownstrings = 0;
+	pr_freeknownstring = -1;
+	pr_numdynstrings = 0;
+	pr_dynstringsallocd = 0;
+	pr_holdstrings = false;
+	Hash_FreeMalloc (&pr_knownstringhash);
+}
+
+/*
+===============
+PR_CollectStrings
+
+Frees the dynamic strings nothing refers to anymore.  QC values are
+untyped at this level, so every global and every edict field counts as
+a possible reference: a string index is a small negative integer, which
+as a float is a NaN pattern that real data never has, so at worst an
+unused string survives until the next collection.  The server's
+precache and lightstyle tables keep raw pointers, so the strings they
+point to are kept, too.  Must not run while QC code is on the stack:
+its locals are saved off the globals then.
+===============
+*/
+static void PR_MarkStringPointers (byte *used, const char **list, int count)
+{
+	int		i, n, key;
+
+	for (i = 0; i < count; i++)
+	{
+		if (!list[i])
+			continue;
+		key = Hash_GenerateKeyInt(&pr_knownstringhash, PR_KnownStringKey(list[i]));
+		for (n = Hash_First(&pr_knownstringhash, key); n != -1; n = Hash_Next(&pr_knownstringhash, n))
+		{
+			if (pr_knownstrings[n] == list[i])
+				used[n] = 1;
+		}
+	}
+}
+
+static void PR_CollectStrings (void)
+{
+	byte		*used;
+	int		i, e, n, freed;
+	const int	*vals;
+
+	used = (byte *) calloc (pr_numknownstrings, 1);
+	if (!used)
+		return;
+
+#define	PR_MARK_STRING(v)					\
+	do {							\
+		n = -1 - (v);					\
+		if (n >= 0 && n < pr_numknownstrings)		\
+			used[n] = 1;				\
+	} while (0)
+
+	vals = (const int *) pr_globals;
+	for (i = 0; i < progs->numglobals; i++)
+		PR_MARK_STRING(vals[i]);
+	for (e = 0; e < sv.num_edicts; e++)
+	{
+		vals = (const int *) &EDICT_NUM(e)->v;
+		for (i = 0; i < progs->entityfields; i++)
+			PR_MARK_STRING(vals[i]);
+	}
+#undef	PR_MARK_STRING
+	PR_MarkStringPointers (used, sv.model_precache, MAX_MODELS);
+	PR_MarkStringPointers (used, sv.sound_precache, MAX_SOUNDS);
+	PR_MarkStringPointers (used, sv.lightstyles, MAX_LIGHTSTYLES);
+
+	freed = 0;
+	for (i = 0; i < pr_numknownstrings; i++)
+	{
+		if (used[i] || !pr_knownstrings[i] || pr_knownstringnext[i] != PR_STRING_DYNAMIC)
+			continue;
+		Hash_Remove (&pr_knownstringhash, Hash_GenerateKeyInt(&pr_knownstringhash, PR_KnownStringKey(pr_knownstrings[i])), i);
+		free ((void *)pr_knownstrings[i]);
+		pr_knownstrings[i] = NULL;
+		pr_knownstringnext[i] = pr_freeknownstring;
+		pr_freeknownstring = i;
+		pr_numdynstrings--;
+		freed++;
+	}
+	free (used);
+
+	pr_dynstringsallocd = 0;
+	Con_DPrintf ("%s: freed %d, %d dynamic strings in use\n", __thisfunc__, freed, pr_numdynstrings);
 }
 
 const char *PR_GetString (int num)
@@ -2204,9 +2695,20 @@ const char *PR_GetString (int num)
 	}
 }
 
+/* false for strings whose text may change without the string_t
+ * changing: engine strings, and offsets PR_GetString() would reject. */
+static qboolean PR_IsStableString (int num)
+{
+	if (num >= 0)
+		return (num < pr_stringssize);
+	if (num < -pr_numknownstrings || !pr_knownstrings[-1 - num])
+		return false;
+	return (pr_knownstringnext[-1 - num] == PR_STRING_DYNAMIC);
+}
+
 int PR_SetEngineString (const char *s)
 {
-	int		i;
+	int		i, key;
 
 	if (!s)
 		return 0;
@@ -2217,50 +2719,50 @@ int PR_SetEngineString (const char *s)
 	if (s >= pr_strings && s <= pr_strings + pr_stringssize - 2)
 		return (int)(s - pr_strings);
 #endif
-	for (i = 0; i < pr_numknownstrings; i++)
+	if (pr_maxknownstrings)
 	{
-		if (pr_knownstrings[i] == s)
-			return -1 - i;
+		key = Hash_GenerateKeyInt(&pr_knownstringhash, PR_KnownStringKey(s));
+		for (i = Hash_First(&pr_knownstringhash, key); i != -1; i = Hash_Next(&pr_knownstringhash, i))
+		{
+			if (pr_knownstrings[i] == s)
+				return -1 - i;
+		}
 	}
 	// new unknown engine string
 	DEBUG_Printf ("%s: new engine string %p\n", __thisfunc__, s);
-#if 0
-	for (i = 0; i < pr_numknownstrings; i++)
-	{
-		if (!pr_knownstrings[i])
-			break;
-	}
-#endif
-//	if (i >= pr_numknownstrings)
-//	{
-		if (i >= pr_maxknownstrings)
-			PR_AllocStringSlots();
-		pr_numknownstrings++;
-//	}
+	i = PR_NewStringSlot();
 	pr_knownstrings[i] = s;
+	pr_knownstringnext[i] = PR_STRING_ENGINE;
+	Hash_Add (&pr_knownstringhash, Hash_GenerateKeyInt(&pr_knownstringhash, PR_KnownStringKey(s)), i);
 	return -1 - i;
 }
 
 int PR_AllocString (int size, char **ptr)
 {
 	int		i;
+	char	*buf;
 
 	if (!size)
 		return 0;
-	for (i = 0; i < pr_numknownstrings; i++)
-	{
-		if (!pr_knownstrings[i])
-			break;
-	}
-//	if (i >= pr_numknownstrings)
-//	{
-		if (i >= pr_maxknownstrings)
-			PR_AllocStringSlots();
-		pr_numknownstrings++;
-//	}
-	pr_knownstrings[i] = (char *)Hunk_AllocName(size, "string");
+	/* amortized: collect once the strings allocated since the last
+	 * collection amount to half of those alive, and at least 256.
+	 * not while edicts are being parsed from a map or a save game:
+	 * the one being parsed may be past sv.num_edicts, i.e. unmarked. */
+	if (pr_freeknownstring == -1 && pr_dynstringsallocd >= PR_STRING_ALLOCSLOTS &&
+	    pr_dynstringsallocd >= pr_numdynstrings / 2 && !PR_InExecution() &&
+	    sv.state != ss_loading && !pr_holdstrings)
+		PR_CollectStrings();
+
+	buf = (char *) calloc (size, 1);
+	if (!buf)
+		Sys_Error ("%s: failed on allocation of %i bytes", __thisfunc__, size);
+	i = PR_NewStringSlot();
+	pr_knownstrings[i] = buf;
+	pr_knownstringnext[i] = PR_STRING_DYNAMIC;
+	Hash_Add (&pr_knownstringhash, Hash_GenerateKeyInt(&pr_knownstringhash, PR_KnownStringKey(buf)), i);
+	pr_numdynstrings++;
+	pr_dynstringsallocd++;
 	if (ptr)
-		*ptr = (char *) pr_knownstrings[i];
+		*ptr = buf;
 	return -1 - i;
 }
-
@@ -24,12 +24,36 @@
 
 #include "quakedef.h"
 #include "q_ctype.h"
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#elif defined(PLATFORM_UNIX)
+#include <time.h>
+#endif
 
 // MACROS ------------------------------------------------------------------
 
 #define MAX_STACK_DEPTH	64	/* was 32 */
 #define LOCALSTACK_SIZE	2048
 
+/* hierarchical profiler: one node per distinct call stack. builtins
+ * get their own frames, so we need room for two frames per QC level. */
+#define PRPROF_MAXNODES	16384
+#define PRPROF_MAXDEPTH	(MAX_STACK_DEPTH * 2 + 2)
+
+/* entity fields whose stores through OP_STOREP_* the engine has to hear
+ * about, see PR_StoredField(). */
+#define PR_FIELDOFS(f)		((int)(offsetof(entvars_t, f) / 4))
+#define PR_WATCHFIELDS		((int)(sizeof(entvars_t) / 4))
+#define FW_LINK		1	/* SV_LinkEdict inputs: area links go stale */
+#define FW_STRING	2	/* indexed by ED_FindString() */
+#define FW_PHYSICS	4	/* may wake an idle edict for SV_Physics */
+#define FW_MODEL	8	/* may give the edict a visible model */
+#define FW_TRACE	16	/* only traces read it: cached ones go stale */
+
+#define PR_FUNC_OK	0	/* verified, runs unchecked */
+#define PR_FUNC_CHECKED	1	/* has statements that failed, runs checked */
+#define PR_FUNC_BAD	2	/* the header itself failed, can't be entered */
+
 // TYPES -------------------------------------------------------------------
 
 typedef struct
@@ -38,6 +62,27 @@ typedef struct
 	dfunction_t	*f;
 } prstack_t;
 
+typedef struct
+{
+	int		func;		/* index into pr_functions, -1 for root */
+	int		parent;
+	int		child;		/* first callee */
+	int		sibling;	/* next callee of our parent */
+	unsigned int	calls;
+	unsigned int	self_stmts;	/* statements run while on top */
+	double		total_time;	/* inclusive wall time, in seconds */
+	/* filled in by PR_ProfileSums() when reporting: */
+	unsigned int	total_stmts;
+	double		child_time;
+} prprof_node_t;
+
+typedef struct
+{
+	int		node;
+	qboolean	folded;		/* out of nodes: counted in the caller */
+	uint64_t	start;		/* PR_ProfileClock() */
+} prprof_frame_t;
+
 /* switch types */
 enum {
 	SWITCH_F,
@@ -60,6 +105,10 @@ static int EnterFunction(dfunction_t *f);
 static int LeaveFunction(void);
 static void PrintStatement(dstatement_t *s);
 static void PrintCallHistory(void);
+static void PR_ProfilePush(int func);
+static void PR_ProfilePop(void);
+static void PR_StoredField(int ptr, int n);
+static void PR_FailedVerification(dstatement_t *st);
 
 // EXTERNAL DATA DECLARATIONS ----------------------------------------------
 
@@ -77,6 +126,23 @@ static int pr_depth;
 static int localstack[LOCALSTACK_SIZE];
 static int localstack_used;
 
+static qboolean prprof_active;
+static prprof_node_t *prprof_nodes;
+static int prprof_numnodes;
+static int prprof_dropped;
+static prprof_frame_t prprof_stack[PRPROF_MAXDEPTH];
+static int prprof_depth;
+static int prprof_overdepth;
+static unsigned short prprof_crc;
+static double prprof_starttime, prprof_elapsed;
+
+static byte pr_fieldwatch[PR_WATCHFIELDS];
+
+/* PR_VerifyProgs() results: one status per function, one bit per
+ * statement that failed. */
+static byte *pr_funcstatus;
+static byte *pr_badstatements;
+
 static const char *pr_opnames[] =
 {
 	"DONE",
@@ -127,6 +193,59 @@ static const char *pr_opnames[] =
 
 };
 
+/* operand use of each opcode, for PR_VerifyProgs(): the number of
+ * globals read or written at the offset, or one of the OPND_ kinds. */
+#define OPND_JUMP	4	/* relative statement offset */
+#define OPND_ARRAY	5	/* array base, its bound is stored just before it */
+
+typedef struct
+{
+	byte	a, b, c;
+} propinfo_t;
+
+static const propinfo_t pr_opinfo[] =
+{
+	{3,0,0},	/* DONE */
+	{1,1,1}, {3,3,1}, {1,3,3}, {3,1,3},	/* MUL_F, MUL_V, MUL_FV, MUL_VF */
+	{1,1,1},	/* DIV */
+	{1,1,1}, {3,3,3},	/* ADD_F, ADD_V */
+	{1,1,1}, {3,3,3},	/* SUB_F, SUB_V */
+	{1,1,1}, {3,3,1}, {1,1,1}, {1,1,1}, {1,1,1},	/* EQ_* */
+	{1,1,1}, {3,3,1}, {1,1,1}, {1,1,1}, {1,1,1},	/* NE_* */
+	{1,1,1}, {1,1,1}, {1,1,1}, {1,1,1},	/* LE, GE, LT, GT */
+	{1,1,1}, {1,1,3}, {1,1,1}, {1,1,1}, {1,1,1}, {1,1,1},	/* LOAD_* */
+	{1,1,1},	/* ADDRESS */
+	{1,1,0}, {3,3,0}, {1,1,0}, {1,1,0}, {1,1,0}, {1,1,0},	/* STORE_* */
+	{1,1,0}, {3,1,0}, {1,1,0}, {1,1,0}, {1,1,0}, {1,1,0},	/* STOREP_* */
+	{3,0,0},	/* RETURN */
+	{1,0,1}, {3,0,1}, {1,0,1}, {1,0,1}, {1,0,1},	/* NOT_* */
+	{1,OPND_JUMP,0}, {1,OPND_JUMP,0},	/* IF, IFNOT */
+	{1,0,0}, {1,3,0}, {1,3,3}, {1,3,3}, {1,3,3},	/* CALL0 - CALL4 */
+	{1,3,3}, {1,3,3}, {1,3,3}, {1,3,3},	/* CALL5 - CALL8 */
+	{1,1,0},	/* STATE */
+	{OPND_JUMP,0,0},	/* GOTO */
+	{1,1,1}, {1,1,1},	/* AND, OR */
+	{1,1,1}, {1,1,1},	/* BITAND, BITOR */
+	{1,1,0}, {1,3,0}, {1,1,1}, {1,1,3},	/* MULSTORE_F, _V, MULSTOREP_F, _V */
+	{1,1,0}, {1,1,1},	/* DIVSTORE_F, DIVSTOREP_F */
+	{1,1,0}, {3,3,0}, {1,1,1}, {3,1,3},	/* ADDSTORE_F, _V, ADDSTOREP_F, _V */
+	{1,1,0}, {3,3,0}, {1,1,1}, {3,1,3},	/* SUBSTORE_F, _V, SUBSTOREP_F, _V */
+	{OPND_ARRAY,1,1}, {OPND_ARRAY,1,3}, {OPND_ARRAY,1,1},	/* FETCH_GBL_* */
+	{OPND_ARRAY,1,1}, {OPND_ARRAY,1,1},
+	{1,1,0}, {1,1,0},	/* CSTATE, CWSTATE */
+	{1,1,0},	/* THINKTIME */
+	{1,1,0}, {1,1,0}, {1,1,0}, {1,1,0},	/* BITSET, BITSETP, BITCLR, BITCLRP */
+	{0,0,0}, {1,0,0}, {1,1,0},	/* RAND0, RAND1, RAND2 */
+	{0,0,0}, {3,0,0}, {3,3,0},	/* RANDV0, RANDV1, RANDV2 */
+	{1,OPND_JUMP,0}, {3,OPND_JUMP,0}, {1,OPND_JUMP,0},	/* SWITCH_* */
+	{1,OPND_JUMP,0}, {1,OPND_JUMP,0},
+	{1,OPND_JUMP,0},	/* CASE */
+	{1,1,OPND_JUMP}	/* CASERANGE */
+};
+
+#define PR_NUMOPS	((int)(sizeof(pr_opinfo) / sizeof(pr_opinfo[0])))
+COMPILE_TIME_ASSERT(pr_opinfo, PR_NUMOPS == OP_CASERANGE + 1);
+
 // CODE --------------------------------------------------------------------
 
 //==========================================================================
@@ -147,6 +266,22 @@ static const char *pr_opnames[] =
 #define OPC ((eval_t *)&pr_globals[st->c])
 #endif
 
+/* field offsets come from globals that QC can overwrite, so unlike the
+ * operands they are checked on use: the n fields at ofs must fit. */
+#define PR_CHECKFIELD(ofs, n)							\
+	do {									\
+		if ((unsigned int)(ofs) > (unsigned int)(progs->entityfields - (n)))	\
+		{								\
+			pr_xstatement = st - pr_statements;			\
+			PR_RunError("field offset %d out of the entity", (ofs));	\
+		}								\
+	} while (0)
+
+/* after a store through an OP_ADDRESS pointer: OP_ADDRESS itself runs
+ * before the right-hand side is evaluated, so the old value is still
+ * what a find() or traceline in there has to see. */
+#define PR_STOREDFIELD(ptr, n)	PR_StoredField((ptr), (n))
+
 void PR_ExecuteProgram (func_t fnum, const char *funcname)
 {
 	eval_t		*ptr, *a, *b, *c;
@@ -156,6 +291,7 @@ void PR_ExecuteProgram (func_t fnum, const char *funcname)
 	edict_t		*ed;
 	int		jump_ofs;
 	int exitdepth;
+	qboolean	checked;
 	int profile, startprofile;
 	/* switch/case support:  */
 	int	case_type = -1;
@@ -179,650 +315,56 @@ void PR_ExecuteProgram (func_t fnum, const char *funcname)
 	exitdepth = pr_depth;
 
 	st = &pr_statements[EnterFunction(f)];
+	checked = pr_funcstatus[f - pr_functions];
 	startprofile = profile = 0;
 
+	if (checked)
+		goto checked_loop;
+
+/* verified functions */
+#define	PR_SWITCHLOOP	if (checked) goto checked_loop
+unchecked_loop:
     while (1)
     {
 	st++;	/* next statement */
-	a = OPA;
-	b = OPB;
-	c = OPC;
-
-	if (++profile > 100000)
-	{
-		pr_xstatement = st - pr_statements;
-		PR_RunError("runaway loop error");
-	}
-
-	if (pr_trace)
-	{
-		PrintStatement(st);
-	}
+#include "pr_execops.h"
+    }	/* end of while(1) loop */
+#undef	PR_SWITCHLOOP
 
-	switch (st->op)
+/* functions with statements that failed PR_VerifyProgs() */
+#define	PR_SWITCHLOOP	if (!checked) goto unchecked_loop
+checked_loop:
+    while (1)
+    {
+	st++;	/* next statement */
 	{
-	case OP_ADD_F:
-		c->_float = a->_float + b->_float;
-		break;
-	case OP_ADD_V:
-		c->vector[0] = a->vector[0] + b->vector[0];
-		c->vector[1] = a->vector[1] + b->vector[1];
-		c->vector[2] = a->vector[2] + b->vector[2];
-		break;
-
-	case OP_SUB_F:
-		c->_float = a->_float - b->_float;
-		break;
-	case OP_SUB_V:
-		c->vector[0] = a->vector[0] - b->vector[0];
-		c->vector[1] = a->vector[1] - b->vector[1];
-		c->vector[2] = a->vector[2] - b->vector[2];
-		break;
-
-	case OP_MUL_F:
-		c->_float = a->_float * b->_float;
-		break;
-	case OP_MUL_V:
-		c->_float = a->vector[0] * b->vector[0] +
-			    a->vector[1] * b->vector[1] +
-			    a->vector[2] * b->vector[2];
-		break;
-	case OP_MUL_FV:
-		c->vector[0] = a->_float * b->vector[0];
-		c->vector[1] = a->_float * b->vector[1];
-		c->vector[2] = a->_float * b->vector[2];
-		break;
-	case OP_MUL_VF:
-		c->vector[0] = b->_float * a->vector[0];
-		c->vector[1] = b->_float * a->vector[1];
-		c->vector[2] = b->_float * a->vector[2];
-		break;
-
-	case OP_DIV_F:
-		c->_float = a->_float / b->_float;
-		break;
-
-	case OP_BITAND:
-		c->_float = (int)a->_float & (int)b->_float;
-		break;
-
-	case OP_BITOR:
-		c->_float = (int)a->_float | (int)b->_float;
-		break;
-
-	case OP_GE:
-		c->_float = a->_float >= b->_float;
-		break;
-	case OP_LE:
-		c->_float = a->_float <= b->_float;
-		break;
-	case OP_GT:
-		c->_float = a->_float > b->_float;
-		break;
-	case OP_LT:
-		c->_float = a->_float < b->_float;
-		break;
-	case OP_AND:
-		c->_float = a->_float && b->_float;
-		break;
-	case OP_OR:
-		c->_float = a->_float || b->_float;
-		break;
-
-	case OP_NOT_F:
-		c->_float = !a->_float;
-		break;
-	case OP_NOT_V:
-		c->_float = !a->vector[0] && !a->vector[1] && !a->vector[2];
-		break;
-	case OP_NOT_S:
-		c->_float = !a->string || !*PR_GetString(a->string);
-		break;
-	case OP_NOT_FNC:
-		c->_float = !a->function;
-		break;
-	case OP_NOT_ENT:
-		c->_float = (PROG_TO_EDICT(a->edict) == sv.edicts);
-		break;
-
-	case OP_EQ_F:
-		c->_float = a->_float == b->_float;
-		break;
-	case OP_EQ_V:
-		c->_float = (a->vector[0] == b->vector[0]) &&
-			    (a->vector[1] == b->vector[1]) &&
-			    (a->vector[2] == b->vector[2]);
-		break;
-	case OP_EQ_S:
-		c->_float = !strcmp(PR_GetString(a->string), PR_GetString(b->string));
-		break;
-	case OP_EQ_E:
-		c->_float = a->_int == b->_int;
-		break;
-	case OP_EQ_FNC:
-		c->_float = a->function == b->function;
-		break;
-
-	case OP_NE_F:
-		c->_float = a->_float != b->_float;
-		break;
-	case OP_NE_V:
-		c->_float = (a->vector[0] != b->vector[0]) ||
-			    (a->vector[1] != b->vector[1]) ||
-			    (a->vector[2] != b->vector[2]);
-		break;
-	case OP_NE_S:
-		c->_float = strcmp(PR_GetString(a->string), PR_GetString(b->string));
-		break;
-	case OP_NE_E:
-		c->_float = a->_int != b->_int;
-		break;
-	case OP_NE_FNC:
-		c->_float = a->function != b->function;
-		break;
-
-	case OP_STORE_F:
-	case OP_STORE_ENT:
-	case OP_STORE_FLD:	// integers
-	case OP_STORE_S:
-	case OP_STORE_FNC:	// pointers
-		b->_int = a->_int;
-		break;
-	case OP_STORE_V:
-		b->vector[0] = a->vector[0];
-		b->vector[1] = a->vector[1];
-		b->vector[2] = a->vector[2];
-		break;
-
-	case OP_STOREP_F:
-	case OP_STOREP_ENT:
-	case OP_STOREP_FLD:	// integers
-	case OP_STOREP_S:
-	case OP_STOREP_FNC:	// pointers
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		ptr->_int = a->_int;
-		break;
-	case OP_STOREP_V:
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		ptr->vector[0] = a->vector[0];
-		ptr->vector[1] = a->vector[1];
-		ptr->vector[2] = a->vector[2];
-		break;
-
-	case OP_MULSTORE_F:	// f *= f
-		b->_float *= a->_float;
-		break;
-	case OP_MULSTORE_V:	// v *= f
-		b->vector[0] *= a->_float;
-		b->vector[1] *= a->_float;
-		b->vector[2] *= a->_float;
-		break;
-	case OP_MULSTOREP_F:	// e.f *= f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->_float = (ptr->_float *= a->_float);
-		break;
-	case OP_MULSTOREP_V:	// e.v *= f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->vector[0] = (ptr->vector[0] *= a->_float);
-		c->vector[0] = (ptr->vector[1] *= a->_float);
-		c->vector[0] = (ptr->vector[2] *= a->_float);
-		break;
-
-	case OP_DIVSTORE_F:	// f /= f
-		b->_float /= a->_float;
-		break;
-	case OP_DIVSTOREP_F:	// e.f /= f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->_float = (ptr->_float /= a->_float);
-		break;
-
-	case OP_ADDSTORE_F:	// f += f
-		b->_float += a->_float;
-		break;
-	case OP_ADDSTORE_V:	// v += v
-		b->vector[0] += a->vector[0];
-		b->vector[1] += a->vector[1];
-		b->vector[2] += a->vector[2];
-		break;
-	case OP_ADDSTOREP_F:	// e.f += f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->_float = (ptr->_float += a->_float);
-		break;
-	case OP_ADDSTOREP_V:	// e.v += v
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->vector[0] = (ptr->vector[0] += a->vector[0]);
-		c->vector[1] = (ptr->vector[1] += a->vector[1]);
-		c->vector[2] = (ptr->vector[2] += a->vector[2]);
-		break;
-
-	case OP_SUBSTORE_F:	// f -= f
-		b->_float -= a->_float;
-		break;
-	case OP_SUBSTORE_V:	// v -= v
-		b->vector[0] -= a->vector[0];
-		b->vector[1] -= a->vector[1];
-		b->vector[2] -= a->vector[2];
-		break;
-	case OP_SUBSTOREP_F:	// e.f -= f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->_float = (ptr->_float -= a->_float);
-		break;
-	case OP_SUBSTOREP_V:	// e.v -= v
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		c->vector[0] = (ptr->vector[0] -= a->vector[0]);
-		c->vector[1] = (ptr->vector[1] -= a->vector[1]);
-		c->vector[2] = (ptr->vector[2] -= a->vector[2]);
-		break;
-
-	case OP_ADDRESS:
-		ed = PROG_TO_EDICT(a->edict);
-#ifdef PARANOID
-		NUM_FOR_EDICT(ed);	// Make sure it's in range
-#endif
-		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
-		{
-			pr_xstatement = st - pr_statements;
-			PR_RunError("assignment to world entity");
-		}
-		c->_int = (byte *)((int *)&ed->v + b->_int) - (byte *)sv.edicts;
-		break;
-
-	case OP_LOAD_F:
-	case OP_LOAD_FLD:
-	case OP_LOAD_ENT:
-	case OP_LOAD_S:
-	case OP_LOAD_FNC:
-		ed = PROG_TO_EDICT(a->edict);
-#ifdef PARANOID
-		NUM_FOR_EDICT(ed);	// Make sure it's in range
-#endif
-		ptr = (eval_t *)((int *)&ed->v + b->_int);
-		c->_int = ptr->_int;
-		break;
-
-	case OP_LOAD_V:
-		ed = PROG_TO_EDICT(a->edict);
-#ifdef PARANOID
-		NUM_FOR_EDICT(ed);	// Make sure it's in range
-#endif
-		ptr = (eval_t *)((int *)&ed->v + b->_int);
-		c->vector[0] = ptr->vector[0];
-		c->vector[1] = ptr->vector[1];
-		c->vector[2] = ptr->vector[2];
-		break;
-
-	case OP_FETCH_GBL_F:
-	case OP_FETCH_GBL_S:
-	case OP_FETCH_GBL_E:
-	case OP_FETCH_GBL_FNC:
-	  {	int i = (int)b->_float;
-		if (i < 0 || i > G_INT(st->a - 1))
-		{
-			pr_xstatement = st - pr_statements;
-			PR_RunError("array index out of bounds: %d", i);
-		}
-		ptr = (eval_t *)&pr_globals[st->a + i];
-		c->_int = ptr->_int;
-	  }	break;
-	case OP_FETCH_GBL_V:
-	  {	int i = (int)b->_float;
-		if (i < 0 || i > G_INT(st->a - 1))
-		{
-			pr_xstatement = st - pr_statements;
-			PR_RunError("array index out of bounds: %d", i);
-		}
-		ptr = (eval_t *)&pr_globals[st->a + (i * 3)];
-		c->vector[0] = ptr->vector[0];
-		c->vector[1] = ptr->vector[1];
-		c->vector[2] = ptr->vector[2];
-	  }	break;
-
-	case OP_IFNOT:
-		if (!a->_int)
-		{
-		/* Pa3PyX: a, b, and c used to be signed shorts for progs v6,
-		 * now they are signed ints.  The problem is, they were used
-		 * as signed sometimes and as unsigned other times - most of
-		 * the time they were used as unsigned with an explicit cast
-		 * in PR_ExecuteProgram().  When we convert the old progs to
-		 * to the new format in PR_ConvertOldStmts(), we zero-extend
-		 * them instead of sign-extending them for that reason: if we
-		 * sign-extend them, most of the code will not work - we will
-		 * have negative array offsets in PR_ExecuteProgram(), among
-		 * other things.  Note that they are cast to unsigned short
-		 * in PR_ConvertOldStmts() prior to assigning them to what is
-		 * now int.  There are a few instances where these shorts are
-		 * used as signed as in the case below where negative offsets
-		 * are needed.  Since we now have a zero-extended number in a,
-		 * b, and c, we must change it back to signed short, so that
-		 * when it is added with and assigned to an int, the result
-		 * ends up sign-extended and we get a proper negative offset,
-		 * if there is one.
-		 */
-			jump_ofs = st->b;
-			if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
-			st += jump_ofs - 1;	/* -1 to offset the st++ */
-		}
-		break;
-
-	case OP_IF:
-		if (a->_int)
-		{
-			jump_ofs = st->b;
-			if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
-			st += jump_ofs - 1;	/* -1 to offset the st++ */
-		}
-		break;
-
-	case OP_GOTO:
-		jump_ofs = st->a;
-		if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
-		st += jump_ofs - 1;	/* -1 to offset the st++ */
-		break;
-
-	case OP_CALL8:
-	case OP_CALL7:
-	case OP_CALL6:
-	case OP_CALL5:
-	case OP_CALL4:
-	case OP_CALL3:
-	case OP_CALL2:	// Copy second arg to shared space
-		vecptr = G_VECTOR(OFS_PARM1);
-		VectorCopy(c->vector, vecptr);
-	case OP_CALL1:	// Copy first arg to shared space
-		vecptr = G_VECTOR(OFS_PARM0);
-		VectorCopy(b->vector, vecptr);
-	case OP_CALL0:
-		pr_xfunction->profile += profile - startprofile;
-		startprofile = profile;
-		pr_xstatement = st - pr_statements;
-		pr_argc = st->op - OP_CALL0;
-		if (!a->function)
-		{
-			PR_RunError("NULL function");
-		}
-		newf = &pr_functions[a->function];
-		if (newf->first_statement < 0)
-		{ // Built-in function
-			int i = -newf->first_statement;
-			if (i >= pr_numbuiltins)
-			{
-				PR_RunError("Bad builtin call number %d", i);
-			}
-			pr_builtins[i]();
-			break;
-		}
-		// Normal function
-		st = &pr_statements[EnterFunction(newf)];
-		break;
-
-	case OP_DONE:
-	case OP_RETURN:
-	  {
-		float *retptr = &pr_globals[OFS_RETURN];
-		float *valptr = &pr_globals[st->a];
-		pr_xfunction->profile += profile - startprofile;
-		startprofile = profile;
-		pr_xstatement = st - pr_statements;
-		*retptr++ = *valptr++;
-		*retptr++ = *valptr++;
-		*retptr   = *valptr;
-		st = &pr_statements[LeaveFunction()];
-		if (pr_depth == exitdepth)
-		{ // Done
-			return;
-		}
-	  }	break;
-
-	case OP_STATE:
-		ed = PROG_TO_EDICT(*sv_globals.self);
-/* Id 1.07 changes
-#ifdef FPS_20
-		ed->v.nextthink = *sv_globals.time + 0.05;
-#else
-		ed->v.nextthink = *sv_globals.time + 0.1;
-#endif
-*/
-		ed->v.nextthink = *sv_globals.time + HX_FRAME_TIME;
-		ed->v.frame = a->_float;
-		ed->v.think = b->function;
-		break;
-
-	case OP_CSTATE:	// Cycle state
-	  {	int startFrame, endFrame;
-		ed = PROG_TO_EDICT(*sv_globals.self);
-		ed->v.nextthink = *sv_globals.time + HX_FRAME_TIME;
-		ed->v.think = pr_xfunction - pr_functions;
-		*sv_globals.cycle_wrapped = false;
-		startFrame = (int)a->_float;
-		endFrame = (int)b->_float;
-		if (startFrame <= endFrame)
-		{ // Increment
-			if (ed->v.frame < startFrame || ed->v.frame > endFrame)
-			{
-				ed->v.frame = startFrame;
-			}
-			else
-			{
-				ed->v.frame++;
-				if (ed->v.frame > endFrame)
-				{
-					*sv_globals.cycle_wrapped = true;
-					ed->v.frame = startFrame;
-				}
-			}
-		}
-		else
-		{ // Decrement
-			if (ed->v.frame > startFrame || ed->v.frame < endFrame)
-			{
-				ed->v.frame = startFrame;
-			}
-			else
-			{
-				ed->v.frame--;
-				if (ed->v.frame < endFrame)
-				{
-					*sv_globals.cycle_wrapped = true;
-					ed->v.frame = startFrame;
-				}
-			}
-		}
-	  }	break;
-
-	case OP_CWSTATE:	// Cycle weapon state
-	  {	int startFrame, endFrame;
-		ed = PROG_TO_EDICT(*sv_globals.self);
-		ed->v.nextthink = *sv_globals.time + HX_FRAME_TIME;
-		ed->v.think = pr_xfunction - pr_functions;
-		*sv_globals.cycle_wrapped = false;
-		startFrame = (int)a->_float;
-		endFrame = (int)b->_float;
-		if (startFrame <= endFrame)
-		{ // Increment
-			if (ed->v.weaponframe < startFrame
-				|| ed->v.weaponframe > endFrame)
-			{
-				ed->v.weaponframe = startFrame;
-			}
-			else
-			{
-				ed->v.weaponframe++;
-				if (ed->v.weaponframe > endFrame)
-				{
-					*sv_globals.cycle_wrapped = true;
-					ed->v.weaponframe = startFrame;
-				}
-			}
-		}
-		else
-		{ // Decrement
-			if (ed->v.weaponframe > startFrame
-				|| ed->v.weaponframe < endFrame)
-			{
-				ed->v.weaponframe = startFrame;
-			}
-			else
-			{
-				ed->v.weaponframe--;
-				if (ed->v.weaponframe < endFrame)
-				{
-					*sv_globals.cycle_wrapped = true;
-					ed->v.weaponframe = startFrame;
-				}
-			}
-		}
-	  }	break;
-
-	case OP_THINKTIME:
-		ed = PROG_TO_EDICT(a->edict);
-#ifdef PARANOID
-		NUM_FOR_EDICT(ed);	// Make sure it's in range
-#endif
-		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
-		{
-			pr_xstatement = st - pr_statements;
-			PR_RunError("assignment to world entity");
-		}
-		ed->v.nextthink = *sv_globals.time + b->_float;
-		break;
-
-	case OP_BITSET:		// f (+) f
-		b->_float = (int)b->_float | (int)a->_float;
-		break;
-	case OP_BITSETP:	// e.f (+) f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		ptr->_float = (int)ptr->_float | (int)a->_float;
-		break;
-	case OP_BITCLR:		// f (-) f
-		b->_float = (int)b->_float & ~((int)a->_float);
-		break;
-	case OP_BITCLRP:	// e.f (-) f
-		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
-		ptr->_float = (int)ptr->_float & ~((int)a->_float);
-		break;
-
-	case OP_RAND0:
-	  {	float val;
-		val = rand() * (1.0 / RAND_MAX);
-		G_FLOAT(OFS_RETURN) = val;
-	  }	break;
-	case OP_RAND1:
-	  {	float val;
-		val = rand() * (1.0 / RAND_MAX) * a->_float;
-		G_FLOAT(OFS_RETURN) = val;
-	  }	break;
-	case OP_RAND2:
-	  {	float val;
-		if (a->_float < b->_float)
-		{
-			val = a->_float + (rand() * (1.0 / RAND_MAX) * (b->_float - a->_float));
-		}
-		else
-		{
-			val = b->_float + (rand() * (1.0 / RAND_MAX) * (a->_float - b->_float));
-		}
-		G_FLOAT(OFS_RETURN) = val;
-	  }	break;
-	case OP_RANDV0:
-	  {	float val;
-		float *retptr = &G_FLOAT(OFS_RETURN);
-		val = rand() * (1.0 / RAND_MAX);
-		*retptr++ = val;
-		val = rand() * (1.0 / RAND_MAX);
-		*retptr++ = val;
-		val = rand() * (1.0 / RAND_MAX);
-		*retptr   = val;
-	  }	break;
-	case OP_RANDV1:
-	  {	float val;
-		float *retptr = &G_FLOAT(OFS_RETURN);
-		val = rand() * (1.0 / RAND_MAX) * a->vector[0];
-		*retptr++ = val;
-		val = rand() * (1.0 / RAND_MAX) * a->vector[1];
-		*retptr++ = val;
-		val = rand() * (1.0 / RAND_MAX) * a->vector[2];
-		*retptr   = val;
-	  }	break;
-	case OP_RANDV2:
-	  {	float val;
-		int	i;
-		float *retptr = &G_FLOAT(OFS_RETURN);
-		for (i = 0; i < 3; i++)
-		{
-			if (a->vector[i] < b->vector[i])
-			{
-				val = a->vector[i] + (rand() * (1.0 / RAND_MAX) * (b->vector[i] - a->vector[i]));
-			}
-			else
-			{
-				val = b->vector[i] + (rand() * (1.0 / RAND_MAX) * (a->vector[i] - b->vector[i]));
-			}
-			*retptr++ = val;
-		}
-	  }	break;
-	case OP_SWITCH_F:
-		case_type = SWITCH_F;
-		switch_float = a->_float;
-		jump_ofs = st->b;
-		if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
-		st += jump_ofs - 1;	/* -1 to offset the st++ */
-		break;
-	case OP_SWITCH_V:
-	case OP_SWITCH_S:
-	case OP_SWITCH_E:
-	case OP_SWITCH_FNC:
-		pr_xstatement = st - pr_statements;
-		PR_RunError("%s not done yet!", pr_opnames[st->op]);
-		break;
-
-	case OP_CASERANGE:
-		if (case_type != SWITCH_F)
-		{
-			pr_xstatement = st - pr_statements;
-			PR_RunError("caserange fucked!");
-		}
-		if ((switch_float >= a->_float) && (switch_float <= b->_float))
-		{
-			jump_ofs = st->c;
-			if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
-			st += jump_ofs - 1;	/* -1 to offset the st++ */
-		}
-		break;
-	case OP_CASE:
-		switch (case_type)
-		{
-		case SWITCH_F:
-			if (switch_float == a->_float)
-			{
-				jump_ofs = st->b;
-				if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
-				st += jump_ofs - 1;	/* -1 to offset the st++ */
-			}
-			break;
-		case SWITCH_V:
-		case SWITCH_S:
-		case SWITCH_E:
-		case SWITCH_FNC:
-			pr_xstatement = st - pr_statements;
-			PR_RunError("OP_CASE for %s not done yet!",
-					pr_opnames[case_type + OP_SWITCH_F - SWITCH_F]);
-			break;
-		default:
-			pr_xstatement = st - pr_statements;
-			PR_RunError("fucked case!");
-		}
-		break;
-
-	default:
-		pr_xstatement = st - pr_statements;
-		PR_RunError("Bad opcode %i", st->op);
+		int	num = st - pr_statements;
+		if (pr_badstatements[num >> 3] & (1 << (num & 7)))
+			PR_FailedVerification(st);
 	}
+#include "pr_execops.h"
     }	/* end of while(1) loop */
+#undef	PR_SWITCHLOOP
 }
 #undef OPA
 #undef OPB
 #undef OPC
+#undef PR_CHECKFIELD
+#undef PR_STOREDFIELD
+
+
+//==========================================================================
+//
+// PR_InExecution
+//
+// Whether any QC function is on the stack, i.e. we are in a builtin.
+//
+//==========================================================================
+
+qboolean PR_InExecution (void)
+{
+	return (pr_depth != 0);
+}
 
 
 //==========================================================================
@@ -835,6 +377,19 @@ static int EnterFunction (dfunction_t *f)
 {
 	int	i, j, c, o;
 
+	if (pr_funcstatus[f - pr_functions] == PR_FUNC_BAD)
+	{
+		PR_RunError ("%s: function %s failed verification", __thisfunc__,
+					PR_GetString(f->s_name));
+	}
+
+	if (prprof_active)
+	{
+		if (pr_depth == 0)	/* outermost call: nothing can be left */
+			prprof_depth = prprof_overdepth = 0;
+		PR_ProfilePush(f - pr_functions);
+	}
+
 	pr_stack[pr_depth].s = pr_xstatement;
 	pr_stack[pr_depth].f = pr_xfunction;
 	pr_depth++;
@@ -900,6 +455,9 @@ static int LeaveFunction (void)
 		((int *)pr_globals)[pr_xfunction->parm_start + i] = localstack[localstack_used + i];
 	}
 
+	if (prprof_active)
+		PR_ProfilePop();
+
 	// up stack
 	pr_depth--;
 	pr_xfunction = pr_stack[pr_depth].f;
@@ -907,6 +465,276 @@ static int LeaveFunction (void)
 }
 
 
+//==========================================================================
+//
+// PR_FunctionEnd
+//
+// Functions are laid out one after the other: the statements of f run
+// up to the next function's first statement.
+//
+//==========================================================================
+
+static int PR_FunctionEnd (dfunction_t *f)
+{
+	int		i, end;
+
+	end = progs->numstatements;
+	for (i = 1; i < progs->numfunctions; i++)
+	{
+		if (pr_functions[i].first_statement > f->first_statement &&
+				pr_functions[i].first_statement < end)
+			end = pr_functions[i].first_statement;
+	}
+	return end;
+}
+
+//==========================================================================
+//
+// PR_CheckOperand
+//
+//==========================================================================
+
+static const char *PR_CheckOperand (int num, int first, int end, int kind, int ofs, char name)
+{
+	static char	why[64];
+	int		target;
+
+	switch (kind)
+	{
+	case 0:
+		return NULL;
+	case OPND_JUMP:
+		if (is_progs_v6)
+			ofs = (signed short)ofs;
+		target = num + ofs;
+		if (target < first || target >= end)
+		{
+			q_snprintf (why, sizeof(why), "operand %c jumps to %d, out of the function", name, target);
+			return why;
+		}
+		return NULL;
+	case OPND_ARRAY:
+		if (ofs < 1 || ofs >= progs->numglobals)
+		{
+			q_snprintf (why, sizeof(why), "operand %c: array at %d out of the globals", name, ofs);
+			return why;
+		}
+		return NULL;
+	default:
+		if (ofs < 0 || ofs + kind > progs->numglobals)
+		{
+			q_snprintf (why, sizeof(why), "operand %c: global %d out of range", name, ofs);
+			return why;
+		}
+		return NULL;
+	}
+}
+
+//==========================================================================
+//
+// PR_CheckStatement
+//
+// Returns why statement num of the function whose statements are
+// [first, end) isn't safe to run unchecked, or NULL if it is.
+//
+//==========================================================================
+
+static const char *PR_CheckStatement (int num, int first, int end)
+{
+	static char	why[128];
+	dstatement_t	*st = &pr_statements[num];
+	const propinfo_t	*info;
+	const char	*err;
+	dfunction_t	*callee;
+	int		i;
+
+	if (st->op >= PR_NUMOPS)
+	{
+		q_snprintf (why, sizeof(why), "bad opcode %d", st->op);
+		return why;
+	}
+	info = &pr_opinfo[st->op];
+	if ((err = PR_CheckOperand(num, first, end, info->a, st->a, 'a')) != NULL)
+		return err;
+	if ((err = PR_CheckOperand(num, first, end, info->b, st->b, 'b')) != NULL)
+		return err;
+	if ((err = PR_CheckOperand(num, first, end, info->c, st->c, 'c')) != NULL)
+		return err;
+	if (num == end - 1 && st->op != OP_DONE && st->op != OP_RETURN && st->op != OP_GOTO)
+		return "runs off the end of the function";
+
+	/* the cases of a vector switch compare vectors: the table has
+	 * them as 1 wide, so check them here, where the type is known. */
+	if (st->op == OP_SWITCH_V)
+	{
+		i = num + (is_progs_v6 ? (signed short)st->b : st->b);
+		for ( ; i < end && pr_statements[i].op == OP_CASE; i++)
+		{
+			if ((err = PR_CheckOperand(i, first, end, 3, pr_statements[i].a, 'a')) != NULL)
+				return err;
+		}
+	}
+
+	/* calls through a function constant: compare the arities */
+	if (st->op >= OP_CALL0 && st->op <= OP_CALL8)
+	{
+		i = ((int *)pr_globals)[st->a];
+		if (i <= 0 || i >= progs->numfunctions)
+			return NULL;
+		callee = &pr_functions[i];
+		if (callee->first_statement > 0 && callee->numparms >= 0 &&
+				callee->numparms != st->op - OP_CALL0)
+		{
+			q_snprintf (why, sizeof(why), "calls %s with %d parms, expected %d",
+				PR_GetString(callee->s_name), st->op - OP_CALL0, callee->numparms);
+			return why;
+		}
+	}
+	return NULL;
+}
+
+//==========================================================================
+//
+// PR_CheckFunction
+//
+// Returns why the header of f would make EnterFunction() touch memory
+// outside the globals, or NULL.
+//
+//==========================================================================
+
+static const char *PR_CheckFunction (dfunction_t *f)
+{
+	int		i, size;
+
+	if (f->first_statement < 0)
+		return NULL;	/* builtin: the number is checked by OP_CALL */
+	if (f->first_statement == 0 || f->first_statement >= progs->numstatements)
+		return "first statement out of range";
+	if (f->parm_start < 0 || f->locals < 0 ||
+			f->parm_start + f->locals > progs->numglobals)
+		return "locals out of the globals";
+	if (f->numparms > MAX_PARMS)
+		return "too many parms";
+	for (i = size = 0; i < f->numparms; i++)
+		size += f->parm_size[i];
+	if (size > f->locals)
+		return "parms larger than the locals";
+	return NULL;
+}
+
+static int PR_CompareFirstStatements (const void *a, const void *b)
+{
+	return pr_functions[*(const int *)a].first_statement -
+		pr_functions[*(const int *)b].first_statement;
+}
+
+//==========================================================================
+//
+// PR_VerifyProgs
+//
+// Checks every function header and statement of the just loaded progs
+// against the sizes of the globals, the functions and the opcode table.
+// Functions that pass run on the plain interpreter path; the others are
+// reported here, and their bad statements raise a PR_RunError() when
+// they are reached instead of scribbling over memory.
+//
+//==========================================================================
+
+#define	PR_MAXVERIFYMSGS	16
+
+void PR_VerifyProgs (void)
+{
+	int		i, j, n, first, end, numbad, numbadfuncs;
+	int		*order;
+	dfunction_t	*f;
+	const char	*why;
+
+	pr_funcstatus = (byte *) Hunk_AllocName (progs->numfunctions, "progverify");
+	pr_badstatements = (byte *) Hunk_AllocName ((progs->numstatements + 7) >> 3, "progverify");
+
+	order = (int *) malloc (progs->numfunctions * sizeof(int));
+	if (!order)
+		Sys_Error ("%s: out of memory", __thisfunc__);
+	for (i = 0; i < progs->numfunctions; i++)
+		order[i] = i;
+	qsort (order, progs->numfunctions, sizeof(int), PR_CompareFirstStatements);
+
+	numbad = numbadfuncs = 0;
+	for (n = 0; n < progs->numfunctions; n++)
+	{
+		f = &pr_functions[order[n]];
+		if (order[n] == 0 || f->first_statement < 0)
+			continue;
+
+		if ((why = PR_CheckFunction(f)) != NULL)
+		{
+			pr_funcstatus[order[n]] = PR_FUNC_BAD;
+			if (numbad++ < PR_MAXVERIFYMSGS)
+				Con_Printf ("progs: %s: %s\n", PR_GetString(f->s_name), why);
+			numbadfuncs++;
+			continue;
+		}
+
+		first = f->first_statement;
+		end = progs->numstatements;
+		for (j = n + 1; j < progs->numfunctions; j++)
+		{
+			if (pr_functions[order[j]].first_statement > first)
+			{
+				end = pr_functions[order[j]].first_statement;
+				break;
+			}
+		}
+
+		for (i = first; i < end; i++)
+		{
+			if ((why = PR_CheckStatement(i, first, end)) != NULL)
+			{
+				pr_badstatements[i >> 3] |= 1 << (i & 7);
+				pr_funcstatus[order[n]] = PR_FUNC_CHECKED;
+				if (numbad++ < PR_MAXVERIFYMSGS)
+				{
+					Con_Printf ("progs: %s, statement %d (%s): %s\n", PR_GetString(f->s_name),
+						i, pr_opnames[pr_statements[i].op < PR_NUMOPS ? pr_statements[i].op : 0], why);
+				}
+			}
+		}
+		if (pr_funcstatus[order[n]] != PR_FUNC_OK)
+			numbadfuncs++;
+	}
+
+	free (order);
+
+	if (numbad)
+	{
+		if (numbad > PR_MAXVERIFYMSGS)
+			Con_Printf ("progs: ... %d more\n", numbad - PR_MAXVERIFYMSGS);
+		Con_Printf ("progs: %d problems in %d functions, they will run checked\n", numbad, numbadfuncs);
+	}
+	else
+	{
+		Con_DPrintf ("progs: %d functions verified\n", progs->numfunctions);
+	}
+}
+
+//==========================================================================
+//
+// PR_FailedVerification
+//
+// The checked path reached a statement PR_VerifyProgs() rejected.
+//
+//==========================================================================
+
+static void PR_FailedVerification (dstatement_t *st)
+{
+	int		num = st - pr_statements;
+	const char	*why;
+
+	why = PR_CheckStatement(num, pr_xfunction->first_statement, PR_FunctionEnd(pr_xfunction));
+	pr_xstatement = num;
+	PR_RunError("%s", why ? why : "statement failed verification");
+}
+
 //==========================================================================
 //
 // PR_RunError
@@ -931,6 +759,7 @@ void PR_RunError (const char *error, ...)
 	Con_Printf("%s\n", string);
 
 	pr_depth = 0;	// dump the stack so host_error can shutdown functions
+	prprof_depth = prprof_overdepth = 0;
 
 	Host_Error("Program error");
 }
@@ -1212,3 +1041,484 @@ void PR_Profile_f (void)
 	}
 }
 
+
+
+/*
+==============================================================================
+
+HIERARCHICAL PROFILER
+
+Unlike PR_Profile_f, which only counts statements per function, this
+keeps a call tree with one node per distinct call stack (QC functions
+and builtins alike) and records calls, self statements and inclusive
+wall time for each.  When it is off, the VM pays one flag test per call.
+Inclusive statement counts and self times are derived when reporting.
+
+==============================================================================
+*/
+
+//==========================================================================
+//
+// PR_ProfileClock
+//
+// Monotonic nanoseconds for the call timings.  Read twice per call, so
+// it has to be cheaper and finer than Sys_DoubleTime, which is a
+// gettimeofday with microsecond resolution on unix.  Platforms with
+// neither clock fall back to Sys_DoubleTime.
+//
+//==========================================================================
+
+static uint64_t PR_ProfileClock (void)
+{
+#if defined(PLATFORM_WINDOWS)
+	static double	scale;
+	LARGE_INTEGER	t;
+
+	if (!scale)
+	{
+		QueryPerformanceFrequency (&t);
+		scale = 1.0e9 / (double) t.QuadPart;
+	}
+	QueryPerformanceCounter (&t);
+	return (uint64_t) ((double) t.QuadPart * scale);
+#elif defined(PLATFORM_UNIX) && defined(CLOCK_MONOTONIC)
+	struct timespec	t;
+
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+#else
+	return (uint64_t) (Sys_DoubleTime () * 1.0e9);
+#endif
+}
+
+//==========================================================================
+//
+// PR_ProfilePush
+//
+//==========================================================================
+
+static void PR_ProfilePush (int func)
+{
+	prprof_frame_t	*fr;
+	prprof_node_t	*n;
+	int		parent, i, prev;
+
+	if (prprof_depth >= PRPROF_MAXDEPTH)
+	{
+		prprof_overdepth++;
+		return;
+	}
+
+	parent = (prprof_depth) ? prprof_stack[prprof_depth - 1].node : 0;
+	fr = &prprof_stack[prprof_depth++];
+	fr->folded = false;
+
+	prev = -1;
+	for (i = prprof_nodes[parent].child; i != -1; i = prprof_nodes[i].sibling)
+	{
+		if (prprof_nodes[i].func == func)
+			break;
+		prev = i;
+	}
+
+	if (i == -1)
+	{
+		if (prprof_numnodes >= PRPROF_MAXNODES)
+		{ // out of nodes: charge everything to the caller
+			prprof_dropped++;
+			fr->node = parent;
+			fr->folded = true;
+			return;
+		}
+		i = prprof_numnodes++;
+		n = &prprof_nodes[i];
+		memset (n, 0, sizeof(prprof_node_t));
+		n->func = func;
+		n->parent = parent;
+		n->child = -1;
+		n->sibling = prprof_nodes[parent].child;
+		prprof_nodes[parent].child = i;
+	}
+	else if (prev != -1)
+	{ // move to the front so that hot callees are found first
+		prprof_nodes[prev].sibling = prprof_nodes[i].sibling;
+		prprof_nodes[i].sibling = prprof_nodes[parent].child;
+		prprof_nodes[parent].child = i;
+	}
+
+	prprof_nodes[i].calls++;
+	fr->node = i;
+	fr->start = PR_ProfileClock ();
+}
+
+//==========================================================================
+//
+// PR_ProfilePop
+//
+//==========================================================================
+
+static void PR_ProfilePop (void)
+{
+	prprof_frame_t	*fr;
+
+	if (prprof_overdepth)
+	{
+		prprof_overdepth--;
+		return;
+	}
+	if (!prprof_depth)
+		return;	/* started in the middle of a call */
+
+	fr = &prprof_stack[--prprof_depth];
+	if (!fr->folded)
+		prprof_nodes[fr->node].total_time += (PR_ProfileClock () - fr->start) * 1.0e-9;
+}
+
+//==========================================================================
+//
+// PR_InitFieldWatch
+//
+//==========================================================================
+
+void PR_InitFieldWatch (void)
+{
+	int		i;
+
+	memset (pr_fieldwatch, 0, sizeof(pr_fieldwatch));
+	pr_fieldwatch[PR_FIELDOFS(solid)] |= FW_LINK;
+	for (i = 0; i < 3; i++)
+	{
+		pr_fieldwatch[PR_FIELDOFS(origin) + i] |= FW_LINK;
+		pr_fieldwatch[PR_FIELDOFS(mins) + i] |= FW_LINK;
+		pr_fieldwatch[PR_FIELDOFS(maxs) + i] |= FW_LINK;
+		pr_fieldwatch[PR_FIELDOFS(angles) + i] |= FW_TRACE;
+	}
+	pr_fieldwatch[PR_FIELDOFS(owner)] |= FW_TRACE;
+	pr_fieldwatch[PR_FIELDOFS(classname)] |= FW_STRING;
+	pr_fieldwatch[PR_FIELDOFS(targetname)] |= FW_STRING;
+	pr_fieldwatch[PR_FIELDOFS(target)] |= FW_STRING;
+	pr_fieldwatch[PR_FIELDOFS(netname)] |= FW_STRING;
+	pr_fieldwatch[PR_FIELDOFS(movetype)] |= FW_PHYSICS;
+	pr_fieldwatch[PR_FIELDOFS(nextthink)] |= FW_PHYSICS;
+	pr_fieldwatch[PR_FIELDOFS(model)] |= FW_MODEL;
+	pr_fieldwatch[PR_FIELDOFS(modelindex)] |= FW_MODEL;
+}
+
+//==========================================================================
+//
+// PR_FieldWritten
+//
+// Progs stored to a watched field of ed: tell whoever caches
+// something derived from it.
+//
+//==========================================================================
+
+static void PR_FieldWritten (edict_t *ed, int watch)
+{
+	int		num;
+
+	if (watch & FW_LINK)
+		SV_EdictMoved (ed);
+	else if (watch & FW_TRACE)
+		SV_EdictTurned (ed);
+	if (watch & FW_STRING)
+		ED_StringFieldsChanged (ed);
+	num = NUM_FOR_EDICT(ed);
+	if (watch & FW_PHYSICS)
+		ED_SetAdd (ed_physset, num);
+	if (watch & FW_MODEL)
+		ED_SetAdd (ed_modelset, num);
+}
+
+//==========================================================================
+//
+// PR_StoredField
+//
+// Maps an OP_ADDRESS pointer (a byte offset from sv.edicts) that n
+// words were just stored through back to its edict and field.
+//
+//==========================================================================
+
+static void PR_StoredField (int ptr, int n)
+{
+	int		num, ofs, watch;
+
+	if (ptr < 0)
+		return;
+	num = ptr / pr_edict_size;
+	if (num >= sv.num_edicts)
+		return;
+	ofs = (ptr - num * pr_edict_size - (int)offsetof(edict_t, v)) / 4;
+	watch = 0;
+	for ( ; n > 0; n--, ofs++)
+	{
+		if ((unsigned int)ofs < PR_WATCHFIELDS)
+			watch |= pr_fieldwatch[ofs];
+	}
+	if (watch)
+		PR_FieldWritten (EDICT_NUM(num), watch);
+}
+
+//==========================================================================
+//
+// PR_ProfileReset
+//
+//==========================================================================
+
+static void PR_ProfileReset (void)
+{
+	if (!prprof_nodes)
+		prprof_nodes = (prprof_node_t *) malloc (PRPROF_MAXNODES * sizeof(prprof_node_t));
+	if (!prprof_nodes)
+		Sys_Error ("%s: failed to allocate profile nodes", __thisfunc__);
+
+	memset (&prprof_nodes[0], 0, sizeof(prprof_node_t));
+	prprof_nodes[0].func = -1;
+	prprof_nodes[0].parent = -1;
+	prprof_nodes[0].child = -1;
+	prprof_nodes[0].sibling = -1;
+	prprof_numnodes = 1;
+	prprof_dropped = 0;
+	prprof_depth = prprof_overdepth = 0;
+	prprof_crc = pr_crc;
+	prprof_elapsed = 0;
+	prprof_starttime = Sys_DoubleTime ();
+}
+
+//==========================================================================
+//
+// PR_ProfileCheckProgs
+//
+// Called after a progs load. Function numbers recorded so far are only
+// meaningful for the same progs, so throw them away if it changed.
+//
+//==========================================================================
+
+void PR_ProfileCheckProgs (void)
+{
+	if (!prprof_nodes || prprof_crc == pr_crc)
+		return;
+	if (prprof_numnodes > 1)
+		Con_Printf ("progs changed, profile data discarded\n");
+	PR_ProfileReset ();
+}
+
+//==========================================================================
+//
+// PR_ProfileSums
+//
+// Children are always created after their parents, so a single
+// backwards sweep accumulates the inclusive numbers bottom-up.
+//
+//==========================================================================
+
+static void PR_ProfileSums (void)
+{
+	int		i;
+	prprof_node_t	*n, *p;
+
+	for (i = 0; i < prprof_numnodes; i++)
+	{
+		prprof_nodes[i].total_stmts = prprof_nodes[i].self_stmts;
+		prprof_nodes[i].child_time = 0;
+	}
+	for (i = prprof_numnodes - 1; i > 0; i--)
+	{
+		n = &prprof_nodes[i];
+		p = &prprof_nodes[n->parent];
+		p->total_stmts += n->total_stmts;
+		p->child_time += n->total_time;
+	}
+}
+
+static double PR_ProfileSelfTime (const prprof_node_t *n)
+{
+	double	t = n->total_time - n->child_time;
+	return (t > 0) ? t : 0;
+}
+
+//==========================================================================
+//
+// PR_ProfileStackName
+//
+// Writes the call stack leading to node as "outer;...;inner".
+//
+//==========================================================================
+
+static void PR_ProfileStackName (int node, char *buf, size_t size)
+{
+	int		chain[PRPROF_MAXDEPTH];
+	int		i, count;
+
+	count = 0;
+	for ( ; node > 0 && count < PRPROF_MAXDEPTH; node = prprof_nodes[node].parent)
+		chain[count++] = node;
+
+	buf[0] = 0;
+	for (i = count - 1; i >= 0; i--)
+	{
+		q_strlcat (buf, PR_GetString(pr_functions[prprof_nodes[chain[i]].func].s_name), size);
+		if (i)
+			q_strlcat (buf, ";", size);
+	}
+}
+
+static qboolean PR_ProfileUsable (void)
+{
+	if (!prprof_nodes || prprof_numnodes <= 1)
+	{
+		Con_Printf ("no profile data, use profile_start\n");
+		return false;
+	}
+	if (!progs || prprof_crc != pr_crc)
+	{
+		Con_Printf ("profile data is for a different progs\n");
+		return false;
+	}
+	return true;
+}
+
+static int PR_ProfileCompare (const void *a, const void *b)
+{
+	double	ta = PR_ProfileSelfTime(&prprof_nodes[*(const int *)a]);
+	double	tb = PR_ProfileSelfTime(&prprof_nodes[*(const int *)b]);
+
+	if (ta < tb)
+		return 1;
+	if (ta > tb)
+		return -1;
+	return 0;
+}
+
+//==========================================================================
+//
+// PR_ProfileStart_f, PR_ProfileStop_f
+//
+//==========================================================================
+
+void PR_ProfileStart_f (void)
+{
+	PR_ProfileReset ();
+	prprof_active = true;
+	Con_Printf ("QC call stack profiling started\n");
+}
+
+void PR_ProfileStop_f (void)
+{
+	if (!prprof_active)
+		return;
+	prprof_active = false;
+	prprof_depth = prprof_overdepth = 0;
+	prprof_elapsed = Sys_DoubleTime () - prprof_starttime;
+	Con_Printf ("QC call stack profiling stopped after %.1f seconds\n", prprof_elapsed);
+}
+
+//==========================================================================
+//
+// PR_ProfileReport_f
+//
+// profile_report [count]: the call stacks with the most self time.
+//
+//==========================================================================
+
+void PR_ProfileReport_f (void)
+{
+	int		i, count, *order;
+	prprof_node_t	*n;
+	char		name[1024];
+	double		elapsed;
+
+	if (!PR_ProfileUsable())
+		return;
+
+	count = 20;
+	if (Cmd_Argc() > 1)
+		count = atoi(Cmd_Argv(1));
+	if (count < 1)
+		count = 1;
+
+	order = (int *) malloc ((prprof_numnodes - 1) * sizeof(int));
+	if (!order)
+		return;
+	PR_ProfileSums ();
+	for (i = 1; i < prprof_numnodes; i++)
+		order[i - 1] = i;
+	qsort (order, prprof_numnodes - 1, sizeof(int), PR_ProfileCompare);
+
+	elapsed = (prprof_active) ? Sys_DoubleTime () - prprof_starttime : prprof_elapsed;
+	Con_Printf ("%d call stacks in %.1f seconds, %.2f ms in QC, %u statements\n",
+			prprof_numnodes - 1, elapsed,
+			prprof_nodes[0].child_time * 1000.0, prprof_nodes[0].total_stmts);
+	if (prprof_dropped)
+		Con_Printf ("%d calls charged to their caller (out of nodes)\n", prprof_dropped);
+	Con_Printf ("   calls  self ms  incl ms  self st  incl st  stack\n");
+	for (i = 0; i < count && i < prprof_numnodes - 1; i++)
+	{
+		n = &prprof_nodes[order[i]];
+		PR_ProfileStackName (order[i], name, sizeof(name));
+		Con_Printf ("%8u %8.2f %8.2f %8u %8u  %s\n", n->calls,
+				PR_ProfileSelfTime(n) * 1000.0, n->total_time * 1000.0,
+				n->self_stmts, n->total_stmts, name);
+	}
+
+	free (order);
+}
+
+//==========================================================================
+//
+// PR_ProfileFolded_f
+//
+// profile_folded [filename] [stmts]: writes the call stacks in the
+// "folded" format understood by flamegraph.pl and compatible tools.
+// Values are self nanoseconds, or self statements with "stmts".
+//
+//==========================================================================
+
+void PR_ProfileFolded_f (void)
+{
+	int		i;
+	prprof_node_t	*n;
+	const char	*saveName;
+	FILE		*f;
+	qboolean	stmts;
+	char		name[1024];
+	unsigned long	val;
+
+	if (!PR_ProfileUsable())
+		return;
+
+	stmts = false;
+	saveName = "profile.folded";
+	for (i = 1; i < Cmd_Argc(); i++)
+	{
+		if (!q_strcasecmp(Cmd_Argv(i), "stmts"))
+			stmts = true;
+		else
+			saveName = Cmd_Argv(i);
+	}
+
+	saveName = FS_MakePath(FS_USERDIR, NULL, saveName);
+	f = fopen (saveName, "w");
+	if (!f)
+	{
+		Con_Printf ("Could not open %s\n", saveName);
+		return;
+	}
+
+	PR_ProfileSums ();
+	for (i = 1; i < prprof_numnodes; i++)
+	{
+		n = &prprof_nodes[i];
+		if (stmts)
+			val = n->self_stmts;
+		else
+			val = (unsigned long) (PR_ProfileSelfTime(n) * 1.0e9);
+		if (!val)
+			continue;
+		PR_ProfileStackName (i, name, sizeof(name));
+		fprintf (f, "%s %lu\n", name, val);
+	}
+
+	fclose (f);
+	Con_Printf ("Wrote %s\n", saveName);
+}
@@ -0,0 +1,696 @@
+/* pr_execops.h -- the statement dispatch of PR_ExecuteProgram()
+ *
+ * Copyright (C) 1996-1997  Id Software, Inc.
+ * Copyright (C) 1997-1998  Raven Software Corp.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* not a real header: pr_exec.c includes this inside PR_ExecuteProgram()
+ * once for the unchecked and once for the checked interpreter loop, so
+ * that the verified functions don't pay for testing the bad statement
+ * bitmap.  PR_SWITCHLOOP moves to the other loop when a call or return
+ * lands in a function of the other kind.  */
+
+	a = OPA;
+	b = OPB;
+	c = OPC;
+
+	if (++profile > 100000)
+	{
+		pr_xstatement = st - pr_statements;
+		PR_RunError("runaway loop error");
+	}
+
+	if (pr_trace)
+	{
+		PrintStatement(st);
+	}
+
+	switch (st->op)
+	{
+	case OP_ADD_F:
+		c->_float = a->_float + b->_float;
+		break;
+	case OP_ADD_V:
+		c->vector[0] = a->vector[0] + b->vector[0];
+		c->vector[1] = a->vector[1] + b->vector[1];
+		c->vector[2] = a->vector[2] + b->vector[2];
+		break;
+
+	case OP_SUB_F:
+		c->_float = a->_float - b->_float;
+		break;
+	case OP_SUB_V:
+		c->vector[0] = a->vector[0] - b->vector[0];
+		c->vector[1] = a->vector[1] - b->vector[1];
+		c->vector[2] = a->vector[2] - b->vector[2];
+		break;
+
+	case OP_MUL_F:
+		c->_float = a->_float * b->_float;
+		break;
+	case OP_MUL_V:
+		c->_float = a->vector[0] * b->vector[0] +
+			    a->vector[1] * b->vector[1] +
+			    a->vector[2] * b->vector[2];
+		break;
+	case OP_MUL_FV:
+		c->vector[0] = a->_float * b->vector[0];
+		c->vector[1] = a->_float * b->vector[1];
+		c->vector[2] = a->_float * b->vector[2];
+		break;
+	case OP_MUL_VF:
+		c->vector[0] = b->_float * a->vector[0];
+		c->vector[1] = b->_float * a->vector[1];
+		c->vector[2] = b->_float * a->vector[2];
+		break;
+
+	case OP_DIV_F:
+		c->_float = a->_float / b->_float;
+		break;
+
+	case OP_BITAND:
+		c->_float = (int)a->_float & (int)b->_float;
+		break;
+
+	case OP_BITOR:
+		c->_float = (int)a->_float | (int)b->_float;
+		break;
+
+	case OP_GE:
+		c->_float = a->_float >= b->_float;
+		break;
+	case OP_LE:
+		c->_float = a->_float <= b->_float;
+		break;
+	case OP_GT:
+		c->_float = a->_float > b->_float;
+		break;
+	case OP_LT:
+		c->_float = a->_float < b->_float;
+		break;
+	case OP_AND:
+		c->_float = a->_float && b->_float;
+		break;
+	case OP_OR:
+		c->_float = a->_float || b->_float;
+		break;
+
+	case OP_NOT_F:
+		c->_float = !a->_float;
+		break;
+	case OP_NOT_V:
+		c->_float = !a->vector[0] && !a->vector[1] && !a->vector[2];
+		break;
+	case OP_NOT_S:
+		c->_float = !a->string || !*PR_GetString(a->string);
+		break;
+	case OP_NOT_FNC:
+		c->_float = !a->function;
+		break;
+	case OP_NOT_ENT:
+		c->_float = (PROG_TO_EDICT(a->edict) == sv.edicts);
+		break;
+
+	case OP_EQ_F:
+		c->_float = a->_float == b->_float;
+		break;
+	case OP_EQ_V:
+		c->_float = (a->vector[0] == b->vector[0]) &&
+			    (a->vector[1] == b->vector[1]) &&
+			    (a->vector[2] == b->vector[2]);
+		break;
+	case OP_EQ_S:
+		c->_float = !strcmp(PR_GetString(a->string), PR_GetString(b->string));
+		break;
+	case OP_EQ_E:
+		c->_float = a->_int == b->_int;
+		break;
+	case OP_EQ_FNC:
+		c->_float = a->function == b->function;
+		break;
+
+	case OP_NE_F:
+		c->_float = a->_float != b->_float;
+		break;
+	case OP_NE_V:
+		c->_float = (a->vector[0] != b->vector[0]) ||
+			    (a->vector[1] != b->vector[1]) ||
+			    (a->vector[2] != b->vector[2]);
+		break;
+	case OP_NE_S:
+		c->_float = strcmp(PR_GetString(a->string), PR_GetString(b->string));
+		break;
+	case OP_NE_E:
+		c->_float = a->_int != b->_int;
+		break;
+	case OP_NE_FNC:
+		c->_float = a->function != b->function;
+		break;
+
+	case OP_STORE_F:
+	case OP_STORE_ENT:
+	case OP_STORE_FLD:	// integers
+	case OP_STORE_S:
+	case OP_STORE_FNC:	// pointers
+		b->_int = a->_int;
+		break;
+	case OP_STORE_V:
+		b->vector[0] = a->vector[0];
+		b->vector[1] = a->vector[1];
+		b->vector[2] = a->vector[2];
+		break;
+
+	case OP_STOREP_F:
+	case OP_STOREP_ENT:
+	case OP_STOREP_FLD:	// integers
+	case OP_STOREP_S:
+	case OP_STOREP_FNC:	// pointers
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		ptr->_int = a->_int;
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+	case OP_STOREP_V:
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		ptr->vector[0] = a->vector[0];
+		ptr->vector[1] = a->vector[1];
+		ptr->vector[2] = a->vector[2];
+		PR_STOREDFIELD(b->_int, 3);
+		break;
+
+	case OP_MULSTORE_F:	// f *= f
+		b->_float *= a->_float;
+		break;
+	case OP_MULSTORE_V:	// v *= f
+		b->vector[0] *= a->_float;
+		b->vector[1] *= a->_float;
+		b->vector[2] *= a->_float;
+		break;
+	case OP_MULSTOREP_F:	// e.f *= f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->_float = (ptr->_float *= a->_float);
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+	case OP_MULSTOREP_V:	// e.v *= f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->vector[0] = (ptr->vector[0] *= a->_float);
+		c->vector[0] = (ptr->vector[1] *= a->_float);
+		c->vector[0] = (ptr->vector[2] *= a->_float);
+		PR_STOREDFIELD(b->_int, 3);
+		break;
+
+	case OP_DIVSTORE_F:	// f /= f
+		b->_float /= a->_float;
+		break;
+	case OP_DIVSTOREP_F:	// e.f /= f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->_float = (ptr->_float /= a->_float);
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+
+	case OP_ADDSTORE_F:	// f += f
+		b->_float += a->_float;
+		break;
+	case OP_ADDSTORE_V:	// v += v
+		b->vector[0] += a->vector[0];
+		b->vector[1] += a->vector[1];
+		b->vector[2] += a->vector[2];
+		break;
+	case OP_ADDSTOREP_F:	// e.f += f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->_float = (ptr->_float += a->_float);
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+	case OP_ADDSTOREP_V:	// e.v += v
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->vector[0] = (ptr->vector[0] += a->vector[0]);
+		c->vector[1] = (ptr->vector[1] += a->vector[1]);
+		c->vector[2] = (ptr->vector[2] += a->vector[2]);
+		PR_STOREDFIELD(b->_int, 3);
+		break;
+
+	case OP_SUBSTORE_F:	// f -= f
+		b->_float -= a->_float;
+		break;
+	case OP_SUBSTORE_V:	// v -= v
+		b->vector[0] -= a->vector[0];
+		b->vector[1] -= a->vector[1];
+		b->vector[2] -= a->vector[2];
+		break;
+	case OP_SUBSTOREP_F:	// e.f -= f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->_float = (ptr->_float -= a->_float);
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+	case OP_SUBSTOREP_V:	// e.v -= v
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		c->vector[0] = (ptr->vector[0] -= a->vector[0]);
+		c->vector[1] = (ptr->vector[1] -= a->vector[1]);
+		c->vector[2] = (ptr->vector[2] -= a->vector[2]);
+		PR_STOREDFIELD(b->_int, 3);
+		break;
+
+	case OP_ADDRESS:
+		ed = PROG_TO_EDICT(a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+		{
+			pr_xstatement = st - pr_statements;
+			PR_RunError("assignment to world entity");
+		}
+		PR_CHECKFIELD(b->_int, 1);
+		c->_int = (byte *)((int *)&ed->v + b->_int) - (byte *)sv.edicts;
+		break;
+
+	case OP_LOAD_F:
+	case OP_LOAD_FLD:
+	case OP_LOAD_ENT:
+	case OP_LOAD_S:
+	case OP_LOAD_FNC:
+		ed = PROG_TO_EDICT(a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		PR_CHECKFIELD(b->_int, 1);
+		ptr = (eval_t *)((int *)&ed->v + b->_int);
+		c->_int = ptr->_int;
+		break;
+
+	case OP_LOAD_V:
+		ed = PROG_TO_EDICT(a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		PR_CHECKFIELD(b->_int, 3);
+		ptr = (eval_t *)((int *)&ed->v + b->_int);
+		c->vector[0] = ptr->vector[0];
+		c->vector[1] = ptr->vector[1];
+		c->vector[2] = ptr->vector[2];
+		break;
+
+	case OP_FETCH_GBL_F:
+	case OP_FETCH_GBL_S:
+	case OP_FETCH_GBL_E:
+	case OP_FETCH_GBL_FNC:
+	  {	int i = (int)b->_float;
+		if (i < 0 || i > G_INT(st->a - 1))
+		{
+			pr_xstatement = st - pr_statements;
+			PR_RunError("array index out of bounds: %d", i);
+		}
+		ptr = (eval_t *)&pr_globals[st->a + i];
+		c->_int = ptr->_int;
+	  }	break;
+	case OP_FETCH_GBL_V:
+	  {	int i = (int)b->_float;
+		if (i < 0 || i > G_INT(st->a - 1))
+		{
+			pr_xstatement = st - pr_statements;
+			PR_RunError("array index out of bounds: %d", i);
+		}
+		ptr = (eval_t *)&pr_globals[st->a + (i * 3)];
+		c->vector[0] = ptr->vector[0];
+		c->vector[1] = ptr->vector[1];
+		c->vector[2] = ptr->vector[2];
+	  }	break;
+
+	case OP_IFNOT:
+		if (!a->_int)
+		{
+		/* Pa3PyX: a, b, and c used to be signed shorts for progs v6,
+		 * now they are signed ints.  The problem is, they were used
+		 * as signed sometimes and as unsigned other times - most of
+		 * the time they were used as unsigned with an explicit cast
+		 * in PR_ExecuteProgram().  When we convert the old progs to
+		 * to the new format in PR_ConvertOldStmts(), we zero-extend
+		 * them instead of sign-extending them for that reason: if we
+		 * sign-extend them, most of the code will not work - we will
+		 * have negative array offsets in PR_ExecuteProgram(), among
+		 * other things.  Note that they are cast to unsigned short
+		 * in PR_ConvertOldStmts() prior to assigning them to what is
+		 * now int.  There are a few instances where these shorts are
+		 * used as signed as in the case below where negative offsets
+		 * are needed.  Since we now have a zero-extended number in a,
+		 * b, and c, we must change it back to signed short, so that
+		 * when it is added with and assigned to an int, the result
+		 * ends up sign-extended and we get a proper negative offset,
+		 * if there is one.
+		 */
+			jump_ofs = st->b;
+			if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
+			st += jump_ofs - 1;	/* -1 to offset the st++ */
+		}
+		break;
+
+	case OP_IF:
+		if (a->_int)
+		{
+			jump_ofs = st->b;
+			if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
+			st += jump_ofs - 1;	/* -1 to offset the st++ */
+		}
+		break;
+
+	case OP_GOTO:
+		jump_ofs = st->a;
+		if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
+		st += jump_ofs - 1;	/* -1 to offset the st++ */
+		break;
+
+	case OP_CALL8:
+	case OP_CALL7:
+	case OP_CALL6:
+	case OP_CALL5:
+	case OP_CALL4:
+	case OP_CALL3:
+	case OP_CALL2:	// Copy second arg to shared space
+		vecptr = G_VECTOR(OFS_PARM1);
+		VectorCopy(c->vector, vecptr);
+	case OP_CALL1:	// Copy first arg to shared space
+		vecptr = G_VECTOR(OFS_PARM0);
+		VectorCopy(b->vector, vecptr);
+	case OP_CALL0:
+		pr_xfunction->profile += profile - startprofile;
+		if (prprof_active && prprof_depth)
+			prprof_nodes[prprof_stack[prprof_depth - 1].node].self_stmts += profile - startprofile;
+		startprofile = profile;
+		pr_xstatement = st - pr_statements;
+		pr_argc = st->op - OP_CALL0;
+		if (!a->function)
+		{
+			PR_RunError("NULL function");
+		}
+		newf = &pr_functions[a->function];
+		if (newf->first_statement < 0)
+		{ // Built-in function
+			int i = -newf->first_statement;
+			if (i >= pr_numbuiltins)
+			{
+				PR_RunError("Bad builtin call number %d", i);
+			}
+			if (prprof_active)
+			{
+				PR_ProfilePush(a->function);
+				pr_builtins[i]();
+				PR_ProfilePop();
+			}
+			else
+			{
+				pr_builtins[i]();
+			}
+			break;
+		}
+		// Normal function
+		st = &pr_statements[EnterFunction(newf)];
+		checked = pr_funcstatus[newf - pr_functions];
+		PR_SWITCHLOOP;
+		break;
+
+	case OP_DONE:
+	case OP_RETURN:
+	  {
+		float *retptr = &pr_globals[OFS_RETURN];
+		float *valptr = &pr_globals[st->a];
+		pr_xfunction->profile += profile - startprofile;
+		if (prprof_active && prprof_depth)
+			prprof_nodes[prprof_stack[prprof_depth - 1].node].self_stmts += profile - startprofile;
+		startprofile = profile;
+		pr_xstatement = st - pr_statements;
+		*retptr++ = *valptr++;
+		*retptr++ = *valptr++;
+		*retptr   = *valptr;
+		st = &pr_statements[LeaveFunction()];
+		if (pr_depth == exitdepth)
+		{ // Done
+			return;
+		}
+		checked = pr_funcstatus[pr_xfunction - pr_functions];
+		PR_SWITCHLOOP;
+	  }	break;
+
+	case OP_STATE:
+		ed = PROG_TO_EDICT(*sv_globals.self);
+/* Id 1.07 changes
+#ifdef FPS_20
+		ed->v.nextthink = *sv_globals.time + 0.05;
+#else
+		ed->v.nextthink = *sv_globals.time + 0.1;
+#endif
+*/
+		ed->v.nextthink = *sv_globals.time + HX_FRAME_TIME;
+		ED_SetAdd (ed_physset, NUM_FOR_EDICT(ed));
+		ed->v.frame = a->_float;
+		ed->v.think = b->function;
+		break;
+
+	case OP_CSTATE:	// Cycle state
+	  {	int startFrame, endFrame;
+		ed = PROG_TO_EDICT(*sv_globals.self);
+		ed->v.nextthink = *sv_globals.time + HX_FRAME_TIME;
+		ED_SetAdd (ed_physset, NUM_FOR_EDICT(ed));
+		ed->v.think = pr_xfunction - pr_functions;
+		*sv_globals.cycle_wrapped = false;
+		startFrame = (int)a->_float;
+		endFrame = (int)b->_float;
+		if (startFrame <= endFrame)
+		{ // Increment
+			if (ed->v.frame < startFrame || ed->v.frame > endFrame)
+			{
+				ed->v.frame = startFrame;
+			}
+			else
+			{
+				ed->v.frame++;
+				if (ed->v.frame > endFrame)
+				{
+					*sv_globals.cycle_wrapped = true;
+					ed->v.frame = startFrame;
+				}
+			}
+		}
+		else
+		{ // Decrement
+			if (ed->v.frame > startFrame || ed->v.frame < endFrame)
+			{
+				ed->v.frame = startFrame;
+			}
+			else
+			{
+				ed->v.frame--;
+				if (ed->v.frame < endFrame)
+				{
+					*sv_globals.cycle_wrapped = true;
+					ed->v.frame = startFrame;
+				}
+			}
+		}
+	  }	break;
+
+	case OP_CWSTATE:	// Cycle weapon state
+	  {	int startFrame, endFrame;
+		ed = PROG_TO_EDICT(*sv_globals.self);
+		ed->v.nextthink = *sv_globals.time + HX_FRAME_TIME;
+		ED_SetAdd (ed_physset, NUM_FOR_EDICT(ed));
+		ed->v.think = pr_xfunction - pr_functions;
+		*sv_globals.cycle_wrapped = false;
+		startFrame = (int)a->_float;
+		endFrame = (int)b->_float;
+		if (startFrame <= endFrame)
+		{ // Increment
+			if (ed->v.weaponframe < startFrame
+				|| ed->v.weaponframe > endFrame)
+			{
+				ed->v.weaponframe = startFrame;
+			}
+			else
+			{
+				ed->v.weaponframe++;
+				if (ed->v.weaponframe > endFrame)
+				{
+					*sv_globals.cycle_wrapped = true;
+					ed->v.weaponframe = startFrame;
+				}
+			}
+		}
+		else
+		{ // Decrement
+			if (ed->v.weaponframe > startFrame
+				|| ed->v.weaponframe < endFrame)
+			{
+				ed->v.weaponframe = startFrame;
+			}
+			else
+			{
+				ed->v.weaponframe--;
+				if (ed->v.weaponframe < endFrame)
+				{
+					*sv_globals.cycle_wrapped = true;
+					ed->v.weaponframe = startFrame;
+				}
+			}
+		}
+	  }	break;
+
+	case OP_THINKTIME:
+		ed = PROG_TO_EDICT(a->edict);
+#ifdef PARANOID
+		NUM_FOR_EDICT(ed);	// Make sure it's in range
+#endif
+		if (ed == (edict_t *)sv.edicts && sv.state == ss_active)
+		{
+			pr_xstatement = st - pr_statements;
+			PR_RunError("assignment to world entity");
+		}
+		ed->v.nextthink = *sv_globals.time + b->_float;
+		ED_SetAdd (ed_physset, NUM_FOR_EDICT(ed));
+		break;
+
+	case OP_BITSET:		// f (+) f
+		b->_float = (int)b->_float | (int)a->_float;
+		break;
+	case OP_BITSETP:	// e.f (+) f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		ptr->_float = (int)ptr->_float | (int)a->_float;
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+	case OP_BITCLR:		// f (-) f
+		b->_float = (int)b->_float & ~((int)a->_float);
+		break;
+	case OP_BITCLRP:	// e.f (-) f
+		ptr = (eval_t *)((byte *)sv.edicts + b->_int);
+		ptr->_float = (int)ptr->_float & ~((int)a->_float);
+		PR_STOREDFIELD(b->_int, 1);
+		break;
+
+	case OP_RAND0:
+	  {	float val;
+		val = rand() * (1.0 / RAND_MAX);
+		G_FLOAT(OFS_RETURN) = val;
+	  }	break;
+	case OP_RAND1:
+	  {	float val;
+		val = rand() * (1.0 / RAND_MAX) * a->_float;
+		G_FLOAT(OFS_RETURN) = val;
+	  }	break;
+	case OP_RAND2:
+	  {	float val;
+		if (a->_float < b->_float)
+		{
+			val = a->_float + (rand() * (1.0 / RAND_MAX) * (b->_float - a->_float));
+		}
+		else
+		{
+			val = b->_float + (rand() * (1.0 / RAND_MAX) * (a->_float - b->_float));
+		}
+		G_FLOAT(OFS_RETURN) = val;
+	  }	break;
+	case OP_RANDV0:
+	  {	float val;
+		float *retptr = &G_FLOAT(OFS_RETURN);
+		val = rand() * (1.0 / RAND_MAX);
+		*retptr++ = val;
+		val = rand() * (1.0 / RAND_MAX);
+		*retptr++ = val;
+		val = rand() * (1.0 / RAND_MAX);
+		*retptr   = val;
+	  }	break;
+	case OP_RANDV1:
+	  {	float val;
+		float *retptr = &G_FLOAT(OFS_RETURN);
+		val = rand() * (1.0 / RAND_MAX) * a->vector[0];
+		*retptr++ = val;
+		val = rand() * (1.0 / RAND_MAX) * a->vector[1];
+		*retptr++ = val;
+		val = rand() * (1.0 / RAND_MAX) * a->vector[2];
+		*retptr   = val;
+	  }	break;
+	case OP_RANDV2:
+	  {	float val;
+		int	i;
+		float *retptr = &G_FLOAT(OFS_RETURN);
+		for (i = 0; i < 3; i++)
+		{
+			if (a->vector[i] < b->vector[i])
+			{
+				val = a->vector[i] + (rand() * (1.0 / RAND_MAX) * (b->vector[i] - a->vector[i]));
+			}
+			else
+			{
+				val = b->vector[i] + (rand() * (1.0 / RAND_MAX) * (a->vector[i] - b->vector[i]));
+			}
+			*retptr++ = val;
+		}
+	  }	break;
+	case OP_SWITCH_F:
+		case_type = SWITCH_F;
+		switch_float = a->_float;
+		jump_ofs = st->b;
+		if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
+		st += jump_ofs - 1;	/* -1 to offset the st++ */
+		break;
+	case OP_SWITCH_V:
+	case OP_SWITCH_S:
+	case OP_SWITCH_E:
+	case OP_SWITCH_FNC:
+		pr_xstatement = st - pr_statements;
+		PR_RunError("%s not done yet!", pr_opnames[st->op]);
+		break;
+
+	case OP_CASERANGE:
+		if (case_type != SWITCH_F)
+		{
+			pr_xstatement = st - pr_statements;
+			PR_RunError("caserange fucked!");
+		}
+		if ((switch_float >= a->_float) && (switch_float <= b->_float))
+		{
+			jump_ofs = st->c;
+			if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
+			st += jump_ofs - 1;	/* -1 to offset the st++ */
+		}
+		break;
+	case OP_CASE:
+		switch (case_type)
+		{
+		case SWITCH_F:
+			if (switch_float == a->_float)
+			{
+				jump_ofs = st->b;
+				if (is_progs_v6) jump_ofs = (signed short)jump_ofs;
+				st += jump_ofs - 1;	/* -1 to offset the st++ */
+			}
+			break;
+		case SWITCH_V:
+		case SWITCH_S:
+		case SWITCH_E:
+		case SWITCH_FNC:
+			pr_xstatement = st - pr_statements;
+			PR_RunError("OP_CASE for %s not done yet!",
+					pr_opnames[case_type + OP_SWITCH_F - SWITCH_F]);
+			break;
+		default:
+			pr_xstatement = st - pr_statements;
+			PR_RunError("fucked case!");
+		}
+		break;
+
+	default:
+		pr_xstatement = st - pr_statements;
+		PR_RunError("Bad opcode %i", st->op);
+	}
@@ -41,6 +41,16 @@ typedef struct edict_s
 	qboolean	free;
 	link_t		area;			/* linked to a division node or leaf */
 
+	int		movedslot;		/* index+1 in the moved list, 0 if links are current */
+	int		areanode;		/* the sv_areanodes entry area is linked to */
+	int		trigger;		/* how a trigger is in the trigger index */
+	int		triggercells[4];	/* the columns it is in there */
+
+	qboolean	linkvalid;		/* the link* fields describe the current links */
+	qboolean	linkleafs;		/* leafnums were searched at the last link */
+	int		linksolid;		/* solid at the last link */
+	vec3_t		linkmins, linkmaxs;	/* absmin and absmax at the last link */
+
 	int		num_leafs;
 	int		leafnums[MAX_ENT_LEAFS];
 
@@ -88,6 +98,9 @@ extern	qboolean	is_progs_v6;
 void PR_Init (void);
 
 void PR_ExecuteProgram (func_t fnum, const char *funcname);
+qboolean PR_InExecution (void);
+void PR_InitFieldWatch (void);
+void PR_VerifyProgs (void);
 void PR_LoadProgs (void);
 
 const char *PR_GetString (int num);
@@ -95,11 +108,30 @@ int PR_SetEngineString (const char *s);
 int PR_AllocString (int bufferlength, char **ptr);
 
 void PR_Profile_f (void);
+void PR_ProfileStart_f (void);
+void PR_ProfileStop_f (void);
+void PR_ProfileReport_f (void);
+void PR_ProfileFolded_f (void);
+void PR_ProfileCheckProgs (void);
 
 edict_t *ED_Alloc (void);
 edict_t *ED_Alloc_Temp (void);
 void ED_Free (edict_t *ed);
 void ED_ClearEdict (edict_t *e);
+void ED_StringFieldsChanged (edict_t *ed);
+
+/* edict sets, kept as bitmaps over edict numbers so that walking one
+ * visits its members in the same ascending order as a full scan.
+ * members are added whenever they might qualify and removed lazily by
+ * the loops that walk the set. */
+#define	ED_SETWORDS		((MAX_EDICTS + 31) / 32)
+extern	unsigned int	ed_physset[ED_SETWORDS];	/* may need SV_Physics this frame */
+extern	unsigned int	ed_modelset[ED_SETWORDS];	/* may have a visible model */
+#define	ED_SetAdd(set,n)	((set)[(n) >> 5] |= (1U << ((n) & 31)))
+#define	ED_SetRemove(set,n)	((set)[(n) >> 5] &= ~(1U << ((n) & 31)))
+int ED_SetNext (const unsigned int *set, int n, int end);
+int ED_FindString (int start, int field, const char *s);
+int ED_GlobalArray (const char *name, int type, int *count);
 
 void ED_Print (edict_t *ed);
 const char *ED_GetProperty (edict_t *ed, char *propname);
@@ -167,5 +199,6 @@ eval_t *GetEdictFieldValue(edict_t *ed, const char *field);
 extern	cvar_t		max_temp_edicts;
 
 extern	qboolean	ignore_precache;
+extern	qboolean	pr_holdstrings;
 
 #endif	/* HX2_PROGS_H */
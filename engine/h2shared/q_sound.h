@@ -102,6 +102,7 @@ void S_BlockSound (void);
 void S_UnblockSound (void);
 
 sfx_t *S_PrecacheSound (const char *sample);
+void S_PrefetchSound (const char *sample);
 void S_TouchSound (const char *sample);
 void S_ClearPrecache (void);
 void S_BeginPrecaching (void);
@@ -161,6 +162,8 @@ extern	cvar_t		bgmvolume;
 
 void S_LocalSound (const char *name);
 sfxcache_t *S_LoadSound (sfx_t *s);
+byte *S_PrepareSound (const char *name, byte *data, long *size);
+	/* an fsprepfunc_t for FS_Prefetch, which S_LoadSound takes from */
 
 wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength);
 
@@ -25,21 +25,34 @@
 #include <errno.h>
 #ifdef PLATFORM_WINDOWS
 #include <io.h>
+#include <windows.h>
+#endif
+#ifdef PLATFORM_UNIX
+#include <sys/mman.h>
+#include <dirent.h>
+#include <unistd.h>
 #endif
 #include "filenames.h"
 #include "hashindex.h"
+#include "lzpak.h"
+#include "threads.h"
 
 typedef struct
 {
 	char	name[MAX_QPATH];
 	int	filepos, filelen;
+	int	packlen;	/* bytes at filepos, filelen unless compressed */
+	int	method;		/* PAKZ_STORED or PAKZ_LZBLOCKS */
 } pakfiles_t;
 
 typedef struct pack_s
 {
 	char	filename[MAX_OSPATH];
 	FILE	*handle;
+	byte	*map;		/* read-only mapping of the whole pak, or NULL */
+	size_t	mapsize;
 	int	numfiles;
+	qboolean	compressed;	/* a PAKZ file */
 	pakfiles_t	*files;
 	hashindex_t	hash;
 } pack_t;
@@ -51,15 +64,39 @@ typedef struct searchpath_s
 					 *	<userdir>/game1 have the same id. */
 	char		filename[MAX_OSPATH];
 	struct pack_s		*pack;	/* only one of filename / pack will be used */
+	qboolean		indexed;	/* lookups answered by fs_index */
 	struct searchpath_s	*next;
 } searchpath_t;
 
+/* merged index of all indexed search paths: each name appears once,
+ * pointing at the search path which wins it.  a name missing from the
+ * index is missing from all indexed search paths.  */
+typedef struct
+{
+	const char	*name;		/* pak directory name or malloc'ed */
+	searchpath_t	*search;
+	int		filenum;	/* in search->pack, or -1 if a loose file */
+} fsindexent_t;
+
+typedef struct
+{
+	fsindexent_t	*files;
+	int		numfiles, maxfiles;
+	hashindex_t	hash;
+	qboolean	valid;		/* built for the current search paths */
+	int		lookups, misses;
+} fsindex_t;
+
+static fsindex_t	fs_index;
+
 static searchpath_t	*fs_searchpaths;
 static searchpath_t	*fs_base_searchpaths;	/* without gamedirs */
 
 static const char	*fs_basedir;
 static char	fs_gamedir[MAX_OSPATH];
 static char	fs_userdir[MAX_OSPATH];
+static qboolean	fs_nommap;	/* -nommap: read paks through stdio only */
+static qboolean	fs_serialinit;	/* -serialinit: read paks one by one */
 char	fs_gamedir_nopath[MAX_QPATH];
 
 unsigned int	gameflags;
@@ -251,68 +288,242 @@ static unsigned int check_known_paks (int paknum, int numfiles, unsigned short c
 
 /*
 =================
-FS_LoadPackFile
+FS_MapPack
 
-Takes a path to a pak file.  Loads the header and directory.
+Maps the whole pak read-only so that files in it can be read without
+reopening the pak.  Returns false if mapping isn't supported or fails,
+in which case the pak is read through its FILE handle as before.
 =================
 */
-static pack_t *FS_LoadPackFile (const char *packfile, int paknum, qboolean base_fs)
+static qboolean FS_MapPack (pack_t *pack)
 {
-	dpackheader_t	header;
-	int	i, numpackfiles, key;
-	pakfiles_t	*newfiles;
-	pack_t		*pack;
-	FILE		*packhandle;
-	dpackfile_t	info[MAX_FILES_IN_PACK];
-	unsigned short	crc;
+	long	size;
 
-	packhandle = fopen (packfile, "rb");
-	if (!packhandle)
-		return NULL;
+	pack->map = NULL;
+	pack->mapsize = 0;
+	if (fs_nommap)
+		return false;
+
+	fseek (pack->handle, 0, SEEK_END);
+	size = ftell (pack->handle);
+	if (size <= 0)
+		return false;
 
-	fread (&header, 1, sizeof(header), packhandle);
-	if (header.id[0] != 'P' || header.id[1] != 'A' ||
-	    header.id[2] != 'C' || header.id[3] != 'K')
+#if defined(PLATFORM_UNIX)
 	{
-		Sys_Printf ("WARNING: %s is not a packfile, ignored\n", packfile);
-		goto pak_error;
+		void	*p;
+
+		p = mmap (NULL, (size_t)size, PROT_READ, MAP_SHARED, fileno(pack->handle), 0);
+		if (p == MAP_FAILED)
+			return false;
+		pack->map = (byte *) p;
 	}
+#elif defined(PLATFORM_WINDOWS)
+	{
+		HANDLE	mapping;
 
-	header.dirofs = LittleLong (header.dirofs);
-	header.dirlen = LittleLong (header.dirlen);
+		mapping = CreateFileMapping ((HANDLE) _get_osfhandle(_fileno(pack->handle)),
+						NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping)
+			return false;
+		pack->map = (byte *) MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle (mapping);
+		if (!pack->map)
+			return false;
+	}
+#else
+	return false;
+#endif
+
+	pack->mapsize = (size_t)size;
+	return true;
+}
+
+static void FS_UnmapPack (pack_t *pack)
+{
+	if (!pack->map)
+		return;
+#if defined(PLATFORM_UNIX)
+	munmap (pack->map, pack->mapsize);
+#elif defined(PLATFORM_WINDOWS)
+	UnmapViewOfFile (pack->map);
+#endif
+	pack->map = NULL;
+	pack->mapsize = 0;
+}
+
+/*
+=================
+FS_FreePack
+=================
+*/
+static void FS_FreePack (pack_t *pack)
+{
+	FS_UnmapPack (pack);
+	fclose (pack->handle);
+	Z_Free (pack->files);
+	Hash_Free(&pack->hash);
+	Z_Free (pack);
+}
 
-	numpackfiles = header.dirlen / sizeof(dpackfile_t);
+/*
+=================
+FS_ReadPack
 
-	if (header.dirlen < 0 || header.dirofs < 0)
+Reads the header and the directory of a pak file.  Both the plain PACK
+format and the compressed PAKZ format are accepted.  The paks of a game
+directory are read on the worker threads, so this only fills in pr and
+leaves the complaining to FS_LoadPackFile.
+=================
+*/
+typedef struct
+{
+	char		path[MAX_OSPATH];
+	FILE		*handle;
+	dpackfile_t	*info;		/* malloc'ed directory */
+	int		numfiles, dirlen;
+	unsigned short	crc;
+	qboolean	compressed;
+	qboolean	fatal;
+	char		error[MAX_OSPATH + 64];
+} pakread_t;
+
+#define	MAX_PAKS_IN_DIR		10	/* pak0.pak to pak9.pak */
+
+static void FS_PackError (pakread_t *pr, qboolean fatal, const char *fmt, ...)
+{
+	va_list		argptr;
+
+	va_start (argptr, fmt);
+	q_vsnprintf (pr->error, sizeof(pr->error), fmt, argptr);
+	va_end (argptr);
+	pr->fatal = fatal;
+	fclose (pr->handle);
+	pr->handle = NULL;
+}
+
+static void FS_ReadPack (pakread_t *pr)
+{
+	union
+	{
+		dpackheader_t	pak;
+		dpackzheader_t	pakz;
+	} header;
+	int	i, dirofs;
+
+	pr->handle = fopen (pr->path, "rb");
+	if (!pr->handle)
+		return;
+
+	memset (&header, 0, sizeof(header));
+	fread (&header, 1, sizeof(header), pr->handle);
+	if (header.pak.id[0] == 'P' && header.pak.id[1] == 'A' &&
+	    header.pak.id[2] == 'C' && header.pak.id[3] == 'K')
+	{
+		dirofs = LittleLong (header.pak.dirofs);
+		pr->dirlen = LittleLong (header.pak.dirlen);
+		if (pr->dirlen < 0 || dirofs < 0)
+		{
+			FS_PackError (pr, true, "Invalid packfile %s (dirlen: %i, dirofs: %i)",
+						pr->path, pr->dirlen, dirofs);
+			return;
+		}
+		pr->numfiles = pr->dirlen / sizeof(dpackfile_t);
+		pr->compressed = false;
+	}
+	else if (header.pakz.id[0] == 'P' && header.pakz.id[1] == 'A' &&
+		 header.pakz.id[2] == 'K' && header.pakz.id[3] == 'Z')
+	{
+		if (LittleLong (header.pakz.version) != PAKZ_VERSION)
+		{
+			FS_PackError (pr, false, "%s has version %i (should be %i)",
+					pr->path, LittleLong (header.pakz.version), PAKZ_VERSION);
+			return;
+		}
+		dirofs = LittleLong (header.pakz.dirofs);
+		pr->numfiles = LittleLong (header.pakz.numfiles);
+		if (pr->numfiles < 0 || dirofs < 0)
+		{
+			FS_PackError (pr, true, "Invalid packfile %s (numfiles: %i, dirofs: %i)",
+						pr->path, pr->numfiles, dirofs);
+			return;
+		}
+		pr->compressed = true;
+	}
+	else
 	{
-		Sys_Error ("Invalid packfile %s (dirlen: %i, dirofs: %i)",
-					packfile, header.dirlen, header.dirofs);
+		FS_PackError (pr, false, "%s is not a packfile", pr->path);
+		return;
 	}
-	if (!numpackfiles)
+
+	if (!pr->numfiles)
 	{
-		Sys_Printf ("WARNING: %s has no files, ignored\n", packfile);
-		goto pak_error;
+		FS_PackError (pr, false, "%s has no files", pr->path);
+		return;
 	}
-	if (numpackfiles > MAX_FILES_IN_PACK)
+	if (pr->numfiles > MAX_FILES_IN_PACK)
 	{
-		Sys_Printf ("WARNING: %s has %i files (max. allowed is %i), ignored\n",
-					packfile, numpackfiles, MAX_FILES_IN_PACK);
-		goto pak_error;
+		FS_PackError (pr, false, "%s has %i files (max. allowed is %i)",
+					pr->path, pr->numfiles, MAX_FILES_IN_PACK);
+		return;
 	}
+	if (pr->compressed)	/* now that numfiles is known to be sane */
+		pr->dirlen = pr->numfiles * (int) sizeof(dpackzfile_t);
 
-	newfiles = (pakfiles_t *) Z_Malloc (numpackfiles * sizeof(pakfiles_t), Z_MAINZONE);
+	pr->info = (dpackfile_t *) malloc (pr->dirlen);
+	if (!pr->info)
+	{
+		FS_PackError (pr, true, "%s: out of memory", __thisfunc__);
+		return;
+	}
 
-	fseek (packhandle, header.dirofs, SEEK_SET);
-	fread (info,  1, header.dirlen, packhandle);
+	fseek (pr->handle, dirofs, SEEK_SET);
+	fread (pr->info, 1, pr->dirlen, pr->handle);
 
 	/* crc the directory */
-	CRC_Init (&crc);
-	for (i = 0; i < header.dirlen; i++)
-		CRC_ProcessByte (&crc, ((byte *)info)[i]);
+	CRC_Init (&pr->crc);
+	for (i = 0; i < pr->dirlen; i++)
+		CRC_ProcessByte (&pr->crc, ((byte *)pr->info)[i]);
+}
+
+static void FS_ReadPackJob (void *data, int index)
+{
+	FS_ReadPack (&((pakread_t *) data)[index]);
+}
+
+/*
+=================
+FS_LoadPackFile
+
+Sets up a pak file read by FS_ReadPack.
+=================
+*/
+static pack_t *FS_LoadPackFile (pakread_t *pr, int paknum, qboolean base_fs)
+{
+	int	i, numpackfiles, key;
+	pakfiles_t	*newfiles;
+	pack_t		*pack;
+	dpackfile_t	*info;
+	dpackzfile_t	*zinfo;
+
+	if (pr->error[0])
+	{
+		if (pr->fatal)
+			Sys_Error ("%s", pr->error);
+		Sys_Printf ("WARNING: %s, ignored\n", pr->error);
+		return NULL;
+	}
+	if (!pr->handle)
+		return NULL;
+
+	numpackfiles = pr->numfiles;
+	info = pr->info;
+	zinfo = (pr->compressed) ? (dpackzfile_t *) info : NULL;
+	newfiles = (pakfiles_t *) Z_Malloc (numpackfiles * sizeof(pakfiles_t), Z_MAINZONE);
 
 	/* check for modifications */
 	if (base_fs)
-		gameflags |= check_known_paks (paknum, numpackfiles, crc);
+		gameflags |= check_known_paks (paknum, numpackfiles, pr->crc);
 	else	gameflags |= GAME_MODIFIED;
 
 	pack = (pack_t *) Z_Malloc (sizeof(pack_t), Z_MAINZONE);
@@ -327,25 +538,312 @@ static pack_t *FS_LoadPackFile (const char *packfile, int paknum, qboolean base_
 	/* parse the directory */
 	for (i = 0; i < numpackfiles; i++)
 	{
-		qerr_strlcpy(__thisfunc__, __LINE__, newfiles[i].name, info[i].name, MAX_QPATH);
-		newfiles[i].filepos = LittleLong(info[i].filepos);
-		newfiles[i].filelen = LittleLong(info[i].filelen);
-		key = Hash_GenerateKeyString (&pack->hash, newfiles[i].name, true);
+		if (zinfo)
+		{
+			zinfo[i].name[PAK_PATH_LENGTH - 1] = '\0';
+			qerr_strlcpy(__thisfunc__, __LINE__, newfiles[i].name, zinfo[i].name, MAX_QPATH);
+			newfiles[i].filepos = LittleLong(zinfo[i].filepos);
+			newfiles[i].filelen = LittleLong(zinfo[i].filelen);
+			newfiles[i].packlen = LittleLong(zinfo[i].packlen);
+			newfiles[i].method = LittleLong(zinfo[i].method);
+			if (newfiles[i].method != PAKZ_STORED && newfiles[i].method != PAKZ_LZBLOCKS)
+			{
+				Sys_Error ("Invalid packfile %s (%s has method %i)",
+						pr->path, newfiles[i].name, newfiles[i].method);
+			}
+			if (newfiles[i].method == PAKZ_STORED)
+				newfiles[i].packlen = newfiles[i].filelen;
+			/* the packer hashed the name already */
+			key = LittleLong(zinfo[i].hash) & pack->hash.hashMask;
+		}
+		else
+		{
+			qerr_strlcpy(__thisfunc__, __LINE__, newfiles[i].name, info[i].name, MAX_QPATH);
+			newfiles[i].filepos = LittleLong(info[i].filepos);
+			newfiles[i].filelen = LittleLong(info[i].filelen);
+			newfiles[i].packlen = newfiles[i].filelen;
+			newfiles[i].method = PAKZ_STORED;
+			key = Hash_GenerateKeyString (&pack->hash, newfiles[i].name, true);
+		}
 		Hash_Add (&pack->hash, key, i);
 	}
+	free (info);
+	pr->info = NULL;
 
-	qerr_strlcpy(__thisfunc__, __LINE__, pack->filename, packfile, MAX_OSPATH);
-	pack->handle = packhandle;
+	qerr_strlcpy(__thisfunc__, __LINE__, pack->filename, pr->path, MAX_OSPATH);
+	pack->handle = pr->handle;
 	pack->numfiles = numpackfiles;
 	pack->files = newfiles;
+	pack->compressed = pr->compressed;
+
+	/* drop the mapping if the directory points outside of it */
+	if (FS_MapPack (pack))
+	{
+		for (i = 0; i < numpackfiles; i++)
+		{
+			if (newfiles[i].filepos < 0 || newfiles[i].packlen < 0 ||
+			    (size_t)newfiles[i].filepos + newfiles[i].packlen > pack->mapsize)
+				break;
+		}
+		if (i < numpackfiles)
+		{
+			Sys_Printf ("WARNING: %s has files past its end, not mapped\n", pr->path);
+			FS_UnmapPack (pack);
+		}
+	}
 
-	Sys_Printf ("Added packfile %s (%i files)\n", packfile, numpackfiles);
+	Sys_Printf ("Added packfile %s (%i files%s%s)\n", pr->path, numpackfiles,
+					pack->compressed ? ", compressed" : "",
+					pack->map ? ", mapped" : "");
 	return pack;
-pak_error:
-	fclose (packhandle);
+}
+
+
+/*
+==============================================================================
+
+FILE INDEX
+
+==============================================================================
+*/
+
+#define	FS_SCANDEPTH	8	/* how deep to descend into loose directories */
+
+static void FS_IndexAdd (const char *name, searchpath_t *search, int filenum)
+{
+	fsindexent_t	*ent;
+
+	if (fs_index.numfiles == fs_index.maxfiles)
+	{
+		fs_index.maxfiles = (fs_index.maxfiles) ? fs_index.maxfiles * 2 : 4096;
+		fs_index.files = (fsindexent_t *) realloc (fs_index.files,
+					fs_index.maxfiles * sizeof(fsindexent_t));
+		if (!fs_index.files)
+			Sys_Error ("%s: out of memory", __thisfunc__);
+	}
+	ent = &fs_index.files[fs_index.numfiles++];
+	ent->name = name;
+	ent->search = search;
+	ent->filenum = filenum;
+}
+
+static qboolean FS_ScanDirectory (searchpath_t *search, const char *subdir, int depth);
+
+static void FS_ScanEntry (searchpath_t *search, const char *path,
+			  const char *subdir, const char *entry, int depth)
+{
+	char	name[MAX_QPATH];
+	int	type;
+
+	if (entry[0] == '.')
+		return;	/* ., .. and hidden files */
+	if (*subdir)
+	{
+		if (q_snprintf(name, sizeof(name), "%s/%s", subdir, entry) >= (int)sizeof(name))
+			return;
+	}
+	else if (q_strlcpy(name, entry, sizeof(name)) >= sizeof(name))
+		return;
+
+	type = Sys_FileType (va("%s/%s", path, entry));
+	if (type & FS_ENT_DIRECTORY)
+	{
+		if (depth < FS_SCANDEPTH)
+			FS_ScanDirectory (search, name, depth + 1);
+	}
+	else if (type & FS_ENT_FILE)
+	{
+		FS_IndexAdd (strdup(name), search, -1);
+	}
+}
+
+/*
+================
+FS_ScanDirectory
+
+Adds the loose files under search->filename/subdir to the index.
+Returns false if directories can't be listed on this platform, in
+which case the search path stays unindexed and is stat'ed as before.
+================
+*/
+static qboolean FS_ScanDirectory (searchpath_t *search, const char *subdir, int depth)
+{
+#if defined(PLATFORM_UNIX) || defined(PLATFORM_WINDOWS)
+	char	path[MAX_OSPATH];
+#if defined(PLATFORM_UNIX)
+	DIR	*dir;
+	struct dirent	*de;
+#else
+	HANDLE	dir;
+	WIN32_FIND_DATAA	fd;
+#endif
+
+	if (*subdir)
+		q_snprintf (path, sizeof(path), "%s/%s", search->filename, subdir);
+	else	q_strlcpy (path, search->filename, sizeof(path));
+
+#if defined(PLATFORM_UNIX)
+	dir = opendir (path);
+	if (!dir)
+		return true;	/* nothing there (yet) */
+	while ((de = readdir(dir)) != NULL)
+		FS_ScanEntry (search, path, subdir, de->d_name, depth);
+	closedir (dir);
+#else
+	dir = FindFirstFileA (va("%s/*", path), &fd);
+	if (dir == INVALID_HANDLE_VALUE)
+		return true;
+	do {
+		FS_ScanEntry (search, path, subdir, fd.cFileName, depth);
+	} while (FindNextFileA(dir, &fd));
+	FindClose (dir);
+#endif
+	return true;
+#else
+	return false;
+#endif
+}
+
+static int FS_IndexCompare (const fsindexent_t *ent, const char *name)
+{
+#if defined(PLATFORM_WINDOWS) || defined(PLATFORM_DOS) || defined(PLATFORM_OS2)
+	if (ent->filenum == -1)	/* case insensitive filesystem */
+		return q_strcasecmp (ent->name, name);
+#endif
+	return strcmp (ent->name, name);
+}
+
+static fsindexent_t *FS_IndexFind (const char *name)
+{
+	int	i, key;
+
+	key = Hash_GenerateKeyString (&fs_index.hash, name, false);
+	for (i = Hash_First(&fs_index.hash, key); i != -1; i = Hash_Next(&fs_index.hash, i))
+	{
+		if (!FS_IndexCompare(&fs_index.files[i], name))
+			return &fs_index.files[i];
+	}
 	return NULL;
 }
 
+/*
+================
+FS_ClearIndex
+
+Must be called before any search path is freed.
+================
+*/
+static void FS_ClearIndex (void)
+{
+	searchpath_t	*search;
+	int	i;
+
+	for (i = 0; i < fs_index.numfiles; i++)
+	{
+		if (fs_index.files[i].filenum == -1)
+			free ((void *) fs_index.files[i].name);
+	}
+	fs_index.numfiles = 0;
+	Hash_FreeMalloc (&fs_index.hash);
+	fs_index.valid = false;
+
+	for (search = fs_searchpaths; search; search = search->next)
+		search->indexed = false;
+}
+
+/*
+================
+FS_BuildIndex
+
+Indexes every file in the paks and directories of the search path.
+Names are added in search order, so the first one added wins.
+================
+*/
+static void FS_BuildIndex (void)
+{
+	searchpath_t	*search;
+	fsindexent_t	*ent;
+	int	i, count, size, key;
+
+	FS_ClearIndex ();
+
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		if (search->pack)
+		{
+			for (i = 0; i < search->pack->numfiles; i++)
+				FS_IndexAdd (search->pack->files[i].name, search, i);
+			search->indexed = true;
+		}
+		else
+		{
+			search->indexed = FS_ScanDirectory (search, "", 0);
+		}
+	}
+
+	for (size = 1; size < fs_index.numfiles; size <<= 1)
+		;
+	Hash_AllocateMalloc (&fs_index.hash, size);
+
+	/* drop the overridden names, keeping the order */
+	count = 0;
+	for (i = 0; i < fs_index.numfiles; i++)
+	{
+		ent = &fs_index.files[i];
+		if (FS_IndexFind(ent->name))
+		{
+			if (ent->filenum == -1)
+				free ((void *) ent->name);
+			continue;
+		}
+		fs_index.files[count] = *ent;
+		key = Hash_GenerateKeyString (&fs_index.hash, ent->name, false);
+		Hash_Add (&fs_index.hash, key, count);
+		count++;
+	}
+	fs_index.numfiles = count;
+	fs_index.valid = true;
+}
+
+/*
+================
+FS_Rescan
+
+Rebuilds the file index, picking up files added to or removed from
+the game directories since it was built.
+================
+*/
+void FS_Rescan (void)
+{
+	FS_BuildIndex ();
+}
+
+static void FS_Rescan_f (void)
+{
+	searchpath_t	*search;
+	int	paths, unindexed;
+	double	start;
+
+	start = Sys_DoubleTime ();
+	FS_BuildIndex ();
+
+	paths = unindexed = 0;
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		paths++;
+		if (!search->indexed)
+			unindexed++;
+	}
+	Con_Printf ("%i files indexed from %i search paths in %.1f ms\n",
+			fs_index.numfiles, paths - unindexed, (Sys_DoubleTime() - start) * 1000.0);
+	if (unindexed)
+		Con_Printf ("%i directories can't be indexed on this platform\n", unindexed);
+	if (fs_index.lookups)
+	{
+		Con_Printf ("%i lookups, %i probes answered as missing by the index\n",
+				fs_index.lookups, fs_index.misses);
+	}
+}
 
 /*
 ================
@@ -357,10 +855,10 @@ to the head of the path, then loads and adds pak1.pak pak2.pak ...
 */
 static void FS_AddGameDirectory (const char *dir, qboolean base_fs)
 {
+	static pakread_t	paks[MAX_PAKS_IN_DIR];
 	unsigned int	path_id;
 	searchpath_t	*search;
 	pack_t		*pak;
-	char	pakfile[MAX_OSPATH];
 	qboolean do_userdir = false;
 	int	i;
 
@@ -371,6 +869,8 @@ static void FS_AddGameDirectory (const char *dir, qboolean base_fs)
 	FSERR_MakePath_BUF (__thisfunc__, __LINE__, FS_USERBASE,
 				fs_userdir, sizeof(fs_userdir), dir);
 
+	fs_index.valid = false;	/* new paths aren't indexed yet */
+
 /* assign a path_id to this game directory */
 	if (fs_searchpaths)
 		path_id = fs_searchpaths->path_id << 1;
@@ -382,13 +882,28 @@ add_pakfile:
 /* add any pak files in the format pak0.pak pak1.pak, ...
  * unlike Quake, Hexen II can't stop at first unavailable
  * pak: the mission pack has only pak3, hw has only pak4.
+ * the workers read their directories, then they are added
+ * in order.
  */
-	for (i = 0; i < 10; i++)
+	memset (paks, 0, sizeof(paks));
+	for (i = 0; i < MAX_PAKS_IN_DIR; i++)
 	{
 		FSERR_MakePath_VABUF (__thisfunc__, __LINE__,
 					(do_userdir) ? FS_USERDIR : FS_GAMEDIR,
-					pakfile, sizeof(pakfile), "pak%i.pak", i);
-		pak = FS_LoadPackFile (pakfile, i, base_fs);
+					paks[i].path, sizeof(paks[i].path), "pak%i.pak", i);
+	}
+	if (fs_serialinit)
+	{
+		for (i = 0; i < MAX_PAKS_IN_DIR; i++)
+			FS_ReadPack (&paks[i]);
+	}
+	else
+	{
+		Jobs_Run (FS_ReadPackJob, paks, MAX_PAKS_IN_DIR);
+	}
+	for (i = 0; i < MAX_PAKS_IN_DIR; i++)
+	{
+		pak = FS_LoadPackFile (&paks[i], i, base_fs);
 		if (!pak) continue;
 		search = (searchpath_t *) Z_Malloc (sizeof(searchpath_t), Z_MAINZONE);
 		search->path_id = path_id;
@@ -456,7 +971,7 @@ static inline void set_hw_dir (void) { /* helper for FS_Gamedir () */
 }
 #endif
 
-void FS_Gamedir (const char *dir)
+static void FS_ChangeGamedir (const char *dir)
 {
 	searchpath_t	*next;
 
@@ -478,15 +993,11 @@ void FS_Gamedir (const char *dir)
  * since hexen2 doesn't use this during game execution there will be no
  * changes for it: it has portals or data1 at the top.
  */
+	FS_ClearIndex ();
 	while (fs_searchpaths != fs_base_searchpaths)
 	{
 		if (fs_searchpaths->pack)
-		{
-			fclose (fs_searchpaths->pack->handle);
-			Z_Free (fs_searchpaths->pack->files);
-			Hash_Free(&fs_searchpaths->pack->hash);
-			Z_Free (fs_searchpaths->pack);
-		}
+			FS_FreePack (fs_searchpaths->pack);
 		next = fs_searchpaths->next;
 		Z_Free (fs_searchpaths);
 		fs_searchpaths = next;
@@ -545,6 +1056,14 @@ void FS_Gamedir (const char *dir)
 #endif
 }
 
+void FS_Gamedir (const char *dir)
+{
+	FS_PrefetchEnd ();	/* it points into the search paths */
+	FS_ChangeGamedir (dir);
+	if (!fs_index.valid)
+		FS_BuildIndex ();
+}
+
 
 /*
 ==============================================================================
@@ -700,118 +1219,368 @@ int FS_CreatePath (char *path)
 	int	err = 0;
 	size_t	offset;
 
-	if (!path || !*path)
-	{
-		Con_Printf ("%s: no path!\n", __thisfunc__);
-		return 1;
-	}
+	if (!path || !*path)
+	{
+		Con_Printf ("%s: no path!\n", __thisfunc__);
+		return 1;
+	}
+
+	if (strstr(path, ".."))
+	{
+		Con_Printf ("Relative pathnames are not allowed.\n");
+		return 1;
+	}
+
+	offset = strlen(host_parms->userdir);
+	if (offset && strstr(path, host_parms->userdir) != path)
+	{
+		Sys_Error ("Attempted to create a directory out of user's path");
+		return 1;
+	}
+
+	ofs = path + offset;
+	if (*ofs == '\0')	/* not necessarily an error. */
+		return 0;
+	/* check for the path separator after the userdir. */
+	if (IS_DIR_SEPARATOR(*ofs))
+		ofs++;
+	else if (offset)
+	{
+		/* if the userdir itself has no trailing DIRSEP
+		 * either, then it is a bad path: */
+		if (!IS_DIR_SEPARATOR(host_parms->userdir[offset - 1]))
+		{
+			Con_Printf ("%s: bad path\n", __thisfunc__);
+			return 1;
+		}
+	}
+
+	for ( ; *ofs; ofs++)
+	{
+		c = *ofs;
+		if (IS_DIR_SEPARATOR(c))
+		{	/* create the directory */
+			*ofs = 0;
+			err = Sys_mkdir (path, false);
+			*ofs = c;
+			if (err)
+				break;
+		}
+	}
+
+	return err;
+}
+
+
+/*
+==============================================================================
+
+COMPRESSED PAK ENTRIES
+
+A PAKZ_LZBLOCKS entry is a table of block offsets followed by blocks of
+PAKZ_BLOCKSIZE bytes compressed one by one, which lets the blocks of a
+big file (a bsp, a skin) be decompressed by the worker threads at once.
+
+==============================================================================
+*/
+
+typedef struct
+{
+	const byte	*src;		/* the packed entry */
+	int		packlen;
+	byte		*dest;		/* filelen bytes */
+	int		filelen;
+	qboolean	failed;
+} fsunpack_t;
+
+static pack_t	*fs_packed;	/* FS_OpenFile_Internal found a compressed */
+static int	fs_packednum;	/* entry and left it for the caller */
+
+static searchpath_t	*fs_foundsearch;	/* where FS_OpenFile_Internal */
+static int	fs_foundfilenum;	/* found the file, -1 if loose */
+
+static int FS_BlockOffset (const fsunpack_t *u, int block)
+{
+	const byte	*p = u->src + block * 4;
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static void FS_UnpackBlock (void *data, int block)
+{
+	fsunpack_t	*u = (fsunpack_t *) data;
+	int	start, end, outlen;
+	byte	*out;
+
+	start = FS_BlockOffset (u, block);
+	end = FS_BlockOffset (u, block + 1);
+	out = u->dest + block * PAKZ_BLOCKSIZE;
+	outlen = u->filelen - block * PAKZ_BLOCKSIZE;
+	if (outlen > PAKZ_BLOCKSIZE)
+		outlen = PAKZ_BLOCKSIZE;
+
+	if (end - start == outlen)	/* didn't compress */
+		memcpy (out, u->src + start, outlen);
+	else if (LZ_Decompress (u->src + start, end - start, out, outlen) != outlen)
+		u->failed = true;
+}
+
+/*
+===========
+FS_Unpack
+
+Decompresses a PAKZ_LZBLOCKS entry into dest, which must hold filelen
+bytes.  Safe to call from the worker threads: returns what went wrong
+instead of raising an error, NULL if all went well.
+===========
+*/
+static const char *FS_Unpack (pack_t *pak, int filenum, byte *dest)
+{
+	pakfiles_t	*pf = &pak->files[filenum];
+	fsunpack_t	u;
+	byte	*readbuf;
+	FILE	*h;
+	int	i, numblocks, ofs, prev;
+
+	readbuf = NULL;
+	if (pak->map)
+	{
+		u.src = pak->map + pf->filepos;
+	}
+	else
+	{
+		readbuf = (byte *) malloc (pf->packlen);
+		if (!readbuf)
+			return "out of memory";
+		h = fopen (pak->filename, "rb");
+		if (!h)
+		{
+			free (readbuf);
+			return "couldn't reopen the pak";
+		}
+		fseek (h, pf->filepos, SEEK_SET);
+		i = (int) fread (readbuf, 1, pf->packlen, h);
+		fclose (h);
+		if (i != pf->packlen)
+		{
+			free (readbuf);
+			return "truncated";
+		}
+		u.src = readbuf;
+	}
+	u.packlen = pf->packlen;
+	u.dest = dest;
+	u.filelen = pf->filelen;
+	u.failed = false;
+
+	/* check the block table before anything uses it */
+	numblocks = (pf->filelen + PAKZ_BLOCKSIZE - 1) / PAKZ_BLOCKSIZE;
+	prev = (numblocks + 1) * 4;
+	if (prev > u.packlen)
+		u.failed = true;
+	for (i = 0; i <= numblocks && !u.failed; i++)
+	{
+		ofs = FS_BlockOffset (&u, i);
+		if (ofs < prev || ofs > u.packlen)
+			u.failed = true;
+		prev = ofs;
+	}
+
+	if (!u.failed)
+		Jobs_Run (FS_UnpackBlock, &u, numblocks);
+	if (readbuf)
+		free (readbuf);
+	return (u.failed) ? "corrupt" : NULL;
+}
+
+static void FS_UnpackFile (pack_t *pak, int filenum, byte *dest)
+{
+	const char	*err = FS_Unpack (pak, filenum, dest);
+
+	if (err)
+		Sys_Error ("%s: %s in %s: %s", __thisfunc__, pak->files[filenum].name, pak->filename, err);
+}
+
+/* malloc'ed copy of a compressed entry, for FS_OpenHandle and FS_UnpackToFile */
+static byte *FS_UnpackToBuffer (pack_t *pak, int filenum)
+{
+	pakfiles_t	*pf = &pak->files[filenum];
+	byte	*buf;
+
+	buf = (byte *) malloc (pf->filelen + 1);
+	if (!buf)
+		Sys_Error ("%s: out of memory for %s", __thisfunc__, pf->name);
+	FS_UnpackFile (pak, filenum, buf);
+	return buf;
+}
+
+/* for the callers which want a FILE: a stream over the decompressed
+ * data, in memory where the C library can, else in a temporary file.
+ * the extra byte is for the null that fmemopen writes after the data. */
+#if defined(_POSIX_VERSION) && (_POSIX_VERSION >= 200809L)
+#define	FS_MemoryStream(size)	fmemopen (NULL, (size) + 1, "w+b")
+#else
+#define	FS_MemoryStream(size)	tmpfile ()
+#endif
+
+static FILE *FS_UnpackToFile (pack_t *pak, int filenum)
+{
+	pakfiles_t	*pf = &pak->files[filenum];
+	byte	*buf;
+	FILE	*f;
 
-	if (strstr(path, ".."))
-	{
-		Con_Printf ("Relative pathnames are not allowed.\n");
-		return 1;
-	}
+	buf = FS_UnpackToBuffer (pak, filenum);
+	f = FS_MemoryStream (pf->filelen);
+	if (!f)
+		Sys_Error ("%s: couldn't create a stream for %s", __thisfunc__, pf->name);
+	if (fwrite (buf, 1, pf->filelen, f) != (size_t) pf->filelen)
+		Sys_Error ("%s: couldn't write a stream for %s", __thisfunc__, pf->name);
+	free (buf);
+	rewind (f);
+	return f;
+}
 
-	offset = strlen(host_parms->userdir);
-	if (offset && strstr(path, host_parms->userdir) != path)
-	{
-		Sys_Error ("Attempted to create a directory out of user's path");
-		return 1;
-	}
 
-	ofs = path + offset;
-	if (*ofs == '\0')	/* not necessarily an error. */
-		return 0;
-	/* check for the path separator after the userdir. */
-	if (IS_DIR_SEPARATOR(*ofs))
-		ofs++;
-	else if (offset)
+static long FS_OpenPakFile (searchpath_t *search, int filenum, FILE **file,
+			    unsigned int *path_id, const byte **data)
+{
+	pack_t	*pak = search->pack;
+
+	fs_filesize = pak->files[filenum].filelen;
+	file_from_pak = 1;
+	fs_foundsearch = search;
+	fs_foundfilenum = filenum;
+	if (path_id)
+		*path_id = search->path_id;
+	if (!file) /* for FS_FileExists() */
+		return fs_filesize;
+	if (pak->files[filenum].method != PAKZ_STORED)
 	{
-		/* if the userdir itself has no trailing DIRSEP
-		 * either, then it is a bad path: */
-		if (!IS_DIR_SEPARATOR(host_parms->userdir[offset - 1]))
+		if (data)	/* the caller decompresses it itself */
 		{
-			Con_Printf ("%s: bad path\n", __thisfunc__);
-			return 1;
+			fs_packed = pak;
+			fs_packednum = filenum;
+			*file = NULL;
 		}
-	}
-
-	for ( ; *ofs; ofs++)
-	{
-		c = *ofs;
-		if (IS_DIR_SEPARATOR(c))
-		{	/* create the directory */
-			*ofs = 0;
-			err = Sys_mkdir (path, false);
-			*ofs = c;
-			if (err)
-				break;
+		else
+		{
+			*file = FS_UnpackToFile (pak, filenum);
 		}
+		return fs_filesize;
 	}
-
-	return err;
+	if (data && pak->map)
+	{
+		*data = pak->map + pak->files[filenum].filepos;
+		*file = NULL;
+		return fs_filesize;
+	}
+	/* open a new file on the pakfile */
+	*file = fopen (pak->filename, "rb");
+	if (!*file)
+		Sys_Error ("Couldn't reopen %s", pak->filename);
+	fseek (*file, pak->files[filenum].filepos, SEEK_SET);
+	return fs_filesize;
 }
 
+static long FS_OpenLooseFile (searchpath_t *search, const char *filename, FILE **file,
+			      unsigned int *path_id)
+{
+	char	ospath[MAX_OSPATH];
+
+	q_snprintf (ospath, sizeof(ospath), "%s/%s",search->filename, filename);
+	fs_filesize = Sys_filesize (ospath);
+	if (fs_filesize < 0)
+		return -1;
+	fs_foundsearch = search;
+	fs_foundfilenum = -1;
+	if (path_id)
+		*path_id = search->path_id;
+	if (!file) /* for FS_FileExists() */
+		return fs_filesize;
+	*file = fopen (ospath, "rb");
+	if (!*file)
+		Sys_Error ("Couldn't reopen %s", ospath);
+	return fs_filesize;
+}
 
 /*
 ===========
 FS_OpenFile_Internal
 
 Internal function - finds the file in the search path, returns fs_filesize.
-If silent is true, suppresses error messages for missing files.
+If silent is true, suppresses error messages for missing files.  If data
+is not NULL and the file is in a mapped pak, *data is pointed at it and
+no FILE is opened, otherwise *data is set to NULL.  If data is not NULL
+and the file is compressed, neither is set and fs_packed tells the caller
+to decompress it.  Without data, compressed files come in a stream made
+by FS_UnpackToFile.
 ===========
 */
-static long FS_OpenFile_Internal (const char *filename, FILE **file, unsigned int *path_id, qboolean silent)
+static long FS_OpenFile_Internal (const char *filename, FILE **file, unsigned int *path_id,
+				  qboolean silent, const byte **data)
 {
 	searchpath_t	*search;
 	pack_t		*pak;
-	char	ospath[MAX_OSPATH];
+	fsindexent_t	*ent;
 	int	i, key;
 
 	file_from_pak = 0;
+	fs_packed = NULL;
+	if (data)
+		*data = NULL;
+
+	ent = NULL;
+	if (fs_index.hash.hash)
+	{
+		fs_index.lookups++;
+		ent = FS_IndexFind (filename);
+	}
 
 	/* search through the path, one element at a time */
 	for (search = fs_searchpaths ; search ; search = search->next)
 	{
+		if (search->indexed)	/* the index knows what is in there */
+		{
+			if (!ent || ent->search != search)
+				continue;
+			if (search->pack)
+				return FS_OpenPakFile (search, ent->filenum, file, path_id, data);
+			if (FS_OpenLooseFile (search, filename, file, path_id) >= 0)
+				return fs_filesize;
+			continue;	/* removed since the scan */
+		}
 		if (search->pack)	/* look through all the pak file elements */
 		{
 			pak = search->pack;
 			key = Hash_GenerateKeyString (&pak->hash, filename, true);
 			for (i = Hash_First(&pak->hash, key); i != -1; i = Hash_Next(&pak->hash, i))
 			{
-				if (strcmp(pak->files[i].name, filename) != 0)
-					continue;
-				/* found it! */
-				fs_filesize = pak->files[i].filelen;
-				file_from_pak = 1;
-				if (path_id)
-					*path_id = search->path_id;
-				if (!file) /* for FS_FileExists() */
-					return fs_filesize;
-				/* open a new file on the pakfile */
-				*file = fopen (pak->filename, "rb");
-				if (!*file)
-					Sys_Error ("Couldn't reopen %s", pak->filename);
-				fseek (*file, pak->files[i].filepos, SEEK_SET);
-				return fs_filesize;
+				if (strcmp(pak->files[i].name, filename) == 0)
+					return FS_OpenPakFile (search, i, file, path_id, data);
 			}
 		}
 		else	/* check a file in the directory tree */
 		{
-			q_snprintf (ospath, sizeof(ospath), "%s/%s",search->filename, filename);
-			fs_filesize = Sys_filesize (ospath);
-			if (fs_filesize < 0)
-				continue;
-			if (path_id)
-				*path_id = search->path_id;
-			if (!file) /* for FS_FileExists() */
+			if (FS_OpenLooseFile (search, filename, file, path_id) >= 0)
+				return fs_filesize;
+		}
+	}
+
+	/* the probes (silent opens and FS_FileExists) trust the index.  real
+	 * opens check the indexed directories too, for files written since
+	 * the index was built: demos, configs, downloads.  */
+	if (!silent && file)
+	{
+		for (search = fs_searchpaths ; search ; search = search->next)
+		{
+			if (search->indexed && !search->pack &&
+			    FS_OpenLooseFile (search, filename, file, path_id) >= 0)
 				return fs_filesize;
-			*file = fopen (ospath, "rb");
-			if (!*file)
-				Sys_Error ("Couldn't reopen %s", ospath);
-			return fs_filesize;
 		}
 	}
+	else if (fs_index.hash.hash && !ent)
+	{
+		fs_index.misses++;
+	}
 
 	// Only print "can't find" messages when developer >= 1 and not in silent mode
 	// (suppresses noise from optional external textures and missing assets)
@@ -832,7 +1601,7 @@ Finds the file in the search path, returns fs_filesize.
 */
 long FS_OpenFile (const char *filename, FILE **file, unsigned int *path_id)
 {
-	return FS_OpenFile_Internal (filename, file, path_id, false);
+	return FS_OpenFile_Internal (filename, file, path_id, false, NULL);
 }
 
 /*
@@ -846,7 +1615,7 @@ Use for optional file checks (e.g., external textures).
 */
 long FS_OpenFile_Silent (const char *filename, FILE **file, unsigned int *path_id)
 {
-	return FS_OpenFile_Internal (filename, file, path_id, true);
+	return FS_OpenFile_Internal (filename, file, path_id, true, NULL);
 }
 
 /*
@@ -862,6 +1631,63 @@ qboolean FS_FileExists (const char *filename, unsigned int *path_id)
 	return (ret < 0) ? false : true;
 }
 
+/*
+===========
+FS_OpenHandle
+
+Opens a file into an fshandle_t, reading it straight from the mapping
+when it is stored in a mapped pak, or from a buffer the handle owns when
+it is compressed.  Returns fs_filesize, or -1 if not found.
+===========
+*/
+long FS_OpenHandle (const char *filename, fshandle_t *fh, unsigned int *path_id)
+{
+	const byte	*data;
+	long	length;
+
+	memset (fh, 0, sizeof(fshandle_t));
+	length = FS_OpenFile_Internal (filename, &fh->file, path_id, false, &data);
+	if (length < 0)
+		return -1;
+
+	if (fs_packed)
+		data = fh->buffer = FS_UnpackToBuffer (fs_packed, fs_packednum);
+	fh->data = data;
+	fh->pak = file_from_pak;
+	fh->start = (data) ? 0 : ftell(fh->file);
+	fh->length = length;
+	return length;
+}
+
+/*
+===========
+FS_MapFile
+
+Returns a pointer to the file's data inside a mapped pak without copying
+it, or NULL if the file isn't found, isn't stored in a mapped pak or isn't
+four byte aligned there.  The data is read-only, not null terminated and valid
+until the next gamedir change.  fs_filesize is set as for FS_OpenFile.
+===========
+*/
+const byte *FS_MapFile (const char *path, unsigned int *path_id)
+{
+	FILE	*h;
+	const byte	*data;
+
+	if (FS_OpenFile_Internal (path, &h, path_id, true, &data) < 0)
+		return NULL;
+	if (!data)	/* not mapped, or compressed */
+	{
+		if (h)
+			fclose (h);
+		return NULL;
+	}
+	if ((intptr_t)data & 3)
+		return NULL;
+
+	return data;
+}
+
 /*
 ============
 FS_FileInGamedir
@@ -884,6 +1710,294 @@ qboolean FS_FileInGamedir (const char *filename)
 	return false;
 }
 
+/*
+==============================================================================
+
+PREFETCHING
+
+Once the precache lists of a map are known, their files are queued with
+FS_Prefetch and read, decompressed and prepared on the worker threads
+while the main thread loads one after the other: FS_LoadFile and
+FS_PrefetchTake hand out what was read ahead instead of going to disk.
+The files are looked up on the main thread when queued, the workers only
+get to see where each one is.
+
+==============================================================================
+*/
+
+#define	FS_PREFETCH_MAXSIZE	(64 * 1024 * 1024)	/* don't read ahead more */
+
+typedef struct
+{
+	char		name[MAX_QPATH];
+	fsprepfunc_t	prep;
+	searchpath_t	*search;	/* where it is */
+	int		filenum;	/* in search->pack, or -1 if a loose file */
+	unsigned int	path_id;
+	long		filelen;
+	/* set by the worker */
+	byte		*buf;		/* malloc'ed, NULL if it failed */
+	long		size;
+	/* main thread only */
+	qboolean	taken;
+	double		waited;
+} fsprefetch_t;
+
+typedef struct
+{
+	fsprefetch_t	*files;
+	int		numfiles, maxfiles;
+	long		totalsize;
+	qboolean	active, started;
+	int		cursor;		/* the next take is likely here */
+	double		begintime, starttime, waited;
+} fsprefetchlist_t;
+
+static fsprefetchlist_t	fs_prefetch;
+
+static long FS_ReadAt (const char *path, long pos, byte *buf, long len)
+{
+	FILE	*h;
+	long	n;
+
+	h = fopen (path, "rb");
+	if (!h)
+		return -1;
+	fseek (h, pos, SEEK_SET);
+	n = (long) fread (buf, 1, len, h);
+	fclose (h);
+	return n;
+}
+
+/* runs on a worker thread: nothing but the entry itself is written */
+static void FS_PrefetchJob (void *unused, int index)
+{
+	fsprefetch_t	*p = &fs_prefetch.files[index];
+	pack_t		*pak;
+	pakfiles_t	*pf;
+	char	ospath[MAX_OSPATH];
+	byte	*buf;
+	long	n;
+
+	buf = (byte *) malloc (p->filelen + 1);
+	if (!buf)
+		return;
+	if (p->filenum >= 0)
+	{
+		pak = p->search->pack;
+		pf = &pak->files[p->filenum];
+		if (pf->method != PAKZ_STORED)
+			n = (FS_Unpack (pak, p->filenum, buf) == NULL) ? p->filelen : -1;
+		else if (pak->map)
+		{
+			memcpy (buf, pak->map + pf->filepos, p->filelen);
+			n = p->filelen;
+		}
+		else
+			n = FS_ReadAt (pak->filename, pf->filepos, buf, p->filelen);
+	}
+	else
+	{
+		q_snprintf (ospath, sizeof(ospath), "%s/%s", p->search->filename, p->name);
+		n = FS_ReadAt (ospath, 0, buf, p->filelen);
+	}
+	if (n != p->filelen)
+	{	/* the main thread loads it itself and reports the trouble */
+		free (buf);
+		return;
+	}
+
+	buf[n] = 0;
+	p->size = n;
+	if (p->prep)
+		buf = p->prep (p->name, buf, &p->size);
+	p->buf = buf;
+}
+
+/*
+===========
+FS_PrefetchBegin
+
+Starts a new list of files to read ahead.  Does nothing without worker
+threads, which makes FS_Prefetch do nothing either.
+===========
+*/
+void FS_PrefetchBegin (void)
+{
+	FS_PrefetchEnd ();	/* one left behind by a Host_Error */
+	if (Jobs_NumWorkers () <= 0)
+		return;
+	fs_prefetch.active = true;
+	fs_prefetch.begintime = Sys_DoubleTime ();
+}
+
+/*
+===========
+FS_Prefetch
+
+Queues a file for the workers.  If prep is not NULL, the worker passes
+the data through it and it must be taken with the same prep.  Missing
+files are ignored, their loaders will complain about them.
+===========
+*/
+void FS_Prefetch (const char *path, fsprepfunc_t prep)
+{
+	fsprefetch_t	*p;
+	unsigned int	path_id;
+
+	if (!fs_prefetch.active || fs_prefetch.started)
+		return;
+	if (fs_prefetch.totalsize >= FS_PREFETCH_MAXSIZE)
+		return;
+	if (strlen(path) >= MAX_QPATH)
+		return;
+	if (FS_OpenFile_Internal (path, NULL, &path_id, true, NULL) < 0)
+		return;
+
+	if (fs_prefetch.numfiles == fs_prefetch.maxfiles)
+	{
+		p = (fsprefetch_t *) realloc (fs_prefetch.files,
+				(fs_prefetch.maxfiles + 64) * sizeof(fsprefetch_t));
+		if (!p)
+			return;
+		fs_prefetch.files = p;
+		fs_prefetch.maxfiles += 64;
+	}
+	p = &fs_prefetch.files[fs_prefetch.numfiles++];
+	memset (p, 0, sizeof(fsprefetch_t));
+	q_strlcpy (p->name, path, sizeof(p->name));
+	p->prep = prep;
+	p->search = fs_foundsearch;
+	p->filenum = fs_foundfilenum;
+	p->path_id = path_id;
+	p->filelen = fs_filesize;
+	fs_prefetch.totalsize += fs_filesize;
+}
+
+/*
+===========
+FS_PrefetchStart
+
+Hands the queued files to the workers.
+===========
+*/
+void FS_PrefetchStart (void)
+{
+	if (!fs_prefetch.active || fs_prefetch.started)
+		return;
+	fs_prefetch.starttime = Sys_DoubleTime ();
+	if (!fs_prefetch.numfiles ||
+	    !Jobs_Start (FS_PrefetchJob, NULL, fs_prefetch.numfiles))
+	{
+		fs_prefetch.numfiles = 0;
+		return;
+	}
+	fs_prefetch.started = true;
+}
+
+/*
+===========
+FS_PrefetchTake
+
+Returns the malloc'ed data of a prefetched file, waiting for it if the
+workers aren't done with it yet, or NULL if it wasn't prefetched or the
+prefetch failed.  The caller owns the data.  Sets fs_filesize and path_id
+as FS_OpenFile would, *size is that of the data.
+===========
+*/
+byte *FS_PrefetchTake (const char *path, fsprepfunc_t prep, long *size, unsigned int *path_id)
+{
+	fsprefetch_t	*p;
+	byte	*buf;
+	double	t;
+	int	i, n;
+
+	if (!fs_prefetch.started)
+		return NULL;
+	/* the precache loops take the files in the order they were queued */
+	i = fs_prefetch.cursor;
+	p = NULL;
+	for (n = 0; n < fs_prefetch.numfiles; n++)
+	{
+		p = &fs_prefetch.files[i];
+		if (!p->taken && p->prep == prep && !strcmp(p->name, path))
+			break;
+		if (++i == fs_prefetch.numfiles)
+			i = 0;
+	}
+	if (n == fs_prefetch.numfiles)
+		return NULL;
+	fs_prefetch.cursor = (i + 1) % fs_prefetch.numfiles;
+
+	t = Sys_DoubleTime ();
+	Jobs_WaitFor (i);
+	p->waited = Sys_DoubleTime () - t;
+	fs_prefetch.waited += p->waited;
+	p->taken = true;
+	if (!p->buf)
+		return NULL;
+
+	buf = p->buf;
+	p->buf = NULL;
+	*size = p->size;
+	if (path_id)
+		*path_id = p->path_id;
+	fs_filesize = p->filelen;
+	file_from_pak = (p->filenum >= 0);
+	return buf;
+}
+
+/*
+===========
+FS_PrefetchEnd
+
+Waits for the workers, drops whatever wasn't taken and, with developer
+set, logs how the map load went.
+===========
+*/
+void FS_PrefetchEnd (void)
+{
+	fsprefetch_t	*p;
+	double	now;
+	long	unused;
+	int	i, taken;
+
+	if (!fs_prefetch.active)
+		return;
+	if (fs_prefetch.started)
+		Jobs_Finish ();
+	now = Sys_DoubleTime ();
+
+	taken = 0;
+	unused = 0;
+	for (i = 0, p = fs_prefetch.files; i < fs_prefetch.numfiles; i++, p++)
+	{
+		if (p->taken)
+			taken++;
+		else	unused += p->filelen;
+		if (p->buf)
+			free (p->buf);
+		if (developer.integer < 2)
+			continue;
+		if (p->taken)
+			Con_DPrintf ("prefetch: %-40s %8ld bytes, waited %.1f ms\n", p->name, p->filelen, p->waited * 1000.0);
+		else	Con_DPrintf ("prefetch: %-40s %8ld bytes, unused\n", p->name, p->filelen);
+	}
+	if (fs_prefetch.numfiles)
+	{
+		Con_DPrintf ("prefetch: %d files, %ld KB on %d workers: queued in %.1f ms, "
+				"loaded in %.1f ms, main thread waited %.1f ms, %d taken (%ld KB unused)\n",
+				fs_prefetch.numfiles, fs_prefetch.totalsize >> 10, Jobs_NumWorkers (),
+				(fs_prefetch.starttime - fs_prefetch.begintime) * 1000.0,
+				(now - fs_prefetch.starttime) * 1000.0,
+				fs_prefetch.waited * 1000.0, taken, unused >> 10);
+	}
+
+	free (fs_prefetch.files);
+	memset (&fs_prefetch, 0, sizeof(fs_prefetch));
+}
+
+
 /*
 ============
 FS_LoadFile
@@ -914,14 +2028,27 @@ static int		zone_num;
 static byte *FS_LoadFile (const char *path, int usehunk, unsigned int *path_id)
 {
 	FILE	*h;
-	byte	*buf;
+	byte	*buf, *prefetched;
+	const byte	*data;
 	char	base[32];
 	long	len;
 
+/* see if the workers read it already */
+	prefetched = FS_PrefetchTake (path, NULL, &len, path_id);
+	if (prefetched)
+	{
+		if (usehunk == LOADFILE_MALLOC)
+			return prefetched;
+		h = NULL;
+		data = NULL;
+	}
 /* look for it in the filesystem or pack files */
-	len = FS_OpenFile (path, &h, path_id);
-	if (len < 0)
-		return NULL;
+	else
+	{
+		len = FS_OpenFile_Internal (path, &h, path_id, false, &data);
+		if (len < 0)
+			return NULL;
+	}
 
 /* extract the file's base name for hunk tag */
 	COM_FileBase (path, base, sizeof(base));
@@ -961,6 +2088,25 @@ static byte *FS_LoadFile (const char *path, int usehunk, unsigned int *path_id)
 
 	((byte *)buf)[len] = 0;
 
+	if (prefetched)
+	{
+		memcpy (buf, prefetched, (size_t)len);
+		free (prefetched);
+		return buf;
+	}
+	if (data)	/* in a mapped pak */
+	{
+		memcpy (buf, data, (size_t)len);
+		return buf;
+	}
+	if (fs_packed)	/* compressed */
+	{
+		Draw_BeginDisc ();
+		FS_UnpackFile (fs_packed, fs_packednum, buf);
+		Draw_EndDisc ();
+		return buf;
+	}
+
 	Draw_BeginDisc ();
 	fread (buf, 1, (size_t)len, h);
 	fclose (h);
@@ -1220,6 +2366,11 @@ void FS_Init (void)
 	Cvar_RegisterVariable (&registered);
 
 	Cmd_AddCommand ("path", FS_Path_f);
+	Cmd_AddCommand ("fs_rescan", FS_Rescan_f);
+
+	fs_nommap = (COM_CheckParm ("-nommap") != 0);
+	fs_serialinit = (COM_CheckParm ("-serialinit") != 0);
+	Jobs_Init ();	/* compressed paks are unpacked on the workers */
 #if !defined(SERVERONLY)
 	Cmd_AddCommand ("maplist", FS_Maplist_f);
 #endif
@@ -1342,16 +2493,14 @@ void FS_Init (void)
 			searchpath_t	*next;
 			Sys_Printf ("Missing or invalid mission pack installation\n");
 			Con_Printf("Missing or invalid mission pack installation\n");
+			FS_ClearIndex ();
 
 			while (fs_searchpaths != mark)
 			{
 				if (fs_searchpaths->pack)
 				{
-					fclose (fs_searchpaths->pack->handle);
-					Z_Free (fs_searchpaths->pack->files);
-					Hash_Free(&fs_searchpaths->pack->hash);
-					Z_Free (fs_searchpaths->pack);
 					Sys_Printf ("Removed packfile %s\n", fs_searchpaths->pack->filename);
+					FS_FreePack (fs_searchpaths->pack);
 				}
 				else
 				{
@@ -1393,6 +2542,9 @@ void FS_Init (void)
 		if (i < com_argc - 1)
 			FS_Gamedir (com_argv[i+1]);
 	}
+
+	if (!fs_index.valid)
+		FS_BuildIndex ();
 }
 
 #define	FS_NUM_BUFFS	4
@@ -1585,7 +2737,12 @@ size_t FS_fread(void *ptr, size_t size, size_t nmemb, fshandle_t *fh)
 	byte_size = nmemb * size;
 	if (byte_size > fh->length - fh->pos)	/* just read to end */
 		byte_size = fh->length - fh->pos;
-	bytes_read = fread(ptr, 1, byte_size, fh->file);
+	if (fh->data)
+	{
+		memcpy(ptr, fh->data + fh->pos, byte_size);
+		bytes_read = byte_size;
+	}
+	else	bytes_read = fread(ptr, 1, byte_size, fh->file);
 	fh->pos += bytes_read;
 
 	/* fread() must return the number of elements read,
@@ -1635,6 +2792,11 @@ int FS_fseek(fshandle_t *fh, long offset, int whence)
 	if (offset > fh->length)	/* just seek to end */
 		offset = fh->length;
 
+	if (fh->data)
+	{
+		fh->pos = offset;
+		return 0;
+	}
 	ret = fseek(fh->file, fh->start + offset, SEEK_SET);
 	if (ret < 0)
 		return ret;
@@ -1649,6 +2811,13 @@ int FS_fclose(fshandle_t *fh)
 		errno = EBADF;
 		return -1;
 	}
+	if (fh->data)
+	{
+		free (fh->buffer);
+		fh->buffer = NULL;
+		fh->data = NULL;
+		return 0;
+	}
 	return fclose(fh->file);
 }
 
@@ -1664,9 +2833,11 @@ long FS_ftell(fshandle_t *fh)
 void FS_rewind(fshandle_t *fh)
 {
 	if (!fh) return;
+	fh->pos = 0;
+	if (fh->data)
+		return;
 	clearerr(fh->file);
 	fseek(fh->file, fh->start, SEEK_SET);
-	fh->pos = 0;
 }
 
 int FS_feof(fshandle_t *fh)
@@ -1686,6 +2857,8 @@ int FS_ferror(fshandle_t *fh)
 		errno = EBADF;
 		return -1;
 	}
+	if (fh->data)
+		return 0;
 	return ferror(fh->file);
 }
 
@@ -1697,6 +2870,8 @@ int FS_fgetc(fshandle_t *fh)
 	}
 	if (fh->pos >= fh->length)
 		return EOF;
+	if (fh->data)
+		return fh->data[fh->pos++];
 	fh->pos += 1;
 	return fgetc(fh->file);
 }
@@ -1711,6 +2886,20 @@ char *FS_fgets(char *s, int size, fshandle_t *fh)
 	if (size > (fh->length - fh->pos) + 1)
 		size = (fh->length - fh->pos) + 1;
 
+	if (fh->data)
+	{
+		char	*p = s;
+
+		while (--size > 0)
+		{
+			*p = fh->data[fh->pos++];
+			if (*p++ == '\n')
+				break;
+		}
+		*p = 0;
+		return s;
+	}
+
 	ret = fgets(s, size, fh->file);
 	fh->pos = ftell(fh->file) - fh->start;
 
@@ -61,6 +61,11 @@ void FS_Init (void);
 void FS_Gamedir (const char *dir);
 	/* Sets the gamedir and path to a different directory. */
 
+void FS_Rescan (void);
+	/* Rebuilds the index of all files in the search path.  Files which
+	 * are added to the game directories while the game runs aren't seen
+	 * by FS_FileExists and FS_OpenFile_Silent until this is called.  */
+
 
 /* file i/o within qfs */
 extern	long	fs_filesize;	/* size of the last file opened through QFS api */
@@ -127,6 +132,27 @@ void  FS_LoadCacheFile (const char *path, struct cache_user_s *cu,
 							unsigned int *path_id);
 	/* uses cache mem for allocating the buffer.  */
 
+const byte *FS_MapFile (const char *path, unsigned int *path_id);
+	/* returns the file's data in place if it is in a memory mapped pak, NULL
+	 * otherwise.  the data is read-only and not null terminated.  callers must
+	 * fall back to one of the above when NULL is returned.  */
+
+/* reading the files of a map's precache lists ahead on the worker threads.
+ * FS_PrefetchBegin, FS_Prefetch for each file, FS_PrefetchStart, then the
+ * usual loading, which picks them up, and FS_PrefetchEnd once done.  */
+typedef byte *(*fsprepfunc_t) (const char *name, byte *data, long *size);
+	/* runs on a worker thread with the malloc'ed file data of *size bytes
+	 * (plus a terminating zero): returns what the loader wants instead,
+	 * malloc'ed, with its size in *size, or NULL to leave the file to the
+	 * loader.  either way, data is its to free.  no engine calls.  */
+void FS_PrefetchBegin (void);
+void FS_Prefetch (const char *path, fsprepfunc_t prep);
+void FS_PrefetchStart (void);
+byte *FS_PrefetchTake (const char *path, fsprepfunc_t prep, long *size, unsigned int *path_id);
+	/* the malloc'ed data of a prefetched file, NULL if it wasn't. sets
+	 * fs_filesize like FS_OpenFile.  FS_Load*File take them themselves. */
+void FS_PrefetchEnd (void);
+
 #define	FS_BASEDIR	0	/* host_parms->basedir (i.e.:  fs_basedir) */
 #define	FS_USERBASE	1	/* host_parms->userdir */
 #define	FS_GAMEDIR	2	/* host_parms->basedir/gamedir (fs_gamedir) */
@@ -149,12 +175,18 @@ char *FS_MakePath_VABUF (int base, int *error, char *buf, size_t siz, const char
 typedef struct _fshandle_t
 {
 	FILE *file;
+	const byte *data;	/* file data in memory, NULL if read from file */
+	byte *buffer;	/* malloc'ed data of a compressed file, freed by FS_fclose */
 	qboolean pak;	/* is the file read from a pak */
 	long start;	/* file or data start position */
 	long length;	/* file or data size */
 	long pos;	/* current position relative to start */
 } fshandle_t;
 
+long FS_OpenHandle (const char *filename, fshandle_t *fh, unsigned int *path_id);
+	/* Like FS_OpenFile, but fills in fh and reads files in mapped paks straight
+	 * from memory.  Close with FS_fclose.  */
+
 size_t FS_fread(void *ptr, size_t size, size_t nmemb, fshandle_t *fh);
 int FS_fseek(fshandle_t *fh, long offset, int whence);
 long FS_ftell(fshandle_t *fh);
@@ -425,6 +425,26 @@ sfx_t *S_PrecacheSound (const char *name)
 	return sfx;
 }
 
+/*
+==================
+S_PrefetchSound
+
+Queues a sound which S_PrecacheSound will load for FS_Prefetch.
+==================
+*/
+void S_PrefetchSound (const char *name)
+{
+	sfx_t	*sfx;
+
+	if (!sound_started || nosound.integer || !precache.integer)
+		return;
+
+	sfx = S_FindName (name);
+	if (Cache_Check (&sfx->cache))
+		return;
+	FS_Prefetch (va("sound/%s", name), S_PrepareSound);
+}
+
 
 //=============================================================================
 
@@ -27,18 +27,13 @@
 ResampleSfx
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfx (sfxcache_t *sc, int inrate, int inwidth, byte *data)
 {
 	int		outcount;
 	int		srcsample;
 	float	stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
-	sfxcache_t	*sc;
-
-	sc = (sfxcache_t *) Cache_Check (&sfx->cache);
-	if (!sc)
-		return;
 
 	stepscale = (float)inrate / shm->speed;	// this is usually 0.5, 1, or 2
 
@@ -85,6 +80,55 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 
 //=============================================================================
 
+static wavinfo_t S_ParseWavinfo (const char *name, byte *wav, int wavlength, qboolean quiet);
+
+/*
+==============
+S_PrepareSound
+
+Turns the data of a prefetched wav file into the sfxcache_t S_LoadSound
+would make of it.  Runs on a worker thread, so it doesn't complain: what
+it can't make sense of is left to S_LoadSound.
+==============
+*/
+byte *S_PrepareSound (const char *name, byte *data, long *size)
+{
+	wavinfo_t	info;
+	int		len;
+	float	stepscale;
+	sfxcache_t	*sc;
+
+	info = S_ParseWavinfo (name, data, *size, true);
+	if (info.channels != 1 || (info.width != 1 && info.width != 2))
+	{
+		free (data);
+		return NULL;
+	}
+
+	stepscale = (float)info.rate / shm->speed;
+	len = info.samples / stepscale;
+	len = len * info.width * info.channels;
+	if (info.samples == 0 || len == 0)
+	{
+		free (data);
+		return NULL;
+	}
+
+	sc = (sfxcache_t *) malloc (len + sizeof(sfxcache_t));
+	if (sc)
+	{
+		sc->length = info.samples;
+		sc->loopstart = info.loopstart;
+		sc->speed = info.rate;
+		sc->width = info.width;
+		sc->stereo = info.channels;
+		ResampleSfx (sc, sc->speed, sc->width, data + info.dataofs);
+		*size = len + sizeof(sfxcache_t);
+	}
+	free (data);
+	return (byte *) sc;
+}
+
 /*
 ==============
 S_LoadSound
@@ -96,6 +140,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	byte	*data;
 	wavinfo_t	info;
 	int		len;
+	long	size;
 	float	stepscale;
 	sfxcache_t	*sc;
 	byte	stackbuf[1*1024];		// avoid dirtying the cache heap
@@ -111,9 +156,23 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	q_strlcpy(namebuffer, "sound/", sizeof(namebuffer));
 	q_strlcat(namebuffer, s->name, sizeof(namebuffer));
 
+	// a prefetched one is already resampled
+	data = FS_PrefetchTake(namebuffer, S_PrepareSound, &size, NULL);
+	if (data)
+	{
+		sc = (sfxcache_t *) Cache_Alloc (&s->cache, size, s->name);
+		if (sc)
+			memcpy (sc, data, size);
+		free (data);
+		return sc;
+	}
+
 //	Con_Printf ("loading %s\n",namebuffer);
 
-	data = FS_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
+	// samples in a mapped pak are read in place, they are only resampled
+	data = (byte *) FS_MapFile(namebuffer, NULL);
+	if (!data)
+		data = FS_LoadStackFile(namebuffer, stackbuf, sizeof(stackbuf), NULL);
 
 	if (!data)
 	{
@@ -155,7 +214,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	sc->width = info.width;
 	sc->stereo = info.channels;
 
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	ResampleSfx (sc, sc->speed, sc->width, data + info.dataofs);
 
 	return sc;
 }
@@ -170,89 +229,100 @@ WAV loading
 ===============================================================================
 */
 
-static byte	*data_p;
-static byte	*iff_end;
-static byte	*last_chunk;
-static byte	*iff_data;
-static int	iff_chunk_len;
-
-static short GetLittleShort (void)
+/* the parse is kept in a struct of its own so that the workers can
+ * prepare prefetched sounds while the main thread loads others. */
+typedef struct
+{
+	byte	*data_p;
+	byte	*iff_end;
+	byte	*last_chunk;
+	byte	*iff_data;
+	int	iff_chunk_len;
+	qboolean	quiet;
+} wavparse_t;
+
+static short GetLittleShort (wavparse_t *w)
 {
 	short val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	data_p += 2;
+	val = *w->data_p;
+	val = val + (*(w->data_p+1)<<8);
+	w->data_p += 2;
 	return val;
 }
 
-static int GetLittleLong (void)
+static int GetLittleLong (wavparse_t *w)
 {
 	int val = 0;
-	val = *data_p;
-	val = val + (*(data_p+1)<<8);
-	val = val + (*(data_p+2)<<16);
-	val = val + (*(data_p+3)<<24);
-	data_p += 4;
+	val = *w->data_p;
+	val = val + (*(w->data_p+1)<<8);
+	val = val + (*(w->data_p+2)<<16);
+	val = val + (*(w->data_p+3)<<24);
+	w->data_p += 4;
 	return val;
 }
 
-static void FindNextChunk (const char *name)
+static void FindNextChunk (wavparse_t *w, const char *name)
 {
 	while (1)
 	{
 	// Need at least 8 bytes for a chunk
-		if (last_chunk + 8 >= iff_end)
+		if (w->last_chunk + 8 >= w->iff_end)
 		{
-			data_p = NULL;
+			w->data_p = NULL;
 			return;
 		}
 
-		data_p = last_chunk + 4;
-		iff_chunk_len = GetLittleLong();
-		if (iff_chunk_len < 0 || iff_chunk_len > iff_end - data_p)
+		w->data_p = w->last_chunk + 4;
+		w->iff_chunk_len = GetLittleLong(w);
+		if (w->iff_chunk_len < 0 || w->iff_chunk_len > w->iff_end - w->data_p)
 		{
-			data_p = NULL;
-			Con_DPrintf("bad \"%s\" chunk length (%d)\n", name, iff_chunk_len);
+			w->data_p = NULL;
+			if (!w->quiet)
+				Con_DPrintf("bad \"%s\" chunk length (%d)\n", name, w->iff_chunk_len);
 			return;
 		}
-		last_chunk = data_p + ((iff_chunk_len + 1) & ~1);
-		data_p -= 8;
-		if (!strncmp((char *)data_p, name, 4))
+		w->last_chunk = w->data_p + ((w->iff_chunk_len + 1) & ~1);
+		w->data_p -= 8;
+		if (!strncmp((char *)w->data_p, name, 4))
 			return;
 	}
 }
 
-static void FindChunk (const char *name)
+static void FindChunk (wavparse_t *w, const char *name)
 {
-	last_chunk = iff_data;
-	FindNextChunk (name);
+	w->last_chunk = w->iff_data;
+	FindNextChunk (w, name);
 }
 
 #if 0
-static void DumpChunks (void)
+static void DumpChunks (wavparse_t *w)
 {
 	char	str[5];
 
 	str[4] = 0;
-	data_p = iff_data;
+	w->data_p = w->iff_data;
 	do
 	{
-		memcpy (str, data_p, 4);
-		data_p += 4;
-		iff_chunk_len = GetLittleLong();
-		Con_Printf ("0x%x : %s (%d)\n", (int)(data_p - 4), str, iff_chunk_len);
-		data_p += (iff_chunk_len + 1) & ~1;
-	} while (data_p < iff_end);
+		memcpy (str, w->data_p, 4);
+		w->data_p += 4;
+		w->iff_chunk_len = GetLittleLong(w);
+		Con_Printf ("0x%x : %s (%d)\n", (int)(w->data_p - 4), str, w->iff_chunk_len);
+		w->data_p += (w->iff_chunk_len + 1) & ~1;
+	} while (w->data_p < w->iff_end);
 }
 #endif
 
 /*
 ============
-GetWavinfo
+S_ParseWavinfo
+
+With quiet set, nothing is printed and a bad file only makes for an
+empty info, so that it can run on a worker thread.
 ============
 */
-wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+static wavinfo_t S_ParseWavinfo (const char *name, byte *wav, int wavlength, qboolean quiet)
 {
+	wavparse_t	w;
 	wavinfo_t	info;
 	int	i;
 	int	format;
@@ -263,61 +333,65 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 	if (!wav)
 		return info;
 
-	iff_data = wav;
-	iff_end = wav + wavlength;
+	w.quiet = quiet;
+	w.iff_data = wav;
+	w.iff_end = wav + wavlength;
 
 // find "RIFF" chunk
-	FindChunk("RIFF");
-	if (!(data_p && !strncmp((char *)data_p + 8, "WAVE", 4)))
+	FindChunk(&w, "RIFF");
+	if (!(w.data_p && !strncmp((char *)w.data_p + 8, "WAVE", 4)))
 	{
-		Con_Printf("%s missing RIFF/WAVE chunks\n", name);
+		if (!quiet)
+			Con_Printf("%s missing RIFF/WAVE chunks\n", name);
 		return info;
 	}
 
 // get "fmt " chunk
-	iff_data = data_p + 12;
+	w.iff_data = w.data_p + 12;
 #if 0
-	DumpChunks ();
+	DumpChunks (&w);
 #endif
 
-	FindChunk("fmt ");
-	if (!data_p)
+	FindChunk(&w, "fmt ");
+	if (!w.data_p)
 	{
-		Con_Printf("%s is missing fmt chunk\n", name);
+		if (!quiet)
+			Con_Printf("%s is missing fmt chunk\n", name);
 		return info;
 	}
-	data_p += 8;
-	format = GetLittleShort();
+	w.data_p += 8;
+	format = GetLittleShort(&w);
 	if (format != WAV_FORMAT_PCM)
 	{
-		Con_Printf("%s is not Microsoft PCM format\n", name);
+		if (!quiet)
+			Con_Printf("%s is not Microsoft PCM format\n", name);
 		return info;
 	}
 
-	info.channels = GetLittleShort();
-	info.rate = GetLittleLong();
-	data_p += 4 + 2;
-	i = GetLittleShort();
+	info.channels = GetLittleShort(&w);
+	info.rate = GetLittleLong(&w);
+	w.data_p += 4 + 2;
+	i = GetLittleShort(&w);
 	if (i != 8 && i != 16)
 		return info;
 	info.width = i / 8;
 
 // get cue chunk
-	FindChunk("cue ");
-	if (data_p)
+	FindChunk(&w, "cue ");
+	if (w.data_p)
 	{
-		data_p += 32;
-		info.loopstart = GetLittleLong();
+		w.data_p += 32;
+		info.loopstart = GetLittleLong(&w);
 	//	Con_Printf("loopstart=%d\n", sfx->loopstart);
 
 	// if the next chunk is a LIST chunk, look for a cue length marker
-		FindNextChunk ("LIST");
-		if (data_p)
+		FindNextChunk (&w, "LIST");
+		if (w.data_p)
 		{
-			if (!strncmp((char *)data_p + 28, "mark", 4))
+			if (!strncmp((char *)w.data_p + 28, "mark", 4))
 			{	// this is not a proper parse, but it works with cooledit...
-				data_p += 24;
-				i = GetLittleLong();	// samples in loop
+				w.data_p += 24;
+				i = GetLittleLong(&w);	// samples in loop
 				info.samples = info.loopstart + i;
 		//		Con_Printf("looped length: %i\n", i);
 			}
@@ -327,26 +401,44 @@ wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
 		info.loopstart = -1;
 
 // find data chunk
-	FindChunk("data");
-	if (!data_p)
+	FindChunk(&w, "data");
+	if (!w.data_p)
 	{
-		Con_Printf("%s is missing data chunk\n", name);
+		if (!quiet)
+			Con_Printf("%s is missing data chunk\n", name);
 		return info;
 	}
 
-	data_p += 4;
-	samples = GetLittleLong() / info.width;
+	w.data_p += 4;
+	samples = GetLittleLong(&w) / info.width;
 
 	if (info.samples)
 	{
 		if (samples < info.samples)
+		{
+			if (quiet)
+			{	// S_LoadSound will find out for itself
+				memset (&info, 0, sizeof(info));
+				return info;
+			}
 			Sys_Error ("%s has a bad loop length", name);
+		}
 	}
 	else
 		info.samples = samples;
 
-	info.dataofs = data_p - wav;
+	info.dataofs = w.data_p - wav;
 
 	return info;
 }
 
+/*
+============
+GetWavinfo
+============
+*/
+wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength)
+{
+	return S_ParseWavinfo (name, wav, wavlength, false);
+}
+
@@ -63,6 +63,10 @@ sfx_t *S_PrecacheSound (const char *name)
 	return NULL;
 }
 
+void S_PrefetchSound (const char *name)
+{
+}
+
 void S_ClearPrecache (void)
 {
 }
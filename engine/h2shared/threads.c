@@ -0,0 +1,356 @@
+/* threads.c -- a small pool of worker threads.
+ *
+ * Copyright (C) 2026  uHexen2 developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "quakedef.h"
+#include "threads.h"
+
+#if defined(PLATFORM_WINDOWS)
+#include <windows.h>
+#define	JOBS_THREADS	1
+#elif defined(PLATFORM_UNIX)
+#include <pthread.h>
+#include <unistd.h>
+#define	JOBS_THREADS	1
+#else
+#define	JOBS_THREADS	0
+#endif
+
+static qboolean	jobs_initialized;
+static int	jobs_numworkers;
+
+/* the current batch: the workers take indices from job_next on until
+ * job_count, job_pending counts the calls which haven't returned yet.
+ * a batch from Jobs_Start also has a state for each call, so that it
+ * can be waited for or claimed one by one.  all of it is protected by
+ * the pool lock. */
+static jobfunc_t	job_func;
+static void	*job_data;
+static int	job_count, job_next, job_pending;
+static byte	*job_state;	/* JOB_QUEUED, JOB_RUNNING or JOB_DONE */
+static qboolean	job_async;	/* batch from Jobs_Start not finished */
+
+#define	JOB_QUEUED	0
+#define	JOB_RUNNING	1
+#define	JOB_DONE	2
+
+#if JOBS_THREADS
+
+#if defined(PLATFORM_WINDOWS)
+static CRITICAL_SECTION	jobs_lock;
+static HANDLE	jobs_wake;	/* semaphore, one count per worker to wake */
+static HANDLE	jobs_done;	/* auto reset event */
+
+#define	Jobs_Lock()	EnterCriticalSection (&jobs_lock)
+#define	Jobs_Unlock()	LeaveCriticalSection (&jobs_lock)
+
+static int Jobs_NumCPUs (void)
+{
+	SYSTEM_INFO	info;
+
+	GetSystemInfo (&info);
+	return (int) info.dwNumberOfProcessors;
+}
+
+#else	/* pthreads */
+static pthread_mutex_t	jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	jobs_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	jobs_done = PTHREAD_COND_INITIALIZER;
+
+#define	Jobs_Lock()	pthread_mutex_lock (&jobs_lock)
+#define	Jobs_Unlock()	pthread_mutex_unlock (&jobs_lock)
+
+static int Jobs_NumCPUs (void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+	return (int) sysconf (_SC_NPROCESSORS_ONLN);
+#else
+	return 1;
+#endif
+}
+#endif
+
+static void Jobs_Signal (void)
+{
+#if defined(PLATFORM_WINDOWS)
+	SetEvent (jobs_done);
+#else
+	pthread_cond_broadcast (&jobs_done);
+#endif
+}
+
+static void Jobs_WaitSignal (void)
+{
+#if defined(PLATFORM_WINDOWS)
+	Jobs_Unlock ();
+	WaitForSingleObject (jobs_done, INFINITE);
+	Jobs_Lock ();
+#else
+	pthread_cond_wait (&jobs_done, &jobs_lock);
+#endif
+}
+
+/* makes call i of the current batch, which must have been taken.
+ * called with the lock held, returns with it held. */
+static void Jobs_Call (int i)
+{
+	jobfunc_t	func = job_func;
+	void	*data = job_data;
+
+	if (job_state)
+		job_state[i] = JOB_RUNNING;
+	Jobs_Unlock ();
+	func (data, i);
+	Jobs_Lock ();
+	if (job_state)
+	{
+		job_state[i] = JOB_DONE;
+		Jobs_Signal ();		/* someone may be waiting for this one */
+	}
+	if (--job_pending == 0)
+		Jobs_Signal ();
+}
+
+/* takes the jobs of the current batch until there are none left.
+ * called with the lock held, returns with it held. */
+static void Jobs_Work (void)
+{
+	int	i;
+
+	while (job_next < job_count)
+	{
+		i = job_next++;
+		if (job_state && job_state[i] != JOB_QUEUED)
+			continue;	/* claimed by Jobs_WaitFor */
+		Jobs_Call (i);
+	}
+}
+
+#if defined(PLATFORM_WINDOWS)
+static DWORD WINAPI Jobs_Worker (LPVOID unused)
+{
+	for ( ; ; )
+	{
+		WaitForSingleObject (jobs_wake, INFINITE);
+		Jobs_Lock ();
+		Jobs_Work ();
+		Jobs_Unlock ();
+	}
+	return 0;
+}
+
+static qboolean Jobs_StartWorker (void)
+{
+	HANDLE	h = CreateThread (NULL, 0, Jobs_Worker, NULL, 0, NULL);
+
+	if (h == NULL)
+		return false;
+	CloseHandle (h);
+	return true;
+}
+
+#else
+static void *Jobs_Worker (void *unused)
+{
+	Jobs_Lock ();
+	for ( ; ; )
+	{
+		while (job_next >= job_count)
+			pthread_cond_wait (&jobs_wake, &jobs_lock);
+		Jobs_Work ();
+	}
+	Jobs_Unlock ();
+	return NULL;
+}
+
+static qboolean Jobs_StartWorker (void)
+{
+	pthread_t	thread;
+	pthread_attr_t	attr;
+	int		err;
+
+	pthread_attr_init (&attr);
+	pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create (&thread, &attr, Jobs_Worker, NULL);
+	pthread_attr_destroy (&attr);
+	return (err == 0);
+}
+#endif
+
+#endif	/* JOBS_THREADS */
+
+
+void Jobs_Init (void)
+{
+#if JOBS_THREADS
+	int	i, want;
+#endif
+
+	if (jobs_initialized)
+		return;
+	jobs_initialized = true;
+
+#if JOBS_THREADS
+	i = COM_CheckParm ("-threads");
+	if (i && i < com_argc - 1)
+		want = atoi (com_argv[i + 1]);
+	else	want = Jobs_NumCPUs () - 1;
+	if (want > MAX_WORKERS)
+		want = MAX_WORKERS;
+	if (want <= 0)
+		return;
+
+#if defined(PLATFORM_WINDOWS)
+	InitializeCriticalSection (&jobs_lock);
+	jobs_wake = CreateSemaphore (NULL, 0, 0x7fffffff, NULL);
+	jobs_done = CreateEvent (NULL, FALSE, FALSE, NULL);
+	if (!jobs_wake || !jobs_done)
+	{
+		Sys_Printf ("%s: couldn't create the pool, running serially\n", __thisfunc__);
+		return;
+	}
+#endif
+	for (i = 0; i < want; i++)
+	{
+		if (!Jobs_StartWorker ())
+			break;
+	}
+	jobs_numworkers = i;
+	Sys_Printf ("Started %d worker thread%s\n", i, (i == 1) ? "" : "s");
+#endif
+}
+
+int Jobs_NumWorkers (void)
+{
+	return jobs_numworkers;
+}
+
+void Jobs_Run (jobfunc_t func, void *data, int count)
+{
+	int	i;
+
+	if (count <= 0)
+		return;
+
+#if JOBS_THREADS
+	if (jobs_numworkers > 0 && count > 1)
+	{
+		Jobs_Lock ();
+		if (job_pending == 0 && !job_async)
+		{
+			job_func = func;
+			job_data = data;
+			job_count = count;
+			job_next = 0;
+			job_pending = count;
+#if defined(PLATFORM_WINDOWS)
+			ReleaseSemaphore (jobs_wake,
+					(count - 1 < jobs_numworkers) ? count - 1 : jobs_numworkers,
+					NULL);
+#else
+			pthread_cond_broadcast (&jobs_wake);
+#endif
+			Jobs_Work ();
+			while (job_pending != 0)
+				Jobs_WaitSignal ();
+			job_count = job_next = 0;
+			job_func = NULL;
+			job_data = NULL;
+			Jobs_Unlock ();
+			return;
+		}
+		Jobs_Unlock ();
+	}
+#endif
+
+	for (i = 0; i < count; i++)
+		func (data, i);
+}
+
+qboolean Jobs_Start (jobfunc_t func, void *data, int count)
+{
+#if JOBS_THREADS
+	byte	*state;
+
+	if (jobs_numworkers <= 0 || count <= 0)
+		return false;
+	state = (byte *) calloc (count, 1);
+	if (!state)
+		return false;
+
+	Jobs_Lock ();
+	if (job_pending != 0 || job_async)
+	{
+		Jobs_Unlock ();
+		free (state);
+		return false;
+	}
+	job_func = func;
+	job_data = data;
+	job_count = count;
+	job_next = 0;
+	job_pending = count;
+	job_state = state;
+	job_async = true;
+#if defined(PLATFORM_WINDOWS)
+	ReleaseSemaphore (jobs_wake, (count < jobs_numworkers) ? count : jobs_numworkers, NULL);
+#else
+	pthread_cond_broadcast (&jobs_wake);
+#endif
+	Jobs_Unlock ();
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Jobs_WaitFor (int index)
+{
+#if JOBS_THREADS
+	Jobs_Lock ();
+	if (job_async && index >= 0 && index < job_count)
+	{
+		if (job_state[index] == JOB_QUEUED)
+			Jobs_Call (index);
+		while (job_state[index] != JOB_DONE)
+			Jobs_WaitSignal ();
+	}
+	Jobs_Unlock ();
+#endif
+}
+
+void Jobs_Finish (void)
+{
+#if JOBS_THREADS
+	Jobs_Lock ();
+	if (job_async)
+	{
+		Jobs_Work ();	/* help with what is left */
+		while (job_pending != 0)
+			Jobs_WaitSignal ();
+		free (job_state);
+		job_state = NULL;
+		job_async = false;
+		job_count = job_next = 0;
+		job_func = NULL;
+		job_data = NULL;
+	}
+	Jobs_Unlock ();
+#endif
+}
@@ -0,0 +1,54 @@
+/* threads.h -- a small pool of worker threads.
+ *
+ * Copyright (C) 2026  uHexen2 developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __H2_THREADS_H
+#define __H2_THREADS_H
+
+#define	MAX_WORKERS	8
+
+typedef void (*jobfunc_t) (void *data, int index);
+
+void Jobs_Init (void);
+	/* starts the workers: -threads <n> on the command line sets their
+	 * number, the default is one less than the number of cpus.  platforms
+	 * without thread support get none.  safe to call more than once.  */
+
+int Jobs_NumWorkers (void);
+
+void Jobs_Run (jobfunc_t func, void *data, int count);
+	/* calls func(data, i) for each i in [0, count) on the workers and the
+	 * calling thread, and returns when all of them are done.  the calls
+	 * are made in no particular order and must not touch the hunk, the
+	 * zone or the console.  when the pool is already busy, such as for a
+	 * Jobs_Run from within a job, the calls are made serially instead.  */
+
+qboolean Jobs_Start (jobfunc_t func, void *data, int count);
+	/* like Jobs_Run, but returns at once and leaves the calls to the
+	 * workers.  returns false and calls nothing when there are no workers
+	 * or the pool is busy.  the pool stays busy until Jobs_Finish.  */
+
+void Jobs_WaitFor (int index);
+	/* returns once the call for index of the started batch is done,
+	 * making it on the calling thread if no worker has taken it yet. */
+
+void Jobs_Finish (void);
+	/* waits for the rest of the started batch and frees the pool. */
+
+#endif	/* __H2_THREADS_H */
@@ -89,14 +89,57 @@ typedef struct memzone_s
 	memblock_t	*rover;
 } memzone_t;
 
+/* small allocations come from size classes: zone blocks tagged
+ * ZTAG_SLAB are cut into equal blocks tagged ZTAG_POOLED, which go
+ * back to the free list of their class when freed instead of being
+ * merged into the zone.	*/
+#define	ZTAG_DEFAULT	1
+#define	ZTAG_POOLED	2
+#define	ZTAG_SLAB	3
+
+#define	ZPOOL_CLASSES	8
+#define	ZPOOL_SLABSIZE	4096
+
+static const int zpool_sizes[ZPOOL_CLASSES] =
+{
+	16, 32, 48, 64, 96, 128, 192, 256
+};
+
+typedef struct zoneslab_s
+{
+	struct zoneslab_s	*next;
+	int		used;		/* blocks handed out */
+	int		pad;
+} zoneslab_t;
+
+typedef struct
+{
+	memblock_t	*free;		/* linked through next */
+	zoneslab_t	*slabs;
+} zonepool_t;
+
+typedef struct
+{
+	int		allocs, frees;
+	int		pooled;		/* allocs served by a size class */
+	int		slabs;		/* zone blocks held by the size classes */
+	int		used, peak;	/* bytes in allocated blocks */
+	int		lastallocs;	/* allocs at the last sys_stats */
+	double		lasttime;
+} zonestats_t;
+
 typedef struct zonelist_s
 {
 	int		id, magic;
 	const char		*name;
 	memzone_t		*zone;
+	zonepool_t		pools[ZPOOL_CLASSES];
+	zonestats_t		stats;
 	struct zonelist_s	*next;
 } zonelist_t;
 
+static	qboolean	zone_pools = true;	/* sys_zonetest turns it off */
+
 #if defined (SERVERONLY)
 #define Cache_FreeLow(x)
 #define Cache_FreeHigh(x)
@@ -105,6 +148,23 @@ static void Cache_FreeLow (int new_low_hunk);
 static void Cache_FreeHigh (int new_high_hunk);
 #endif
 
+/* the memory profiler, see MEMORY PROFILER below */
+#define	MP_HUNK_ALLOC	0
+#define	MP_HUNK_FREE	1
+#define	MP_HIGH_ALLOC	2
+#define	MP_HIGH_FREE	3
+#define	MP_ZONE_ALLOC	4
+#define	MP_ZONE_FREE	5
+#define	MP_CACHE_ALLOC	6
+#define	MP_CACHE_FREE	7
+#define	MP_CACHE_EVICT	8
+#define	MP_CACHE_MOVE	9
+#define	MP_NEWMAP	10
+
+static	qboolean	memprof_active;
+static void MemProf_Record (int kind, const char *name, int size);
+static void MemProf_FreeHunk (int kind, byte *start, byte *end);
+
 
 /*
 ==============================================================================
@@ -126,32 +186,18 @@ static	char		mainzone[] = "MAINZONE";
 static	char		sec_zone[] = "SEC_ZONE";
 #endif
 
+static void *Z_TagMalloc (zonelist_t *z, int size, int tag);
+
 /*
 ========================
-Z_Free
+Z_FreeBlock
+
+Returns a block to the zone, merging it with free neighbours.
 ========================
 */
-void Z_Free (void *ptr)
+static void Z_FreeBlock (zonelist_t *z, memblock_t *block)
 {
-	zonelist_t	*z;
-	memblock_t	*block, *other;
-
-	if (!ptr)
-		Sys_Error ("%s: NULL pointer", __thisfunc__);
-
-	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->tag == 0)
-		Sys_Error ("%s: freed a freed pointer", __thisfunc__);
-
-	z = zonelist;
-	while (z != NULL)
-	{
-		if (z->magic == block->magic)
-			break;
-		z = z->next;
-	}
-	if (z == NULL)
-		Sys_Error ("%s: freed a pointer without ZMAGIC", __thisfunc__);
+	memblock_t	*other;
 
 	block->tag = 0;		/* mark as free */
 
@@ -177,6 +223,195 @@ void Z_Free (void *ptr)
 	}
 }
 
+/*
+========================
+Z_PoolMalloc
+
+Returns a block of the smallest size class size fits in, cutting a new
+slab out of the zone when the class has no free block left.  Returns
+NULL if size is too big for the size classes or the zone is full.
+========================
+*/
+static void *Z_PoolMalloc (zonelist_t *z, int size)
+{
+	zonepool_t	*pool;
+	zoneslab_t	*slab;
+	memblock_t	*block;
+	int		c, i, count, blocksize;
+
+	for (c = 0; c < ZPOOL_CLASSES; c++)
+	{
+		if (size <= zpool_sizes[c])
+			break;
+	}
+	if (c == ZPOOL_CLASSES)
+		return NULL;
+	pool = &z->pools[c];
+
+	if (!pool->free)
+	{
+		slab = (zoneslab_t *) Z_TagMalloc (z, ZPOOL_SLABSIZE, ZTAG_SLAB);
+		if (!slab)
+			return NULL;
+		slab->next = pool->slabs;
+		slab->used = 0;
+		pool->slabs = slab;
+		z->stats.slabs++;
+
+		blocksize = (sizeof(memblock_t) + zpool_sizes[c] + 4 + 7) & ~7;
+		i = (sizeof(zoneslab_t) + 7) & ~7;
+		count = (ZPOOL_SLABSIZE - i) / blocksize;
+		for (block = (memblock_t *)((byte *)slab + i); count; count--)
+		{
+			block->size = blocksize;
+			block->tag = 0;
+			block->magic = z->magic;
+			block->pad = c;
+			block->prev = (memblock_t *) slab;
+			block->next = pool->free;
+			pool->free = block;
+			*(int *)((byte *)block + blocksize - 4) = z->magic;
+			block = (memblock_t *)((byte *)block + blocksize);
+		}
+	}
+
+	block = pool->free;
+	pool->free = block->next;
+	block->tag = ZTAG_POOLED;
+	block->next = NULL;
+	((zoneslab_t *) block->prev)->used++;
+	z->stats.pooled++;
+
+	return (void *) ((byte *)block + sizeof(memblock_t));
+}
+
+/*
+========================
+Z_PoolFree
+========================
+*/
+static void Z_PoolFree (zonelist_t *z, memblock_t *block)
+{
+	zonepool_t	*pool;
+
+	pool = &z->pools[block->pad];
+	block->tag = 0;
+	block->next = pool->free;
+	pool->free = block;
+	((zoneslab_t *) block->prev)->used--;
+}
+
+/*
+========================
+Z_ReleaseSlabs
+
+Gives the slabs no block is allocated from back to the zone.  Returns
+how many were released.
+========================
+*/
+static int Z_ReleaseSlabs (zonelist_t *z)
+{
+	zonepool_t	*pool;
+	zoneslab_t	*slab, **prevslab;
+	memblock_t	*block, **prev;
+	int		c, count;
+
+	count = 0;
+	for (c = 0, pool = z->pools; c < ZPOOL_CLASSES; c++, pool++)
+	{
+		for (prev = &pool->free; (block = *prev) != NULL; )
+		{
+			if (((zoneslab_t *) block->prev)->used == 0)
+				*prev = block->next;
+			else
+				prev = &block->next;
+		}
+		for (prevslab = &pool->slabs; (slab = *prevslab) != NULL; )
+		{
+			if (slab->used)
+			{
+				prevslab = &slab->next;
+				continue;
+			}
+			*prevslab = slab->next;
+			Z_FreeBlock (z, (memblock_t *)((byte *)slab - sizeof(memblock_t)));
+			z->stats.slabs--;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+========================
+Z_Alloc
+
+Tries the size classes, then the zone, then the zone again after giving
+it the unused slabs.  Returns NULL if all fail.
+========================
+*/
+static void *Z_Alloc (zonelist_t *z, int size)
+{
+	memblock_t	*block;
+	void		*buf;
+
+	buf = zone_pools ? Z_PoolMalloc (z, size) : NULL;
+	if (!buf)
+		buf = Z_TagMalloc (z, size, ZTAG_DEFAULT);
+	if (!buf && Z_ReleaseSlabs (z))
+		buf = Z_TagMalloc (z, size, ZTAG_DEFAULT);
+	if (!buf)
+		return NULL;
+
+	block = (memblock_t *) ((byte *)buf - sizeof(memblock_t));
+	z->stats.allocs++;
+	z->stats.used += block->size;
+	if (z->stats.used > z->stats.peak)
+		z->stats.peak = z->stats.used;
+	if (memprof_active)
+		MemProf_Record (MP_ZONE_ALLOC, z->name, block->size);
+
+	return buf;
+}
+
+/*
+========================
+Z_Free
+========================
+*/
+void Z_Free (void *ptr)
+{
+	zonelist_t	*z;
+	memblock_t	*block;
+
+	if (!ptr)
+		Sys_Error ("%s: NULL pointer", __thisfunc__);
+
+	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+	if (block->tag == 0)
+		Sys_Error ("%s: freed a freed pointer", __thisfunc__);
+
+	z = zonelist;
+	while (z != NULL)
+	{
+		if (z->magic == block->magic)
+			break;
+		z = z->next;
+	}
+	if (z == NULL)
+		Sys_Error ("%s: freed a pointer without ZMAGIC", __thisfunc__);
+
+	z->stats.frees++;
+	z->stats.used -= block->size;
+	if (memprof_active)
+		MemProf_Record (MP_ZONE_FREE, z->name, block->size);
+	if (block->tag == ZTAG_POOLED)
+		Z_PoolFree (z, block);
+	else
+		Z_FreeBlock (z, block);
+}
+
 
 static void *Z_TagMalloc (zonelist_t *z, int size, int tag)
 {
@@ -280,7 +515,7 @@ void *Z_Malloc (int size, int zone_id)
 #if Z_CHECKHEAP
 	Z_CheckHeap (z->zone);	/* DEBUG */
 #endif
-	buf = Z_TagMalloc (z, size, 1);
+	buf = Z_Alloc (z, size);
 	if (!buf)
 		Sys_Error ("%s: failed on allocation of %i bytes", __thisfunc__, size);
 	memset (buf, 0, size);
@@ -316,7 +551,6 @@ void *Z_Realloc (void *ptr, int size, int zone_id)
 	old_size -= (4 + (int)sizeof(memblock_t));	/* see Z_TagMalloc() */
 	old_ptr = ptr;
 
-	Z_Free (ptr);
 	z = zonelist;
 	while (z != NULL)
 	{
@@ -327,14 +561,16 @@ void *Z_Realloc (void *ptr, int size, int zone_id)
 	if (z == NULL)
 		Sys_Error ("%s: Bad zone id %i", __thisfunc__, zone_id);
 
-	ptr = Z_TagMalloc (z, size, 1);
+	ptr = Z_Alloc (z, size);
 	if (!ptr)
 		Sys_Error ("%s: failed on allocation of %i bytes", __thisfunc__, size);
 
-	if (ptr != old_ptr)
-		memmove (ptr, old_ptr, q_min(old_size, size));
+	/* allocate before freeing: Z_PoolMalloc may carve a new slab out
+	 * of the freed block and write block headers over the old data. */
+	memcpy (ptr, old_ptr, q_min(old_size, size));
 	if (old_size < size)
 		memset ((byte *)ptr + old_size, 0, size - old_size);
+	Z_Free (old_ptr);
 
 	return ptr;
 }
@@ -419,6 +655,8 @@ void *Hunk_AllocName (int size, const char *name)
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	q_strlcpy (h->name, name, HUNKNAME_LEN);
+	if (memprof_active)
+		MemProf_Record (MP_HUNK_ALLOC, h->name, size);
 
 	return (void *)(h + 1);
 }
@@ -442,6 +680,8 @@ void Hunk_FreeToLowMark (int mark)
 {
 	if (mark < 0 || mark > hunk_low_used)
 		Sys_Error ("%s: bad mark %i", __thisfunc__, mark);
+	if (memprof_active)
+		MemProf_FreeHunk (MP_HUNK_FREE, hunk_base + mark, hunk_base + hunk_low_used);
 	memset (hunk_base + mark, 0, hunk_low_used - mark);
 	hunk_low_used = mark;
 }
@@ -466,6 +706,9 @@ void Hunk_FreeToHighMark (int mark)
 	}
 	if (mark < 0 || mark > hunk_high_used)
 		Sys_Error ("%s: bad mark %i", __thisfunc__, mark);
+	if (memprof_active)
+		MemProf_FreeHunk (MP_HIGH_FREE, hunk_base + hunk_size - hunk_high_used,
+					hunk_base + hunk_size - mark);
 	memset (hunk_base + hunk_size - hunk_high_used, 0, hunk_high_used - mark);
 	hunk_high_used = mark;
 }
@@ -510,6 +753,8 @@ void *Hunk_HighAllocName (int size, const char *name)
 	h->size = size;
 	h->sentinal = HUNK_SENTINAL;
 	q_strlcpy (h->name, name, HUNKNAME_LEN);
+	if (memprof_active)
+		MemProf_Record (MP_HIGH_ALLOC, h->name, size);
 
 	return (void *)(h + 1);
 }
@@ -571,6 +816,8 @@ typedef struct cache_system_s
 } cache_system_t;
 
 static cache_system_t *Cache_TryAlloc (int size, qboolean nobottom);
+static void Cache_Release (cache_user_t *c);
+static void Cache_Evict (cache_user_t *c);
 
 static cache_system_t	cache_head;
 
@@ -591,13 +838,15 @@ static void Cache_Move ( cache_system_t *c)
 		memcpy (new_cs+1, c+1, c->size - sizeof(cache_system_t));
 		new_cs->user = c->user;
 		memcpy (new_cs->name, c->name, sizeof(new_cs->name));
-		Cache_Free (c->user);
+		if (memprof_active)
+			MemProf_Record (MP_CACHE_MOVE, c->name, c->size);
+		Cache_Release (c->user);
 		new_cs->user->data = (void *)(new_cs + 1);
 	}
 	else
 	{
 	/*	Con_Printf ("cache_move failed\n");*/
-		Cache_Free (c->user);	/* tough luck... */
+		Cache_Evict (c->user);	/* tough luck... */
 	}
 }
 
@@ -643,7 +892,7 @@ static void Cache_FreeHigh (int new_high_hunk)
 		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
 			return;		/* there is space to grow the hunk */
 		if (c == prev)
-			Cache_Free (c->user);	/* didn't move out of the way */
+			Cache_Evict (c->user);	/* didn't move out of the way */
 		else
 		{
 			Cache_Move (c);	/* try to move it */
@@ -791,12 +1040,12 @@ static void Cache_Init (void)
 
 /*
 ==============
-Cache_Free
+Cache_Release
 
 Frees the memory and removes it from the LRU list
 ==============
 */
-void Cache_Free (cache_user_t *c)
+static void Cache_Release (cache_user_t *c)
 {
 	cache_system_t	*cs;
 
@@ -814,6 +1063,42 @@ void Cache_Free (cache_user_t *c)
 	Cache_UnlinkLRU (cs);
 }
 
+/*
+==============
+Cache_Free
+==============
+*/
+void Cache_Free (cache_user_t *c)
+{
+	cache_system_t	*cs;
+
+	if (memprof_active && c->data)
+	{
+		cs = ((cache_system_t *)c->data) - 1;
+		MemProf_Record (MP_CACHE_FREE, cs->name, cs->size);
+	}
+	Cache_Release (c);
+}
+
+/*
+==============
+Cache_Evict
+
+Frees the memory to make room for something else
+==============
+*/
+static void Cache_Evict (cache_user_t *c)
+{
+	cache_system_t	*cs;
+
+	if (memprof_active && c->data)
+	{
+		cs = ((cache_system_t *)c->data) - 1;
+		MemProf_Record (MP_CACHE_EVICT, cs->name, cs->size);
+	}
+	Cache_Release (c);
+}
+
 
 /*
 ==============
@@ -863,13 +1148,15 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 			q_strlcpy (cs->name, name, CACHENAME_LEN);
 			c->data = (void *)(cs + 1);
 			cs->user = c;
+			if (memprof_active)
+				MemProf_Record (MP_CACHE_ALLOC, cs->name, cs->size);
 			break;
 		}
 
 	/* free the least recently used cahedat */
 		if (cache_head.lru_prev == &cache_head)	/* not enough memory at all */
 			Sys_Error ("%s: out of memory", __thisfunc__);
-		Cache_Free ( cache_head.lru_prev->user );
+		Cache_Evict ( cache_head.lru_prev->user );
 	}
 
 	return Cache_Check (c);
@@ -877,6 +1164,493 @@ void *Cache_Alloc (cache_user_t *c, int size, const char *name)
 #endif	/* ! SERVERONLY */
 
 
+/*
+==============================================================================
+
+		MEMORY PROFILER
+
+When started with the memprof command or with -memprof on the command
+line, every hunk, zone and cache allocation and free is recorded with its
+tag, size and time.  The hunk tags are the names given to Hunk_AllocName,
+the cache tags the names given to Cache_Alloc, and the zone allocations
+are tagged with the name of their zone.  For each tag it keeps the bytes
+in use, the peak of the current map and of the whole run, and for the
+cache the evictions, moves and reloads of evicted data.  Memory_NewMap
+starts a new map.  "memprof save" writes all of it with the timeline of
+the events to memprof.txt in the user directory.
+
+The recorder uses malloc only, so it never shows up in what it records.
+==============================================================================
+*/
+
+#define	MP_AREA_HUNK	0	/* low hunk */
+#define	MP_AREA_HIGH	1	/* high hunk */
+#define	MP_AREA_ZONE	2
+#define	MP_AREA_CACHE	3
+#define	MP_AREAS	4
+
+#define	MEMPROF_MAXTAGS		1024
+#define	MEMPROF_HASHSIZE	2048	/* power of two, > MEMPROF_MAXTAGS */
+#define	MEMPROF_MAXEVENTS	(1 << 20)
+#define	MEMPROF_NAMELEN		32
+
+static const char *memprof_kinds[] =
+{
+	"alloc", "free", "alloc", "free", "alloc", "free",
+	"alloc", "free", "evict", "move", "newmap"
+};
+static const int memprof_areas[] =
+{
+	MP_AREA_HUNK, MP_AREA_HUNK, MP_AREA_HIGH, MP_AREA_HIGH, MP_AREA_ZONE, MP_AREA_ZONE,
+	MP_AREA_CACHE, MP_AREA_CACHE, MP_AREA_CACHE, MP_AREA_CACHE, MP_AREA_HUNK
+};
+static const char *memprof_areanames[MP_AREAS] =
+{
+	"hunk", "high", "zone", "cache"
+};
+
+typedef struct
+{
+	double		time;
+	int		size;
+	short		tag;		/* the map for MP_NEWMAP */
+	byte		kind;
+	byte		pad;
+	int		low, high;	/* the hunk marks after it */
+} memevent_t;
+
+typedef struct
+{
+	char		name[MEMPROF_NAMELEN];
+	int		area;
+	int		used;		/* bytes */
+	int		peak, maxpeak;	/* of the current map, of the run */
+	int		allocs, frees;
+	int		evicts, moves, reloads;
+	qboolean	evicted;	/* the next alloc is a reload */
+} memtag_t;
+
+typedef struct
+{
+	short		tag;
+	int		peak;
+} mempeak_t;
+
+typedef struct
+{
+	char		name[MAX_QPATH];
+	double		time;
+	int		peak[MP_AREAS];
+	int		hunkpeak;	/* low and high together */
+	int		evicts, moves;
+	mempeak_t	*peaks;		/* of the tags, once the map is done */
+	int		numpeaks;
+} memmap_t;
+
+static struct
+{
+	double		start;
+	memtag_t	*tags;
+	int		numtags;
+	short		hash[MEMPROF_HASHSIZE];	/* tag + 1, 0 if free */
+	memevent_t	*events;
+	int		numevents, maxevents;
+	memmap_t	*maps;
+	int		nummaps, maxmaps;
+	int		used[MP_AREAS];
+} memprof;
+
+static int MemProf_Tag (int area, const char *name)
+{
+	unsigned int	h = 2166136261u ^ (unsigned int) area;
+	const char	*p;
+	memtag_t	*t;
+	int		i;
+
+	for (p = name; *p && p - name < MEMPROF_NAMELEN - 1; p++)
+		h = (h ^ (byte)*p) * 16777619u;
+	for (i = h & (MEMPROF_HASHSIZE - 1); memprof.hash[i]; i = (i + 1) & (MEMPROF_HASHSIZE - 1))
+	{
+		t = &memprof.tags[memprof.hash[i] - 1];
+		if (t->area == area && !strncmp(t->name, name, MEMPROF_NAMELEN - 1))
+			return memprof.hash[i] - 1;
+	}
+	/* the last tags are left for an "(other)" of each area */
+	if (memprof.numtags >= MEMPROF_MAXTAGS - MP_AREAS && strcmp(name, "(other)"))
+		return MemProf_Tag (area, "(other)");
+	t = &memprof.tags[memprof.numtags];
+	memset (t, 0, sizeof(*t));
+	q_strlcpy (t->name, name, MEMPROF_NAMELEN);
+	t->area = area;
+	memprof.hash[i] = ++memprof.numtags;
+	return memprof.numtags - 1;
+}
+
+static memmap_t *MemProf_CurrentMap (void)
+{
+	return &memprof.maps[memprof.nummaps - 1];
+}
+
+static void MemProf_AddEvent (int kind, int tag, int size)
+{
+	memevent_t	*e;
+	void		*p;
+	int		max;
+
+	if (memprof.numevents == memprof.maxevents)
+	{
+		if (memprof.maxevents == MEMPROF_MAXEVENTS)
+			return;		/* the counters go on */
+		max = memprof.maxevents ? memprof.maxevents * 2 : 4096;
+		p = realloc (memprof.events, max * sizeof(memevent_t));
+		if (!p)
+		{
+			memprof.maxevents = MEMPROF_MAXEVENTS;
+			return;
+		}
+		memprof.events = (memevent_t *) p;
+		memprof.maxevents = max;
+	}
+	e = &memprof.events[memprof.numevents++];
+	e->time = Sys_DoubleTime () - memprof.start;
+	e->size = size;
+	e->tag = (short) tag;
+	e->kind = (byte) kind;
+	e->pad = 0;
+	e->low = hunk_low_used;
+	e->high = hunk_high_used;
+}
+
+static void MemProf_Record (int kind, const char *name, int size)
+{
+	memtag_t	*t;
+	memmap_t	*map;
+	int		tag, area = memprof_areas[kind];
+
+	tag = MemProf_Tag (area, name);
+	t = &memprof.tags[tag];
+	map = MemProf_CurrentMap ();
+	switch (kind)
+	{
+	case MP_HUNK_ALLOC:
+	case MP_HIGH_ALLOC:
+	case MP_ZONE_ALLOC:
+	case MP_CACHE_ALLOC:
+		t->allocs++;
+		t->used += size;
+		if (t->used > t->peak)
+			t->peak = t->used;
+		if (t->peak > t->maxpeak)
+			t->maxpeak = t->peak;
+		if (t->evicted)
+		{
+			t->reloads++;
+			t->evicted = false;
+		}
+		memprof.used[area] += size;
+		if (memprof.used[area] > map->peak[area])
+			map->peak[area] = memprof.used[area];
+		if (hunk_low_used + hunk_high_used > map->hunkpeak)
+			map->hunkpeak = hunk_low_used + hunk_high_used;
+		break;
+	case MP_CACHE_EVICT:
+		t->evicts++;
+		t->evicted = true;
+		map->evicts++;
+		/* fall through */
+	case MP_HUNK_FREE:
+	case MP_HIGH_FREE:
+	case MP_ZONE_FREE:
+	case MP_CACHE_FREE:
+		t->frees++;
+		t->used -= size;
+		memprof.used[area] -= size;
+		break;
+	case MP_CACHE_MOVE:
+		t->moves++;
+		map->moves++;
+		break;
+	}
+	MemProf_AddEvent (kind, tag, size);
+}
+
+/* records the frees of the hunk blocks between start and end */
+static void MemProf_FreeHunk (int kind, byte *start, byte *end)
+{
+	hunk_t	*h;
+
+	for (h = (hunk_t *)start; (byte *)h < end; h = (hunk_t *)((byte *)h + h->size))
+	{
+		if (h->sentinal != HUNK_SENTINAL || h->size < (int)sizeof(hunk_t))
+			break;	/* Hunk_Check will tell */
+		MemProf_Record (kind, h->name, h->size);
+	}
+}
+
+/* keeps the peaks of the tags for the map that is done */
+static void MemProf_EndMap (void)
+{
+	memmap_t	*map = MemProf_CurrentMap ();
+	int		i;
+
+	map->peaks = (mempeak_t *) malloc (memprof.numtags * sizeof(mempeak_t) + 1);
+	map->numpeaks = 0;
+	for (i = 0; map->peaks && i < memprof.numtags; i++)
+	{
+		if (!memprof.tags[i].peak)
+			continue;
+		map->peaks[map->numpeaks].tag = (short) i;
+		map->peaks[map->numpeaks].peak = memprof.tags[i].peak;
+		map->numpeaks++;
+	}
+}
+
+static void MemProf_BeginMap (const char *name)
+{
+	memmap_t	*map;
+	void		*p;
+	int		i;
+
+	if (memprof.nummaps == memprof.maxmaps)
+	{
+		i = memprof.maxmaps ? memprof.maxmaps * 2 : 16;
+		p = realloc (memprof.maps, i * sizeof(memmap_t));
+		if (!p)
+			return;		/* stays with the current map */
+		memprof.maps = (memmap_t *) p;
+		memprof.maxmaps = i;
+	}
+	map = &memprof.maps[memprof.nummaps++];
+	memset (map, 0, sizeof(*map));
+	q_strlcpy (map->name, name, sizeof(map->name));
+	map->time = Sys_DoubleTime () - memprof.start;
+	for (i = 0; i < MP_AREAS; i++)
+		map->peak[i] = memprof.used[i];
+	map->hunkpeak = hunk_low_used + hunk_high_used;
+	for (i = 0; i < memprof.numtags; i++)
+		memprof.tags[i].peak = memprof.tags[i].used;
+	MemProf_AddEvent (MP_NEWMAP, memprof.nummaps - 1, 0);
+}
+
+/*
+========================
+Memory_NewMap
+
+Called once the memory of the previous map is freed.
+========================
+*/
+void Memory_NewMap (const char *name)
+{
+	if (!memprof_active)
+		return;
+	MemProf_EndMap ();
+	MemProf_BeginMap (name);
+}
+
+static void MemProf_Seed (int kind, const char *name, int size)
+{
+	memtag_t	*t;
+	int		area = memprof_areas[kind];
+
+	t = &memprof.tags[MemProf_Tag (area, name)];
+	t->used += size;
+	t->peak = t->maxpeak = t->used;
+	memprof.used[area] += size;
+}
+
+static void MemProf_Reset (void)
+{
+	int		i;
+
+	memprof_active = false;
+	free (memprof.tags);
+	free (memprof.events);
+	for (i = 0; i < memprof.nummaps; i++)
+		free (memprof.maps[i].peaks);
+	free (memprof.maps);
+	memset (&memprof, 0, sizeof(memprof));
+}
+
+static void MemProf_Start (void)
+{
+	hunk_t		*h;
+	zonelist_t	*z;
+#if !defined(SERVERONLY)
+	cache_system_t	*cs;
+#endif
+
+	MemProf_Reset ();
+	memprof.tags = (memtag_t *) calloc (MEMPROF_MAXTAGS, sizeof(memtag_t));
+	if (!memprof.tags)
+	{
+		Con_Printf ("memprof: couldn't allocate the tags\n");
+		return;
+	}
+	memprof.start = Sys_DoubleTime ();
+	MemProf_BeginMap ("(start)");
+	if (!memprof.nummaps)
+	{
+		MemProf_Reset ();
+		return;
+	}
+
+/* what is already there */
+	for (h = (hunk_t *)hunk_base; (byte *)h < hunk_base + hunk_low_used; h = (hunk_t *)((byte *)h + h->size))
+		MemProf_Seed (MP_HUNK_ALLOC, h->name, h->size);
+	for (h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used); (byte *)h < hunk_base + hunk_size;
+					h = (hunk_t *)((byte *)h + h->size))
+		MemProf_Seed (MP_HIGH_ALLOC, h->name, h->size);
+	for (z = zonelist; z; z = z->next)
+		MemProf_Seed (MP_ZONE_ALLOC, z->name, z->stats.used);
+#if !defined(SERVERONLY)
+	for (cs = cache_head.next; cs && cs != &cache_head; cs = cs->next)
+		MemProf_Seed (MP_CACHE_ALLOC, cs->name, cs->size);
+#endif
+	memcpy (MemProf_CurrentMap()->peak, memprof.used, sizeof(memprof.used));
+	memprof_active = true;
+}
+
+static int MemProf_ComparePeaks (const void *a, const void *b)
+{
+	const memtag_t	*ta = &memprof.tags[*(const short *)a];
+	const memtag_t	*tb = &memprof.tags[*(const short *)b];
+
+	return tb->maxpeak - ta->maxpeak;
+}
+
+static void MemProf_Report (int count)
+{
+	memmap_t	*map;
+	memtag_t	*t;
+	short		*order;
+	int		i;
+
+	Con_Printf ("%d tags, %d events%s in %.1f s\n", memprof.numtags, memprof.numevents,
+			(memprof.numevents == MEMPROF_MAXEVENTS) ? " (full)" : "",
+			Sys_DoubleTime () - memprof.start);
+	Con_Printf ("map              hunk peak  zone peak cache peak evicts  moves\n");
+	for (i = 0; i < memprof.nummaps; i++)
+	{
+		map = &memprof.maps[i];
+		Con_Printf ("%-16.16s %9i %10i %10i %6i %6i\n", map->name, map->hunkpeak,
+				map->peak[MP_AREA_ZONE], map->peak[MP_AREA_CACHE], map->evicts, map->moves);
+	}
+
+	order = (short *) malloc (memprof.numtags * sizeof(short) + 1);
+	if (!order)
+		return;
+	for (i = 0; i < memprof.numtags; i++)
+		order[i] = (short) i;
+	qsort (order, memprof.numtags, sizeof(short), MemProf_ComparePeaks);
+	Con_Printf ("area  tag                     in use  map peak  run peak  allocs  evicts reloads\n");
+	for (i = 0; i < memprof.numtags && i < count; i++)
+	{
+		t = &memprof.tags[order[i]];
+		if (!t->maxpeak)
+			break;
+		Con_Printf ("%-5s %-20.20s %9i %9i %9i %7i %7i %7i\n", memprof_areanames[t->area],
+				t->name, t->used, t->peak, t->maxpeak, t->allocs, t->evicts, t->reloads);
+	}
+	free (order);
+}
+
+static void MemProf_Save (const char *name)
+{
+	memevent_t	*e;
+	memmap_t	*map;
+	memtag_t	*t;
+	FILE		*f;
+	int		i, j;
+
+	f = fopen (FS_MakePath(FS_USERDIR, NULL, name), "w");
+	if (!f)
+	{
+		Con_Printf ("memprof: couldn't write %s\n", name);
+		return;
+	}
+	fprintf (f, "# map <index> <name> <start time> <hunk peak> <low hunk peak> <high hunk peak> <zone peak> <cache peak> <evicts> <moves>\n");
+	for (i = 0; i < memprof.nummaps; i++)
+	{
+		map = &memprof.maps[i];
+		fprintf (f, "map %d %s %.6f %d %d %d %d %d %d %d\n", i, map->name, map->time,
+				map->hunkpeak, map->peak[MP_AREA_HUNK], map->peak[MP_AREA_HIGH],
+				map->peak[MP_AREA_ZONE], map->peak[MP_AREA_CACHE], map->evicts, map->moves);
+	}
+	fprintf (f, "# peak <map index> <area> <tag> <bytes>\n");
+	for (i = 0; i < memprof.nummaps; i++)
+	{
+		map = &memprof.maps[i];
+		if (i == memprof.nummaps - 1)
+		{	/* still going */
+			for (j = 0; j < memprof.numtags; j++)
+			{
+				t = &memprof.tags[j];
+				if (t->peak)
+					fprintf (f, "peak %d %s \"%s\" %d\n", i, memprof_areanames[t->area], t->name, t->peak);
+			}
+			break;
+		}
+		for (j = 0; j < map->numpeaks; j++)
+		{
+			t = &memprof.tags[map->peaks[j].tag];
+			fprintf (f, "peak %d %s \"%s\" %d\n", i, memprof_areanames[t->area], t->name, map->peaks[j].peak);
+		}
+	}
+	fprintf (f, "# tag <area> <tag> <in use> <run peak> <allocs> <frees> <evicts> <moves> <reloads>\n");
+	for (i = 0; i < memprof.numtags; i++)
+	{
+		t = &memprof.tags[i];
+		if (!t->maxpeak && !t->allocs)
+			continue;
+		fprintf (f, "tag %s \"%s\" %d %d %d %d %d %d %d\n", memprof_areanames[t->area], t->name,
+				t->used, t->maxpeak, t->allocs, t->frees, t->evicts, t->moves, t->reloads);
+	}
+	fprintf (f, "# event <time> <kind> <area> <tag> <bytes> <low hunk> <high hunk>\n");
+	for (i = 0, e = memprof.events; i < memprof.numevents; i++, e++)
+	{
+		if (e->kind == MP_NEWMAP)
+		{
+			fprintf (f, "event %.6f newmap - \"%s\" 0 %d %d\n", e->time,
+					memprof.maps[e->tag].name, e->low, e->high);
+			continue;
+		}
+		t = &memprof.tags[e->tag];
+		fprintf (f, "event %.6f %s %s \"%s\" %d %d %d\n", e->time, memprof_kinds[e->kind],
+				memprof_areanames[t->area], t->name, e->size, e->low, e->high);
+	}
+	fclose (f);
+	Con_Printf ("Wrote %d events to %s\n", memprof.numevents, name);
+}
+
+static void MemProf_f (void)
+{
+	const char	*cmd = (Cmd_Argc() > 1) ? Cmd_Argv(1) : "";
+
+	if (!q_strcasecmp(cmd, "start"))
+	{
+		MemProf_Start ();
+		if (memprof_active)
+			Con_Printf ("memprof: recording\n");
+		return;
+	}
+	if (!memprof.tags)
+	{
+		Con_Printf ("usage: memprof start | stop | save [file] | [count]\n"
+			    "nothing recorded, start with memprof start or -memprof\n");
+		return;
+	}
+	if (!q_strcasecmp(cmd, "stop"))
+	{	/* what was recorded stays for report and save */
+		memprof_active = false;
+		Con_Printf ("memprof: stopped\n");
+	}
+	else if (!q_strcasecmp(cmd, "save"))
+		MemProf_Save ((Cmd_Argc() > 2) ? Cmd_Argv(2) : "memprof.txt");
+	else
+		MemProf_Report (cmd[0] ? atoi(cmd) : 20);
+}
+
+
 /*
 ==============================================================================
 
@@ -1147,6 +1921,139 @@ static void Zone_Display_f(void)
 	}
 }
 
+/*
+========================
+Z_Stats
+========================
+*/
+static void Z_Stats (zonelist_t *z, FILE *f)
+{
+	memblock_t	*block;
+	zoneslab_t	*slab;
+	int		c, freebytes, freeblocks, largest, poolfree, slabs;
+	double		now;
+
+	freebytes = freeblocks = largest = 0;
+	for (block = z->zone->blocklist.next; block != &z->zone->blocklist; block = block->next)
+	{
+		if (block->tag)
+			continue;
+		freebytes += block->size;
+		freeblocks++;
+		if (block->size > largest)
+			largest = block->size;
+	}
+	poolfree = slabs = 0;
+	for (c = 0; c < ZPOOL_CLASSES; c++)
+	{
+		for (block = z->pools[c].free; block; block = block->next)
+			poolfree += block->size;
+		for (slab = z->pools[c].slabs; slab; slab = slab->next)
+			slabs++;
+	}
+
+	now = Sys_DoubleTime ();
+	MEM_Printf (f, "%s: %i allocs (%i pooled), %i frees", z->name,
+			z->stats.allocs, z->stats.pooled, z->stats.frees);
+	if (z->stats.lasttime && now > z->stats.lasttime)
+	{
+		MEM_Printf (f, ", %.0f allocs/sec",
+			(z->stats.allocs - z->stats.lastallocs) / (now - z->stats.lasttime));
+	}
+	MEM_Printf (f, "\n");
+	z->stats.lastallocs = z->stats.allocs;
+	z->stats.lasttime = now;
+
+	MEM_Printf (f, "  %i used, %i peak, %i size\n",
+			z->stats.used, z->stats.peak, z->zone->size);
+	MEM_Printf (f, "  %i free in %i blocks, largest %i, %.1f%% fragmented\n",
+			freebytes, freeblocks, largest,
+			freebytes ? 100.0 * (freebytes - largest) / freebytes : 0.0);
+	MEM_Printf (f, "  %i slabs, %i bytes free in size classes\n", slabs, poolfree);
+}
+
+/*
+========================
+Zone_Test_f
+
+Runs a mix of small and large allocations and frees against the main
+zone, first without the size classes and then with them.
+========================
+*/
+#define	ZTEST_LIVE	256
+
+/* own generator, so both passes get the same mix without reseeding
+ * the rand() the game itself uses. */
+static int Zone_TestRand (unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7fff;
+}
+
+static void Zone_Test_f (void)
+{
+	zonelist_t	*z;
+	void		*live[ZTEST_LIVE];
+	int		i, j, pass, ops, fails, size;
+	unsigned int	seed;
+	double		start, time;
+	qboolean	pools;
+
+	ops = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : 100000;
+	if (ops < 1)
+		ops = 1;
+
+	for (z = zonelist; z != NULL; z = z->next)
+	{
+		if (z->id & Z_MAINZONE)
+			break;
+	}
+	if (z == NULL)
+		return;
+
+	pools = zone_pools;
+	for (pass = 0; pass < 2; pass++)
+	{
+		zone_pools = (pass == 1);
+		memset (live, 0, sizeof(live));
+		seed = 1;
+		fails = 0;
+
+		start = Sys_DoubleTime ();
+		for (i = 0; i < ops; i++)
+		{
+			j = Zone_TestRand(&seed) % ZTEST_LIVE;
+			if (live[j])
+			{
+				Z_Free (live[j]);
+				live[j] = NULL;
+				continue;
+			}
+			if (Zone_TestRand(&seed) & 7)
+				size = 8 + Zone_TestRand(&seed) % 200;	/* strings, small structs */
+			else
+				size = 256 + Zone_TestRand(&seed) % 4096;
+			live[j] = Z_Alloc (z, size);
+			if (!live[j])
+				fails++;
+		}
+		time = Sys_DoubleTime () - start;
+
+		Con_Printf ("%s: %i ops, %.0f ns/op, %i failed\n",
+				zone_pools ? "size classes" : "zone only",
+				ops, time * 1.0e9 / ops, fails);
+		Z_Stats (z, NULL);
+
+		for (j = 0; j < ZTEST_LIVE; j++)
+		{
+			if (live[j])
+				Z_Free (live[j]);
+		}
+		Z_ReleaseSlabs (z);
+	}
+	zone_pools = pools;
+}
+
 #define NUM_GROUPS 18
 static const char *MemoryGroups[NUM_GROUPS+1] =
 {
@@ -1178,6 +2085,7 @@ static void Memory_Stats_f(void)
 	int	GroupCount[NUM_GROUPS+1], GroupSum[NUM_GROUPS+1];
 	FILE	*FH;
 	qboolean write_file;
+	zonelist_t	*z;
 
 	write_file = false;
 
@@ -1243,6 +2151,10 @@ static void Memory_Stats_f(void)
 	}
 	MEM_Printf(FH,"--------------- ----- --------\n");
 	MEM_Printf(FH,"%-15s %-5i %i\n","Total",count,sum);
+
+	MEM_Printf(FH,"\n");
+	for (z = zonelist; z != NULL; z = z->next)
+		Z_Stats (z, FH);
 	if (FH)
 	{
 		fclose(FH);
@@ -1269,6 +2181,7 @@ static void Memory_InitZone (const char *name, int id, int magic, int size)
 	z->magic = magic;
 	z->name = name;
 	z->zone = (memzone_t *) Hunk_AllocName (size, name);
+	z->zone->size = size;
 
 /* set the entire zone to one free block */
 	z->zone->blocklist.next = z->zone->blocklist.prev = block =
@@ -1323,10 +2236,14 @@ void Memory_Init (void *buf, int size)
 #if !defined(SERVERONLY)
 	Cmd_AddCommand ("flush", Cache_Flush);
 #endif	/* SERVERONLY */
+	Cmd_AddCommand ("memprof", MemProf_f);
+	if (COM_CheckParm ("-memprof"))
+		MemProf_Start ();
 #if Z_DEBUG_COMMANDS
 	Cmd_AddCommand ("sys_memory", Memory_Display_f);
 	Cmd_AddCommand ("sys_zone", Zone_Display_f);
 	Cmd_AddCommand ("sys_stats", Memory_Stats_f);
+	Cmd_AddCommand ("sys_zonetest", Zone_Test_f);
 #if !defined(SERVERONLY)
 	Cmd_AddCommand ("sys_cache", Cache_Display_f);
 #endif	/* SERVERONLY */
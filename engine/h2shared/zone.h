@@ -87,6 +87,8 @@ Zone block
 
 
 void Memory_Init (void *buf, int size);
+void Memory_NewMap (const char *name);
+/* tells the memory profiler (memprof) that a new map starts */
 
 
 /* valid values zone_idx arg: */
@@ -475,6 +475,7 @@ COMMONOBJS = &
 	debuglog.obj &
 	quakefs.obj &
 	crc.obj &
+	lzpak.obj &
 	cvar.obj &
 	cfgfile.obj &
 	host.obj &
@@ -493,6 +494,7 @@ COMMONOBJS = &
 	world.obj &
 	zone.obj &
 	hashindex.obj &
+	threads.obj &
 	$(SYSOBJ_SYS)
 
 all: $(BUILD_TARGET)
@@ -251,6 +251,7 @@ static void CL_ParseServerInfo (void)
 	const char	*str;
 	int		i, j;
 	int		nummodels, numsounds, numfx, numitems;
+	double	t1, t2, t3;
 	char	model_precache[MAX_MODELS][MAX_QPATH];
 	char	sound_precache[MAX_SOUNDS][MAX_QPATH];
 
@@ -452,6 +453,8 @@ static void CL_ParseServerInfo (void)
 
 	// copy the naked name of the map file to the cl structure
 	COM_FileBase (model_precache[1], cl.mapname, sizeof(cl.mapname));
+	if (!sv.active)	// else SV_SpawnServer did it
+		Memory_NewMap (cl.mapname);
 
 	//always precache the world!!!
 	if (developer.integer >= 2)
@@ -470,6 +473,20 @@ static void CL_ParseServerInfo (void)
 		Con_Printf("ERROR: World model name is empty! Cannot load map.\n");
 		return;
 	}
+
+	// have the workers read ahead what is about to be loaded
+	t1 = Sys_DoubleTime ();
+	FS_PrefetchBegin ();
+	Mod_Prefetch (model_precache[1]);
+	for (i = 2; precache.integer && i < nummodels; i++)
+	{
+		if (model_precache[i][0])
+			Mod_Prefetch (model_precache[i]);
+	}
+	for (i = 1; i < numsounds; i++)
+		S_PrefetchSound (sound_precache[i]);
+	FS_PrefetchStart ();
+
 	cl.model_precache[1] = Mod_ForName (model_precache[1], false);
 	for (i = 2; i < nummodels; i++)
 	{
@@ -539,7 +556,7 @@ static void CL_ParseServerInfo (void)
 			{
 				cl.num_ex_items += 1;
 				cl.ex_items[i].id = (int)(i + 1);
-				q_strlcpy(cl.ex_items[i].icon, va("gfx/arti%02d.lmp", i), MAX_QPATH);
+				q_snprintf(cl.ex_items[i].icon, MAX_QPATH, "gfx/arti%02d.lmp", i);
 			}
 		}
 		//shan check with no ex_items received?
@@ -573,6 +590,7 @@ static void CL_ParseServerInfo (void)
 		}
 	}
 
+	t2 = Sys_DoubleTime ();
 	S_BeginPrecaching ();
 	for (i = 1; i < numsounds; i++)
 	{
@@ -586,6 +604,10 @@ static void CL_ParseServerInfo (void)
 		CL_KeepaliveMessage ();
 	}
 	S_EndPrecaching ();
+	t3 = Sys_DoubleTime ();
+	FS_PrefetchEnd ();
+	Con_DPrintf ("%s: models loaded in %.1f ms, sounds in %.1f ms\n", cl.mapname,
+				(t2 - t1) * 1000.0, (t3 - t2) * 1000.0);
 
 	total_loading_size = 0;
 	loading_stage = 0;
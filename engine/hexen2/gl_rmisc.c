@@ -423,6 +423,7 @@ void R_NewMap (void)
 	R_ClearParticles ();
 
 	GL_BuildLightmaps ();
+	Mod_WriteBrushCache (cl.worldmodel);
 
 	// identify sky texture
 	skytexturenum = -1;
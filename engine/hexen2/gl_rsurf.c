@@ -1581,7 +1581,9 @@ void GL_BuildLightmaps (void)
 			if (m->surfaces[i].flags & SURF_DRAWSKY)
 				continue;
 #endif
-			if (!draw_reinit)
+			// the polygons of a world model read from the bsp
+			// cache are already built
+			if (!draw_reinit && !m->surfaces[i].polys)
 				BuildSurfaceDisplayList (m->surfaces + i);
 		}
 	}
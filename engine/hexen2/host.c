@@ -27,6 +27,7 @@
 #include "debuglog.h"
 #include "bgmusic.h"
 #include "cdaudio.h"
+#include "threads.h"
 #include <setjmp.h>
 
 /*
@@ -60,6 +61,21 @@ client_t	*host_client;			// current client
 byte		*host_basepal;
 byte		*host_colormap;
 
+// startup trace: Host_Init notes when each of its steps is done, and the
+// first frame on the screen ends it.  -inittrace prints the steps as they
+// are done, the "inittrace" command prints them afterwards.
+#define	MAX_INITSTEPS	32
+static struct
+{
+	const char	*name;
+	double		time;
+} host_initsteps[MAX_INITSTEPS];
+static int	host_numinitsteps;
+static double	host_inittime;			// when Host_Init started
+static double	host_firstframe;		// when the first frame was drawn
+static qboolean	host_inittrace;			// -inittrace
+static qboolean	host_serialinit;		// -serialinit, or no worker threads
+
 cvar_t		sys_ticrate = {"sys_ticrate", "0.05", CVAR_NONE};
 static	cvar_t	sys_adaptive = {"sys_adaptive", "1", CVAR_ARCHIVE};
 static	cvar_t	host_framerate = {"host_framerate", "0", CVAR_NONE};	// set for slow motion
@@ -227,6 +243,7 @@ void Host_Error (const char *error, ...)
 	q_vsnprintf (string, sizeof(string), error, argptr);
 	va_end (argptr);
 	Con_Printf ("%s: %s\n", __thisfunc__, string);
+	pr_holdstrings = false;	// in case a save game was being parsed
 
 	if (sv.active)
 		Host_ShutdownServer (false);
@@ -337,6 +354,89 @@ static void Host_Version_f (void)
 	Con_Printf ("Exe: " __TIME__ " " __DATE__ "\n");
 }
 
+/*
+===============
+Host_InitStep
+
+Notes that a step of Host_Init is done.
+===============
+*/
+static void Host_InitStep (const char *name)
+{
+	double	now, last;
+
+	if (host_numinitsteps == MAX_INITSTEPS)
+		return;
+	now = Sys_DoubleTime ();
+	last = (host_numinitsteps) ? host_initsteps[host_numinitsteps - 1].time : host_inittime;
+	host_initsteps[host_numinitsteps].name = name;
+	host_initsteps[host_numinitsteps].time = now;
+	host_numinitsteps++;
+
+	if (host_inittrace)
+	{
+		Sys_Printf ("init: %-12s %8.1f ms %8.1f ms\n", name,
+				(now - last) * 1000.0, (now - host_inittime) * 1000.0);
+	}
+}
+
+static void Host_InitTrace_f (void)
+{
+	double	last;
+	int	i;
+
+	if (host_serialinit)
+		Con_Printf ("serial startup\n");
+	else	Con_Printf ("parallel startup, %d worker threads\n", Jobs_NumWorkers());
+	Con_Printf ("step              took    done at\n");
+	last = host_inittime;
+	for (i = 0; i < host_numinitsteps; i++)
+	{
+		Con_Printf ("%-12s %8.1f ms %8.1f ms\n", host_initsteps[i].name,
+				(host_initsteps[i].time - last) * 1000.0,
+				(host_initsteps[i].time - host_inittime) * 1000.0);
+		last = host_initsteps[i].time;
+	}
+	if (host_firstframe)
+	{
+		Con_Printf ("first frame drawn %.1f ms after startup\n",
+				(host_firstframe - host_inittime) * 1000.0);
+	}
+}
+
+/*
+===============
+Host_PrefetchStartup
+
+Has the workers read the files Host_Init loads later on while the main
+thread initializes the network, the video mode and the sound devices.
+===============
+*/
+static void Host_PrefetchStartup (void)
+{
+	static const char	*startup_files[] =
+	{
+		"gfx.wad",
+		"gfx/palette.lmp",
+		"gfx/colormap.lmp",
+		"gfx/menu/conchars.lmp",
+		"gfx/menu/bigfont2.lmp",
+		"gfx/menu/conback.lmp",
+		"gfx/menu/backtile.lmp",
+		"hexen.rc",
+		"default.cfg",
+		"config.cfg",
+		"autoexec.cfg",
+		NULL
+	};
+	int	i;
+
+	FS_PrefetchBegin ();
+	for (i = 0; startup_files[i]; i++)
+		FS_Prefetch (startup_files[i], NULL);
+	FS_PrefetchStart ();
+}
+
 /* cvar callback functions : */
 void Host_Callback_Notify (cvar_t *var)
 {
@@ -353,6 +453,7 @@ static void Host_InitLocal (void)
 {
 	Cmd_AddCommand ("saveconfig", Host_SaveConfig_f);
 	Cmd_AddCommand ("version", Host_Version_f);
+	Cmd_AddCommand ("inittrace", Host_InitTrace_f);
 
 	Host_InitCommands ();
 
@@ -924,6 +1025,17 @@ static void _Host_Frame (float time)
 
 	SCR_UpdateScreen ();
 
+	if (!host_firstframe && !block_drawing && !scr_disabled_for_loading &&
+	    cls.state != ca_dedicated)
+	{
+		host_firstframe = Sys_DoubleTime ();
+		if (host_inittrace)
+		{
+			Con_Printf ("first frame drawn %.1f ms after startup\n",
+					(host_firstframe - host_inittime) * 1000.0);
+		}
+	}
+
 	if (host_speeds.integer)
 		time2 = Sys_DoubleTime ();
 
@@ -999,33 +1111,48 @@ void Host_Init (void)
 {
 	Sys_Printf ("Host_Init\n");
 
+	host_inittime = Sys_DoubleTime ();
+	host_inittrace = (COM_CheckParm ("-inittrace") != 0);
+
 	Memory_Init (host_parms->membase, host_parms->memsize);
 	Cbuf_Init ();
 	Cmd_Init ();
 	COM_Init ();
 	SV_Init ();
+	Host_InitStep ("memory");
 	FS_Init ();
+	Host_InitStep ("filesystem");
+	host_serialinit = (COM_CheckParm ("-serialinit") || Jobs_NumWorkers () <= 0);
 	CL_Cmd_Init ();
 	Host_RemoveGIPFiles(NULL);
 	CFG_OpenConfig ("config.cfg");
 	Host_InitLocal ();
+// the files the client loads below are read on the worker threads
+// in the meantime, unless -serialinit
+	if (cls.state != ca_dedicated && !host_serialinit)
+		Host_PrefetchStartup ();
 	PR_Init ();
 	Mod_Init ();
+	Host_InitStep ("host");
 	NET_Init ();
+	Host_InitStep ("network");
 
 	Con_Printf ("Exe: " __TIME__ " " __DATE__ "\n");
 	Con_Printf ("%4.1f megabyte heap\n", host_parms->memsize/(1024*1024.0));
 
 	R_InitTextures ();		// needed even for dedicated servers
+	Host_InitStep ("textures");
 
 	if (cls.state != ca_dedicated)	// decided in Host_InitLocal() by calling Host_FindMaxClients()
 	{
 		V_Init ();
 		Chase_Init ();
 		W_LoadWadFile ("gfx.wad");
+		Host_InitStep ("wad");
 		Key_Init ();
 		Con_Init ();
 		M_Init ();
+		Host_InitStep ("console");
 
 		host_basepal = (byte *)FS_LoadHunkFile ("gfx/palette.lmp", NULL);
 		if (!host_basepal)
@@ -1034,20 +1161,27 @@ void Host_Init (void)
 		host_colormap = (byte *)FS_LoadHunkFile ("gfx/colormap.lmp", NULL);
 		if (!host_colormap)
 			Sys_Error ("Couldn't load gfx/colormap.lmp");
+		Host_InitStep ("palette");
 
 		VID_Init (host_basepal);
+		Host_InitStep ("video");
 		Draw_Init ();
 		SCR_Init ();
 		R_Init ();
 		Sbar_Init();
+		Host_InitStep ("renderer");
 
 		S_Init ();
+		Host_InitStep ("sound");
 		CDAudio_Init();
+		Host_InitStep ("cdaudio");
 		MIDI_Init();
 		BGM_Init();
+		Host_InitStep ("music");
 
 		CL_Init();
 		IN_Init();
+		Host_InitStep ("input");
 	}
 
 	CFG_CloseConfig();
@@ -1078,6 +1212,8 @@ void Host_Init (void)
 		Cbuf_InsertText ("exec hexen.rc\n");
 		if (!setjmp(host_abort))		/* in case exec fails with a longjmp(), e.g. Host_Error() */
 			Cbuf_Execute ();
+		FS_PrefetchEnd ();
+		Host_InitStep ("config");
 	}
 
 	Cvar_UnlockAll ();				/* unlock the early-set cvars after init */
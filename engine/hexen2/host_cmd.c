@@ -969,6 +969,7 @@ static void RestoreClients (int ClientsMode)
 			//ent->v.colormap = NUM_FOR_EDICT(ent);
 			ent->v.team = (host_client->colors & 15) + 1;
 			ent->v.netname = PR_SetEngineString(host_client->name);
+			ED_StringFieldsChanged (ent);
 			ent->v.playerclass = host_client->playerclass;
 
 			// copy spawn parms out of the client_t
@@ -1006,6 +1007,7 @@ static int LoadGamestate (const char *level, const char *startspot, int ClientsM
 	int		version;
 //	float		spawn_parms[NUM_SPAWN_PARMS];
 	qboolean	auto_correct = false;
+	double		parsetime;
 
 	if (ClientsMode == 1)	/* for RestoreClients() only: map must be active */
 	{
@@ -1085,6 +1087,8 @@ static int LoadGamestate (const char *level, const char *startspot, int ClientsM
 		SV_LoadInventory(f);
 
 // load the edicts out of the savegame file
+	parsetime = Sys_DoubleTime ();
+	pr_holdstrings = true;	// edicts past sv.num_edicts aren't string roots yet
 	while (!feof(f))
 	{
 		fscanf (f, "%i\n", &entnum);
@@ -1103,6 +1107,7 @@ static int LoadGamestate (const char *level, const char *startspot, int ClientsM
 		if (i == (int) sizeof(str) - 1)
 		{
 			fclose (f);
+			pr_holdstrings = false;
 			Host_Error ("%s: Loadgame buffer overflow", __thisfunc__);
 		}
 		str[i] = 0;
@@ -1113,6 +1118,7 @@ static int LoadGamestate (const char *level, const char *startspot, int ClientsM
 		if (strcmp(com_token,"{"))
 		{
 			fclose (f);
+			pr_holdstrings = false;
 			Host_Error ("%s: First token isn't a brace", __thisfunc__);
 		}
 
@@ -1174,6 +1180,8 @@ static int LoadGamestate (const char *level, const char *startspot, int ClientsM
 	}
 
 	fclose (f);
+	pr_holdstrings = false;
+	Con_DPrintf ("%s: edicts parsed in %.1f ms\n", __thisfunc__, (Sys_DoubleTime() - parsetime) * 1000.0);
 
 	if (ClientsMode == 0)
 	{
@@ -1251,6 +1259,7 @@ static void Host_Name_f (void)
 			Con_Printf ("%s renamed to %s\n", host_client->name, newName);
 	strcpy (host_client->name, newName);
 	host_client->edict->v.netname = PR_SetEngineString(host_client->name);
+	ED_StringFieldsChanged (host_client->edict);
 
 // send notification to all clients
 	MSG_WriteByte (&sv.reliable_datagram, svc_updatename);
@@ -1678,6 +1687,7 @@ static void Host_Spawn_f (void)
 			//ent->v.colormap = NUM_FOR_EDICT(ent);
 			ent->v.team = (host_client->colors & 15) + 1;
 			ent->v.netname = PR_SetEngineString(host_client->name);
+			ED_StringFieldsChanged (ent);
 			ent->v.playerclass = host_client->playerclass;
 
 			// copy spawn parms out of the client_t
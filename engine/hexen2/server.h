@@ -313,6 +313,7 @@ void SV_ClientPrintf (unsigned int unused, const char *fmt, ...) FUNC_PRINTF(2,3
 void SV_BroadcastPrintf (const char *fmt, ...) FUNC_PRINTF(1,2);
 
 void SV_Physics (void);
+void SV_ClearThinkTimers (void);
 
 qboolean SV_CheckBottom (edict_t *ent);
 qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink, qboolean noenemy,
@@ -321,6 +322,9 @@ qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink, qboolean noene
 void SV_WriteClientdataToMessage (client_t *client, edict_t *ent, sizebuf_t *msg);
 
 void SV_MoveToGoal (void);
+void SV_ClearNavGraph (void);
+int SV_NavPath (vec3_t start, vec3_t end, vec3_t *points, int maxpoints);
+void SV_NavInfo_f (void);
 
 void SV_CheckForNewClients (void);
 void SV_RunClients (void);
@@ -107,10 +107,12 @@ OBJECTS = &
 	quakefs.obj &
 	cmd.obj &
 	crc.obj &
+	lzpak.obj &
 	cvar.obj &
 	mathlib.obj &
 	zone.obj &
 	hashindex.obj &
+	threads.obj &
 	$(SYSOBJ_NET) &
 	net_dgrm.obj &
 	net_main.obj &
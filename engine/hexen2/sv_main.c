@@ -50,6 +50,9 @@ extern	cvar_t	sv_altnoclip;
 extern	cvar_t	sv_idealpitchscale;
 extern	cvar_t	sv_idealrollscale;
 extern	cvar_t	sv_aim;
+extern	cvar_t	sv_findradius, sv_findindex;
+extern	cvar_t	sv_tracestats, sv_tracecache, sv_areaadapt;
+extern	cvar_t	sv_navmove;
 extern	cvar_t	sv_walkpitch;
 extern	cvar_t	sv_flypitch;
 
@@ -89,6 +92,12 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_idealpitchscale);
 	Cvar_RegisterVariable (&sv_idealrollscale);
 	Cvar_RegisterVariable (&sv_aim);
+	Cvar_RegisterVariable (&sv_findradius);
+	Cvar_RegisterVariable (&sv_findindex);
+	Cvar_RegisterVariable (&sv_tracestats);
+	Cvar_RegisterVariable (&sv_tracecache);
+	Cvar_RegisterVariable (&sv_areaadapt);
+	Cvar_RegisterVariable (&sv_navmove);
 	Cvar_RegisterVariable (&sv_nostep);
 	Cvar_RegisterVariable (&sv_walkpitch);
 	Cvar_RegisterVariable (&sv_flypitch);
@@ -103,6 +112,10 @@ void SV_Init (void)
 	SV_UserInit ();
 
 	Cmd_AddCommand ("sv_edicts", Sv_Edicts_f);	
+	Cmd_AddCommand ("sv_tracestats", SV_TraceStats_f);
+	Cmd_AddCommand ("sv_tracetest", SV_TraceTest_f);
+	Cmd_AddCommand ("sv_areatest", SV_AreaTest_f);
+	Cmd_AddCommand ("sv_navinfo", SV_NavInfo_f);
 
 	for (i = 0; i < MAX_MODELS; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -817,6 +830,30 @@ static byte *SV_FatPVS (vec3_t org)
 	return fatpvs;
 }
 
+/*
+=============
+SV_NextClientEntity
+
+Edicts without a visible model are only of interest to
+SV_PrepareClientEntities when they are the client itself or still have
+to be removed from its reference frame: returns the first edict from e
+that has a model, is clentnum, or is in the reference frame.
+=============
+*/
+static int SV_NextClientEntity (int e, int clentnum, client_frames_t *reference, int position)
+{
+	int		next;
+
+	next = ED_SetNext (ed_modelset, e, sv.num_edicts);
+	if (clentnum >= e && clentnum < next)
+		next = clentnum;
+	while (position < reference->count && reference->states[position].index < e)
+		position++;
+	if (position < reference->count && reference->states[position].index < next)
+		next = reference->states[position].index;
+	return next;
+}
+
 #define CLIENT_FRAME_INIT	255
 #define CLIENT_FRAME_RESET	254
 
@@ -832,7 +869,7 @@ static void SV_PrepareClientEntities (client_t *client, edict_t	*clent, sizebuf_
 	char	NewName[MAX_QPATH];
 	long	flagtest;
 	int			position = 0;
-	int			client_num;
+	int			client_num, clentnum;
 	client_frames_t	*reference, *build;
 	client_state2_t	*state;
 	entity_state2_t	*ref_ent, *set_ent, build_ent;
@@ -923,9 +960,13 @@ static void SV_PrepareClientEntities (client_t *client, edict_t	*clent, sizebuf_
 	pvs = SV_FatPVS (org);
 
 	// send over all entities (except the client) that touch the pvs
-	ent = NEXT_EDICT(sv.edicts);
-	for (e = 1; e < sv.num_edicts; e++, ent = NEXT_EDICT(ent))
+	clentnum = NUM_FOR_EDICT(clent);
+	for (e = SV_NextClientEntity(1, clentnum, reference, position); e < sv.num_edicts;
+			e = SV_NextClientEntity(e + 1, clentnum, reference, position))
 	{
+		ent = EDICT_NUM(e);
+		if (!ent->v.modelindex)
+			ED_SetRemove (ed_modelset, e);
 		DoRemove = false;
 		// don't send if flagged for NODRAW and there are no lighting effects
 		if (ent->v.effects == EF_NODRAW)
@@ -2271,6 +2312,7 @@ void SV_SpawnServer (const char *server, const char *startspot)
 //
 	//memset (&sv, 0, sizeof(sv));
 	Host_ClearMemory ();
+	Memory_NewMap (server);
 
 	q_strlcpy (sv.name, server, sizeof(sv.name));
 	if (startspot)
@@ -2346,6 +2388,8 @@ void SV_SpawnServer (const char *server, const char *startspot)
 // clear world interaction links
 //
 	SV_ClearWorld ();
+	SV_ClearNavGraph ();
+	SV_ClearThinkTimers ();
 
 	sv.sound_precache[0] = dummy;
 	sv.model_precache[0] = dummy;
@@ -2364,7 +2408,7 @@ void SV_SpawnServer (const char *server, const char *startspot)
 		{
 			sv.num_ex_items += 1;
 			sv.ex_items[i].id = (int)(i + 1);
-			q_strlcpy(sv.ex_items[i].icon, va("gfx/arti%02d.lmp", i), MAX_QPATH);
+			q_snprintf(sv.ex_items[i].icon, MAX_QPATH, "gfx/arti%02d.lmp", i);
 		}
 	}
 
@@ -54,10 +54,16 @@ typedef struct areanode_s
 	struct areanode_s	*children[2];
 	link_t	trigger_edicts;
 	link_t	solid_edicts;
+	vec3_t	mins, maxs;	// the area the node covers
+	int		depth;
+	int		numlinks;	// edicts linked at this node, not below it
 } areanode_t;
 
-#define	AREA_DEPTH	4
-#define	AREA_NODES	32
+#define	AREA_MINDEPTH	4	// the tree is always split this deep
+#define	AREA_MAXDEPTH	10	// and leaves holding many edicts down to this
+#define	AREA_NODES	1024
+#define	AREA_SPLITLINKS	16	// split a leaf holding more edicts than this
+#define	AREA_MERGELINKS	4	// merge two leaves holding no more than this
 
 
 
@@ -75,6 +81,16 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers);
 // sets ent->v.absmin and ent->v.absmax
 // if touchtriggers, calls prog functions for the intersected triggers
 
+void SV_EdictMoved (edict_t *ent);
+// called when progs write origin, mins, maxs or solid without relinking
+
+void SV_EdictTurned (edict_t *ent);
+// called when progs write angles or owner: only traces depend on them
+
+int SV_FindInRadius (vec3_t org, float rad, int *list);
+// returns, sorted by edict number, every edict whose box center may be
+// within rad of org.  the caller must still test the exact distance.
+
 int SV_PointContents (vec3_t p);
 #ifdef QUAKE2
 int SV_TruePointContents (vec3_t p);
@@ -98,12 +114,27 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
+void SV_MoveBatch (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t *ends, int count, int type, edict_t *passedict, trace_t *traces);
+// the same as count SV_Move calls from start to each of ends, sharing the
+// search for the edicts in the way
+
 
 ASM_LINKAGE_BEGIN
-#if id386
 int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
-#endif
 ASM_LINKAGE_END
 qboolean SV_RecursiveHullCheck (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
 
+qboolean SV_HullTrace (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace);
+// iterative SV_RecursiveHullCheck with the same results, used by SV_Move
+
+void SV_AdaptAreaNodes (void);
+// called at the start of each server frame to split crowded areanode
+// leaves and merge empty ones
+
+void SV_TraceStatsFrame (void);
+// called at the start of each server frame to close the trace counters
+void SV_TraceStats_f (void);
+void SV_TraceTest_f (void);
+void SV_AreaTest_f (void);
+
 #endif	/* __HX2_WORLD_H */
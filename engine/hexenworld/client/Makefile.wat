@@ -481,6 +481,7 @@ COMMONOBJS = &
 	quakefs.obj &
 	info_str.obj &
 	crc.obj &
+	lzpak.obj &
 	cvar.obj &
 	cfgfile.obj &
 	host_string.obj &
@@ -489,6 +490,7 @@ COMMONOBJS = &
 	pmovetst.obj &
 	zone.obj &
 	hashindex.obj &
+	threads.obj &
 	$(SYSOBJ_SYS)
 
 all: $(BUILD_TARGET)
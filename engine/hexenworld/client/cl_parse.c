@@ -197,6 +197,7 @@ static void Model_NextDownload (void)
 {
 	const char	*s;
 	int	i;
+	double	t;
 
 	if (cls.downloadnumber == 0)
 	{
@@ -214,6 +215,17 @@ static void Model_NextDownload (void)
 			return;		// started a download
 	}
 
+	// copy the naked name of the map file to the cl structure
+	COM_FileBase (cl.model_name[1], cl.mapname, sizeof(cl.mapname));
+	Memory_NewMap (cl.mapname);
+
+	// have the workers read ahead what is about to be loaded
+	t = Sys_DoubleTime ();
+	FS_PrefetchBegin ();
+	for (i = 1; i < MAX_MODELS && cl.model_name[i][0]; i++)
+		Mod_Prefetch (cl.model_name[i]);
+	FS_PrefetchStart ();
+
 	for (i = 1; i < MAX_MODELS; i++)
 	{
 		if (!cl.model_name[i][0])
@@ -221,6 +233,7 @@ static void Model_NextDownload (void)
 		cl.model_precache[i] = Mod_ForName (cl.model_name[i], false);
 		if (!cl.model_precache[i])
 		{
+			FS_PrefetchEnd ();
 			Con_Printf ("\nThe required model file '%s' could not be found or downloaded.\n\n", cl.model_name[i]);
 			Con_Printf ("You may need to download or purchase a %s client "
 					"pack in order to play on this server.\n\n", fs_gamedir_nopath);
@@ -228,9 +241,8 @@ static void Model_NextDownload (void)
 			return;
 		}
 	}
-
-	// copy the naked name of the map file to the cl structure
-	COM_FileBase (cl.model_name[1], cl.mapname, sizeof(cl.mapname));
+	FS_PrefetchEnd ();
+	Con_DPrintf ("models loaded in %.1f ms\n", (Sys_DoubleTime () - t) * 1000.0);
 
 	// all done
 	cl.worldmodel = cl.model_precache[1];
@@ -254,6 +266,7 @@ static void Sound_NextDownload (void)
 {
 	const char	*s;
 	int	i;
+	double	t;
 
 	if (cls.downloadnumber == 0)
 	{
@@ -269,12 +282,20 @@ static void Sound_NextDownload (void)
 			return;		// started a download
 	}
 
+	t = Sys_DoubleTime ();
+	FS_PrefetchBegin ();
+	for (i = 1; i < MAX_SOUNDS && cl.sound_name[i][0]; i++)
+		S_PrefetchSound (cl.sound_name[i]);
+	FS_PrefetchStart ();
+
 	for (i = 1; i < MAX_SOUNDS; i++)
 	{
 		if (!cl.sound_name[i][0])
 			break;
 		cl.sound_precache[i] = S_PrecacheSound (cl.sound_name[i]);
 	}
+	FS_PrefetchEnd ();
+	Con_DPrintf ("sounds loaded in %.1f ms\n", (Sys_DoubleTime () - t) * 1000.0);
 
 	// done with sounds, request models now
 	MSG_WriteByte (&cls.netchan.message, clc_stringcmd);
@@ -391,6 +412,7 @@ static void CL_ParseDownload (void)
 		FS_MakePath_BUF (FS_USERDIR, NULL, newn, sizeof(newn), cls.downloadname);
 		if (Sys_rename(oldn, newn) != 0)
 			Con_Printf ("failed to rename.\n");
+		else	FS_Rescan ();	// make the file index see it
 
 		// get another file if needed
 		CL_RequestNextDownload ();
@@ -110,11 +110,13 @@ OBJECTS = &
 	info_str.obj &
 	cmd.obj &
 	crc.obj &
+	lzpak.obj &
 	cvar.obj &
 	host_string.obj &
 	mathlib.obj &
 	zone.obj &
 	hashindex.obj &
+	threads.obj &
 	huffman.obj &
 	net_udp.obj &
 	net_chan.obj &
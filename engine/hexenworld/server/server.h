@@ -409,6 +409,9 @@ qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink, qboolean noene
 void SV_WriteClientdataToMessage (client_t *client, sizebuf_t *msg);
 
 void SV_MoveToGoal (void);
+void SV_ClearNavGraph (void);
+int SV_NavPath (vec3_t start, vec3_t end, vec3_t *points, int maxpoints);
+void SV_NavInfo_f (void);
 
 void SV_SaveSpawnparms (void);
 
@@ -437,6 +440,7 @@ const char *SV_GetLevelname (void);
 //
 void SV_ProgStartFrame (void);
 void SV_Physics (void);
+void SV_ClearThinkTimers (void);
 void SV_CheckVelocity (edict_t *ent);
 void SV_AddGravity (edict_t *ent, float scale);
 qboolean SV_RunThink (edict_t *ent);
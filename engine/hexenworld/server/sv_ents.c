@@ -1419,10 +1419,18 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 	numravens = 0;
 	numraven2s = 0;
 
-	for (e = MAX_CLIENTS+1, ent = EDICT_NUM(e); e < sv.num_edicts; e++, ent = NEXT_EDICT(ent))
+	// ed_modelset holds every edict that may have a visible model
+	for (e = ED_SetNext(ed_modelset, MAX_CLIENTS+1, sv.num_edicts); e < sv.num_edicts;
+			e = ED_SetNext(ed_modelset, e + 1, sv.num_edicts))
 	{
+		ent = EDICT_NUM(e);
 		// ignore ents without visible models
-		if (!ent->v.modelindex || !*PR_GetString(ent->v.model))
+		if (!ent->v.modelindex)
+		{
+			ED_SetRemove (ed_modelset, e);
+			continue;
+		}
+		if (!*PR_GetString(ent->v.model))
 			continue;
 
 		if ((int)ent->v.effects & EF_NODRAW)
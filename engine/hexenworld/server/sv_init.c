@@ -313,6 +313,7 @@ void SV_SpawnServer (const char *server, const char *startspot)
 
 	Mod_ClearAll ();
 	Hunk_FreeToLowMark (host_hunklevel);
+	Memory_NewMap (server);
 
 	// wipe the entire per-level structure
 	memset (&sv, 0, sizeof(sv));
@@ -359,6 +360,8 @@ void SV_SpawnServer (const char *server, const char *startspot)
 	// clear physics interaction links
 	//
 	SV_ClearWorld ();
+	SV_ClearNavGraph ();
+	SV_ClearThinkTimers ();
 
 	sv.sound_precache[0] = dummy;
 	sv.model_precache[0] = dummy;
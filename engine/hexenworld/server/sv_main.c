@@ -110,6 +110,9 @@ static void Master_Shutdown (void);
 extern	cvar_t	sv_maxvelocity;
 extern	cvar_t	sv_gravity;
 extern	cvar_t	sv_aim;
+extern	cvar_t	sv_findradius, sv_findindex;
+extern	cvar_t	sv_tracestats, sv_tracecache, sv_areaadapt;
+extern	cvar_t	sv_navmove;
 extern	cvar_t	sv_stopspeed;
 extern	cvar_t	sv_spectatormaxspeed;
 extern	cvar_t	sv_accelerate;
@@ -1352,6 +1355,12 @@ static void SV_InitLocal (void)
 	Cvar_RegisterVariable (&sv_waterfriction);
 
 	Cvar_RegisterVariable (&sv_aim);
+	Cvar_RegisterVariable (&sv_findradius);
+	Cvar_RegisterVariable (&sv_findindex);
+	Cvar_RegisterVariable (&sv_tracestats);
+	Cvar_RegisterVariable (&sv_tracecache);
+	Cvar_RegisterVariable (&sv_areaadapt);
+	Cvar_RegisterVariable (&sv_navmove);
 
 	Cvar_RegisterVariable (&filterban);
 
@@ -1373,6 +1382,10 @@ static void SV_InitLocal (void)
 	Cmd_AddCommand ("removeip", SV_RemoveIP_f);
 	Cmd_AddCommand ("listip", SV_ListIP_f);
 	Cmd_AddCommand ("writeip", SV_WriteIP_f);
+	Cmd_AddCommand ("sv_tracestats", SV_TraceStats_f);
+	Cmd_AddCommand ("sv_tracetest", SV_TraceTest_f);
+	Cmd_AddCommand ("sv_areatest", SV_AreaTest_f);
+	Cmd_AddCommand ("sv_navinfo", SV_NavInfo_f);
 
 	for (i = 0; i < MAX_MODELS; i++)
 		sprintf (localmodels[i], "*%i", i);
@@ -435,6 +435,983 @@ static qboolean SV_CloseEnough (edict_t *ent, edict_t *goal, float dist)
 }
 
 
+/*
+===============================================================================
+
+NAVIGATION GRAPH
+
+The floor under every NAV_GRID column of the world is sampled with the
+player clipping hull the first time a path is asked for, and neighbouring
+floor samples
+a monster could walk between with SV_movestep's step up and step down
+are linked.  SV_MoveToGoal follows paths through the graph with
+sv_navmove 1 instead of bumping around, and progs can ask for them with
+navpath().
+The graph is saved as maps/<mapname>.nav and only rebuilt when the clip
+hull it was made from changes.
+
+===============================================================================
+*/
+
+#define	NAV_VERSION	1
+#define	NAV_GRID	64	// distance between floor columns
+#define	NAV_SUBSTEPS	4	// walk tests between two columns
+#define	NAV_SOLIDSTEP	8	// column scan step through solid space
+#define	NAV_MAXNODES	16384
+#define	NAV_MAXPATH	256
+#define	NAV_REACH	16	// a waypoint this close is reached
+#define	NAV_CANDIDATES	32
+#define	NAV_ROUTELEN	8	// path nodes kept per actor
+#define	NAV_OFFPATH	(NAV_GRID * 2)	// this far from its next node, an actor lost the path
+
+typedef struct
+{
+	vec3_t	origin;		// hull 1 origin standing on the floor
+	int	firstlink;
+	int	numlinks;
+} navnode_t;
+
+typedef struct
+{
+	char	id[4];		// "NAVG"
+	int	version;
+	int	checksum;	// of the hull the graph was made from
+	int	columns[2];
+	int	numnodes;
+	int	numlinks;
+} navheader_t;
+
+typedef struct
+{
+	float	cost;		// path cost so far plus the estimate left
+	int	node;
+} navopen_t;
+
+// what SV_MoveToGoal follows for one actor until the goal's node changes
+// or the actor leaves the path
+typedef struct
+{
+	int	goal;		// edict number, 0 for no route
+	float	actorfree;	// freetimes, a reused edict isn't the same one
+	float	goalfree;
+	vec3_t	start;		// where the actor was at the search
+	vec3_t	goalorg;	// where the goal was when goalnode was found
+	int	goalnode;
+	int	count;		// nodes in path, 0 if there was no way
+	int	next;		// first node in path not reached yet
+	int	path[NAV_ROUTELEN];
+} navroute_t;
+
+cvar_t	sv_navmove = {"sv_navmove", "0", CVAR_NONE};
+
+static navnode_t	*sv_navnodes;
+static int		sv_numnavnodes;
+static int		*sv_navlinks;	// node numbers linked to
+static int		sv_numnavlinks;
+static int		*sv_navcolumns;	// first node of each column, top down
+static int		sv_navsize[2];
+static vec3_t		sv_navorigin;	// center of column 0
+static int		sv_navchecksum;
+static qboolean		sv_navloaded;	// SV_LoadNavGraph has run for this map
+static qboolean		sv_navcached;
+static double		sv_navtime;
+static navroute_t	*sv_navroutes;	// one per edict
+
+// search state
+static navopen_t	*sv_navopen;
+static float		*sv_navcost;
+static int		*sv_navparent;
+static int		*sv_navseen;
+static int		*sv_navdone;
+static int		sv_navsearch;
+
+static struct
+{
+	int	searches;
+	int	found;
+	int	steps;		// SV_MoveToGoal steps along a path
+	int	fallbacks;	// SV_MoveToGoal steps left to SV_NewChaseDir
+} sv_navstats;
+
+
+/*
+==================
+SV_NavTrace
+
+Traces the player hull through the world alone.  Returns true if nothing
+was in the way.
+==================
+*/
+static qboolean SV_NavTrace (vec3_t start, vec3_t end, trace_t *trace)
+{
+	hull_t		*hull;
+
+	hull = &sv.worldmodel->hulls[1];
+	memset (trace, 0, sizeof(trace_t));
+	trace->fraction = 1;
+	trace->allsolid = true;
+	VectorCopy (end, trace->endpos);
+	SV_HullTrace (hull, hull->firstclipnode, 0, 1, start, end, trace);
+
+	return !trace->allsolid && !trace->startsolid && trace->fraction == 1;
+}
+
+
+/*
+==================
+SV_NavChecksum
+
+==================
+*/
+static int SV_NavChecksum (void)
+{
+	qmodel_t	*model;
+	unsigned short	crc;
+	int		i;
+
+	model = sv.worldmodel;
+	CRC_Init (&crc);
+	CRC_ProcessBlock ((byte *)model->clipnodes, &crc, model->numclipnodes * sizeof(mclipnode_t));
+	for (i = 0; i < model->numplanes; i++)
+	{
+		CRC_ProcessBlock ((byte *)model->planes[i].normal, &crc, sizeof(vec3_t));
+		CRC_ProcessBlock ((byte *)&model->planes[i].dist, &crc, sizeof(float));
+	}
+
+	return (int)(((unsigned int)CRC_Value(crc) << 16) | (model->hulls[1].firstclipnode & 0xffff));
+}
+
+
+/*
+==================
+SV_NavColumn
+
+Returns the column a point is in, or -1 outside of the grid.
+==================
+*/
+static int SV_NavColumn (float x, float y)
+{
+	int		i, j;
+
+	i = (int) floor((x - sv_navorigin[0]) / NAV_GRID + 0.5);
+	j = (int) floor((y - sv_navorigin[1]) / NAV_GRID + 0.5);
+	if (i < 0 || i >= sv_navsize[0] || j < 0 || j >= sv_navsize[1])
+		return -1;
+	return j * sv_navsize[0] + i;
+}
+
+
+/*
+==================
+SV_NavScanColumn
+
+Adds a node for each floor under the column from the top of the world
+down, and returns how many were added.
+==================
+*/
+static int SV_NavScanColumn (int column, navnode_t *nodes, int maxnodes)
+{
+	hull_t		*hull;
+	trace_t		trace;
+	vec3_t		p, end, feet;
+	int		count, contents;
+
+	hull = &sv.worldmodel->hulls[1];
+	p[0] = sv_navorigin[0] + (column % sv_navsize[0]) * NAV_GRID;
+	p[1] = sv_navorigin[1] + (column / sv_navsize[0]) * NAV_GRID;
+	p[2] = sv.worldmodel->maxs[2];
+	count = 0;
+
+	while (count < maxnodes)
+	{
+		// find the next open space
+		while (p[2] > sv.worldmodel->mins[2] &&
+				SV_HullPointContents(hull, hull->firstclipnode, p) == CONTENTS_SOLID)
+			p[2] -= NAV_SOLIDSTEP;
+		if (p[2] <= sv.worldmodel->mins[2])
+			break;
+
+		// and drop to the floor below it
+		VectorCopy (p, end);
+		end[2] = sv.worldmodel->mins[2];
+		SV_NavTrace (p, end, &trace);
+		if (trace.allsolid || trace.fraction == 1)
+			break;
+
+		if (trace.plane.normal[2] >= 0.7)
+		{
+			VectorCopy (trace.endpos, feet);
+			feet[2] += hull->clip_mins[2] + 1;
+			contents = SV_PointContents (feet);
+			if (contents != CONTENTS_LAVA && contents != CONTENTS_SLIME)
+			{
+				VectorCopy (trace.endpos, nodes[count].origin);
+				count++;
+			}
+		}
+
+		p[2] = trace.endpos[2] - NAV_SOLIDSTEP;
+	}
+
+	return count;
+}
+
+
+/*
+==================
+SV_NavWalk
+
+Walks from one floor node toward the center of a neighbouring column
+the way SV_movestep would, and leaves the floor position reached in end.
+==================
+*/
+static qboolean SV_NavWalk (vec3_t start, vec3_t target, vec3_t end)
+{
+	trace_t		trace;
+	vec3_t		p, q;
+	int		i;
+
+	VectorCopy (start, p);
+	for (i = 1; i <= NAV_SUBSTEPS; i++)
+	{
+		q[0] = start[0] + (target[0] - start[0]) * i / NAV_SUBSTEPS;
+		q[1] = start[1] + (target[1] - start[1]) * i / NAV_SUBSTEPS;
+
+		// try to step up, then along the floor under a low ceiling
+		p[2] += STEPSIZE;
+		q[2] = p[2];
+		if (!SV_NavTrace(p, q, &trace))
+		{
+			p[2] -= STEPSIZE;
+			q[2] = p[2];
+			if (!SV_NavTrace(p, q, &trace))
+				return false;
+		}
+
+		// step back down, no further than a monster would
+		VectorCopy (q, p);
+		q[2] = p[2] - STEPSIZE*2;
+		SV_NavTrace (p, q, &trace);
+		if (trace.allsolid || trace.fraction == 1 || trace.plane.normal[2] < 0.7)
+			return false;
+		VectorCopy (trace.endpos, p);
+	}
+
+	VectorCopy (p, end);
+	return true;
+}
+
+
+/*
+==================
+SV_BuildNavGraph
+
+Samples the floors and links them into scratch arrays, then copies the
+result to the hunk.
+==================
+*/
+static void SV_BuildNavGraph (void)
+{
+	static const int	dirs[8][2] =
+	{
+		{ 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 },
+		{ -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+	};
+	navnode_t	*nodes, *node;
+	int		*links, *columns;
+	int		numcolumns, column, c, i, j, k, best;
+	int		numnodes, numlinks;
+	vec3_t		target, end;
+	float		d, bestd;
+
+	numcolumns = sv_navsize[0] * sv_navsize[1];
+	nodes = (navnode_t *) Hunk_TempAlloc (NAV_MAXNODES * sizeof(navnode_t) +
+					NAV_MAXNODES * 8 * sizeof(int) +
+					(numcolumns + 1) * sizeof(int));
+	links = (int *)(nodes + NAV_MAXNODES);
+	columns = links + NAV_MAXNODES * 8;
+
+	numnodes = 0;
+	for (column = 0; column < numcolumns; column++)
+	{
+		columns[column] = numnodes;
+		numnodes += SV_NavScanColumn (column, nodes + numnodes, NAV_MAXNODES - numnodes);
+	}
+	columns[numcolumns] = numnodes;
+	if (numnodes == NAV_MAXNODES)
+		Con_Printf ("%s: more than %d nodes in %s\n", __thisfunc__, NAV_MAXNODES, sv.name);
+
+	numlinks = 0;
+	for (i = 0, node = nodes; i < numnodes; i++, node++)
+	{
+		node->firstlink = numlinks;
+		for (j = 0; j < 8; j++)
+		{
+			target[0] = node->origin[0] + dirs[j][0] * NAV_GRID;
+			target[1] = node->origin[1] + dirs[j][1] * NAV_GRID;
+			c = SV_NavColumn (target[0], target[1]);
+			if (c < 0 || columns[c] == columns[c + 1])
+				continue;
+			if (!SV_NavWalk(node->origin, target, end))
+				continue;
+
+			// link to the floor the walk ended on
+			best = -1;
+			bestd = STEPSIZE / 2;
+			for (k = columns[c]; k < columns[c + 1]; k++)
+			{
+				d = fabs(nodes[k].origin[2] - end[2]);
+				if (d <= bestd)
+				{
+					bestd = d;
+					best = k;
+				}
+			}
+			if (best >= 0)
+				links[numlinks++] = best;
+		}
+		node->numlinks = numlinks - node->firstlink;
+	}
+
+	sv_numnavnodes = numnodes;
+	sv_numnavlinks = numlinks;
+	sv_navnodes = (navnode_t *) Hunk_AllocName (numnodes * sizeof(navnode_t), "navnodes");
+	sv_navlinks = (int *) Hunk_AllocName ((numlinks + 1) * sizeof(int), "navlinks");
+	sv_navcolumns = (int *) Hunk_AllocName ((numcolumns + 1) * sizeof(int), "navcolumns");
+	memcpy (sv_navnodes, nodes, numnodes * sizeof(navnode_t));
+	memcpy (sv_navlinks, links, numlinks * sizeof(int));
+	memcpy (sv_navcolumns, columns, (numcolumns + 1) * sizeof(int));
+}
+
+
+/*
+==================
+SV_ReadNavGraph
+
+Loads maps/<mapname>.nav if it was made from the same clip hull.
+==================
+*/
+static qboolean SV_ReadNavGraph (const char *name)
+{
+	navheader_t	*header;
+	navnode_t	*node;
+	byte		*buf;
+	int		*in;
+	int		i, numcolumns;
+	qboolean	bad;
+
+	buf = FS_LoadTempFile (name, NULL);
+	if (!buf || fs_filesize < (long)sizeof(navheader_t))
+		return false;
+
+	header = (navheader_t *)buf;
+	numcolumns = sv_navsize[0] * sv_navsize[1];
+	if (memcmp(header->id, "NAVG", 4) ||
+		LittleLong(header->version) != NAV_VERSION ||
+		LittleLong(header->checksum) != sv_navchecksum ||
+		LittleLong(header->columns[0]) != sv_navsize[0] ||
+		LittleLong(header->columns[1]) != sv_navsize[1])
+		return false;
+
+	sv_numnavnodes = LittleLong (header->numnodes);
+	sv_numnavlinks = LittleLong (header->numlinks);
+	if (sv_numnavnodes < 0 || sv_numnavnodes > NAV_MAXNODES ||
+		sv_numnavlinks < 0 || sv_numnavlinks > NAV_MAXNODES * 8 ||
+		fs_filesize != (long)(sizeof(navheader_t) + sv_numnavnodes * 5 * sizeof(int) +
+					(sv_numnavlinks + numcolumns + 1) * sizeof(int)))
+	{
+		Con_Printf ("%s is corrupt\n", name);
+		sv_numnavnodes = sv_numnavlinks = 0;
+		return false;
+	}
+
+	sv_navnodes = (navnode_t *) Hunk_AllocName (sv_numnavnodes * sizeof(navnode_t), "navnodes");
+	sv_navlinks = (int *) Hunk_AllocName ((sv_numnavlinks + 1) * sizeof(int), "navlinks");
+	sv_navcolumns = (int *) Hunk_AllocName ((numcolumns + 1) * sizeof(int), "navcolumns");
+
+	in = (int *)(header + 1);
+	for (i = 0, node = sv_navnodes; i < sv_numnavnodes; i++, node++)
+	{
+		node->origin[0] = LittleFloat (*(float *)in++);
+		node->origin[1] = LittleFloat (*(float *)in++);
+		node->origin[2] = LittleFloat (*(float *)in++);
+		node->firstlink = LittleLong (*in++);
+		node->numlinks = LittleLong (*in++);
+	}
+	for (i = 0; i < sv_numnavlinks; i++)
+		sv_navlinks[i] = LittleLong (*in++);
+	for (i = 0; i <= numcolumns; i++)
+		sv_navcolumns[i] = LittleLong (*in++);
+
+	// never trust a file for indices
+	bad = false;
+	for (i = 0, node = sv_navnodes; !bad && i < sv_numnavnodes; i++, node++)
+	{
+		if (node->firstlink < 0 || node->numlinks < 0 ||
+				node->firstlink + node->numlinks > sv_numnavlinks)
+			bad = true;
+	}
+	for (i = 0; !bad && i < sv_numnavlinks; i++)
+	{
+		if (sv_navlinks[i] < 0 || sv_navlinks[i] >= sv_numnavnodes)
+			bad = true;
+	}
+	for (i = 0; !bad && i < numcolumns; i++)
+	{
+		if (sv_navcolumns[i] > sv_navcolumns[i + 1])
+			bad = true;
+	}
+	if (!bad && sv_navcolumns[0] == 0 && sv_navcolumns[numcolumns] == sv_numnavnodes)
+		return true;
+
+	Con_Printf ("%s is corrupt\n", name);
+	sv_numnavnodes = sv_numnavlinks = 0;
+	return false;
+}
+
+
+/*
+==================
+SV_WriteNavGraph
+
+==================
+*/
+static void SV_WriteNavGraph (const char *name)
+{
+	navheader_t	*header;
+	navnode_t	*node;
+	char		path[MAX_OSPATH];
+	int		*out;
+	int		i, numcolumns, err;
+	size_t		size;
+
+	numcolumns = sv_navsize[0] * sv_navsize[1];
+	size = sizeof(navheader_t) + sv_numnavnodes * 5 * sizeof(int) +
+			(sv_numnavlinks + numcolumns + 1) * sizeof(int);
+	header = (navheader_t *) Hunk_TempAlloc (size);
+
+	memcpy (header->id, "NAVG", 4);
+	header->version = LittleLong (NAV_VERSION);
+	header->checksum = LittleLong (sv_navchecksum);
+	header->columns[0] = LittleLong (sv_navsize[0]);
+	header->columns[1] = LittleLong (sv_navsize[1]);
+	header->numnodes = LittleLong (sv_numnavnodes);
+	header->numlinks = LittleLong (sv_numnavlinks);
+
+	out = (int *)(header + 1);
+	for (i = 0, node = sv_navnodes; i < sv_numnavnodes; i++, node++)
+	{
+		*(float *)out++ = LittleFloat (node->origin[0]);
+		*(float *)out++ = LittleFloat (node->origin[1]);
+		*(float *)out++ = LittleFloat (node->origin[2]);
+		*out++ = LittleLong (node->firstlink);
+		*out++ = LittleLong (node->numlinks);
+	}
+	for (i = 0; i < sv_numnavlinks; i++)
+		*out++ = LittleLong (sv_navlinks[i]);
+	for (i = 0; i <= numcolumns; i++)
+		*out++ = LittleLong (sv_navcolumns[i]);
+
+	FS_MakePath_BUF (FS_USERDIR, &err, path, sizeof(path), name);
+	if (err || FS_CreatePath(path))
+	{
+		Con_Printf ("Couldn't create the path for %s\n", name);
+		return;
+	}
+	FS_WriteFile (name, header, size);
+}
+
+
+/*
+==================
+SV_ClearNavGraph
+
+Called after the world model has been loaded.  The graph itself is only
+read or built when something first asks for a path.
+==================
+*/
+void SV_ClearNavGraph (void)
+{
+	sv_navnodes = NULL;
+	sv_numnavnodes = 0;
+	sv_numnavlinks = 0;
+	sv_navroutes = NULL;
+	sv_navloaded = false;
+	sv_navcached = false;
+	sv_navtime = 0;
+	memset (&sv_navstats, 0, sizeof(sv_navstats));
+}
+
+
+/*
+==================
+SV_LoadNavGraph
+
+Reads the cached graph for the map or builds and caches a new one.
+==================
+*/
+static void SV_LoadNavGraph (void)
+{
+	char		name[MAX_QPATH];
+	hull_t		*hull;
+	int		i;
+
+	sv_navloaded = true;
+	hull = &sv.worldmodel->hulls[1];
+	if (hull->lastclipnode < hull->firstclipnode)
+		return;
+
+	sv_navtime = Sys_DoubleTime ();
+	for (i = 0; i < 2; i++)
+	{
+		sv_navorigin[i] = sv.worldmodel->mins[i] + NAV_GRID/2;
+		sv_navsize[i] = (int)((sv.worldmodel->maxs[i] - sv.worldmodel->mins[i]) / NAV_GRID) + 1;
+	}
+	sv_navorigin[2] = 0;
+	sv_navchecksum = SV_NavChecksum ();
+
+	q_snprintf (name, sizeof(name), "maps/%s.nav", sv.name);
+	sv_navcached = SV_ReadNavGraph (name);
+	if (!sv_navcached)
+	{
+		SV_BuildNavGraph ();
+		SV_WriteNavGraph (name);
+	}
+
+	sv_navopen = (navopen_t *) Hunk_AllocName ((sv_numnavlinks + 1) * sizeof(navopen_t), "navsearch");
+	sv_navcost = (float *) Hunk_AllocName (sv_numnavnodes * sizeof(float), "navsearch");
+	sv_navparent = (int *) Hunk_AllocName (sv_numnavnodes * sizeof(int), "navsearch");
+	sv_navseen = (int *) Hunk_AllocName (sv_numnavnodes * sizeof(int), "navsearch");
+	sv_navdone = (int *) Hunk_AllocName (sv_numnavnodes * sizeof(int), "navsearch");
+	sv_navroutes = (navroute_t *) Hunk_AllocName (MAX_EDICTS * sizeof(navroute_t), "navroutes");
+	sv_navsearch = 0;
+	sv_navtime = Sys_DoubleTime () - sv_navtime;
+}
+
+
+/*
+==================
+SV_NavReady
+
+Loads the graph on first use.  Returns false if the map has none.
+==================
+*/
+static qboolean SV_NavReady (void)
+{
+	if (!sv_navloaded)
+		SV_LoadNavGraph ();
+	return sv_numnavnodes != 0;
+}
+
+
+/*
+==================
+SV_NavNearest
+
+Returns the closest node that can be reached in a straight line from p,
+or -1.
+==================
+*/
+static int SV_NavNearest (vec3_t p)
+{
+	int		list[NAV_CANDIDATES];
+	float		dist[NAV_CANDIDATES];
+	trace_t		trace;
+	vec3_t		v, start, end;
+	int		count, column, i, j, k, n;
+	float		d;
+
+	count = 0;
+	for (j = -1; j <= 1; j++)
+	{
+		for (i = -1; i <= 1; i++)
+		{
+			column = SV_NavColumn (p[0] + i * NAV_GRID, p[1] + j * NAV_GRID);
+			if (column < 0)
+				continue;
+			for (n = sv_navcolumns[column]; n < sv_navcolumns[column + 1]; n++)
+			{
+				VectorSubtract (sv_navnodes[n].origin, p, v);
+				if (fabs(v[2]) > NAV_GRID)
+					continue;
+				d = DotProduct (v, v);
+				// insertion sort, nearest first
+				for (k = count; k > 0 && dist[k - 1] > d; k--)
+				{
+					if (k < NAV_CANDIDATES)
+					{
+						list[k] = list[k - 1];
+						dist[k] = dist[k - 1];
+					}
+				}
+				if (k < NAV_CANDIDATES)
+				{
+					list[k] = n;
+					dist[k] = d;
+					if (count < NAV_CANDIDATES)
+						count++;
+				}
+			}
+		}
+	}
+
+	for (k = 0; k < count && k < 4; k++)
+	{
+		if (SV_NavTrace(p, sv_navnodes[list[k]].origin, &trace))
+			return list[k];
+		VectorCopy (p, start);
+		VectorCopy (sv_navnodes[list[k]].origin, end);
+		start[2] += STEPSIZE;
+		end[2] += STEPSIZE;
+		if (SV_NavTrace(start, end, &trace))
+			return list[k];
+	}
+
+	return -1;
+}
+
+
+/*
+==================
+SV_NavSearch
+
+A* from node start to node goal.  Fills path with up to maxpath nodes
+from the start and returns how many, or 0 if there is no path.
+==================
+*/
+static int SV_NavSearch (int start, int goal, int *path, int maxpath)
+{
+	navopen_t	item;
+	vec3_t		v;
+	float		cost;
+	int		numopen, node, next, length;
+	int		i, j, parent;
+
+	sv_navstats.searches++;
+	if (++sv_navsearch == 0x7fffffff)
+	{
+		memset (sv_navseen, 0, sv_numnavnodes * sizeof(int));
+		memset (sv_navdone, 0, sv_numnavnodes * sizeof(int));
+		sv_navsearch = 1;
+	}
+
+	sv_navseen[start] = sv_navsearch;
+	sv_navcost[start] = 0;
+	sv_navparent[start] = -1;
+	sv_navopen[0].node = start;
+	sv_navopen[0].cost = 0;
+	numopen = 1;
+
+	while (numopen)
+	{
+		// pop the cheapest node off the heap
+		node = sv_navopen[0].node;
+		item = sv_navopen[--numopen];
+		for (i = 0; (j = i*2 + 1) < numopen; i = j)
+		{
+			if (j + 1 < numopen && sv_navopen[j + 1].cost < sv_navopen[j].cost)
+				j++;
+			if (item.cost <= sv_navopen[j].cost)
+				break;
+			sv_navopen[i] = sv_navopen[j];
+		}
+		sv_navopen[i] = item;
+
+		if (sv_navdone[node] == sv_navsearch)
+			continue;
+		sv_navdone[node] = sv_navsearch;
+		if (node == goal)
+			break;
+
+		for (i = 0; i < sv_navnodes[node].numlinks; i++)
+		{
+			next = sv_navlinks[sv_navnodes[node].firstlink + i];
+			if (sv_navdone[next] == sv_navsearch)
+				continue;
+			VectorSubtract (sv_navnodes[next].origin, sv_navnodes[node].origin, v);
+			cost = sv_navcost[node] + VectorLength (v);
+			if (sv_navseen[next] == sv_navsearch && sv_navcost[next] <= cost)
+				continue;
+			sv_navseen[next] = sv_navsearch;
+			sv_navcost[next] = cost;
+			sv_navparent[next] = node;
+
+			// push it with the straight line distance left as the estimate,
+			// every link is followed once so the heap can't overflow
+			VectorSubtract (sv_navnodes[goal].origin, sv_navnodes[next].origin, v);
+			item.node = next;
+			item.cost = cost + VectorLength (v);
+			for (j = numopen++; j > 0; j = parent)
+			{
+				parent = (j - 1) / 2;
+				if (sv_navopen[parent].cost <= item.cost)
+					break;
+				sv_navopen[j] = sv_navopen[parent];
+			}
+			sv_navopen[j] = item;
+		}
+	}
+
+	if (sv_navdone[goal] != sv_navsearch)
+		return 0;
+	sv_navstats.found++;
+
+	length = 0;
+	for (node = goal; node != -1; node = sv_navparent[node])
+		length++;
+	for (node = goal, i = length - 1; node != -1; node = sv_navparent[node], i--)
+	{
+		if (i < maxpath)
+			path[i] = node;
+	}
+
+	return (length < maxpath) ? length : maxpath;
+}
+
+
+/*
+==================
+SV_NavPath
+
+Finds the nodes to walk through from start to end, both hull 1 origins.
+Copies up to maxpoints of their positions to points and returns how many,
+or 0 if there is no known way.
+==================
+*/
+int SV_NavPath (vec3_t start, vec3_t end, vec3_t *points, int maxpoints)
+{
+	int		path[NAV_MAXPATH];
+	int		from, to, count, i;
+
+	if (!SV_NavReady())
+		return 0;
+	from = SV_NavNearest (start);
+	if (from < 0)
+		return 0;
+	to = SV_NavNearest (end);
+	if (to < 0)
+		return 0;
+
+	if (maxpoints > NAV_MAXPATH)
+		maxpoints = NAV_MAXPATH;
+	count = SV_NavSearch (from, to, path, maxpoints);
+	for (i = 0; i < count; i++)
+		VectorCopy (sv_navnodes[path[i]].origin, points[i]);
+
+	return count;
+}
+
+
+/*
+==================
+SV_NavOrigin
+
+Moves an edict's origin to where the player hull origin would be when
+standing on the same floor.
+==================
+*/
+static void SV_NavOrigin (edict_t *ent, vec3_t org)
+{
+	VectorCopy (ent->v.origin, org);
+	org[2] += ent->v.mins[2] - sv.worldmodel->hulls[1].clip_mins[2];
+}
+
+
+/*
+==================
+SV_NavRouteValid
+
+Returns true if ent can keep following route toward goal.
+==================
+*/
+static qboolean SV_NavRouteValid (navroute_t *route, edict_t *ent, edict_t *goal, vec3_t org, vec3_t goalorg)
+{
+	vec3_t		v;
+
+	if (route->goal != NUM_FOR_EDICT(goal) ||
+			route->actorfree != ent->freetime || route->goalfree != goal->freetime)
+		return false;
+
+	// the goal moved, but it may still be nearest the same node
+	VectorSubtract (goalorg, route->goalorg, v);
+	if (VectorLength(v) > NAV_GRID/2)
+	{
+		if (SV_NavNearest(goalorg) != route->goalnode)
+			return false;
+		VectorCopy (goalorg, route->goalorg);
+	}
+
+	if (!route->count)
+	{	// there was no way from where the actor was
+		VectorSubtract (org, route->start, v);
+		return VectorLength(v) <= NAV_GRID;
+	}
+	if (route->next < route->count)
+	{
+		VectorSubtract (sv_navnodes[route->path[route->next]].origin, org, v);
+		if (fabs(v[2]) > NAV_GRID)
+			return false;
+		v[2] = 0;
+		if (VectorLength(v) > NAV_OFFPATH)
+			return false;
+	}
+	return true;
+}
+
+
+/*
+==================
+SV_NavRoute
+
+Searches a new route for ent to goal.
+==================
+*/
+static void SV_NavRoute (navroute_t *route, edict_t *ent, edict_t *goal, vec3_t org, vec3_t goalorg)
+{
+	int		from, to;
+
+	from = SV_NavNearest (org);
+	to = (from < 0) ? -1 : SV_NavNearest (goalorg);
+
+	route->goal = NUM_FOR_EDICT(goal);
+	route->actorfree = ent->freetime;
+	route->goalfree = goal->freetime;
+	VectorCopy (org, route->start);
+	VectorCopy (goalorg, route->goalorg);
+	route->goalnode = to;
+	route->count = (to < 0) ? 0 : SV_NavSearch (from, to, route->path, NAV_ROUTELEN);
+	// path[0] is the node the edict is at
+	route->next = (route->count > 1) ? 1 : 0;
+}
+
+
+/*
+==================
+SV_NavAdvance
+
+Skips the route nodes org is within reach of.  Returns false if that
+used up a route that ends short of the goal.
+==================
+*/
+static qboolean SV_NavAdvance (navroute_t *route, vec3_t org, float reach)
+{
+	vec3_t		v;
+
+	for ( ; route->next < route->count; route->next++)
+	{
+		VectorSubtract (sv_navnodes[route->path[route->next]].origin, org, v);
+		v[2] = 0;
+		if (VectorLength(v) >= reach)
+			return true;
+	}
+	return route->path[route->count - 1] == route->goalnode;
+}
+
+
+/*
+==================
+SV_NavChaseDir
+
+Steps toward the next node on the way to goal.  Returns false when there
+is no path or the step failed, leaving the move to SV_NewChaseDir.
+The route is kept until the goal's node changes or ent strays from it.
+==================
+*/
+static qboolean SV_NavChaseDir (edict_t *ent, edict_t *goal, float dist)
+{
+	navroute_t	*route;
+	vec3_t		org, goalorg;
+	float		*target, yaw, reach;
+
+	if (((int)ent->v.flags & (FL_FLY|FL_SWIM)) || goal == sv.edicts || !SV_NavReady())
+		return false;
+
+	SV_NavOrigin (ent, org);
+	SV_NavOrigin (goal, goalorg);
+	route = &sv_navroutes[NUM_FOR_EDICT(ent)];
+	if (!SV_NavRouteValid(route, ent, goal, org, goalorg))
+		SV_NavRoute (route, ent, goal, org, goalorg);
+	if (!route->count)
+	{
+		sv_navstats.fallbacks++;
+		return false;
+	}
+
+	// head for the first node that isn't reached yet, or for the goal itself
+	reach = (dist > NAV_REACH) ? dist : NAV_REACH;
+	if (!SV_NavAdvance(route, org, reach))
+	{	// at the end of a partial route, go on from here
+		SV_NavRoute (route, ent, goal, org, goalorg);
+		if (!route->count)
+		{
+			sv_navstats.fallbacks++;
+			return false;
+		}
+		SV_NavAdvance (route, org, reach);
+	}
+	target = (route->next < route->count) ? sv_navnodes[route->path[route->next]].origin : goalorg;
+
+	yaw = (int)(atan2(target[1] - org[1], target[0] - org[0]) * 180 / M_PI);
+	if (yaw < 0)
+		yaw += 360;
+
+	if (!SV_StepDirection(ent, yaw, dist))
+	{
+		route->goal = 0;	// blocked, search again next time
+		sv_navstats.fallbacks++;
+		return false;
+	}
+	sv_navstats.steps++;
+	return true;
+}
+
+
+/*
+==================
+SV_NavInfo_f
+
+Prints the size of the navigation graph and how it has been used.
+==================
+*/
+void SV_NavInfo_f (void)
+{
+	if (!sv.worldmodel)
+	{
+		Con_Printf ("no map loaded\n");
+		return;
+	}
+
+	if (!sv_navloaded)
+	{
+		Con_Printf ("navigation graph not loaded yet\n");
+		return;
+	}
+	Con_Printf ("%d nodes, %d links, %d x %d columns\n",
+			sv_numnavnodes, sv_numnavlinks, sv_navsize[0], sv_navsize[1]);
+	Con_Printf ("%s in %.3f seconds, checksum %08x\n",
+			sv_navcached ? "loaded" : "built", sv_navtime, (unsigned int)sv_navchecksum);
+	Con_Printf ("%d searches, %d found\n", sv_navstats.searches, sv_navstats.found);
+	Con_Printf ("%d path steps, %d left to the old chase\n",
+			sv_navstats.steps, sv_navstats.fallbacks);
+}
+
+
+/*
+======================
+SV_ChaseDir
+
+Picks a new direction toward goal, along the navigation graph with
+sv_navmove 1.
+======================
+*/
+static void SV_ChaseDir (edict_t *actor, edict_t *goal, float dist)
+{
+	if (sv_navmove.integer && SV_NavChaseDir(actor, goal, dist))
+		return;
+	SV_NewChaseDir (actor, goal, dist);
+}
+
+
 /*
 ======================
 SV_MoveToGoal
@@ -463,6 +1440,6 @@ void SV_MoveToGoal (void)
 	// bump around...
 	if ( (rand() & 3) == 1 || !SV_StepDirection(ent, ent->v.ideal_yaw, dist) )
 	{
-		SV_NewChaseDir (ent, goal, dist);
+		SV_ChaseDir (ent, goal, dist);
 	}
 }
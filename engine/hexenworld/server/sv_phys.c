@@ -2156,6 +2156,134 @@ void SV_RunNewmis (void)
 }
 
 
+/*
+===============================================================================
+
+IDLE EDICTS
+
+A MOVETYPE_NONE edict whose think isn't due does nothing in SV_Physics
+but stamp its lastruntime, which only SV_RunEntity reads, so it is dropped from ed_physset until something could change
+that: a progs store to its movetype or nextthink, its reallocation, or
+its think time coming up, which the timer heap below takes care of.
+
+===============================================================================
+*/
+
+#define	MAX_THINKTIMERS		(MAX_EDICTS * 4)
+// wake sleepers a little early: host_frametime may grow within a frame
+#define	THINKTIMER_SLACK	0.1
+
+typedef struct
+{
+	float	time;
+	int		num;
+} thinktimer_t;
+
+static	thinktimer_t	sv_thinktimers[MAX_THINKTIMERS];	// min-heap on time
+static	int		sv_numthinktimers;
+
+void SV_ClearThinkTimers (void)
+{
+	sv_numthinktimers = 0;
+}
+
+static qboolean SV_PushThinkTimer (float time, int num)
+{
+	int		i, parent;
+
+	if (sv_numthinktimers == MAX_THINKTIMERS)
+		return false;
+	i = sv_numthinktimers++;
+	while (i > 0)
+	{
+		parent = (i - 1) / 2;
+		if (sv_thinktimers[parent].time <= time)
+			break;
+		sv_thinktimers[i] = sv_thinktimers[parent];
+		i = parent;
+	}
+	sv_thinktimers[i].time = time;
+	sv_thinktimers[i].num = num;
+	return true;
+}
+
+static void SV_PopThinkTimer (void)
+{
+	thinktimer_t	last;
+	int		i, child;
+
+	last = sv_thinktimers[--sv_numthinktimers];
+	i = 0;
+	while ((child = 2 * i + 1) < sv_numthinktimers)
+	{
+		if (child + 1 < sv_numthinktimers &&
+			sv_thinktimers[child + 1].time < sv_thinktimers[child].time)
+			child++;
+		if (last.time <= sv_thinktimers[child].time)
+			break;
+		sv_thinktimers[i] = sv_thinktimers[child];
+		i = child;
+	}
+	sv_thinktimers[i] = last;
+}
+
+/*
+================
+SV_WakeThinkers
+
+Puts every sleeping edict whose think may come due this frame back in
+ed_physset.  Entries left over from a nextthink that has since changed
+only cost a spurious wakeup.
+================
+*/
+static void SV_WakeThinkers (void)
+{
+	while (sv_numthinktimers &&
+		sv_thinktimers[0].time <= sv.time + host_frametime + THINKTIMER_SLACK)
+	{
+		ED_SetAdd (ed_physset, sv_thinktimers[0].num);
+		SV_PopThinkTimer ();
+	}
+}
+
+/*
+================
+SV_SleepIfIdle
+
+Returns true if ent would do nothing in SV_Physics this frame, taking it
+out of ed_physset until it can matter again.
+================
+*/
+static qboolean SV_SleepIfIdle (edict_t *ent, int num)
+{
+	float	thinktime;
+
+	if (ent->v.movetype != MOVETYPE_NONE)
+		return false;
+	thinktime = ent->v.nextthink;	// same test as SV_RunThink
+	if (!(thinktime <= 0 || thinktime > sv.time + host_frametime))
+		return false;
+
+	if (thinktime <= 0 || SV_PushThinkTimer(thinktime, num))
+		ED_SetRemove (ed_physset, num);
+	return true;
+}
+
+/*
+================
+SV_NextPhysicsEdict
+
+The world and the clients are always visited, everything else only when
+it is in ed_physset, unless force_retouch needs every edict relinked.
+================
+*/
+static int SV_NextPhysicsEdict (int num)
+{
+	if (num <= MAX_CLIENTS || *sv_globals.force_retouch)
+		return num;
+	return ED_SetNext (ed_physset, num, sv.num_edicts);
+}
+
 /*
 ================
 SV_Physics
@@ -2176,18 +2304,32 @@ void SV_Physics (void)
 		host_frametime = sv_maxtic.value;
 	old_time = realtime;
 
+	SV_TraceStatsFrame ();
+	SV_AdaptAreaNodes ();
+
 	*sv_globals.frametime = host_frametime;
 
 	SV_ProgStartFrame ();
 
+	SV_WakeThinkers ();
+
 //
 // treat each object in turn
 // even the world gets a chance to think
+// ed_physset is walked in edict order and rechecked at every step, so
+// edicts spawned or woken by earlier ones are picked up exactly as the
+// full scan would.
 //
-	ent = sv.edicts;
-	for (i = 0; i < sv.num_edicts; i++, ent = NEXT_EDICT(ent))
+	for (i = 0; i < sv.num_edicts; i = SV_NextPhysicsEdict(i + 1))
 	{
+		ent = EDICT_NUM(i);
 		if (ent->free)
+		{
+			if (i > MAX_CLIENTS)
+				ED_SetRemove (ed_physset, i);
+			continue;
+		}
+		if (i > MAX_CLIENTS && !*sv_globals.force_retouch && SV_SleepIfIdle(ent, i))
 			continue;
 
 		if (*sv_globals.force_retouch)
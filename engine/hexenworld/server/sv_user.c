@@ -350,6 +350,7 @@ static void SV_Spawn_f (void)
 		ent->v.team = 0;	// FIXME
 
 	ent->v.netname = PR_SetEngineString(host_client->name);
+	ED_StringFieldsChanged (ent);
 	//ent->v.playerclass = host_client->playerclass = 
 	ent->v.next_playerclass = host_client->next_playerclass;
 	ent->v.has_portals = host_client->portals;
@@ -403,7 +404,7 @@ static void SV_Spawn_f (void)
 	// get the client to check and download skins
 	// when that is completed, a begin command will be issued
 	MSG_WriteByte (&host_client->netchan.message, svc_stufftext);
-	MSG_WriteString (&host_client->netchan.message, va("skins\n") );
+	MSG_WriteString (&host_client->netchan.message, "skins\n");
 }
 
 /*
@@ -24,6 +24,9 @@
  */
 
 #include "quakedef.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 typedef struct
 {
@@ -36,7 +39,68 @@ typedef struct
 	edict_t		*passedict;
 } moveclip_t;
 
-static int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
+static void SV_ClearTraceStats (void);
+static void SV_MoveAreaLinks (areanode_t *anode, link_t *list, qboolean trigger);
+
+typedef struct
+{
+	int		traces;		// SV_Move calls
+	int		hullchecks;	// hulls traced for them
+	int		nodes;		// clipnodes visited by SV_HullTrace
+	int		links;		// SV_LinkEdict calls
+	int		linkskips;	// of which found nothing to relink
+	int		cachehits;	// SV_Move calls answered by the trace cache
+	int		cachemisses;	// and cacheable ones that weren't
+	double		time;		// seconds in SV_Move, with sv_tracestats 1 only
+} tracestats_t;
+
+static tracestats_t	sv_tracecur, sv_tracelast, sv_tracetotal, sv_tracepeak;
+static int		sv_traceframes;
+
+cvar_t	sv_tracestats = {"sv_tracestats", "0", CVAR_NONE};
+
+/*
+MOVE_NOMONSTERS traces only clip against the world and brush entities,
+so the line of sight checks monsters make each frame keep giving the same
+results until a brush entity moves.  With sv_tracecache 1 SV_Move keeps
+them in a table hashed on the endpoints rounded to whole units, compared
+exactly, and emptied every frame and whenever a brush entity is linked,
+unlinked, or has its origin, size, solid, angles or owner set by the
+progs: a rotated brush model clips rotated, and an owner passes through
+what it owns.
+*/
+#define	TRACECACHE_SIZE	1024	// must be a power of two
+
+typedef struct
+{
+	unsigned int	gen;		// tracecache_gen when stored
+	vec3_t		start, end, mins, maxs;
+	edict_t		*passedict;	// and what SV_Move reads from it:
+	int		owner;
+	float		hull;
+	int		flags;		// FL_MONSTER, and 1 for a nonzero size
+	trace_t		trace;
+} tracecache_t;
+
+static tracecache_t	tracecache[TRACECACHE_SIZE];
+static unsigned int	tracecache_gen = 1;
+
+cvar_t	sv_tracecache = {"sv_tracecache", "0", CVAR_NONE};
+
+static void SV_FlushTraceCache (void)
+{
+	if (++tracecache_gen == 0)
+	{
+		memset (tracecache, 0, sizeof(tracecache));
+		tracecache_gen = 1;
+	}
+}
+
+static void SV_BrushMoved (edict_t *ent)
+{
+	if (ent->v.solid == SOLID_BSP || (ent->linkvalid && ent->linksolid == SOLID_BSP))
+		SV_FlushTraceCache ();
+}
 
 
 /*
@@ -190,116 +254,511 @@ ENTITY AREA CHECKING
 
 areanode_t	sv_areanodes[AREA_NODES];
 static	int			sv_numareanodes;
+static	areanode_t	*sv_freeareanodes;	// chained through children[0]
+static	int			sv_numfreeareanodes;
+
+cvar_t	sv_areaadapt = {"sv_areaadapt", "1", CVAR_NONE};
+
+// edicts whose origin, size or solid have been written since their last
+// SV_LinkEdict: their area links may be stale, so radius queries always
+// consider them in addition to what the area tree returns.
+static	int		sv_movedents[MAX_EDICTS];
+static	int		sv_nummovedents;
 
 /*
 ===============
-SV_CreateAreaNode
+SV_EdictMoved
+
+Called whenever progs write one of the fields SV_LinkEdict depends on.
+===============
+*/
+void SV_EdictMoved (edict_t *ent)
+{
+	SV_BrushMoved (ent);
+	if (ent->movedslot)
+		return;
+	if (sv_nummovedents >= MAX_EDICTS)
+		return;	// can't happen: one slot per edict
+	sv_movedents[sv_nummovedents] = NUM_FOR_EDICT(ent);
+	ent->movedslot = ++sv_nummovedents;
+}
 
+/*
+===============
+SV_EdictTurned
+
+Called whenever progs write the angles or the owner of an edict.
+Linking doesn't depend on them, but the cached traces through a brush
+model do.
+===============
+*/
+void SV_EdictTurned (edict_t *ent)
+{
+	SV_BrushMoved (ent);
+}
+
+static void SV_ClearMoved (edict_t *ent)
+{
+	int		slot, last;
+
+	slot = ent->movedslot - 1;
+	ent->movedslot = 0;
+	last = sv_movedents[--sv_nummovedents];
+	if (slot < sv_nummovedents)
+	{
+		sv_movedents[slot] = last;
+		EDICT_NUM(last)->movedslot = slot + 1;
+	}
+}
+
+
+/*
+===============
+SV_NewAreaNode
+
+Takes a node off the free list or the end of the array, NULL when the
+array is full.
 ===============
 */
-static areanode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
+static areanode_t *SV_NewAreaNode (int depth, vec3_t mins, vec3_t maxs)
 {
 	areanode_t	*anode;
-	vec3_t		size;
-	vec3_t		mins1, maxs1, mins2, maxs2;
 
-	anode = &sv_areanodes[sv_numareanodes];
-	sv_numareanodes++;
+	if (sv_freeareanodes)
+	{
+		anode = sv_freeareanodes;
+		sv_freeareanodes = anode->children[0];
+		sv_numfreeareanodes--;
+	}
+	else if (sv_numareanodes < AREA_NODES)
+	{
+		anode = &sv_areanodes[sv_numareanodes];
+		sv_numareanodes++;
+	}
+	else
+	{
+		return NULL;
+	}
 
 	ClearLink (&anode->trigger_edicts);
 	ClearLink (&anode->solid_edicts);
+	anode->axis = -1;
+	anode->children[0] = anode->children[1] = NULL;
+	VectorCopy (mins, anode->mins);
+	VectorCopy (maxs, anode->maxs);
+	anode->depth = depth;
+	anode->numlinks = 0;
 
-	if (depth == AREA_DEPTH)
-	{
-		anode->axis = -1;
-		anode->children[0] = anode->children[1] = NULL;
-		return anode;
-	}
+	return anode;
+}
+
+static void SV_FreeAreaNode (areanode_t *anode)
+{
+	anode->axis = -1;
+	anode->children[0] = sv_freeareanodes;
+	anode->children[1] = NULL;
+	sv_freeareanodes = anode;
+	sv_numfreeareanodes++;
+}
+
+/*
+===============
+SV_SplitAreaNode
+
+Turns a leaf into a node with two leaf children, halving its area
+along the longer horizontal axis, and moves down the edicts that fit
+entirely on one side.
+===============
+*/
+static qboolean SV_SplitAreaNode (areanode_t *anode)
+{
+	vec3_t		size;
+	vec3_t		mins1, maxs1, mins2, maxs2;
+
+	if (sv_numfreeareanodes + AREA_NODES - sv_numareanodes < 2)
+		return false;
 
-	VectorSubtract (maxs, mins, size);
+	VectorSubtract (anode->maxs, anode->mins, size);
 	if (size[0] > size[1])
 		anode->axis = 0;
 	else
 		anode->axis = 1;
 
-	anode->dist = 0.5 * (maxs[anode->axis] + mins[anode->axis]);
-	VectorCopy (mins, mins1);
-	VectorCopy (mins, mins2);
-	VectorCopy (maxs, maxs1);
-	VectorCopy (maxs, maxs2);
+	anode->dist = 0.5 * (anode->maxs[anode->axis] + anode->mins[anode->axis]);
+	VectorCopy (anode->mins, mins1);
+	VectorCopy (anode->mins, mins2);
+	VectorCopy (anode->maxs, maxs1);
+	VectorCopy (anode->maxs, maxs2);
 
 	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
 
-	anode->children[0] = SV_CreateAreaNode (depth+1, mins2, maxs2);
-	anode->children[1] = SV_CreateAreaNode (depth+1, mins1, maxs1);
+	anode->children[0] = SV_NewAreaNode (anode->depth+1, mins2, maxs2);
+	anode->children[1] = SV_NewAreaNode (anode->depth+1, mins1, maxs1);
 
-	return anode;
+	SV_MoveAreaLinks (anode, &anode->trigger_edicts, true);
+	SV_MoveAreaLinks (anode, &anode->solid_edicts, false);
+
+	return true;
 }
 
 /*
 ===============
-SV_ClearWorld
+SV_MoveAreaLinks
 
+Moves the edicts of list that no longer cross anode's plane to the
+child they are on, keeping their order.
 ===============
 */
-void SV_ClearWorld (void)
+static void SV_MoveAreaLinks (areanode_t *anode, link_t *list, qboolean trigger)
 {
-	SV_InitBoxHull ();
+	link_t		*l, *next;
+	edict_t		*ent;
+	areanode_t	*child;
 
-	memset (sv_areanodes, 0, sizeof(sv_areanodes));
-	sv_numareanodes = 0;
-	SV_CreateAreaNode (0, sv.worldmodel->mins, sv.worldmodel->maxs);
+	for (l = list->next ; l != list ; l = next)
+	{
+		next = l->next;
+		ent = EDICT_FROM_AREA(l);
+		if (ent->v.absmin[anode->axis] > anode->dist)
+			child = anode->children[0];
+		else if (ent->v.absmax[anode->axis] < anode->dist)
+			child = anode->children[1];
+		else
+			continue;
+
+		RemoveLink (l);
+		InsertLinkBefore (l, trigger ? &child->trigger_edicts : &child->solid_edicts);
+		ent->areanode = child - sv_areanodes;
+		anode->numlinks--;
+		child->numlinks++;
+	}
 }
 
+/*
+===============
+SV_MergeAreaNode
+
+Turns a node whose children are both leaves back into a leaf.
+===============
+*/
+static void SV_MergeAreaNode (areanode_t *anode)
+{
+	link_t		*l, *next;
+	areanode_t	*child;
+	int			i;
+
+	for (i = 0; i < 2; i++)
+	{
+		child = anode->children[i];
+		for (l = child->trigger_edicts.next ; l != &child->trigger_edicts ; l = next)
+		{
+			next = l->next;
+			RemoveLink (l);
+			InsertLinkBefore (l, &anode->trigger_edicts);
+			EDICT_FROM_AREA(l)->areanode = anode - sv_areanodes;
+		}
+		for (l = child->solid_edicts.next ; l != &child->solid_edicts ; l = next)
+		{
+			next = l->next;
+			RemoveLink (l);
+			InsertLinkBefore (l, &anode->solid_edicts);
+			EDICT_FROM_AREA(l)->areanode = anode - sv_areanodes;
+		}
+		anode->numlinks += child->numlinks;
+		SV_FreeAreaNode (child);
+	}
+
+	anode->axis = -1;
+	anode->children[0] = anode->children[1] = NULL;
+}
 
 /*
 ===============
-SV_UnlinkEdict
+SV_AdaptAreaNode
 
+Splits the leaves holding too many edicts and merges the nodes holding
+too few, so that the depth of the tree follows the entity density.
+Returns the number of edicts linked at or below the node.
 ===============
 */
-static link_t	**sv_link_next;
-static link_t	**sv_link_prev;
+static int SV_AdaptAreaNode (areanode_t *anode)
+{
+	int		total;
 
-void SV_UnlinkEdict (edict_t *ent)
+	if (anode->axis == -1)
+	{
+		if (!sv_areaadapt.integer || anode->numlinks <= AREA_SPLITLINKS ||
+				anode->depth >= AREA_MAXDEPTH || !SV_SplitAreaNode(anode))
+			return anode->numlinks;
+	}
+
+	total = anode->numlinks;
+	total += SV_AdaptAreaNode (anode->children[0]);
+	total += SV_AdaptAreaNode (anode->children[1]);
+
+	if (anode->depth >= AREA_MINDEPTH &&
+			anode->children[0]->axis == -1 && anode->children[1]->axis == -1 &&
+			(total <= AREA_MERGELINKS || !sv_areaadapt.integer))
+		SV_MergeAreaNode (anode);
+
+	return total;
+}
+
+/*
+===============
+SV_AdaptAreaNodes
+
+Called at the start of each server frame, never while SV_ClipToLinks is
+walking the lists.
+===============
+*/
+void SV_AdaptAreaNodes (void)
 {
-	if (!ent->area.prev)
-		return;		// not linked in anywhere
-	RemoveLink (&ent->area);
-	if (sv_link_next && *sv_link_next == &ent->area)
-		*sv_link_next = ent->area.next;
-	if (sv_link_prev && *sv_link_prev == &ent->area)
-		*sv_link_prev = ent->area.prev;
-	ent->area.prev = ent->area.next = NULL;
+	if (sv_numareanodes)
+		SV_AdaptAreaNode (sv_areanodes);
+}
+
+/*
+===============
+SV_CreateAreaNode
+
+Builds the fixed top of the tree, AREA_MINDEPTH deep.
+===============
+*/
+static void SV_CreateAreaNode (areanode_t *anode)
+{
+	if (anode->depth == AREA_MINDEPTH)
+		return;
+
+	SV_SplitAreaNode (anode);
+	SV_CreateAreaNode (anode->children[0]);
+	SV_CreateAreaNode (anode->children[1]);
+}
+
+/*
+===============================================================================
+
+TRIGGER INDEX
+
+Triggers are also kept in a grid of square columns over the world, so a
+moving edict only looks at the triggers in the columns its box covers
+instead of walking the area nodes.  Triggers rarely move, so keeping the
+grid current costs little.  A trigger covering more than
+TRIGGER_MAXCELLS columns goes in a list every query looks at.
+
+===============================================================================
+*/
+
+#define	TRIGGER_CELL		256	// column size, unless the world is too big
+#define	TRIGGER_GRID		64	// columns along each axis at most
+#define	TRIGGER_MAXCELLS	16
+#define	TRIGGER_LINKS		(MAX_EDICTS * 4)
+
+#define	TRIGGER_NONE		0	// values of edict_t trigger
+#define	TRIGGER_CELLS		1
+#define	TRIGGER_BIG		2
+
+typedef struct
+{
+	int		ent;
+	int		next;		// -1 ends the list
+} triggerlink_t;
+
+static triggerlink_t	sv_triggerlinks[TRIGGER_LINKS];
+static int		sv_freetriggerlinks;	// first free entry
+static int		sv_numfreetriggerlinks;
+static int		sv_triggercells[TRIGGER_GRID * TRIGGER_GRID];
+static int		sv_triggergrid[2];
+static float		sv_triggercellsize[2];
+static int		sv_bigtriggers[MAX_EDICTS];
+static int		sv_numbigtriggers;
+static unsigned int	sv_touchmarks[MAX_EDICTS];
+static unsigned int	sv_touchmark;
+
+static int SV_CompareEdictNums (const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+===============
+SV_ClearTriggers
+
+===============
+*/
+static void SV_ClearTriggers (void)
+{
+	int		i;
+
+	for (i = 0; i < 2; i++)
+	{
+		sv_triggergrid[i] = (int)((sv.worldmodel->maxs[i] - sv.worldmodel->mins[i]) / TRIGGER_CELL) + 1;
+		if (sv_triggergrid[i] > TRIGGER_GRID)
+			sv_triggergrid[i] = TRIGGER_GRID;
+		sv_triggercellsize[i] = (sv.worldmodel->maxs[i] - sv.worldmodel->mins[i]) / sv_triggergrid[i];
+		if (sv_triggercellsize[i] < TRIGGER_CELL)
+			sv_triggercellsize[i] = TRIGGER_CELL;
+	}
+
+	for (i = 0; i < TRIGGER_GRID * TRIGGER_GRID; i++)
+		sv_triggercells[i] = -1;
+	for (i = 0; i < TRIGGER_LINKS; i++)
+		sv_triggerlinks[i].next = i + 1;
+	sv_triggerlinks[TRIGGER_LINKS - 1].next = -1;
+	sv_freetriggerlinks = 0;
+	sv_numfreetriggerlinks = TRIGGER_LINKS;
+	sv_numbigtriggers = 0;
+	memset (sv_touchmarks, 0, sizeof(sv_touchmarks));
+	sv_touchmark = 0;
+}
+
+/*
+===============
+SV_TriggerCells
+
+Finds the range of columns a box covers.  Returns how many there are.
+===============
+*/
+static int SV_TriggerCells (vec3_t mins, vec3_t maxs, int *cells)
+{
+	int		i, lo, hi;
+
+	for (i = 0; i < 2; i++)
+	{
+		lo = (int) floor((mins[i] - sv.worldmodel->mins[i]) / sv_triggercellsize[i]);
+		hi = (int) floor((maxs[i] - sv.worldmodel->mins[i]) / sv_triggercellsize[i]);
+		cells[i] = (lo < 0) ? 0 : (lo >= sv_triggergrid[i]) ? sv_triggergrid[i] - 1 : lo;
+		cells[i+2] = (hi < 0) ? 0 : (hi >= sv_triggergrid[i]) ? sv_triggergrid[i] - 1 : hi;
+	}
+
+	return (cells[2] - cells[0] + 1) * (cells[3] - cells[1] + 1);
+}
+
+/*
+===============
+SV_LinkTrigger
+
+===============
+*/
+static void SV_LinkTrigger (edict_t *ent)
+{
+	int		x, y, num, l;
+
+	num = NUM_FOR_EDICT(ent);
+	x = SV_TriggerCells (ent->v.absmin, ent->v.absmax, ent->triggercells);
+	if (x > TRIGGER_MAXCELLS || x > sv_numfreetriggerlinks)
+	{
+		ent->trigger = TRIGGER_BIG;
+		ent->triggercells[0] = sv_numbigtriggers;
+		sv_bigtriggers[sv_numbigtriggers++] = num;
+		return;
+	}
+
+	ent->trigger = TRIGGER_CELLS;
+	for (y = ent->triggercells[1]; y <= ent->triggercells[3]; y++)
+	{
+		for (x = ent->triggercells[0]; x <= ent->triggercells[2]; x++)
+		{
+			l = sv_freetriggerlinks;
+			sv_freetriggerlinks = sv_triggerlinks[l].next;
+			sv_numfreetriggerlinks--;
+			sv_triggerlinks[l].ent = num;
+			sv_triggerlinks[l].next = sv_triggercells[y * TRIGGER_GRID + x];
+			sv_triggercells[y * TRIGGER_GRID + x] = l;
+		}
+	}
 }
 
+/*
+===============
+SV_UnlinkTrigger
+
+===============
+*/
+static void SV_UnlinkTrigger (edict_t *ent)
+{
+	int		x, y, num, l, *prev;
+
+	num = NUM_FOR_EDICT(ent);
+	if (ent->trigger == TRIGGER_BIG)
+	{
+		x = ent->triggercells[0];
+		sv_bigtriggers[x] = sv_bigtriggers[--sv_numbigtriggers];
+		EDICT_NUM(sv_bigtriggers[x])->triggercells[0] = x;
+	}
+	else if (ent->trigger == TRIGGER_CELLS)
+	{
+		for (y = ent->triggercells[1]; y <= ent->triggercells[3]; y++)
+		{
+			for (x = ent->triggercells[0]; x <= ent->triggercells[2]; x++)
+			{
+				prev = &sv_triggercells[y * TRIGGER_GRID + x];
+				for (l = *prev; l != -1; prev = &sv_triggerlinks[l].next, l = *prev)
+				{
+					if (sv_triggerlinks[l].ent != num)
+						continue;
+					*prev = sv_triggerlinks[l].next;
+					sv_triggerlinks[l].next = sv_freetriggerlinks;
+					sv_freetriggerlinks = l;
+					sv_numfreetriggerlinks++;
+					break;
+				}
+			}
+		}
+	}
+	ent->trigger = TRIGGER_NONE;
+}
 
 /*
 ====================
 SV_TouchLinks
+
+Runs the touch functions of the triggers ent's box is in.  They are
+gathered first and called in edict number order, so what the touch
+functions link or unlink doesn't change which ones run or when.
 ====================
 */
-static void SV_TouchLinks (edict_t *ent, areanode_t *node)
+static void SV_TouchLinks (edict_t *ent)
 {
-	link_t		*l, *lnext;
+	int		list[MAX_EDICTS];
+	int		cells[4];
+	int		count, x, y, l, i;
 	edict_t		*touch;
-	int			old_self, old_other;
+	int		old_self, old_other;
 
-loc0:
-	// touch linked edicts
-	sv_link_next = &lnext;
-	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = lnext)
+	if (++sv_touchmark == 0)
+	{
+		memset (sv_touchmarks, 0, sizeof(sv_touchmarks));
+		sv_touchmark = 1;
+	}
+
+	count = 0;
+	for (i = 0; i < sv_numbigtriggers; i++)
+		list[count++] = sv_bigtriggers[i];
+
+	SV_TriggerCells (ent->v.absmin, ent->v.absmax, cells);
+	for (y = cells[1]; y <= cells[3]; y++)
 	{
-		if (!l)
+		for (x = cells[0]; x <= cells[2]; x++)
 		{
-		// my area got removed out from under me!
-			Con_Printf ("%s: encountered NULL link!\n", __thisfunc__);
-			break;
+			for (l = sv_triggercells[y * TRIGGER_GRID + x]; l != -1; l = sv_triggerlinks[l].next)
+			{
+				i = sv_triggerlinks[l].ent;
+				if (sv_touchmarks[i] == sv_touchmark)
+					continue;	// already seen in another column
+				sv_touchmarks[i] = sv_touchmark;
+				list[count++] = i;
+			}
 		}
+	}
 
-		lnext = l->next;
-		touch = EDICT_FROM_AREA(l);
-		if (touch == ent)
+	if (count > 1)
+		qsort (list, count, sizeof(int), SV_CompareEdictNums);
+
+	for (i = 0; i < count; i++)
+	{
+		touch = EDICT_NUM(list[i]);
+		if (touch == ent || touch->free)
 			continue;
 		if (!touch->v.touch || touch->v.solid != SOLID_TRIGGER)
 			continue;
@@ -322,52 +781,68 @@ loc0:
 		*sv_globals.self = old_self;
 		*sv_globals.other = old_other;
 	}
-
-	sv_link_next = NULL;
-
-	// recurse down both sides
-	if (node->axis == -1)
-		return;
-
-	// LordHavoc: optimized recursion
-	//if (ent->v.absmax[node->axis] > node->dist) SV_TouchLinks (ent, node->children[0]);
-	//if (ent->v.absmin[node->axis] < node->dist) SV_TouchLinks (ent, node->children[1]);
-	if (ent->v.absmax[node->axis] > node->dist)
-	{
-		if (ent->v.absmin[node->axis] < node->dist)
-			SV_TouchLinks(ent, node->children[1]); // order reversed to reduce code
-		node = node->children[0];
-		goto loc0;
-	}
-	else
-	{
-		if (ent->v.absmin[node->axis] < node->dist)
-		{
-			node = node->children[1];
-			goto loc0;
-		}
-	}
 }
 
 
 /*
 ===============
-SV_FindTouchedLeafs
+SV_ClearWorld
 
 ===============
 */
-static void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
+void SV_ClearWorld (void)
 {
-	mplane_t	*splitplane;
-	mleaf_t		*leaf;
-	int			sides;
-	int			leafnum;
+	SV_InitBoxHull ();
 
-loc0:
-	if (node->contents == CONTENTS_SOLID)
-		return;
+	memset (sv_areanodes, 0, sizeof(sv_areanodes));
+	sv_numareanodes = 0;
+	sv_freeareanodes = NULL;
+	sv_numfreeareanodes = 0;
+	sv_nummovedents = 0;
+	SV_ClearTraceStats ();
+	SV_FlushTraceCache ();
+	SV_ClearTriggers ();
+	SV_CreateAreaNode (SV_NewAreaNode(0, sv.worldmodel->mins, sv.worldmodel->maxs));
+}
 
-	// add an efrag if the node is a leaf
+
+/*
+===============
+SV_UnlinkEdict
+
+===============
+*/
+void SV_UnlinkEdict (edict_t *ent)
+{
+	if (!ent->area.prev)
+		return;		// not linked in anywhere
+	SV_BrushMoved (ent);
+	RemoveLink (&ent->area);
+	sv_areanodes[ent->areanode].numlinks--;
+	if (ent->trigger)
+		SV_UnlinkTrigger (ent);
+	ent->area.prev = ent->area.next = NULL;
+}
+
+
+/*
+===============
+SV_FindTouchedLeafs
+
+===============
+*/
+static void SV_FindTouchedLeafs (edict_t *ent, mnode_t *node)
+{
+	mplane_t	*splitplane;
+	mleaf_t		*leaf;
+	int			sides;
+	int			leafnum;
+
+loc0:
+	if (node->contents == CONTENTS_SOLID)
+		return;
+
+	// add an efrag if the node is a leaf
 
 	if (node->contents < 0)
 	{
@@ -417,14 +892,16 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 {
 	areanode_t	*node;
 
-	if (ent->area.prev)
-		SV_UnlinkEdict (ent);	// unlink from old position
-
-	if (ent == sv.edicts)
-		return;		// don't add the world
+	if (ent->movedslot)
+		SV_ClearMoved (ent);
 
-	if (ent->free)
+	if (ent == sv.edicts || ent->free)
+	{	// don't add the world
+		if (ent->area.prev)
+			SV_UnlinkEdict (ent);
 		return;
+	}
+	SV_BrushMoved (ent);
 
 	// set the abs box
 	if (ent->v.solid == SOLID_BSP && 
@@ -477,11 +954,36 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 		ent->v.absmax[2] += 1;
 	}
 
+	sv_tracecur.links++;
+
+	// same box, solid and model as the last time: the leafs and the
+	// area node it is linked to are still right
+	if (ent->linkvalid && ent->linksolid == (int)ent->v.solid &&
+		ent->linkleafs == (ent->v.modelindex != 0) &&
+		VectorCompare(ent->v.absmin, ent->linkmins) &&
+		VectorCompare(ent->v.absmax, ent->linkmaxs) &&
+		(ent->area.prev || ent->v.solid == SOLID_NOT))
+	{
+		sv_tracecur.linkskips++;
+		if (touch_triggers && ent->v.solid != SOLID_NOT)
+			SV_TouchLinks (ent);
+		return;
+	}
+
+	if (ent->area.prev)
+		SV_UnlinkEdict (ent);	// unlink from old position
+
 	// link to PVS leafs
 	ent->num_leafs = 0;
 	if (ent->v.modelindex)
 		SV_FindTouchedLeafs (ent, sv.worldmodel->nodes);
 
+	ent->linkvalid = true;
+	ent->linksolid = (int)ent->v.solid;
+	ent->linkleafs = (ent->v.modelindex != 0);
+	VectorCopy (ent->v.absmin, ent->linkmins);
+	VectorCopy (ent->v.absmax, ent->linkmaxs);
+
 	if (ent->v.solid == SOLID_NOT)
 		return;
 
@@ -501,14 +1003,93 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 
 	// link it in
 
+	ent->areanode = node - sv_areanodes;
+	node->numlinks++;
 	if (ent->v.solid == SOLID_TRIGGER)
+	{
 		InsertLinkBefore (&ent->area, &node->trigger_edicts);
+		SV_LinkTrigger (ent);
+	}
 	else
 		InsertLinkBefore (&ent->area, &node->solid_edicts);
 
-	// if touch_triggers, touch all entities at this node and decend for more
+	// if touch_triggers, touch the triggers the box is in
 	if (touch_triggers)
-		SV_TouchLinks ( ent, sv_areanodes );
+		SV_TouchLinks (ent);
+}
+
+
+/*
+===============================================================================
+
+PROXIMITY QUERIES
+
+===============================================================================
+*/
+
+/*
+===============
+SV_AreaEdicts_r
+
+===============
+*/
+static void SV_AreaEdicts_r (areanode_t *node, vec3_t mins, vec3_t maxs, int *list, int *count)
+{
+	link_t		*l;
+	edict_t		*touch;
+
+	for (l = node->trigger_edicts.next ; l != &node->trigger_edicts ; l = l->next)
+	{
+		touch = EDICT_FROM_AREA(l);
+		if (!touch->movedslot)
+			list[(*count)++] = NUM_FOR_EDICT(touch);
+	}
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = l->next)
+	{
+		touch = EDICT_FROM_AREA(l);
+		if (!touch->movedslot)
+			list[(*count)++] = NUM_FOR_EDICT(touch);
+	}
+
+	if (node->axis == -1)
+		return;
+
+	// the box's center is always inside the absbox it was linked with
+	if (maxs[node->axis] >= node->dist)
+		SV_AreaEdicts_r (node->children[0], mins, maxs, list, count);
+	if (mins[node->axis] <= node->dist)
+		SV_AreaEdicts_r (node->children[1], mins, maxs, list, count);
+}
+
+/*
+===============
+SV_FindInRadius
+
+Fills list with the numbers, in ascending order, of every edict whose
+bounding box center may lie within rad of org.  Every edict that can pass
+the exact distance test is returned, but callers must still run it (and
+skip free and SOLID_NOT edicts).  list must hold MAX_EDICTS entries.
+===============
+*/
+int SV_FindInRadius (vec3_t org, float rad, int *list)
+{
+	vec3_t		mins, maxs;
+	int		i, count;
+
+	rad = fabs(rad) + 1;	// epsilon for the float center math
+	for (i = 0; i < 3; i++)
+	{
+		mins[i] = org[i] - rad;
+		maxs[i] = org[i] + rad;
+	}
+
+	count = 0;
+	SV_AreaEdicts_r (sv_areanodes, mins, maxs, list, &count);
+	for (i = 0; i < sv_nummovedents; i++)
+		list[count++] = sv_movedents[i];
+
+	qsort (list, count, sizeof(int), SV_CompareEdictNums);
+	return count;
 }
 
 
@@ -528,7 +1109,7 @@ SV_HullPointContents
 
 ==================
 */
-static int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
+int SV_HullPointContents (hull_t *hull, int num, vec3_t p)
 {
 	float		d;
 	mclipnode_t	*node;
@@ -670,96 +1251,719 @@ loc0: // optimized recursion
 		t2 = DotProductDBL(plane->normal, p2) - plane->dist;
 	}
 
-#if 1
-	if (t1 >= 0 && t2 >= 0)
+#if 1
+	if (t1 >= 0 && t2 >= 0)
+	{
+		//return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
+		num = node->children[0];
+		goto loc0;
+	}
+	if (t1 < 0 && t2 < 0)
+	{
+		//return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
+		num = node->children[1];
+		goto loc0;
+	}
+#else
+	if ( (t1 >= DIST_EPSILON && t2 >= DIST_EPSILON) || (t2 > t1 && t1 >= 0) )
+		return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
+	if ( (t1 <= -DIST_EPSILON && t2 <= -DIST_EPSILON) || (t2 < t1 && t1 <= 0) )
+		return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
+#endif
+
+// put the crosspoint DIST_EPSILON pixels on the near side
+	side = (t1 < 0);
+	if (side)
+		frac = (t1 + DIST_EPSILON)/(t1-t2);
+	else
+		frac = (t1 - DIST_EPSILON)/(t1-t2);
+	if (frac < 0)
+		frac = 0;
+	else if (frac > 1)
+		frac = 1;
+
+	midf = p1f + (p2f - p1f)*frac;
+	for (i = 0; i < 3; i++)
+		mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+
+// move up to the node
+	if (!SV_RecursiveHullCheck (hull, node->children[side], p1f, midf, p1, mid, trace) )
+		return false;
+
+#ifdef PARANOID
+	if (SV_HullPointContents (hull, node->children[side], mid) == CONTENTS_SOLID)
+	{
+		Con_Printf ("mid PointInHullSolid\n");
+		return false;
+	}
+#endif
+
+	// LordHavoc: this recursion can not be optimized because mid would need to be duplicated on a stack
+	if (SV_HullPointContents (hull, node->children[side^1], mid) != CONTENTS_SOLID)
+		// go past the node
+		return SV_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
+
+	if (trace->allsolid)
+		return false;		// never got out of the solid area
+
+//==================
+// the other side of the node is solid, this is the impact point
+//==================
+	if (!side)
+	{
+		VectorCopy (plane->normal, trace->plane.normal);
+		trace->plane.dist = plane->dist;
+	}
+	else
+	{
+		VectorNegate (plane->normal, trace->plane.normal);
+		trace->plane.dist = -plane->dist;
+	}
+
+	while (SV_HullPointContents (hull, hull->firstclipnode, mid) == CONTENTS_SOLID)
+	{
+	//	shouldn't really happen, but does occasionally
+		frac -= 0.1;
+		if (frac < 0)
+		{
+			trace->fraction = midf;
+			VectorCopy (mid, trace->endpos);
+			Con_DPrintf ("backup past 0\n");
+			return false;
+		}
+		midf = p1f + (p2f - p1f)*frac;
+
+		for (i = 0; i < 3; i++)
+			mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+	}
+
+	trace->fraction = midf;
+	VectorCopy (mid, trace->endpos);
+
+	return false;
+}
+
+
+/*
+===============================================================================
+
+ITERATIVE HULL TRACING
+
+===============================================================================
+*/
+
+#define	HULLTRACE_STACK	128
+
+typedef struct
+{
+	int		num;		// the node the segment was split on
+	int		side;		// the side of its plane p1 is on
+	float		p1f, p2f, midf, frac;
+	vec3_t		p1, p2, mid;
+} hulltrace_t;
+
+/*
+==================
+SV_PlaneDists
+
+Distances of both trace endpoints from a non-axial plane, computed like
+DotProductDBL() so the results match SV_RecursiveHullCheck bit for bit.
+==================
+*/
+static void SV_PlaneDists (mplane_t *plane, vec3_t p1, vec3_t p2, float *t1, float *t2)
+{
+#if defined(__SSE2__)
+	__m128d	d;
+
+	d = _mm_mul_pd (_mm_set1_pd(plane->normal[0]), _mm_set_pd(p2[0], p1[0]));
+	d = _mm_add_pd (d, _mm_mul_pd(_mm_set1_pd(plane->normal[1]), _mm_set_pd(p2[1], p1[1])));
+	d = _mm_add_pd (d, _mm_mul_pd(_mm_set1_pd(plane->normal[2]), _mm_set_pd(p2[2], p1[2])));
+	d = _mm_sub_pd (d, _mm_set1_pd(plane->dist));
+	*t1 = (float) _mm_cvtsd_f64 (d);
+	*t2 = (float) _mm_cvtsd_f64 (_mm_unpackhi_pd(d, d));
+#else
+	*t1 = DotProductDBL(plane->normal, p1) - plane->dist;
+	*t2 = DotProductDBL(plane->normal, p2) - plane->dist;
+#endif
+}
+
+/*
+==================
+SV_HullImpact
+
+The far side of the split in fr is solid: fill in the impact point,
+backing off along the segment while it is still inside the hull.
+Always returns false, like the recursive version does at this point.
+==================
+*/
+static qboolean SV_HullImpact (hull_t *hull, hulltrace_t *fr, trace_t *trace)
+{
+	mplane_t	*plane;
+	int			i;
+
+	if (trace->allsolid)
+		return false;		// never got out of the solid area
+
+	plane = hull->planes + hull->clipnodes[fr->num].planenum;
+	if (!fr->side)
+	{
+		VectorCopy (plane->normal, trace->plane.normal);
+		trace->plane.dist = plane->dist;
+	}
+	else
+	{
+		VectorNegate (plane->normal, trace->plane.normal);
+		trace->plane.dist = -plane->dist;
+	}
+
+	while (SV_HullPointContents (hull, hull->firstclipnode, fr->mid) == CONTENTS_SOLID)
+	{
+	//	shouldn't really happen, but does occasionally
+		fr->frac -= 0.1;
+		if (fr->frac < 0)
+		{
+			trace->fraction = fr->midf;
+			VectorCopy (fr->mid, trace->endpos);
+			Con_DPrintf ("backup past 0\n");
+			return false;
+		}
+		fr->midf = fr->p1f + (fr->p2f - fr->p1f)*fr->frac;
+		for (i = 0; i < 3; i++)
+			fr->mid[i] = fr->p1[i] + fr->frac*(fr->p2[i] - fr->p1[i]);
+	}
+
+	trace->fraction = fr->midf;
+	VectorCopy (fr->mid, trace->endpos);
+
+	return false;
+}
+
+/*
+==================
+SV_HullTrace
+
+Same results as SV_RecursiveHullCheck, but walks the clipnodes with an
+explicit stack of the splits whose near side is still being traced.
+==================
+*/
+qboolean SV_HullTrace (hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, trace_t *trace)
+{
+	hulltrace_t	stack[HULLTRACE_STACK], *fr;
+	int			depth, nodes, i;
+	mclipnode_t	*node;
+	mplane_t	*plane;
+	float		t1, t2;
+	vec3_t		start, end;
+	qboolean	result;
+
+	VectorCopy (p1, start);
+	VectorCopy (p2, end);
+	depth = nodes = 0;
+
+	while (1)
+	{
+	// go down to a leaf, splitting the segment on every plane it crosses
+		while (num >= 0)
+		{
+			if (num < hull->firstclipnode || num > hull->lastclipnode)
+				SV_Error ("%s: bad node number", __thisfunc__);
+
+			node = hull->clipnodes + num;
+			plane = hull->planes + node->planenum;
+			nodes++;
+
+			if (plane->type < 3)
+			{
+				t1 = start[plane->type] - plane->dist;
+				t2 = end[plane->type] - plane->dist;
+			}
+			else
+			{
+				SV_PlaneDists (plane, start, end, &t1, &t2);
+			}
+
+			if (t1 >= 0 && t2 >= 0)
+			{
+				num = node->children[0];
+				continue;
+			}
+			if (t1 < 0 && t2 < 0)
+			{
+				num = node->children[1];
+				continue;
+			}
+
+			if (depth == HULLTRACE_STACK)
+			{	// deeper than any sane hull: leave the rest to the recursion
+				result = SV_RecursiveHullCheck (hull, num, p1f, p2f, start, end, trace);
+				goto unwind;
+			}
+
+		// put the crosspoint DIST_EPSILON pixels on the near side
+			fr = &stack[depth++];
+			fr->num = num;
+			fr->side = (t1 < 0);
+			if (fr->side)
+				fr->frac = (t1 + DIST_EPSILON)/(t1-t2);
+			else
+				fr->frac = (t1 - DIST_EPSILON)/(t1-t2);
+			if (fr->frac < 0)
+				fr->frac = 0;
+			else if (fr->frac > 1)
+				fr->frac = 1;
+
+			fr->p1f = p1f;
+			fr->p2f = p2f;
+			fr->midf = p1f + (p2f - p1f)*fr->frac;
+			for (i = 0; i < 3; i++)
+				fr->mid[i] = start[i] + fr->frac*(end[i] - start[i]);
+			VectorCopy (start, fr->p1);
+			VectorCopy (end, fr->p2);
+
+		// move up to the node
+			p2f = fr->midf;
+			VectorCopy (fr->mid, end);
+			num = node->children[fr->side];
+		}
+
+	// check for empty
+		if (num != CONTENTS_SOLID)
+		{
+			trace->allsolid = false;
+			if (num == CONTENTS_EMPTY)
+				trace->inopen = true;
+			else
+				trace->inwater = true;
+		}
+		else
+			trace->startsolid = true;
+		result = true;
+
+unwind:
+	// a false result ends every pending split; a true one lets the
+	// innermost split go on past its node
+		while (1)
+		{
+			if (!result || !depth)
+			{
+				sv_tracecur.nodes += nodes;
+				return result;
+			}
+
+			fr = &stack[--depth];
+			node = hull->clipnodes + fr->num;
+			if (SV_HullPointContents (hull, node->children[fr->side^1], fr->mid) != CONTENTS_SOLID)
+			{	// go past the node
+				num = node->children[fr->side^1];
+				p1f = fr->midf;
+				p2f = fr->p2f;
+				VectorCopy (fr->mid, start);
+				VectorCopy (fr->p2, end);
+				break;
+			}
+
+			result = SV_HullImpact (hull, fr, trace);
+		}
+	}
+}
+
+
+/*
+===============================================================================
+
+TRACE STATISTICS
+
+===============================================================================
+*/
+
+/*
+==================
+SV_ClearTraceStats
+==================
+*/
+static void SV_ClearTraceStats (void)
+{
+	memset (&sv_tracecur, 0, sizeof(sv_tracecur));
+	memset (&sv_tracelast, 0, sizeof(sv_tracelast));
+	memset (&sv_tracetotal, 0, sizeof(sv_tracetotal));
+	memset (&sv_tracepeak, 0, sizeof(sv_tracepeak));
+	sv_traceframes = 0;
+}
+
+/*
+==================
+SV_TraceStatsFrame
+
+Called at the start of each server frame: closes the counters of the
+frame that just ended.
+==================
+*/
+void SV_TraceStatsFrame (void)
+{
+	sv_tracelast = sv_tracecur;
+	memset (&sv_tracecur, 0, sizeof(sv_tracecur));
+
+	sv_tracetotal.traces += sv_tracelast.traces;
+	sv_tracetotal.hullchecks += sv_tracelast.hullchecks;
+	sv_tracetotal.nodes += sv_tracelast.nodes;
+	sv_tracetotal.links += sv_tracelast.links;
+	sv_tracetotal.linkskips += sv_tracelast.linkskips;
+	sv_tracetotal.cachehits += sv_tracelast.cachehits;
+	sv_tracetotal.cachemisses += sv_tracelast.cachemisses;
+	sv_tracetotal.time += sv_tracelast.time;
+	sv_traceframes++;
+
+	if (sv_tracelast.traces > sv_tracepeak.traces)
+		sv_tracepeak.traces = sv_tracelast.traces;
+	if (sv_tracelast.hullchecks > sv_tracepeak.hullchecks)
+		sv_tracepeak.hullchecks = sv_tracelast.hullchecks;
+	if (sv_tracelast.nodes > sv_tracepeak.nodes)
+		sv_tracepeak.nodes = sv_tracelast.nodes;
+	if (sv_tracelast.links > sv_tracepeak.links)
+		sv_tracepeak.links = sv_tracelast.links;
+	if (sv_tracelast.linkskips > sv_tracepeak.linkskips)
+		sv_tracepeak.linkskips = sv_tracelast.linkskips;
+	if (sv_tracelast.cachehits > sv_tracepeak.cachehits)
+		sv_tracepeak.cachehits = sv_tracelast.cachehits;
+	if (sv_tracelast.cachemisses > sv_tracepeak.cachemisses)
+		sv_tracepeak.cachemisses = sv_tracelast.cachemisses;
+	if (sv_tracelast.time > sv_tracepeak.time)
+		sv_tracepeak.time = sv_tracelast.time;
+
+	SV_FlushTraceCache ();
+}
+
+/*
+==================
+SV_TraceStats_f
+==================
+*/
+void SV_TraceStats_f (void)
+{
+	double	frames = sv_traceframes ? sv_traceframes : 1;
+	int	lookups;
+
+	Con_Printf ("%d frames        last     avg    peak\n", sv_traceframes);
+	Con_Printf ("traces      %8d %7.1f %7d\n", sv_tracelast.traces,
+				sv_tracetotal.traces / frames, sv_tracepeak.traces);
+	Con_Printf ("hull checks %8d %7.1f %7d\n", sv_tracelast.hullchecks,
+				sv_tracetotal.hullchecks / frames, sv_tracepeak.hullchecks);
+	Con_Printf ("clipnodes   %8d %7.1f %7d\n", sv_tracelast.nodes,
+				sv_tracetotal.nodes / frames, sv_tracepeak.nodes);
+	Con_Printf ("links       %8d %7.1f %7d\n", sv_tracelast.links,
+				sv_tracetotal.links / frames, sv_tracepeak.links);
+	Con_Printf ("  unchanged %8d %7.1f %7d\n", sv_tracelast.linkskips,
+				sv_tracetotal.linkskips / frames, sv_tracepeak.linkskips);
+	if (sv_tracecache.integer)
+	{
+		Con_Printf ("cache hits  %8d %7.1f %7d\n", sv_tracelast.cachehits,
+				sv_tracetotal.cachehits / frames, sv_tracepeak.cachehits);
+		Con_Printf ("  misses    %8d %7.1f %7d\n", sv_tracelast.cachemisses,
+				sv_tracetotal.cachemisses / frames, sv_tracepeak.cachemisses);
+		lookups = sv_tracetotal.cachehits + sv_tracetotal.cachemisses;
+		Con_Printf ("cache hit rate %.1f%%\n",
+				lookups ? 100.0 * sv_tracetotal.cachehits / lookups : 0.0);
+	}
+	if (sv_tracestats.integer)
+	{
+		Con_Printf ("ms          %8.3f %7.3f %7.3f\n", sv_tracelast.time * 1000,
+				sv_tracetotal.time * 1000 / frames, sv_tracepeak.time * 1000);
+	}
+	else
+	{
+		Con_Printf ("set sv_tracestats 1 to time the traces\n");
+	}
+}
+
+typedef struct
+{
+	hull_t		*hull;		// NULL for a box hull
+	int		num;
+	vec3_t		mins, maxs;	// of the box hull
+	vec3_t		p1, p2;
+} tracetest_t;
+
+static float SV_TraceTestRand (float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() * (1.0f / RAND_MAX));
+}
+
+/*
+==================
+SV_TraceTest_f
+
+Runs SV_RecursiveHullCheck and SV_HullTrace on the same random segments
+through the hulls of the loaded models and compares the traces.
+==================
+*/
+void SV_TraceTest_f (void)
+{
+	tracetest_t	*tests, *t;
+	trace_t		*results;
+	qboolean	*ret;
+	qmodel_t	*mod;
+	hull_t		*hull;
+	int		count, i, j, pass, mismatches;
+	int		nummodels;
+	float		len;
+	double		start, elapsed[2];
+	tracestats_t	saved;
+
+	if (sv.state != ss_active)
+	{
+		Con_Printf ("Server is not active\n");
+		return;
+	}
+
+	count = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : 100000;
+	if (count < 1)
+		count = 1;
+	srand ((Cmd_Argc() > 2) ? atoi(Cmd_Argv(2)) : 1);
+
+	for (nummodels = 1; nummodels < MAX_MODELS; nummodels++)
 	{
-		//return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
-		num = node->children[0];
-		goto loc0;
+		if (!sv.models[nummodels] || sv.models[nummodels]->type != mod_brush)
+			break;
 	}
-	if (t1 < 0 && t2 < 0)
+	if (nummodels < 2)
 	{
-		//return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
-		num = node->children[1];
-		goto loc0;
+		Con_Printf ("No brush models loaded\n");
+		return;
 	}
-#else
-	if ( (t1 >= DIST_EPSILON && t2 >= DIST_EPSILON) || (t2 > t1 && t1 >= 0) )
-		return SV_RecursiveHullCheck (hull, node->children[0], p1f, p2f, p1, p2, trace);
-	if ( (t1 <= -DIST_EPSILON && t2 <= -DIST_EPSILON) || (t2 < t1 && t1 <= 0) )
-		return SV_RecursiveHullCheck (hull, node->children[1], p1f, p2f, p1, p2, trace);
-#endif
 
-// put the crosspoint DIST_EPSILON pixels on the near side
-	side = (t1 < 0);
-	if (side)
-		frac = (t1 + DIST_EPSILON)/(t1-t2);
-	else
-		frac = (t1 - DIST_EPSILON)/(t1-t2);
-	if (frac < 0)
-		frac = 0;
-	else if (frac > 1)
-		frac = 1;
+	tests = (tracetest_t *) malloc (count * sizeof(tracetest_t));
+	results = (trace_t *) malloc (2 * count * sizeof(trace_t));
+	ret = (qboolean *) malloc (2 * count * sizeof(qboolean));
+	if (!tests || !results || !ret)
+		SV_Error ("%s: out of memory", __thisfunc__);
 
-	midf = p1f + (p2f - p1f)*frac;
-	for (i = 0; i < 3; i++)
-		mid[i] = p1[i] + frac*(p2[i] - p1[i]);
+// pick the segments: mostly short moves, some long sight lines, some
+// axial ones and some that don't move at all
+	for (i = 0; i < count; i++)
+	{
+		t = &tests[i];
+		mod = sv.models[1 + rand() % (nummodels - 1)];
+		if (rand() % 8 == 0)
+		{
+			t->hull = NULL;
+			for (j = 0; j < 3; j++)
+			{
+				t->mins[j] = SV_TraceTestRand(-64, 0);
+				t->maxs[j] = SV_TraceTestRand(0, 64);
+			}
+			mod = sv.worldmodel;
+		}
+		else
+		{
+			do
+			{
+				t->hull = &mod->hulls[rand() % MAX_MAP_HULLS];
+			} while (!t->hull->clipnodes || t->hull->lastclipnode < t->hull->firstclipnode);
+			t->num = t->hull->firstclipnode;
+		}
 
-// move up to the node
-	if (!SV_RecursiveHullCheck (hull, node->children[side], p1f, midf, p1, mid, trace) )
-		return false;
+		for (j = 0; j < 3; j++)
+			t->p1[j] = SV_TraceTestRand(mod->mins[j] - 32, mod->maxs[j] + 32);
+		len = (rand() % 4) ? 64 : 2048;
+		for (j = 0; j < 3; j++)
+			t->p2[j] = t->p1[j] + SV_TraceTestRand(-len, len);
+		switch (rand() % 8)
+		{
+		case 0:
+			VectorCopy (t->p1, t->p2);
+			break;
+		case 1:
+			j = rand() % 3;
+			t->p2[(j + 1) % 3] = t->p1[(j + 1) % 3];
+			t->p2[(j + 2) % 3] = t->p1[(j + 2) % 3];
+			break;
+		}
+	}
 
-#ifdef PARANOID
-	if (SV_HullPointContents (hull, node->children[side], mid) == CONTENTS_SOLID)
+	saved = sv_tracecur;
+	for (pass = 0; pass < 2; pass++)
 	{
-		Con_Printf ("mid PointInHullSolid\n");
-		return false;
+		start = Sys_DoubleTime ();
+		for (i = 0; i < count; i++)
+		{
+			trace_t	*tr = &results[pass * count + i];
+
+			t = &tests[i];
+			if (t->hull)
+				hull = t->hull;
+			else
+			{
+				hull = SV_HullForBox (t->mins, t->maxs);
+				t->num = hull->firstclipnode;
+			}
+
+			memset (tr, 0, sizeof(trace_t));
+			tr->fraction = 1;
+			tr->allsolid = true;
+			VectorCopy (t->p2, tr->endpos);
+			if (!pass)
+				ret[i] = SV_RecursiveHullCheck (hull, t->num, 0, 1, t->p1, t->p2, tr);
+			else
+				ret[count + i] = SV_HullTrace (hull, t->num, 0, 1, t->p1, t->p2, tr);
+		}
+		elapsed[pass] = Sys_DoubleTime () - start;
 	}
-#endif
+	sv_tracecur = saved;
 
-	// LordHavoc: this recursion can not be optimized because mid would need to be duplicated on a stack
-	if (SV_HullPointContents (hull, node->children[side^1], mid) != CONTENTS_SOLID)
-		// go past the node
-		return SV_RecursiveHullCheck (hull, node->children[side^1], midf, p2f, mid, p2, trace);
+	mismatches = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (ret[i] == ret[count + i] && !memcmp(&results[i], &results[count + i], sizeof(trace_t)))
+			continue;
+		if (++mismatches <= 5)
+		{
+			t = &tests[i];
+			Con_Printf ("mismatch %d: (%f %f %f) -> (%f %f %f): fraction %f / %f\n", i,
+					t->p1[0], t->p1[1], t->p1[2], t->p2[0], t->p2[1], t->p2[2],
+					results[i].fraction, results[count + i].fraction);
+		}
+	}
 
-	if (trace->allsolid)
-		return false;		// never got out of the solid area
+	Con_Printf ("%d traces, %d mismatches\n", count, mismatches);
+	Con_Printf ("recursive %.3f ms, iterative %.3f ms\n", elapsed[0] * 1000, elapsed[1] * 1000);
 
-//==================
-// the other side of the node is solid, this is the impact point
-//==================
-	if (!side)
+	free (ret);
+	free (results);
+	free (tests);
+}
+
+static int SV_AreaNodeDepth (areanode_t *anode)
+{
+	int		d0, d1;
+
+	if (anode->axis == -1)
+		return anode->depth;
+	d0 = SV_AreaNodeDepth (anode->children[0]);
+	d1 = SV_AreaNodeDepth (anode->children[1]);
+	return (d0 > d1) ? d0 : d1;
+}
+
+/*
+==================
+SV_AreaTest_f
+
+Spawns solid edicts around the current map, half of them crowded into
+one spot, then times the same random moves through them with the fixed
+areanode tree (sv_areaadapt 0) and with the adaptive one.  The test
+edicts are gone afterwards, sv.num_edicts included.
+==================
+*/
+void SV_AreaTest_f (void)
+{
+	static vec3_t	mins = {-16, -16, 0}, maxs = {16, 16, 56};
+	edict_t		**ents, *ent, *mover;
+	float		*freetimes;
+	vec3_t		*starts, *ends, center;
+	int		count, moves, i, j, pass, saved, numedicts;
+	int		numnodes[2], depth[2];
+	double		start, elapsed[2];
+	tracestats_t	stats;
+
+	if (sv.state != ss_active)
 	{
-		VectorCopy (plane->normal, trace->plane.normal);
-		trace->plane.dist = plane->dist;
+		Con_Printf ("Server is not active\n");
+		return;
 	}
-	else
+
+	count = (Cmd_Argc() > 1) ? atoi(Cmd_Argv(1)) : 1500;
+	moves = (Cmd_Argc() > 2) ? atoi(Cmd_Argv(2)) : 20000;
+	j = MAX_EDICTS - sv.num_edicts - 64;
+	if (count > j)
+		count = j;
+	if (count < 1 || moves < 1)
 	{
-		VectorNegate (plane->normal, trace->plane.normal);
-		trace->plane.dist = -plane->dist;
+		Con_Printf ("No free edicts\n");
+		return;
 	}
+	srand (1);
 
-	while (SV_HullPointContents (hull, hull->firstclipnode, mid) == CONTENTS_SOLID)
+	ents = (edict_t **) malloc ((count + 1) * sizeof(edict_t *));
+	freetimes = (float *) malloc ((count + 1) * sizeof(float));
+	starts = (vec3_t *) malloc (moves * sizeof(vec3_t));
+	ends = (vec3_t *) malloc (moves * sizeof(vec3_t));
+	if (!ents || !freetimes || !starts || !ends)
+		SV_Error ("%s: out of memory", __thisfunc__);
+
+	for (j = 0; j < 3; j++)
+		center[j] = SV_TraceTestRand(sv.worldmodel->mins[j] + 256, sv.worldmodel->maxs[j] - 256);
+
+	numedicts = sv.num_edicts;
+	for (i = 0; i < count; i++)
 	{
-	//	shouldn't really happen, but does occasionally
-		frac -= 0.1;
-		if (frac < 0)
+		ent = ents[i] = ED_Alloc ();
+		freetimes[i] = ent->freetime;	/* ED_ClearEdict() keeps it */
+		ent->v.solid = (i % 8) ? SOLID_BBOX : SOLID_TRIGGER;
+		VectorCopy (mins, ent->v.mins);
+		VectorCopy (maxs, ent->v.maxs);
+		for (j = 0; j < 3; j++)
 		{
-			trace->fraction = midf;
-			VectorCopy (mid, trace->endpos);
-			Con_DPrintf ("backup past 0\n");
-			return false;
+			if (i & 1)
+				ent->v.origin[j] = center[j] + SV_TraceTestRand(-256, 256);
+			else
+				ent->v.origin[j] = SV_TraceTestRand(sv.worldmodel->mins[j], sv.worldmodel->maxs[j]);
 		}
-		midf = p1f + (p2f - p1f)*frac;
+		SV_LinkEdict (ent, false);
+	}
+	/* what moves: SV_Move reads the passedict, so it can't be NULL.
+	 * an unlinked edict with no size and no owner clips like a
+	 * plain box against everything above. */
+	mover = ents[count] = ED_Alloc ();
+	freetimes[count] = mover->freetime;
 
-		for (i = 0; i < 3; i++)
-			mid[i] = p1[i] + frac * (p2[i] - p1[i]);
+	for (i = 0; i < moves; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			if (i & 1)
+				starts[i][j] = center[j] + SV_TraceTestRand(-256, 256);
+			else
+				starts[i][j] = SV_TraceTestRand(sv.worldmodel->mins[j], sv.worldmodel->maxs[j]);
+			ends[i][j] = starts[i][j] + SV_TraceTestRand(-128, 128);
+		}
 	}
 
-	trace->fraction = midf;
-	VectorCopy (mid, trace->endpos);
+	saved = sv_areaadapt.integer;
+	stats = sv_tracecur;
+	for (pass = 0; pass < 2; pass++)
+	{
+		Cvar_SetValueQuick (&sv_areaadapt, pass);
+		for (j = 0; j < AREA_MAXDEPTH; j++)
+			SV_AdaptAreaNodes ();
+		numnodes[pass] = sv_numareanodes - sv_numfreeareanodes;
+		depth[pass] = SV_AreaNodeDepth (sv_areanodes);
+
+		start = Sys_DoubleTime ();
+		for (i = 0; i < moves; i++)
+			SV_Move (starts[i], mins, maxs, ends[i], MOVE_NORMAL, mover);
+		elapsed[pass] = Sys_DoubleTime () - start;
+	}
+	sv_tracecur = stats;
 
-	return false;
+	/* free edicts that were reused can go on being reused at once,
+	 * the new ones past the old end go away with the end. */
+	for (i = 0; i <= count; i++)
+	{
+		ED_Free (ents[i]);
+		ents[i]->freetime = freetimes[i];
+	}
+	sv.num_edicts = numedicts;
+	Cvar_SetValueQuick (&sv_areaadapt, saved);
+	for (j = 0; j < AREA_MAXDEPTH; j++)
+		SV_AdaptAreaNodes ();
+
+	Con_Printf ("%d edicts, %d moves\n", count, moves);
+	Con_Printf ("fixed:    %4d nodes, depth %2d, %.3f ms\n", numnodes[0], depth[0], elapsed[0] * 1000);
+	Con_Printf ("adaptive: %4d nodes, depth %2d, %.3f ms\n", numnodes[1], depth[1], elapsed[1] * 1000);
+
+	free (ends);
+	free (starts);
+	free (freetimes);
+	free (ents);
 }
 
 
@@ -811,7 +2015,8 @@ static trace_t SV_ClipMoveToEntity (edict_t *ent, vec3_t start, vec3_t mins, vec
 	}
 
 // trace a line through the apropriate clipping hull
-	SV_RecursiveHullCheck (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
+	sv_tracecur.hullchecks++;
+	SV_HullTrace (hull, hull->firstclipnode, 0, 1, start_l, end_l, &trace);
 
 	if (move_type == MOVE_WATER)
 	{
@@ -983,6 +2188,51 @@ static void SV_MoveBounds (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, v
 #endif
 }
 
+/*
+==================
+SV_TraceCacheSlot
+
+Returns the tracecache entry for a MOVE_NOMONSTERS trace.  *hit is set
+if it holds the result of exactly the same trace.
+==================
+*/
+static tracecache_t *SV_TraceCacheSlot (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, edict_t *passedict, qboolean *hit)
+{
+	tracecache_t	*c;
+	unsigned int	h;
+	int		flags;
+
+	h = (unsigned int)NUM_FOR_EDICT(passedict) * 2654435761u;
+	h ^= (unsigned int)(int)floor(start[0]) * 73856093u;
+	h ^= (unsigned int)(int)floor(start[1]) * 19349663u;
+	h ^= (unsigned int)(int)floor(start[2]) * 83492791u;
+	h += (unsigned int)(int)floor(end[0]) * 2246822519u;
+	h ^= (unsigned int)(int)floor(end[1]) * 3266489917u;
+	h += (unsigned int)(int)floor(end[2]) * 668265263u;
+	h ^= h >> 15;
+	c = &tracecache[h & (TRACECACHE_SIZE - 1)];
+
+	flags = ((int)passedict->v.flags & FL_MONSTER) | (passedict->v.size[0] != 0);
+	*hit = c->gen == tracecache_gen && c->passedict == passedict &&
+		VectorCompare(c->start, start) && VectorCompare(c->end, end) &&
+		VectorCompare(c->mins, mins) && VectorCompare(c->maxs, maxs) &&
+		c->owner == passedict->v.owner && c->hull == passedict->v.hull &&
+		c->flags == flags;
+	if (*hit)
+		return c;
+
+	c->gen = tracecache_gen;
+	VectorCopy (start, c->start);
+	VectorCopy (end, c->end);
+	VectorCopy (mins, c->mins);
+	VectorCopy (maxs, c->maxs);
+	c->passedict = passedict;
+	c->owner = passedict->v.owner;
+	c->hull = passedict->v.hull;
+	c->flags = flags;
+	return c;
+}
+
 /*
 ==================
 SV_Move
@@ -992,6 +2242,26 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 {
 	moveclip_t	clip;
 	int			i;
+	double		start_time;
+	tracecache_t	*cache;
+	qboolean	hit;
+
+	sv_tracecur.traces++;
+	start_time = sv_tracestats.integer ? Sys_DoubleTime () : 0;
+
+	cache = NULL;
+	if (type == MOVE_NOMONSTERS && sv_tracecache.integer && passedict)
+	{
+		cache = SV_TraceCacheSlot (start, mins, maxs, end, passedict, &hit);
+		if (hit)
+		{
+			sv_tracecur.cachehits++;
+			if (sv_tracestats.integer)
+				sv_tracecur.time += Sys_DoubleTime () - start_time;
+			return cache->trace;
+		}
+		sv_tracecur.cachemisses++;
+	}
 
 	memset ( &clip, 0, sizeof ( moveclip_t ) );
 
@@ -1026,9 +2296,191 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 // clip to entities
 	SV_ClipToLinks ( sv_areanodes, &clip );
 
+	if (cache)
+		cache->trace = clip.trace;
+
+	if (sv_tracestats.integer)
+		sv_tracecur.time += Sys_DoubleTime () - start_time;
+
 	return clip.trace;
 }
 
+/*
+==================
+SV_GatherLinks
+
+Collects, in the order SV_ClipToLinks would visit them, the edicts that
+may block a move inside clip's box, leaving out the ones no move of
+the batch could clip against.
+==================
+*/
+static void SV_GatherLinks (areanode_t *node, moveclip_t *clip, edict_t **list, int *count)
+{
+	link_t		*l, *next;
+	edict_t		*touch;
+
+loc0:
+	for (l = node->solid_edicts.next ; l != &node->solid_edicts ; l = next)
+	{
+		next = l->next;
+		touch = EDICT_FROM_AREA(l);
+		if (touch->v.solid == SOLID_NOT)
+			continue;
+		if (touch == clip->passedict)
+			continue;
+		if (touch->v.solid == SOLID_TRIGGER)
+			SV_Error ("Trigger in clipping list");
+
+		if ((clip->type == MOVE_NOMONSTERS || clip->type == MOVE_PHASE)
+				&& touch->v.solid != SOLID_BSP)
+			continue;
+
+		if (clip->boxmins[0] > touch->v.absmax[0]
+				|| clip->boxmins[1] > touch->v.absmax[1]
+				|| clip->boxmins[2] > touch->v.absmax[2]
+				|| clip->boxmaxs[0] < touch->v.absmin[0]
+				|| clip->boxmaxs[1] < touch->v.absmin[1]
+				|| clip->boxmaxs[2] < touch->v.absmin[2] )
+			continue;
+
+		if (clip->passedict && clip->passedict->v.size[0] && !touch->v.size[0])
+			continue;	// points never interact
+		if (clip->passedict)
+		{
+			if (PROG_TO_EDICT(touch->v.owner) == clip->passedict)
+				continue;	// don't clip against own missiles
+			if (PROG_TO_EDICT(clip->passedict->v.owner) == touch)
+				continue;	// don't clip against owner
+		}
+
+		list[(*count)++] = touch;
+	}
+
+	if (node->axis == -1)
+		return;
+
+	if ( clip->boxmaxs[node->axis] > node->dist )
+	{
+		if (clip->boxmins[node->axis] < node->dist)
+			SV_GatherLinks (node->children[1], clip, list, count);
+		node = node->children[0];
+		goto loc0;
+	}
+	else if ( clip->boxmins[node->axis] < node->dist )
+	{
+		node = node->children[1];
+		goto loc0;
+	}
+}
+
+/*
+==================
+SV_MoveBatch
+
+Moves a box from start to each of the count ends, with the results of
+as many SV_Move calls, but gathers the edicts in the way of any of the
+moves from the area tree only once.
+==================
+*/
+void SV_MoveBatch (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t *ends, int count, int type, edict_t *passedict, trace_t *traces)
+{
+	static edict_t	*list[MAX_EDICTS];
+	moveclip_t	clip;
+	edict_t		*touch;
+	trace_t		trace;
+	vec3_t		boxmins, boxmaxs;
+	int			i, j, n, numlist;
+	double		start_time;
+
+	if (count < 1)
+		return;
+
+	sv_tracecur.traces += count;
+	start_time = sv_tracestats.integer ? Sys_DoubleTime () : 0;
+
+	memset ( &clip, 0, sizeof ( moveclip_t ) );
+
+	move_type = type;
+	clip.start = start;
+	clip.mins = mins;
+	clip.maxs = maxs;
+	clip.type = type;
+	clip.passedict = passedict;
+
+	if (type == MOVE_MISSILE || type == MOVE_PHASE)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			clip.mins2[i] = -15;
+			clip.maxs2[i] = 15;
+		}
+	}
+	else
+	{
+		VectorCopy (mins, clip.mins2);
+		VectorCopy (maxs, clip.maxs2);
+	}
+
+// gather once for the bounding box of all the moves
+	for (n = 0; n < count; n++)
+	{
+		SV_MoveBounds ( start, clip.mins2, clip.maxs2, ends[n], boxmins, boxmaxs );
+		for (i = 0; i < 3; i++)
+		{
+			if (!n || boxmins[i] < clip.boxmins[i])
+				clip.boxmins[i] = boxmins[i];
+			if (!n || boxmaxs[i] > clip.boxmaxs[i])
+				clip.boxmaxs[i] = boxmaxs[i];
+		}
+	}
+	numlist = 0;
+	SV_GatherLinks ( sv_areanodes, &clip, list, &numlist );
+
+	for (n = 0; n < count; n++)
+	{
+		clip.end = ends[n];
+		clip.trace = SV_ClipMoveToEntity ( sv.edicts, start, mins, maxs, ends[n], passedict );
+		SV_MoveBounds ( start, clip.mins2, clip.maxs2, ends[n], clip.boxmins, clip.boxmaxs );
+
+		for (j = 0; j < numlist; j++)
+		{
+			touch = list[j];
+			if (clip.boxmins[0] > touch->v.absmax[0]
+					|| clip.boxmins[1] > touch->v.absmax[1]
+					|| clip.boxmins[2] > touch->v.absmax[2]
+					|| clip.boxmaxs[0] < touch->v.absmin[0]
+					|| clip.boxmaxs[1] < touch->v.absmin[1]
+					|| clip.boxmaxs[2] < touch->v.absmin[2] )
+				continue;
+			if (clip.trace.allsolid)
+				break;
+
+			if ((int)touch->v.flags & FL_MONSTER)
+				trace = SV_ClipMoveToEntity (touch, start, clip.mins2, clip.maxs2, ends[n], touch);
+			else
+				trace = SV_ClipMoveToEntity (touch, start, mins, maxs, ends[n], touch);
+			if (trace.allsolid || trace.startsolid || trace.fraction < clip.trace.fraction)
+			{
+				trace.ent = touch;
+				if (clip.trace.startsolid)
+				{
+					clip.trace = trace;
+					clip.trace.startsolid = true;
+				}
+				else
+					clip.trace = trace;
+			}
+			else if (trace.startsolid)
+				clip.trace.startsolid = true;
+		}
+
+		traces[n] = clip.trace;
+	}
+
+	if (sv_tracestats.integer)
+		sv_tracecur.time += Sys_DoubleTime () - start_time;
+}
+
 
 //=============================================================================
 
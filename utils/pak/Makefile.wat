@@ -23,6 +23,7 @@ OSLIBS=$(UHEXEN2_TOP)/oslibs
 # Names of the binaries
 PAKX=pakx.exe
 PAKLIST=paklist.exe
+PAKZ=pakz.exe
 
 # Compiler flags
 CFLAGS = -zq -wx -bm -bt=nt -5s -sg -otexan -fp5 -fpi87 -ei -j -zp8
@@ -51,13 +52,15 @@ OBJ_COMMON= qsnprint.obj &
 	cmdlib.obj &
 	util_io.obj &
 	crc.obj &
+	lzpak.obj &
 	q_endian.obj &
 	byteordr.obj &
 	pakfile.obj
 OBJ_PAKX= pakx.obj
 OBJ_PAKL= paklist.obj
+OBJ_PAKZ= pakz.obj
 
-all: $(PAKX) $(PAKLIST)
+all: $(PAKX) $(PAKLIST) $(PAKZ)
 
 $(PAKX): $(OBJ_COMMON) $(OBJ_PAKX)
 	wlink N $@ SYS NT OP q F {$(OBJ_COMMON) $(OBJ_PAKX)}
@@ -65,8 +68,11 @@ $(PAKX): $(OBJ_COMMON) $(OBJ_PAKX)
 $(PAKLIST): $(OBJ_COMMON) $(OBJ_PAKL)
 	wlink N $@ SYS NT OP q F {$(OBJ_COMMON) $(OBJ_PAKL)}
 
+$(PAKZ): $(OBJ_COMMON) $(OBJ_PAKZ)
+	wlink N $@ SYS NT OP q F {$(OBJ_COMMON) $(OBJ_PAKZ)}
+
 INCLUDES+= -I"$(OSLIBS)/windows/misc/include"
 clean: .symbolic
 	rm -f *.obj *.res *.err
 distclean: clean .symbolic
-	rm -f $(PAKX) $(PAKLIST)
+	rm -f $(PAKX) $(PAKLIST) $(PAKZ)
@@ -24,6 +24,8 @@ typedef struct
 {
 	char	name[MAX_OSPATH];
 	int		filepos, filelen;
+	int		packlen;	/* bytes at filepos */
+	int		method;		/* PAKZ_STORED or PAKZ_LZBLOCKS */
 } pakfiles_t;
 
 typedef struct pack_s
@@ -31,10 +33,14 @@ typedef struct pack_s
 	char	filename[MAX_OSPATH];
 	FILE	*handle;
 	unsigned short	crc;
+	int		compressed;	/* a PAKZ file */
 	int		numfiles;
 	pakfiles_t	*files;
 } pack_t;
 
 pack_t *LoadPackFile (const char *packfile);
+void *ReadPackFile (pack_t *pak, int filenum);
+	/* returns the uncompressed contents of a file in
+	 * the pak in a SafeMalloc'ed buffer. */
 
 #endif	/* QUAKE_PAK_H */
@@ -28,9 +28,78 @@
 #include "pakfile.h"
 #include "pak.h"
 #include "crc.h"
+#include "lzpak.h"
 
 //======================================================================
 
+static pack_t *LoadPackZFile (const char *packfile, FILE *packhandle)
+{
+	dpackzheader_t	header;
+	int			i, numpackfiles, dirlen;
+	pakfiles_t		*newfiles;
+	pack_t			*pack;
+	dpackzfile_t		*info;
+
+	fseek (packhandle, 0, SEEK_SET);
+	SafeRead (packhandle, &header, sizeof(header));
+	if (LittleLong(header.version) != PAKZ_VERSION)
+	{
+		COM_Error ("%s has version %i (should be %i)",
+				packfile, LittleLong(header.version), PAKZ_VERSION);
+	}
+	header.dirofs = LittleLong (header.dirofs);
+	numpackfiles = LittleLong (header.numfiles);
+	if (numpackfiles < 0 || header.dirofs < 0)
+	{
+		COM_Error ("Invalid packfile %s (numfiles: %i, dirofs: %i)",
+				packfile, numpackfiles, header.dirofs);
+	}
+
+	pack = (pack_t *) SafeMalloc (sizeof(pack_t));
+	strcpy(pack->filename, packfile);
+	pack->handle = packhandle;
+	pack->compressed = 1;
+	pack->numfiles = numpackfiles;
+	if (!numpackfiles)
+	{	// let the caller worry about it
+		pack->crc = 0;
+		pack->files = (pakfiles_t *) SafeMalloc (sizeof(pakfiles_t));
+		return pack;
+	}
+	dirlen = numpackfiles * sizeof(dpackzfile_t);
+	info = (dpackzfile_t *) SafeMalloc (dirlen);
+	newfiles = (pakfiles_t *) SafeMalloc (numpackfiles * sizeof(pakfiles_t));
+
+	fseek (packhandle, header.dirofs, SEEK_SET);
+	SafeRead (packhandle, info, dirlen);
+
+// crc the directory
+	CRC_Init (&pack->crc);
+	for (i = 0; i < dirlen; i++)
+		CRC_ProcessByte (&pack->crc, ((byte *)info)[i]);
+
+// parse the directory
+	for (i = 0; i < numpackfiles; i++)
+	{
+		info[i].name[PAK_PATH_LENGTH - 1] = '\0';
+		strcpy (newfiles[i].name, info[i].name);
+		newfiles[i].filepos = LittleLong(info[i].filepos);
+		newfiles[i].filelen = LittleLong(info[i].filelen);
+		newfiles[i].packlen = LittleLong(info[i].packlen);
+		newfiles[i].method = LittleLong(info[i].method);
+		if (newfiles[i].method != PAKZ_STORED && newfiles[i].method != PAKZ_LZBLOCKS)
+		{
+			COM_Error ("Invalid packfile %s (%s has method %i)",
+					packfile, newfiles[i].name, newfiles[i].method);
+		}
+	}
+
+	free (info);
+	pack->files = newfiles;
+
+	return pack;
+}
+
 pack_t *LoadPackFile (const char *packfile)
 {
 	dpackheader_t	header;
@@ -45,6 +114,11 @@ pack_t *LoadPackFile (const char *packfile)
 		return NULL;
 
 	fread (&header, 1, sizeof(header), packhandle);
+	if (header.id[0] == 'P' && header.id[1] == 'A' &&
+	    header.id[2] == 'K' && header.id[3] == 'Z')
+	{
+		return LoadPackZFile (packfile, packhandle);
+	}
 	if (header.id[0] != 'P' || header.id[1] != 'A' ||
 	    header.id[2] != 'C' || header.id[3] != 'K')
 	{
@@ -89,6 +163,8 @@ pack_t *LoadPackFile (const char *packfile)
 		strcpy (newfiles[i].name, info[i].name);
 		newfiles[i].filepos = LittleLong(info[i].filepos);
 		newfiles[i].filelen = LittleLong(info[i].filelen);
+		newfiles[i].packlen = newfiles[i].filelen;
+		newfiles[i].method = PAKZ_STORED;
 	}
 
 	free (info);
@@ -96,3 +172,43 @@ pack_t *LoadPackFile (const char *packfile)
 
 	return pack;
 }
+
+void *ReadPackFile (pack_t *pak, int filenum)
+{
+	pakfiles_t	*pf = &pak->files[filenum];
+	unsigned char	*packed, *out, *p;
+	int		i, numblocks, start, end, outlen;
+
+	out = (unsigned char *) SafeMalloc (pf->filelen + 1);
+	fseek (pak->handle, pf->filepos, SEEK_SET);
+	if (pf->method == PAKZ_STORED)
+	{
+		SafeRead (pak->handle, out, pf->filelen);
+		return out;
+	}
+
+	packed = (unsigned char *) SafeMalloc (pf->packlen);
+	SafeRead (pak->handle, packed, pf->packlen);
+	numblocks = (pf->filelen + PAKZ_BLOCKSIZE - 1) / PAKZ_BLOCKSIZE;
+	if ((numblocks + 1) * 4 > pf->packlen)
+		COM_Error ("%s: bad block table", pf->name);
+	for (i = 0; i < numblocks; i++)
+	{
+		p = packed + i * 4;
+		start = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+		end = p[4] | (p[5] << 8) | (p[6] << 16) | (p[7] << 24);
+		if (start < (numblocks + 1) * 4 || end < start || end > pf->packlen)
+			COM_Error ("%s: bad block table", pf->name);
+		outlen = pf->filelen - i * PAKZ_BLOCKSIZE;
+		if (outlen > PAKZ_BLOCKSIZE)
+			outlen = PAKZ_BLOCKSIZE;
+		if (end - start == outlen)
+			memcpy (out + i * PAKZ_BLOCKSIZE, packed + start, outlen);
+		else if (LZ_Decompress(packed + start, end - start,
+					out + i * PAKZ_BLOCKSIZE, outlen) != outlen)
+			COM_Error ("%s: block %i is corrupt", pf->name, i);
+	}
+	free (packed);
+
+	return out;
+}
@@ -55,16 +55,31 @@ int main (int argc, char **argv)
 	pak = LoadPackFile (argv[1]);
 	if (!pak)
 		COM_Error ("Unable to open file %s", argv[i]);
-	printf ("PAK file %s: %li bytes, %i files, header crc %u.\n",
+	printf ("%s file %s: %li bytes, %i files, header crc %u.\n",
+			pak->compressed ? "PAKZ" : "PAK",
 			pak->filename, Q_filelength(pak->handle),
 			pak->numfiles, pak->crc);
 	if (!pak->numfiles)
 		COM_Error ("%s has no files.", argv[1]);
-	printf ("============================================================================\n");
-	printf ("%-56s%10s%10s\n", "Filename", "Length", "Offset");
-	printf ("============================================================================\n");
+	if (!pak->compressed)
+	{
+		printf ("============================================================================\n");
+		printf ("%-56s%10s%10s\n", "Filename", "Length", "Offset");
+		printf ("============================================================================\n");
+		for (i = 0; i < pak->numfiles; i++)
+			printf ("%-56s%10d%10d\n", pak->files[i].name, pak->files[i].filelen, pak->files[i].filepos);
+		return 0;
+	}
+	printf ("==================================================================================================\n");
+	printf ("%-56s%10s%10s%10s%6s%6s\n", "Filename", "Length", "Offset", "Packed", "Ratio", "Mode");
+	printf ("==================================================================================================\n");
 	for (i = 0; i < pak->numfiles; i++)
-		printf ("%-56s%10d%10d\n", pak->files[i].name, pak->files[i].filelen, pak->files[i].filepos);
+	{
+		printf ("%-56s%10d%10d%10d%5d%%%6s\n", pak->files[i].name,
+				pak->files[i].filelen, pak->files[i].filepos, pak->files[i].packlen,
+				pak->files[i].filelen ? (int)(100.0 * pak->files[i].packlen / pak->files[i].filelen) : 100,
+				(pak->files[i].method == PAKZ_STORED) ? "store" : "lz");
+	}
 
 	return 0;
 }
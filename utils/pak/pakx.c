@@ -31,6 +31,25 @@
 
 //======================================================================
 
+static void WritePakEntry (pack_t *pak, int filenum, const char *dest)
+{
+	char	temp[1024];
+	void	*buf;
+
+	if (pak->files[filenum].method == PAKZ_STORED)
+	{
+		fseek (pak->handle, pak->files[filenum].filepos, SEEK_SET);
+		if (Q_WriteFileFromHandle(pak->handle, dest, pak->files[filenum].filelen) != 0)
+			COM_Error ("I/O errors during copy.");
+		return;
+	}
+	buf = ReadPackFile (pak, filenum);
+	strcpy (temp, dest);
+	CreatePath (temp);
+	SaveFile (dest, buf, pak->files[filenum].filelen);
+	free (buf);
+}
+
 static void ExtractFile (pack_t *pak, const char *filename, const char *destdir)
 {
 	char	dest[1024], *dptr;
@@ -56,22 +75,18 @@ static void ExtractFile (pack_t *pak, const char *filename, const char *destdir)
 	{
 		if (!filename)
 		{
-			fseek (pak->handle, pak->files[i].filepos, SEEK_SET);
 			strcpy (dptr, pak->files[i].name);
 			dest[sizeof(dest) - 1] = '\0';
 			printf ("%s --> %s\n", pak->files[i].name, dest);
-			if (Q_WriteFileFromHandle(pak->handle, dest, pak->files[i].filelen) != 0)
-				COM_Error ("I/O errors during copy.");
+			WritePakEntry (pak, i, dest);
 			continue;
 		}
 		if (!strcmp (pak->files[i].name, filename))
 		{
-			fseek (pak->handle, pak->files[i].filepos, SEEK_SET);
 			strcpy (dptr, pak->files[i].name);
 			dest[sizeof(dest) - 1] = '\0';
 			printf ("%s --> %s\n", pak->files[i].name, dest);
-			if (Q_WriteFileFromHandle(pak->handle, dest, pak->files[i].filelen) != 0)
-				COM_Error ("I/O errors during copy.");
+			WritePakEntry (pak, i, dest);
 			break;
 		}
 	}
@@ -0,0 +1,308 @@
+/* pakz.c -- compressed pack file creation tool.
+ * Copyright (C) 2026  uHexen2 developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "q_stdinc.h"
+#include "compiler.h"
+#include "arch_def.h"
+#include "cmdlib.h"
+#include "util_io.h"
+#include "q_endian.h"
+#include "byteordr.h"
+#include "pathutil.h"
+#include "pakfile.h"
+#include "pak.h"
+#include "lzpak.h"
+#include "filenames.h"
+
+//======================================================================
+
+typedef struct
+{
+	char	name[PAK_PATH_LENGTH];
+	pack_t	*pak;		/* from this pak, */
+	int	filenum;
+	const char	*path;	/* or from this file */
+} entry_t;
+
+static entry_t	entries[MAX_FILES_IN_PACK];
+static int	numentries;
+
+static void AddEntry (const char *name, pack_t *pak, int filenum, const char *path)
+{
+	const unsigned char	*p;
+	int	i;
+
+	if (strlen(name) >= PAK_PATH_LENGTH)
+		COM_Error ("%s: name too long (max. %d)", name, PAK_PATH_LENGTH - 1);
+	for (p = (const unsigned char *) name; *p; p++)
+	{
+		if (*p > 127)
+			COM_Error ("%s: names must be plain ascii", name);
+	}
+
+	/* a later input replaces an earlier file of the same name */
+	for (i = 0; i < numentries; i++)
+	{
+		if (!strcmp(entries[i].name, name))
+			break;
+	}
+	if (i == numentries)
+	{
+		if (numentries == MAX_FILES_IN_PACK)
+			COM_Error ("Too many files (max. allowed is %d)", MAX_FILES_IN_PACK);
+		numentries++;
+	}
+	strcpy (entries[i].name, name);
+	entries[i].pak = pak;
+	entries[i].filenum = filenum;
+	entries[i].path = path;
+}
+
+static int IsPackFile (const char *path)
+{
+	FILE	*f;
+	char	id[4];
+	size_t	len;
+
+	len = strlen(path);
+	if (len < 4 || q_strcasecmp(path + len - 4, ".pak") != 0)
+		return 0;
+	f = fopen (path, "rb");
+	if (!f)
+		return 0;
+	len = fread (id, 1, 4, f);
+	fclose (f);
+	return (len == 4 && id[0] == 'P' && id[1] == 'A' &&
+		((id[2] == 'C' && id[3] == 'K') || (id[2] == 'K' && id[3] == 'Z')));
+}
+
+static void AddInput (const char *path)
+{
+	char	name[1024], *p;
+	pack_t	*pak;
+	int	i;
+
+	if (IsPackFile(path))
+	{
+		pak = LoadPackFile (path);
+		if (!pak)
+			COM_Error ("Unable to open file %s", path);
+		for (i = 0; i < pak->numfiles; i++)
+			AddEntry (pak->files[i].name, pak, i, NULL);
+		return;
+	}
+
+	/* a loose file goes in under the path it was given with */
+	if (!(Q_FileType(path) & FS_ENT_FILE))
+		COM_Error ("%s is not a file", path);
+	while (path[0] == '.' && IS_DIR_SEPARATOR(path[1]))
+		path += 2;
+	if (IS_ABSOLUTE_PATH(path) || strstr(path, ".."))
+		COM_Error ("%s: give loose files with a relative path", path);
+	qerr_strlcpy(__thisfunc__, __LINE__, name, path, sizeof(name));
+	for (p = name; *p; p++)
+	{
+		if (*p == '\\')
+			*p = '/';
+	}
+	AddEntry (name, NULL, 0, path);
+}
+
+static int CompareEntries (const void *a, const void *b)
+{
+	return strcmp (((const entry_t *)a)->name, ((const entry_t *)b)->name);
+}
+
+/* compresses a file in PAKZ_BLOCKSIZE blocks behind its block table.
+ * returns the packed size, which is no smaller than len if the file
+ * should rather be stored. */
+static int PackBlocks (const unsigned char *in, int len, unsigned char *out)
+{
+	unsigned char	*p;
+	int	i, numblocks, ofs, blocklen, clen;
+
+	numblocks = (len + PAKZ_BLOCKSIZE - 1) / PAKZ_BLOCKSIZE;
+	ofs = (numblocks + 1) * 4;
+	for (i = 0; i <= numblocks; i++)
+	{
+		p = out + i * 4;
+		p[0] = ofs & 0xff;
+		p[1] = (ofs >> 8) & 0xff;
+		p[2] = (ofs >> 16) & 0xff;
+		p[3] = (ofs >> 24) & 0xff;
+		if (i == numblocks)
+			break;
+
+		blocklen = len - i * PAKZ_BLOCKSIZE;
+		if (blocklen > PAKZ_BLOCKSIZE)
+			blocklen = PAKZ_BLOCKSIZE;
+		clen = LZ_Compress (in + i * PAKZ_BLOCKSIZE, blocklen,
+				    out + ofs, LZ_CompressBound(blocklen));
+		if (clen == 0 || clen >= blocklen)
+		{	/* a whole block is stored raw */
+			memcpy (out + ofs, in + i * PAKZ_BLOCKSIZE, blocklen);
+			clen = blocklen;
+		}
+		ofs += clen;
+	}
+
+	return ofs;
+}
+
+static void WritePadding (FILE *f)
+{
+	static const char	zeros[PAKZ_ALIGN];
+	long	pos = ftell (f);
+
+	if (pos % PAKZ_ALIGN)
+		SafeWrite (f, zeros, PAKZ_ALIGN - pos % PAKZ_ALIGN);
+}
+
+static void WritePakZ (const char *filename, int store)
+{
+	dpackzheader_t	header;
+	dpackzfile_t	*dir;
+	unsigned char	*data, *packed;
+	FILE	*f;
+	int	i, len, packlen, numblocks;
+	double	total_in, total_out;
+
+	dir = (dpackzfile_t *) SafeMalloc (numentries * sizeof(dpackzfile_t));
+	f = SafeOpenWrite (filename);
+	memset (&header, 0, sizeof(header));
+	SafeWrite (f, &header, sizeof(header));
+
+	total_in = total_out = 0;
+	for (i = 0; i < numentries; i++)
+	{
+		if (entries[i].pak)
+		{
+			data = (unsigned char *) ReadPackFile (entries[i].pak, entries[i].filenum);
+			len = entries[i].pak->files[entries[i].filenum].filelen;
+		}
+		else
+		{
+			len = LoadFile (entries[i].path, (void **) &data);
+		}
+
+		WritePadding (f);
+		memset (&dir[i], 0, sizeof(dpackzfile_t));
+		strcpy (dir[i].name, entries[i].name);
+		dir[i].hash = LittleLong (PAKZ_HashName(entries[i].name));
+		dir[i].filepos = LittleLong (ftell(f));
+		dir[i].filelen = LittleLong (len);
+
+		packed = NULL;
+		packlen = len;
+		if (!store && len > 0)
+		{
+			numblocks = (len + PAKZ_BLOCKSIZE - 1) / PAKZ_BLOCKSIZE;
+			packed = (unsigned char *) SafeMalloc ((numblocks + 1) * 4 +
+						LZ_CompressBound(PAKZ_BLOCKSIZE) * numblocks);
+			packlen = PackBlocks (data, len, packed);
+		}
+		if (packed && packlen < len)
+		{
+			dir[i].method = LittleLong (PAKZ_LZBLOCKS);
+			SafeWrite (f, packed, packlen);
+		}
+		else
+		{
+			packlen = len;
+			dir[i].method = LittleLong (PAKZ_STORED);
+			SafeWrite (f, data, len);
+		}
+		dir[i].packlen = LittleLong (packlen);
+		printf ("%-56s%10d%10d\n", entries[i].name, len, packlen);
+
+		total_in += len;
+		total_out += packlen;
+		if (packed)
+			free (packed);
+		free (data);
+	}
+
+	WritePadding (f);
+	header.id[0] = 'P';
+	header.id[1] = 'A';
+	header.id[2] = 'K';
+	header.id[3] = 'Z';
+	header.version = LittleLong (PAKZ_VERSION);
+	header.dirofs = LittleLong (ftell(f));
+	header.numfiles = LittleLong (numentries);
+	SafeWrite (f, dir, numentries * sizeof(dpackzfile_t));
+	fseek (f, 0, SEEK_SET);
+	SafeWrite (f, &header, sizeof(header));
+	fclose (f);
+	free (dir);
+
+	printf ("Wrote %s: %d files, %.0f bytes packed into %.0f (%.1f%%)\n",
+			filename, numentries, total_in, total_out,
+			total_in ? 100.0 * total_out / total_in : 100.0);
+}
+
+FUNC_NORETURN static void usage (int ret) {
+	printf ("Usage:  pakz [-store] <output> <input> [input ....]\n");
+	printf ("        pakz  -h  to display this help message.\n");
+	printf ("-store :  Optional. Don't compress, only sort and align.\n");
+	printf ("An input is either a pak file (PACK or PAKZ), all of which is\n");
+	printf ("added, or a loose file, added under its relative path.  Later\n");
+	printf ("inputs replace the files of the same name from earlier ones.\n");
+	printf ("\n");
+	exit (ret);
+}
+
+int main (int argc, char **argv)
+{
+	const char	*output;
+	int	i, store;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-h"))
+			usage (0);
+	}
+
+	i = 1;
+	store = 0;
+	if (i < argc && !strcmp(argv[i], "-store"))
+	{
+		store = 1;
+		i++;
+	}
+	if (argc - i < 2)
+		usage (1);
+
+	ValidateByteorder ();
+
+	output = argv[i];
+	for (i = i + 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], output))
+			COM_Error ("%s is both the output and an input", output);
+		AddInput (argv[i]);
+	}
+	if (!numentries)
+		COM_Error ("No files to pack.");
+	qsort (entries, numentries, sizeof(entry_t), CompareEntries);
+
+	WritePakZ (output, store);
+
+	return 0;
+}